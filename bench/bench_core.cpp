@@ -0,0 +1,591 @@
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTemporaryFile>
+#include <QtTest>
+#include "intervalindex.h"
+#include "qcengine.h"
+#include "searchindex.h"
+#include "spellchecker.h"
+#include "spelldictionary.h"
+#include "srtblockindex.h"
+#include "srtgenerator.h"
+#include "srtparser.h"
+#include "srtwriter.h"
+#include "subtitlecache.h"
+#include "subtitlediff.h"
+#include "subtitlefile.h"
+#include "subtitlemodel.h"
+#include "subtitlestore.h"
+#include "textencoding.h"
+#include "timingengine.h"
+#include "trace.h"
+
+namespace {
+
+struct Dataset {
+    const char *name;
+    SrtGeneratorOptions options;
+};
+
+// { cues, linesPerCue, charsPerLine, crlf, bom, malformedEvery }
+const Dataset Datasets[] = {
+    { "1k",             { 1000,    2, 38, false, false, 0 } },
+    { "100k",           { 100000,  2, 38, false, false, 0 } },
+    { "1M",             { 1000000, 2, 38, false, false, 0 } },
+    { "long-multiline", { 20000,   8, 70, false, false, 0 } },
+    { "crlf",           { 100000,  2, 38, true,  false, 0 } },
+    { "bom",            { 100000,  2, 38, false, true,  0 } },
+    { "malformed",      { 100000,  2, 38, false, false, 7 } },
+};
+
+void addDatasets() {
+    QTest::addColumn<int>("dataset");
+    for (int i = 0; i < int(std::size(Datasets)); ++i)
+        QTest::newRow(Datasets[i].name) << i;
+}
+
+// QBENCHMARK reports time per iteration; throughput is printed next to it.
+void reportThroughput(qint64 bytes, qint64 cues, qint64 elapsedNs, int runs) {
+    if (runs == 0 || elapsedNs == 0) return;
+    const double seconds = elapsedNs / 1e9 / runs;
+    if (bytes > 0) {
+        qInfo("%s: %.1f MB/s, %.0f cues/s", QTest::currentDataTag(),
+              bytes / 1e6 / seconds, cues / seconds);
+    } else {
+        qInfo("%s: %.0f cues/s", QTest::currentDataTag(), cues / seconds);
+    }
+}
+
+} // namespace
+
+class BenchCore : public QObject {
+    Q_OBJECT
+
+private slots:
+    // keep the cache entries out of the user's cache directory
+    void initTestCase() { QStandardPaths::setTestModeEnabled(true); }
+    void loadSrt_data() { addDatasets(); }
+    void loadSrt();
+    void parseParallel_data();
+    void parseParallel();
+    void detectEncoding_data() { addDatasets(); }
+    void detectEncoding();
+    void loadCached_data() { addDatasets(); }
+    void loadCached();
+    void saveSrt_data() { addDatasets(); }
+    void saveSrt();
+    void convertAssToVtt_data() { addDatasets(); }
+    void convertAssToVtt();
+    void computeCps_data() { addDatasets(); }
+    void computeCps();
+    void countCharacters_data() { addDatasets(); }
+    void countCharacters();
+    void modelData_data() { addDatasets(); }
+    void modelData();
+    void qcFull_data() { addDatasets(); }
+    void qcFull();
+    void qcRecheck_data() { addDatasets(); }
+    void qcRecheck();
+    void qcRetime_data() { addDatasets(); }
+    void qcRetime();
+    void search_data() { addDatasets(); }
+    void search();
+    void compareVersions_data() { addDatasets(); }
+    void compareVersions();
+    void reloadChanged_data() { addDatasets(); }
+    void reloadChanged();
+    void spellCheck_data() { addDatasets(); }
+    void spellCheck();
+    void retimeBoundary();
+    void traceScope_data();
+    void traceScope();
+
+private:
+    // Generated once per dataset and kept in a temporary directory.
+    QString inputPath(int dataset);
+
+    QTemporaryDir dir_;
+    QHash<int, QString> inputs_;
+};
+
+QString BenchCore::inputPath(int dataset) {
+    auto it = inputs_.constFind(dataset);
+    if (it != inputs_.constEnd()) return *it;
+    const QString path = dir_.filePath(QString::fromLatin1(Datasets[dataset].name) + ".srt");
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly)) return QString();
+    f.write(generateSrt(Datasets[dataset].options));
+    inputs_.insert(dataset, path);
+    return path;
+}
+
+void BenchCore::loadSrt() {
+    QFETCH(int, dataset);
+    const QString path = inputPath(dataset);
+    QVERIFY(!path.isEmpty());
+
+    SubtitleModel model;
+    QElapsedTimer clock;
+    int runs = 0;
+    clock.start();
+    QBENCHMARK {
+        QVERIFY(model.loadSrt(path));
+        ++runs;
+    }
+    reportThroughput(QFileInfo(path).size(), model.rowCount(), clock.nsecsElapsed(), runs);
+}
+
+void BenchCore::parseParallel_data() {
+    QTest::addColumn<int>("dataset");
+    QTest::addColumn<bool>("noIndex");
+    QTest::addColumn<int>("chunkSize"); // 0: what parseParallel picks
+    constexpr int Plain = 1;     // "100k"
+    constexpr int Malformed = 6; // "malformed"
+    QTest::newRow("malformed") << Malformed << false << 0;
+    QTest::newRow("no-index") << Plain << true << 0;
+    // a chunk every few cues, so boundaries land after every kind of break
+    QTest::newRow("chunk-boundary") << Malformed << false << 1000;
+}
+
+void BenchCore::parseParallel() {
+    QFETCH(int, dataset);
+    QFETCH(bool, noIndex);
+    QFETCH(int, chunkSize);
+    SrtGeneratorOptions options = Datasets[dataset].options;
+    options.noIndex = noIndex;
+    const QByteArray bytes = generateSrt(options);
+    const char *begin = bytes.constData();
+    const char *end = begin + bytes.size();
+    SubtitleStore serial;
+    int serialFallbacks = 0;
+    SrtParser::parse(begin, end, serial, serialFallbacks);
+
+    SubtitleStore parallel;
+    int parallelFallbacks = 0;
+    QElapsedTimer clock;
+    int runs = 0;
+    clock.start();
+    QBENCHMARK {
+        parallel.clear();
+        parallelFallbacks = 0;
+        if (chunkSize == 0) {
+            SrtParser::parseParallel(begin, end, parallel, parallelFallbacks);
+        } else {
+            const QVector<SrtParser::Chunk> chunks = SrtParser::splitChunks(begin, end, chunkSize);
+            SrtParser::parseChunks(chunks, parallelFallbacks, int(chunks.size()),
+                                   [&parallel](SubtitleStore &&cues, const char *) {
+                                       parallel.append(cues);
+                                       return true;
+                                   });
+        }
+        ++runs;
+    }
+    reportThroughput(bytes.size(), parallel.size(), clock.nsecsElapsed(), runs);
+
+    // the same store as the serial parse, column by column
+    QCOMPARE(parallelFallbacks, serialFallbacks);
+    QCOMPARE(parallel.size(), serial.size());
+    for (qsizetype i = 0; i < serial.size(); ++i) {
+        QCOMPARE(parallel.lineNumber(i), serial.lineNumber(i));
+        QCOMPARE(parallel.startMs(i), serial.startMs(i));
+        QCOMPARE(parallel.endMs(i), serial.endMs(i));
+        QCOMPARE(parallel.cps(i), serial.cps(i));
+        QCOMPARE(parallel.characters(i), serial.characters(i));
+        QCOMPARE(parallel.textView(i), serial.textView(i));
+    }
+}
+
+void BenchCore::detectEncoding() {
+    QFETCH(int, dataset);
+    const QString path = inputPath(dataset);
+    QVERIFY(!path.isEmpty());
+    QFile f(path);
+    QVERIFY(f.open(QIODevice::ReadOnly));
+    const QByteArray bytes = f.readAll();
+
+    // the share of loadSrt spent before the first cue is scanned
+    TextFormat format;
+    QElapsedTimer clock;
+    int runs = 0;
+    clock.start();
+    QBENCHMARK {
+        format = TextEncoding::detect(bytes.constData(), bytes.size());
+        ++runs;
+    }
+    QCOMPARE(format.encoding, QByteArray("UTF-8"));
+    QCOMPARE(format.crlf, Datasets[dataset].options.crlf);
+    reportThroughput(bytes.size(), 0, clock.nsecsElapsed(), runs);
+}
+
+void BenchCore::loadCached() {
+    QFETCH(int, dataset);
+    const QString path = inputPath(dataset);
+    QVERIFY(!path.isEmpty());
+    SubtitleStore parsed;
+    QVERIFY(SubtitleFile::read(path, parsed));
+    QFile f(path);
+    QVERIFY(f.open(QIODevice::ReadOnly));
+    const QByteArray bytes = f.readAll();
+    QVERIFY(SubtitleCache::save(SubtitleCache::keyFor(path, bytes.constData(), bytes.size()), parsed));
+
+    // what a reopen costs: map and hash the file, then map the cache entry
+    SubtitleStore store;
+    QElapsedTimer clock;
+    int runs = 0;
+    clock.start();
+    QBENCHMARK {
+        QVERIFY(SubtitleCache::read(path, store));
+        ++runs;
+    }
+    QCOMPARE(store.size(), parsed.size());
+    reportThroughput(bytes.size(), store.size(), clock.nsecsElapsed(), runs);
+}
+
+void BenchCore::saveSrt() {
+    QFETCH(int, dataset);
+    SubtitleModel model;
+    QVERIFY(model.loadSrt(inputPath(dataset)));
+    const QString out = dir_.filePath("out.srt");
+
+    QElapsedTimer clock;
+    int runs = 0;
+    clock.start();
+    QBENCHMARK {
+        QVERIFY(model.saveSrt(out));
+        ++runs;
+    }
+    reportThroughput(QFileInfo(out).size(), model.rowCount(), clock.nsecsElapsed(), runs);
+}
+
+void BenchCore::convertAssToVtt() {
+    QFETCH(int, dataset);
+    SubtitleStore store;
+    QVERIFY(SubtitleFile::read(inputPath(dataset), store));
+    SrtWriteOptions options;
+    options.format = SubtitleFormat::Ass;
+    const QString in = dir_.filePath("in.ass");
+    QVERIFY(SubtitleFile::write(in, store, options));
+    const QString out = dir_.filePath("out.vtt");
+    options.format = SubtitleFormat::WebVtt;
+
+    // one scan into the store, one write out of it
+    QElapsedTimer clock;
+    int runs = 0;
+    clock.start();
+    QBENCHMARK {
+        SubtitleStore ass;
+        QVERIFY(SubtitleFile::read(in, ass));
+        QVERIFY(SubtitleFile::write(out, ass, options));
+        ++runs;
+    }
+    SubtitleStore vtt;
+    QVERIFY(SubtitleFile::read(out, vtt));
+    QCOMPARE(vtt.size(), store.size());
+    reportThroughput(QFileInfo(in).size(), store.size(), clock.nsecsElapsed(), runs);
+}
+
+void BenchCore::computeCps() {
+    QFETCH(int, dataset);
+    SubtitleStore store;
+    QVERIFY(SubtitleFile::read(inputPath(dataset), store));
+    QVERIFY(!store.isEmpty());
+
+    QElapsedTimer clock;
+    int runs = 0;
+    clock.start();
+    QBENCHMARK {
+        store.updateCps(0, store.size() - 1);
+        ++runs;
+    }
+    reportThroughput(0, store.size(), clock.nsecsElapsed(), runs);
+}
+
+void BenchCore::countCharacters() {
+    QFETCH(int, dataset);
+    SubtitleStore store;
+    QVERIFY(SubtitleFile::read(inputPath(dataset), store));
+    QVERIFY(!store.isEmpty());
+
+    // what a change of the CPS rules costs; computeCps above is a retime
+    QElapsedTimer clock;
+    int runs = 0;
+    clock.start();
+    QBENCHMARK {
+        store.recountCharacters();
+        ++runs;
+    }
+    reportThroughput(0, store.size(), clock.nsecsElapsed(), runs);
+}
+
+void BenchCore::modelData() {
+    QFETCH(int, dataset);
+    SubtitleModel model;
+    QVERIFY(model.loadSrt(inputPath(dataset)));
+    const int rows = model.rowCount();
+    const int cols = model.columnCount();
+
+    QElapsedTimer clock;
+    int runs = 0;
+    qint64 checksum = 0;
+    clock.start();
+    QBENCHMARK {
+        // what a view does for every visible cell, over the whole model
+        for (int r = 0; r < rows; ++r) {
+            for (int c = 0; c < cols; ++c)
+                checksum += model.data(model.index(r, c), Qt::DisplayRole).toString().size();
+        }
+        ++runs;
+    }
+    QVERIFY(checksum > 0);
+    reportThroughput(0, rows, clock.nsecsElapsed(), runs);
+}
+
+void BenchCore::qcFull() {
+    QFETCH(int, dataset);
+    SubtitleStore store;
+    QVERIFY(SubtitleFile::read(inputPath(dataset), store));
+    IntervalIndex intervals;
+    intervals.rebuild(store);
+    QcEngine qc;
+
+    QElapsedTimer clock;
+    int runs = 0;
+    clock.start();
+    QBENCHMARK {
+        qc.checkAll(store, intervals);
+        ++runs;
+    }
+    reportThroughput(0, store.size(), clock.nsecsElapsed(), runs);
+}
+
+void BenchCore::qcRecheck() {
+    QFETCH(int, dataset);
+    SubtitleStore store;
+    QVERIFY(SubtitleFile::read(inputPath(dataset), store));
+    IntervalIndex intervals;
+    intervals.rebuild(store);
+    QcEngine qc;
+    qc.checkAll(store, intervals);
+    const int row = int(store.size() / 2);
+    const QString text = store.text(row);
+
+    // what one committed keystroke costs
+    QElapsedTimer clock;
+    int runs = 0;
+    clock.start();
+    QBENCHMARK {
+        store.setText(row, text);
+        qc.recheck(store, intervals, row, row, false);
+        ++runs;
+    }
+    reportThroughput(0, 1, clock.nsecsElapsed(), runs);
+}
+
+void BenchCore::qcRetime() {
+    QFETCH(int, dataset);
+    SubtitleStore store;
+    QVERIFY(SubtitleFile::read(inputPath(dataset), store));
+    IntervalIndex intervals;
+    intervals.rebuild(store);
+    QcEngine qc;
+    qc.checkAll(store, intervals);
+    const int row = int(store.size() / 2);
+    const int start = store.startMs(row);
+    const int end = store.endMs(row);
+
+    // what one nudge of a cue's timing costs: the index and the overlap
+    // flags follow the one row
+    QElapsedTimer clock;
+    int runs = 0;
+    clock.start();
+    QBENCHMARK {
+        const int delta = runs % 2 ? 0 : 10;
+        store.setTiming(row, start + delta, end + delta);
+        store.updateCps(row, row);
+        intervals.updateRows(store, row, row);
+        qc.recheck(store, intervals, row, row, true);
+        ++runs;
+    }
+    reportThroughput(0, 1, clock.nsecsElapsed(), runs);
+}
+
+void BenchCore::search() {
+    QFETCH(int, dataset);
+    SubtitleStore store;
+    QVERIFY(SubtitleFile::read(inputPath(dataset), store));
+    SearchIndex index;
+    QElapsedTimer build;
+    build.start();
+    index.rebuild(store);
+    qInfo("%s: index built in %lld ms", QTest::currentDataTag(), build.elapsed());
+
+    // what a keystroke in the find field costs once the index exists
+    const QString needle = QStringLiteral("fix this");
+    QVector<int> rows;
+    QElapsedTimer clock;
+    int runs = 0;
+    clock.start();
+    QBENCHMARK {
+        rows = index.find(store, needle, Qt::CaseInsensitive);
+        ++runs;
+    }
+    int expected = 0;
+    for (int r = 0; r < store.size(); ++r) expected += SearchIndex::matches(store.textView(r), needle, Qt::CaseInsensitive);
+    QCOMPARE(rows.size(), expected);
+    reportThroughput(0, store.size(), clock.nsecsElapsed(), runs);
+}
+
+void BenchCore::compareVersions() {
+    QFETCH(int, dataset);
+    SubtitleStore store;
+    QVERIFY(SubtitleFile::read(inputPath(dataset), store));
+
+    // a reviewed copy: some cues retimed, some reworded, some deleted
+    SubtitleStore other = store;
+    for (qsizetype i = other.size() - 1; i >= 0; --i) {
+        if (i % 97 == 0) other.remove(i, 1);
+        else if (i % 101 == 0) other.setText(i, other.text(i) + QStringLiteral(" (fixed)"));
+        else if (i % 50 == 0 && other.startMs(i) != SubtitleStore::NoTime) other.setTiming(i, other.startMs(i) + 40, other.endMs(i) + 40);
+    }
+
+    QVector<CueChange> changes;
+    QElapsedTimer clock;
+    int runs = 0;
+    clock.start();
+    QBENCHMARK {
+        changes = SubtitleDiff::compare(store, other);
+        ++runs;
+    }
+    reportThroughput(0, store.size(), clock.nsecsElapsed(), runs);
+    // accepting everything gives the other version back
+    const SubtitleStore merged = store.spliced(SubtitleDiff::splices(changes, other));
+    QCOMPARE(merged.size(), other.size());
+    QVERIFY(SubtitleDiff::compare(merged, other).isEmpty());
+}
+
+void BenchCore::reloadChanged() {
+    QFETCH(int, dataset);
+    QFile f(inputPath(dataset));
+    QVERIFY(f.open(QIODevice::ReadOnly));
+    const QByteArray bytes = f.readAll();
+    const TextFormat format = TextEncoding::detect(bytes.constData(), bytes.size());
+    SrtBlockIndex indexed;
+    QVERIFY(indexed.build(bytes.constData(), bytes.size(), format));
+
+    // another program rewords one line in the middle of the file
+    QByteArray edited = bytes;
+    const qsizetype line = edited.indexOf('\n', edited.size() / 2) + 1;
+    edited.insert(line, "(edited) ");
+
+    SrtBlockIndex::Change change;
+    QElapsedTimer clock;
+    int runs = 0;
+    clock.start();
+    QBENCHMARK {
+        SrtBlockIndex index = indexed;
+        QVERIFY(index.update(edited.constData(), edited.size(), change));
+        ++runs;
+    }
+    reportThroughput(edited.size(), change.cues.size(), clock.nsecsElapsed(), runs);
+    // the few cues parsed again turn the old version into the new one
+    SubtitleStore before;
+    SubtitleStore after;
+    QVERIFY(SubtitleFile::read(f.fileName(), before));
+    QTemporaryFile newFile(dir_.filePath(QStringLiteral("edited-XXXXXX.srt")));
+    QVERIFY(newFile.open());
+    newFile.write(edited);
+    newFile.close();
+    QVERIFY(SubtitleFile::read(newFile.fileName(), after));
+    QVERIFY(change.cues.size() < 4096);
+    const SubtitleStore applied = before.spliced({ CueSplice { change.firstRow, change.removedRows, change.cues } });
+    QVERIFY(SubtitleDiff::compare(applied, after).isEmpty());
+}
+
+void BenchCore::spellCheck() {
+    QFETCH(int, dataset);
+    SubtitleStore store;
+    QVERIFY(SubtitleFile::read(inputPath(dataset), store));
+    // the generator's words, a few of them only through an affix rule and
+    // "canción" missing
+    const QByteArray aff = "SET UTF-8\nSFX S Y 1\nSFX S 0 s .\nPFX U Y 1\nPFX U 0 un .\n";
+    const QByteArray dic = "21\nthe\nsubtitle/SU\ntiming/S\nis\noff\nby\none/S\nframe/SU\nagain\nniño/S\n"
+                           "mañana\nqué\npasó\nüber\ncafé\ndéjà\nvu\nno\nway/S\nwe\ncan\nfix/U\nthis\nbefore\nrelease/S\n";
+    SpellDictionary dictionary;
+    QVERIFY(dictionary.build(aff, dic));
+    QVERIFY(dictionary.check(QStringLiteral("unsubtitles")));
+    QVERIFY(dictionary.check(QStringLiteral("Timing")));
+    QVERIFY(!dictionary.check(QStringLiteral("canción")));
+
+    // what the background check after a load costs, on one thread
+    int misspelled = 0;
+    QElapsedTimer clock;
+    int runs = 0;
+    clock.start();
+    QBENCHMARK {
+        misspelled = 0;
+        for (int r = 0; r < store.size(); ++r)
+            misspelled += int(SpellChecker::misspellings(dictionary, store.textView(r)).size());
+        ++runs;
+    }
+    QVERIFY(misspelled > 0);
+    reportThroughput(0, store.size(), clock.nsecsElapsed(), runs);
+}
+
+void BenchCore::retimeBoundary() {
+    // shifting past 99:59:59,999 stops there, and what is written reads back
+    SubtitleStore store;
+    store.append(1, SubtitleStore::MaxTime - 2000, SubtitleStore::MaxTime - 1000, u"last");
+    store.append(2, 1000, 2000, u"first");
+    TimingEngine::shift(store.startMsData(), store.size(), 3600000, SubtitleStore::NoTime);
+    TimingEngine::shift(store.endMsData(), store.size(), 3600000, SubtitleStore::NoTime);
+    store.updateCps(0, store.size() - 1);
+    QCOMPARE(store.startMs(0), SubtitleStore::MaxTime);
+    QCOMPARE(store.endMs(0), SubtitleStore::MaxTime);
+    QCOMPARE(store.startMs(1), 3601000);
+
+    QBuffer out;
+    QVERIFY(out.open(QIODevice::WriteOnly));
+    SrtWriter writer;
+    QVERIFY(writer.write(&out, store));
+    QVERIFY(out.data().contains("99:59:59,999 --> 99:59:59,999"));
+    SubtitleStore read;
+    int fallbackCounter = 0;
+    SrtParser::parse(out.data().constBegin(), out.data().constEnd(), read, fallbackCounter);
+    QCOMPARE(read.size(), store.size());
+    for (qsizetype i = 0; i < store.size(); ++i) {
+        QCOMPARE(read.startMs(i), store.startMs(i));
+        QCOMPARE(read.endMs(i), store.endMs(i));
+    }
+}
+
+void BenchCore::traceScope_data() {
+    QTest::addColumn<bool>("enabled");
+    QTest::newRow("disabled") << false;
+    QTest::newRow("enabled") << true;
+}
+
+void BenchCore::traceScope() {
+    QFETCH(bool, enabled);
+    // what a span costs a hot path such as item painting
+    constexpr int Spans = 100000;
+    Trace::setEnabled(enabled);
+    QElapsedTimer clock;
+    int runs = 0;
+    clock.start();
+    QBENCHMARK {
+        for (int i = 0; i < Spans; ++i) {
+            TRACE_SCOPE("bench");
+        }
+        ++runs;
+    }
+    Trace::setEnabled(false);
+    if (runs > 0) qInfo("%s: %.1f ns per span", QTest::currentDataTag(), double(clock.nsecsElapsed()) / runs / Spans);
+}
+
+QTEST_GUILESS_MAIN(BenchCore)
+#include "bench_core.moc"
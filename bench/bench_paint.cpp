@@ -0,0 +1,171 @@
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QImage>
+#include <QPainter>
+#include <QSettings>
+#include <QStandardItemModel>
+#include <QStandardPaths>
+#include <QtTest>
+#include "appsettings.h"
+#include "cpsdelegate.h"
+#include "textdelegate.h"
+#include <algorithm>
+
+namespace {
+
+constexpr int Rows = 2000;
+constexpr int CellWidth = 60;
+constexpr int CellHeight = 22;
+constexpr int TextCellWidth = 600;
+
+// The CPS delegate as it was before the lookup table: QSettings and two
+// floating-point blends for every cell. Kept here as the baseline.
+class SettingsPerPaintDelegate : public QStyledItemDelegate {
+public:
+    void paint(QPainter *painter, const QStyleOptionViewItem &option,
+               const QModelIndex &index) const override
+    {
+        bool ok = false;
+        const int cps = index.data(Qt::DisplayRole).toInt(&ok);
+        if (!ok || cps <= 0) {
+            QStyledItemDelegate::paint(painter, option, index);
+            return;
+        }
+        QSettings s;
+        int warn = s.value("Subtitle/CPSWarning", 15).toInt();
+        int error = s.value("Subtitle/CPSError", 25).toInt();
+        QColor errorColor = s.value("Colour/CpsError", QColor(255,0,0)).value<QColor>();
+        if (error < warn) error = warn;
+        if (cps <= warn) {
+            QStyledItemDelegate::paint(painter, option, index);
+            return;
+        }
+        const double alpha = std::clamp(double(cps - warn + 1) / double(error - warn + 1), 0.0, 1.0);
+        QColor baseBg = option.palette.color(QPalette::Base);
+        if (option.features.testFlag(QStyleOptionViewItem::Alternate))
+            baseBg = option.palette.color(QPalette::AlternateBase);
+
+        painter->save();
+        painter->setPen(Qt::NoPen);
+        painter->setBrush(CPSDelegate::blend(errorColor, baseBg, alpha));
+        QRect r = option.rect;
+        r.adjust(0, 1, 0, 0);
+        painter->drawRect(r);
+        painter->setPen(CPSDelegate::blend(QColor(0,0,0), option.palette.color(QPalette::Text), alpha));
+        painter->drawText(option.rect, Qt::AlignCenter, index.data(Qt::DisplayRole).toString());
+        painter->restore();
+    }
+};
+
+} // namespace
+
+class BenchPaint : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void paintCps_data();
+    void paintCps();
+    void paintText_data();
+    void paintText();
+
+private:
+    QStandardItemModel model_;
+    QStandardItemModel textModel_;
+};
+
+void BenchPaint::initTestCase() {
+    QStandardPaths::setTestModeEnabled(true);
+    AppSettings::instance()->reload();
+    // CPS values spread over the plain, gradient and saturated ranges
+    model_.setRowCount(Rows);
+    model_.setColumnCount(1);
+    for (int r = 0; r < Rows; ++r)
+        model_.setData(model_.index(r, 0), (r * 7) % 40);
+
+    // dense two-line cues as the table shows them, some with tags
+    textModel_.setRowCount(Rows);
+    textModel_.setColumnCount(1);
+    for (int r = 0; r < Rows; ++r) {
+        const QString first = QStringLiteral("Line %1 of a fairly long subtitle cue").arg(r);
+        const QString second = r % 3 ? QStringLiteral("and its second line, ending here.")
+                                     : QStringLiteral("<i>and an italic second line</i>");
+        textModel_.setData(textModel_.index(r, 0), first + QStringLiteral(" \u21B5 ") + second);
+    }
+}
+
+void BenchPaint::paintCps_data() {
+    QTest::addColumn<bool>("cached");
+    QTest::newRow("settings-per-paint") << false;
+    QTest::newRow("lookup-table") << true;
+}
+
+void BenchPaint::paintCps() {
+    QFETCH(bool, cached);
+    SettingsPerPaintDelegate baseline;
+    CPSDelegate delegate;
+    QStyledItemDelegate *d = cached ? static_cast<QStyledItemDelegate *>(&delegate) : &baseline;
+
+    QImage image(CellWidth, CellHeight, QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&image);
+    QStyleOptionViewItem option;
+    option.rect = QRect(0, 0, CellWidth, CellHeight);
+    option.palette = QGuiApplication::palette();
+
+    QElapsedTimer clock;
+    int runs = 0;
+    clock.start();
+    QBENCHMARK {
+        // one full scroll through the column
+        for (int r = 0; r < Rows; ++r) {
+            option.features.setFlag(QStyleOptionViewItem::Alternate, r % 2);
+            d->paint(&painter, option, model_.index(r, 0));
+        }
+        ++runs;
+    }
+    if (runs > 0)
+        qInfo("%s: %.0f ns per cell", QTest::currentDataTag(), double(clock.nsecsElapsed()) / runs / Rows);
+}
+
+void BenchPaint::paintText_data() {
+    QTest::addColumn<bool>("cached");
+    QTest::addColumn<bool>("tags");
+    QTest::newRow("styled-delegate") << false << false;
+    QTest::newRow("static-text") << true << false;
+    QTest::newRow("static-text-tags") << true << true;
+}
+
+void BenchPaint::paintText() {
+    QFETCH(bool, cached);
+    QFETCH(bool, tags);
+    AppSettings::instance()->setRenderTextTags(tags);
+    QStyledItemDelegate plain;
+    TextDelegate delegate(&textModel_, 0);
+    QStyledItemDelegate *d = cached ? static_cast<QStyledItemDelegate *>(&delegate) : &plain;
+
+    QImage image(TextCellWidth, CellHeight, QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&image);
+    QStyleOptionViewItem option;
+    option.rect = QRect(0, 0, TextCellWidth, CellHeight);
+    option.palette = QGuiApplication::palette();
+    option.font = QGuiApplication::font();
+    option.state = QStyle::State_Enabled | QStyle::State_Active;
+
+    // scrolling back and forth over one screenful of rows: after the first
+    // pass the cached delegate only draws
+    constexpr int Visible = 40;
+    QElapsedTimer clock;
+    int runs = 0;
+    clock.start();
+    QBENCHMARK {
+        for (int r = 0; r < Rows; ++r) {
+            d->paint(&painter, option, textModel_.index(r % Visible, 0));
+        }
+        ++runs;
+    }
+    if (runs > 0)
+        qInfo("%s: %.0f ns per cell", QTest::currentDataTag(), double(clock.nsecsElapsed()) / runs / Rows);
+}
+
+QTEST_MAIN(BenchPaint)
+#include "bench_paint.moc"
@@ -0,0 +1,75 @@
+#include "srtgenerator.h"
+#include <cstdio>
+
+namespace {
+
+const char *const Words[] = {
+    "the", "subtitle", "timing", "is", "off", "by", "one", "frame", "again",
+    "canción", "niño", "mañana", "qué", "pasó", "über", "café", "déjà", "vu",
+    "no", "way", "we", "can", "fix", "this", "before", "release",
+};
+constexpr int WordCount = int(sizeof(Words) / sizeof(Words[0]));
+
+void appendTime(QByteArray &out, qint64 ms, char sep = ',') {
+    char buf[16];
+    const int n = std::snprintf(buf, sizeof(buf), "%02lld:%02lld:%02lld%c%03lld",
+                                ms / 3600000, (ms / 60000) % 60, (ms / 1000) % 60, sep, ms % 1000);
+    out.append(buf, n);
+}
+
+} // namespace
+
+QByteArray generateSrt(const SrtGeneratorOptions &o) {
+    const char *eol = o.crlf ? "\r\n" : "\n";
+    QByteArray out;
+    out.reserve(qsizetype(o.cues) * (40 + o.linesPerCue * (o.charsPerLine + 2)));
+    if (o.bom) out.append("\xEF\xBB\xBF");
+
+    quint32 seed = 12345;
+    auto next = [&seed] {
+        seed = seed * 1664525u + 1013904223u; // LCG, only needs to be repeatable
+        return seed >> 8;
+    };
+
+    qint64 t = 1000;
+    for (int i = 0; i < o.cues; ++i) {
+        const int broken = (o.malformedEvery > 0 && i % o.malformedEvery == o.malformedEvery - 1)
+                               ? int(next() % 4) + 1 : 0;
+        const qint64 start = t;
+        const qint64 end = start + 800 + next() % 4000;
+        t = end + 100 + next() % 1500;
+
+        // 1: index that is not a number
+        if (!o.noIndex) {
+            out.append(broken == 1 ? QByteArray("x") : QByteArray::number(i + 1));
+            out.append(eol);
+        }
+        // 2: no timing line; 3: '.' separator with stray spaces
+        if (broken != 2) {
+            appendTime(out, start, broken == 3 ? '.' : ',');
+            out.append(broken == 3 ? "  -->   " : " --> ");
+            appendTime(out, end, broken == 3 ? '.' : ',');
+            out.append(eol);
+        }
+        for (int l = 0; l < o.linesPerCue; ++l) {
+            int len = 0;
+            while (len < o.charsPerLine) {
+                const char *w = Words[next() % WordCount];
+                if (len > 0) {
+                    out.append(' ');
+                    ++len;
+                }
+                out.append(w);
+                len += int(qstrlen(w));
+            }
+            out.append(eol);
+        }
+        out.append(eol);
+        // 4: whitespace-only lines between cues
+        if (broken == 4) {
+            out.append("  \t");
+            out.append(eol);
+        }
+    }
+    return out;
+}
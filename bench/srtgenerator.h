@@ -0,0 +1,16 @@
+#pragma once
+#include <QByteArray>
+
+struct SrtGeneratorOptions {
+    int cues = 1000;
+    int linesPerCue = 2;
+    int charsPerLine = 38;
+    bool crlf = false;
+    bool bom = false;
+    int malformedEvery = 0; // every n-th cue is broken in one of a few ways; 0 = never
+    bool noIndex = false;   // cues start at their timing line (numbered by the parser)
+};
+
+// Deterministic synthetic SubRip data: the same options always give the same
+// bytes, so runs are comparable. Text mixes ASCII and accented words.
+QByteArray generateSrt(const SrtGeneratorOptions &options);
@@ -0,0 +1,104 @@
+#include "appsettings.h"
+#include <QSettings>
+
+AppSettings::AppSettings() {
+    reload();
+}
+
+AppSettings *AppSettings::instance() {
+    static AppSettings settings;
+    return &settings;
+}
+
+void AppSettings::reload() {
+    QSettings s;
+    cpsWarning_ = s.value("Subtitle/CPSWarning", 15).toInt();
+    cpsError_ = qMax(cpsWarning_, s.value("Subtitle/CPSError", 25).toInt());
+    cpsErrorColour_ = s.value("Colour/CpsError", QColor(255, 0, 0)).value<QColor>();
+    overlapColour_ = s.value("Colour/Overlap", QColor(255, 170, 0, 110)).value<QColor>();
+    qcIssueColour_ = s.value("Colour/QcIssue", QColor(220, 60, 60, 90)).value<QColor>();
+    searchMatchColour_ = s.value("Colour/SearchMatch", QColor(255, 220, 0, 110)).value<QColor>();
+    diffChangedColour_ = s.value("Colour/DiffChanged", QColor(70, 130, 230, 70)).value<QColor>();
+    diffAddedColour_ = s.value("Colour/DiffAdded", QColor(60, 180, 75, 70)).value<QColor>();
+    diffRemovedColour_ = s.value("Colour/DiffRemoved", QColor(230, 80, 80, 70)).value<QColor>();
+    diffConflictColour_ = s.value("Colour/DiffConflict", QColor(170, 70, 200, 100)).value<QColor>();
+    misspellingColour_ = s.value("Colour/Misspelling", QColor(230, 30, 30)).value<QColor>();
+    renderTextTags_ = s.value("Table/RenderTags", false).toBool();
+    const QcOptions defaults;
+    qcOptions_.minDurationMs = s.value("QC/MinDurationMs", defaults.minDurationMs).toInt();
+    qcOptions_.maxDurationMs = s.value("QC/MaxDurationMs", defaults.maxDurationMs).toInt();
+    qcOptions_.minGapMs = s.value("QC/MinGapMs", defaults.minGapMs).toInt();
+    qcOptions_.maxLineLength = s.value("QC/MaxLineLength", defaults.maxLineLength).toInt();
+    qcOptions_.maxLines = s.value("QC/MaxLines", defaults.maxLines).toInt();
+    qcOptions_.maxCps = s.value("QC/MaxCps", defaults.maxCps).toInt();
+    const CpsOptions cpsDefaults;
+    cpsOptions_.countSpaces = s.value("CPS/CountSpaces", cpsDefaults.countSpaces).toBool();
+    cpsOptions_.countLineBreaks = s.value("CPS/CountLineBreaks", cpsDefaults.countLineBreaks).toBool();
+    spellCheck_ = s.value("Spelling/Enabled", true).toBool();
+    spellDictionary_ = s.value("Spelling/Dictionary").toString();
+    emit cpsColoursChanged();
+    emit textRenderingChanged();
+    emit qcOptionsChanged();
+    emit cpsOptionsChanged();
+    emit spellingChanged();
+}
+
+void AppSettings::setCpsThresholds(int warning, int error) {
+    error = qMax(warning, error);
+    if (warning == cpsWarning_ && error == cpsError_) return;
+    QSettings s;
+    s.setValue("Subtitle/CPSWarning", warning);
+    s.setValue("Subtitle/CPSError", error);
+    cpsWarning_ = warning;
+    cpsError_ = error;
+    emit cpsColoursChanged();
+}
+
+void AppSettings::setCpsErrorColour(const QColor &colour) {
+    if (colour == cpsErrorColour_) return;
+    QSettings().setValue("Colour/CpsError", colour);
+    cpsErrorColour_ = colour;
+    emit cpsColoursChanged();
+}
+
+void AppSettings::setRenderTextTags(bool render) {
+    if (render == renderTextTags_) return;
+    QSettings().setValue("Table/RenderTags", render);
+    renderTextTags_ = render;
+    emit textRenderingChanged();
+}
+
+void AppSettings::setQcOptions(const QcOptions &options) {
+    QSettings s;
+    s.setValue("QC/MinDurationMs", options.minDurationMs);
+    s.setValue("QC/MaxDurationMs", options.maxDurationMs);
+    s.setValue("QC/MinGapMs", options.minGapMs);
+    s.setValue("QC/MaxLineLength", options.maxLineLength);
+    s.setValue("QC/MaxLines", options.maxLines);
+    s.setValue("QC/MaxCps", options.maxCps);
+    qcOptions_ = options;
+    emit qcOptionsChanged();
+}
+
+void AppSettings::setCpsOptions(const CpsOptions &options) {
+    if (options == cpsOptions_) return;
+    QSettings s;
+    s.setValue("CPS/CountSpaces", options.countSpaces);
+    s.setValue("CPS/CountLineBreaks", options.countLineBreaks);
+    cpsOptions_ = options;
+    emit cpsOptionsChanged();
+}
+
+void AppSettings::setSpellCheck(bool enabled) {
+    if (enabled == spellCheck_) return;
+    QSettings().setValue("Spelling/Enabled", enabled);
+    spellCheck_ = enabled;
+    emit spellingChanged();
+}
+
+void AppSettings::setSpellDictionary(const QString &dicPath) {
+    if (dicPath == spellDictionary_) return;
+    QSettings().setValue("Spelling/Dictionary", dicPath);
+    spellDictionary_ = dicPath;
+    emit spellingChanged();
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <QColor>
+#include <QObject>
+#include "qcengine.h"
+#include "subtitlestore.h"
+
+// Process-wide cache of the user settings that are read on hot paths (item
+// painting). Values are loaded from QSettings once and kept in plain members;
+// the setters write through to QSettings and notify listeners, so nobody
+// has to poll.
+class AppSettings : public QObject {
+    Q_OBJECT
+public:
+    static AppSettings *instance();
+
+    // CPS at which a cell starts turning the error colour, and CPS at which
+    // it is fully coloured (never below cpsWarning()).
+    int cpsWarning() const { return cpsWarning_; }
+    int cpsError() const { return cpsError_; }
+    QColor cpsErrorColour() const { return cpsErrorColour_; }
+    // Background of the times of cues that overlap another cue.
+    QColor overlapColour() const { return overlapColour_; }
+    // Background of the '#' of cues with QC issues.
+    QColor qcIssueColour() const { return qcIssueColour_; }
+    // Background of the text of cues matching the search.
+    QColor searchMatchColour() const { return searchMatchColour_; }
+    // Row backgrounds of a comparison with another version.
+    QColor diffChangedColour() const { return diffChangedColour_; }
+    QColor diffAddedColour() const { return diffAddedColour_; }
+    QColor diffRemovedColour() const { return diffRemovedColour_; }
+    QColor diffConflictColour() const { return diffConflictColour_; }
+    // Underline of misspelled words.
+    QColor misspellingColour() const { return misspellingColour_; }
+
+    void setCpsThresholds(int warning, int error);
+    void setCpsErrorColour(const QColor &colour);
+
+    // Draw SRT formatting tags (<i>, <b>, <u>, <font color>) in the table
+    // instead of showing them as text.
+    bool renderTextTags() const { return renderTextTags_; }
+    void setRenderTextTags(bool render);
+
+    // What counts as a character for CPS (CPS/CountSpaces, CPS/CountLineBreaks).
+    CpsOptions cpsOptions() const { return cpsOptions_; }
+    void setCpsOptions(const CpsOptions &options);
+
+    // Limits of the quality check (QC/... keys).
+    QcOptions qcOptions() const { return qcOptions_; }
+    void setQcOptions(const QcOptions &options);
+
+    // Spell checking (Spelling/Enabled) against the Hunspell dictionary at
+    // Spelling/Dictionary, or, when that is empty, the installed one for the
+    // system language.
+    bool spellCheck() const { return spellCheck_; }
+    QString spellDictionary() const { return spellDictionary_; }
+    void setSpellCheck(bool enabled);
+    void setSpellDictionary(const QString &dicPath);
+
+    // Re-reads everything from QSettings.
+    void reload();
+
+signals:
+    void cpsColoursChanged();
+    void textRenderingChanged();
+    void qcOptionsChanged();
+    void cpsOptionsChanged();
+    void spellingChanged();
+
+private:
+    AppSettings();
+
+    int cpsWarning_ = 15;
+    int cpsError_ = 25;
+    QColor cpsErrorColour_ = QColor(255, 0, 0);
+    QColor overlapColour_ = QColor(255, 170, 0, 110);
+    QColor qcIssueColour_ = QColor(220, 60, 60, 90);
+    QColor searchMatchColour_ = QColor(255, 220, 0, 110);
+    QColor diffChangedColour_ = QColor(70, 130, 230, 70);
+    QColor diffAddedColour_ = QColor(60, 180, 75, 70);
+    QColor diffRemovedColour_ = QColor(230, 80, 80, 70);
+    QColor diffConflictColour_ = QColor(170, 70, 200, 100);
+    QColor misspellingColour_ = QColor(230, 30, 30);
+    bool renderTextTags_ = false;
+    QcOptions qcOptions_;
+    CpsOptions cpsOptions_;
+    bool spellCheck_ = true;
+    QString spellDictionary_;
+};
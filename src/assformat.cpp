@@ -0,0 +1,384 @@
+#include "assformat.h"
+#include "srtwriter.h"
+#include "subtitlemarkup.h"
+#include "texttokenizer.h"
+#include <QVarLengthArray>
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+using namespace TextScan;
+
+enum class Field { Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text, Marked, Other };
+using Fields = QVarLengthArray<Field, 12>;
+
+// Event fields of ASS files without a Format line, and of new files.
+const Field DefaultFields[] = {
+    Field::Layer, Field::Start, Field::End, Field::Style, Field::Name,
+    Field::MarginL, Field::MarginR, Field::MarginV, Field::Effect, Field::Text,
+};
+
+// Written in front of the events of a document that was not read from ASS.
+QString defaultHeader() {
+    return QStringLiteral(
+        "[Script Info]\n"
+        "ScriptType: v4.00+\n"
+        "PlayResX: 384\n"
+        "PlayResY: 288\n"
+        "WrapStyle: 0\n"
+        "ScaledBorderAndShadow: yes\n"
+        "\n"
+        "[V4+ Styles]\n"
+        "Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, OutlineColour, BackColour, "
+        "Bold, Italic, Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, "
+        "Shadow, Alignment, MarginL, MarginR, MarginV, Encoding\n"
+        "Style: Default,Arial,20,&H00FFFFFF,&H000000FF,&H00000000,&H00000000,0,0,0,0,100,100,0,0,1,2,2,2,"
+        "10,10,10,1\n"
+        "\n"
+        "[Events]\n"
+        "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n");
+}
+
+template<typename Unit>
+bool equalsNoCase(const Unit *b, const Unit *e, const char *s) {
+    return e - b == qsizetype(std::strlen(s)) && startsWithNoCase(b, e, s);
+}
+
+template<typename Unit, typename Decoder>
+Field fieldOf(const Unit *b, const Unit *e, const Decoder &decoder) {
+    trim(b, e, decoder);
+    static const struct { const char *name; Field field; } names[] = {
+        { "layer", Field::Layer }, { "start", Field::Start }, { "end", Field::End },
+        { "style", Field::Style }, { "name", Field::Name }, { "actor", Field::Name },
+        { "marginl", Field::MarginL }, { "marginr", Field::MarginR }, { "marginv", Field::MarginV },
+        { "effect", Field::Effect }, { "text", Field::Text }, { "marked", Field::Marked },
+    };
+    for (const auto &n : names) {
+        if (equalsNoCase(b, e, n.name)) return n.field;
+    }
+    return Field::Other;
+}
+
+// Fields of a Format line, [b, e) being what follows "Format:". Anything
+// without Text as the last field is ignored in favour of the default.
+template<typename Unit, typename Decoder>
+void readFormat(const Unit *b, const Unit *e, Fields &fields, const Decoder &decoder) {
+    Fields parsed;
+    while (b <= e) {
+        const Unit *comma = findUnit(b, e, Unit(','));
+        const Unit *fieldEnd = comma ? comma : e;
+        parsed.append(fieldOf(b, fieldEnd, decoder));
+        if (!comma) break;
+        b = comma + 1;
+    }
+    if (!parsed.isEmpty() && parsed.last() == Field::Text) fields = parsed;
+}
+
+// The Format line of the [Events] section of 'header'.
+Fields formatOf(QStringView header) {
+    Fields fields(std::begin(DefaultFields), std::end(DefaultFields));
+    const char16_t *p = header.utf16();
+    const char16_t *const end = p + header.size();
+    bool inEvents = false;
+    while (p < end) {
+        const char16_t *next;
+        const char16_t *le = lineEnd(p, end, next);
+        if (p < le && *p == u'[') inEvents = startsWithNoCase(p, le, "[events]");
+        else if (inEvents && startsWithNoCase(p, le, "format:")) readFormat(p + 7, le, fields, Utf16Text());
+        p = next;
+    }
+    return fields;
+}
+
+// "H:MM:SS.cc"; the fraction may have 1 to 3 digits.
+template<typename Unit, typename Decoder>
+bool parseTime(const Unit *b, const Unit *e, int &ms, const Decoder &decoder) {
+    trim(b, e, decoder);
+    const Unit *p = b;
+    int hours = 0;
+    while (p < e && isDigit(*p)) {
+        hours = hours * 10 + (*p++ - '0');
+        if (hours > 99) return false; // past SubtitleStore::MaxTime
+    }
+    if (p == b || e - p < 6 || p[0] != ':' || !isDigit(p[1]) || !isDigit(p[2])
+        || p[3] != ':' || !isDigit(p[4]) || !isDigit(p[5])) {
+        return false;
+    }
+    qint64 value = hours * qint64(3600000) + twoDigits(p + 1) * 60000 + twoDigits(p + 4) * 1000;
+    p += 6;
+    if (p < e) {
+        if (!isFractionSeparator(*p)) return false;
+        ++p;
+        const int digits = int(e - p);
+        if (digits < 1 || digits > 3 || !std::all_of(p, e, [](Unit c) { return isDigit(c); })) return false;
+        value += fractionMs(p, digits);
+    }
+    // 99 hours still fit, but not with 99 minutes
+    if (value > SubtitleStore::MaxTime) return false;
+    ms = int(value);
+    return true;
+}
+
+// Last value of a string field: runs of events with the same style or actor
+// are decoded and interned once.
+template<typename Unit>
+struct FieldCache {
+    const Unit *begin = nullptr;
+    qsizetype size = -1;
+    int id = 0;
+};
+
+template<typename Unit, typename Decoder>
+int internField(SubtitleStore &out, Decoder &decoder, FieldCache<Unit> &cache, const Unit *b, const Unit *e) {
+    trim(b, e, decoder);
+    if (b == e) return 0;
+    if (cache.size == e - b && std::equal(b, e, cache.begin)) return cache.id;
+    cache = { b, e - b, out.layoutStringId(decodeField(decoder, b, e)) };
+    return cache.id;
+}
+
+// Turns every "\N" in [b, e) into '\n' in place; returns the new end.
+QChar *foldHardBreaks(QChar *b, QChar *e) {
+    QChar *w = b;
+    for (QChar *r = b; r < e; ++r) {
+        if (*r == u'\\' && r + 1 < e && r[1] == u'N') {
+            *w++ = u'\n';
+            ++r;
+            continue;
+        }
+        *w++ = *r;
+    }
+    return w;
+}
+
+template<typename Unit, typename Decoder>
+QString decodeBlock(Decoder &decoder, const Unit *b, const Unit *e) {
+    QString text = decodeField(decoder, b, e);
+    text.remove(u'\r');
+    return text;
+}
+
+template<typename Unit, typename Decoder>
+void readUnits(const Unit *begin, const Unit *end, SubtitleStore &out, Decoder decoder) {
+    Fields fields(std::begin(DefaultFields), std::end(DefaultFields));
+    FieldCache<Unit> styles;
+    FieldCache<Unit> actors;
+    FieldCache<Unit> effects;
+    bool inEvents = false;
+    bool seenEvent = false;
+    const Unit *headerEnd = end;   // first event line
+    const Unit *footerBegin = end; // first section after the events
+    int lineNumber = 0;
+
+    for (const Unit *line = begin, *next; line < end; line = next) {
+        const Unit *le = lineEnd(line, end, next);
+        const Unit *b = skipSpace(line, le, decoder);
+        if (b < le && *b == '[') {
+            if (seenEvent) {
+                footerBegin = line;
+                break;
+            }
+            inEvents = startsWithNoCase(b, le, "[events]");
+            continue;
+        }
+        if (!inEvents) continue;
+        if (startsWithNoCase(b, le, "format:")) {
+            if (!seenEvent) readFormat(b + 7, le, fields, decoder);
+            continue;
+        }
+        const bool comment = startsWithNoCase(b, le, "comment:");
+        if (!comment && !startsWithNoCase(b, le, "dialogue:")) continue;
+        if (!seenEvent) {
+            seenEvent = true;
+            headerEnd = line;
+        }
+
+        CueLayout layout;
+        layout.comment = comment;
+        int startMs = SubtitleStore::NoTime;
+        int endMs = SubtitleStore::NoTime;
+        const Unit *textBegin = le;
+        const Unit *textEnd = le;
+        const Unit *f = b + (comment ? 8 : 9);
+        bool complete = true;
+        for (qsizetype i = 0; i < fields.size(); ++i) {
+            // the last field (Text) takes the rest of the line, commas and all
+            const Unit *fe = le;
+            if (i + 1 < fields.size()) {
+                fe = findUnit(f, le, Unit(','));
+                if (!fe) {
+                    complete = false;
+                    break;
+                }
+            }
+            int value;
+            switch (fields.at(i)) {
+            case Field::Layer:
+                if (parseInt(f, fe, value, decoder)) layout.layer = value;
+                break;
+            case Field::Start:
+                if (parseTime(f, fe, value, decoder)) startMs = value;
+                break;
+            case Field::End:
+                if (parseTime(f, fe, value, decoder)) endMs = value;
+                break;
+            case Field::Style:
+                layout.style = internField(out, decoder, styles, f, fe);
+                break;
+            case Field::Name:
+                layout.actor = internField(out, decoder, actors, f, fe);
+                break;
+            case Field::MarginL:
+                if (parseInt(f, fe, value, decoder)) layout.marginL = qint16(value);
+                break;
+            case Field::MarginR:
+                if (parseInt(f, fe, value, decoder)) layout.marginR = qint16(value);
+                break;
+            case Field::MarginV:
+                if (parseInt(f, fe, value, decoder)) layout.marginV = qint16(value);
+                break;
+            case Field::Effect:
+                layout.effect = internField(out, decoder, effects, f, fe);
+                break;
+            case Field::Text:
+                textBegin = f;
+                textEnd = fe;
+                break;
+            case Field::Marked:
+            case Field::Other:
+                break;
+            }
+            f = fe + 1;
+        }
+        if (!complete) continue; // not an event: too few fields
+
+        const qsizetype len = textEnd - textBegin;
+        QChar *text = out.beginText(decoder.requiredSpace(len));
+        QChar *written = decoder.append(text, textBegin, len);
+        written = foldHardBreaks(text, written);
+        out.commitCue(++lineNumber, startMs, endMs, written);
+        out.setLayout(out.size() - 1, layout);
+    }
+
+    out.setHeader(decodeBlock(decoder, begin, headerEnd));
+    if (footerBegin < end) out.setFooter(decodeBlock(decoder, footerBegin, end));
+}
+
+void appendNumber(SrtWriter &writer, int value) {
+    char buf[16];
+    writer.appendAscii(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr - buf);
+}
+
+char *writeTwoDigits(char *p, int value) {
+    *p++ = char('0' + value / 10);
+    *p++ = char('0' + value % 10);
+    return p;
+}
+
+// "H:MM:SS.cc", rounded to centiseconds but not past 99:59:59.99.
+void appendTime(SrtWriter &writer, int ms) {
+    const int cs = int(qMin((qint64(qMax(0, ms)) + 5) / 10, qint64(SubtitleStore::MaxTime / 10)));
+    char buf[24];
+    char *p = std::to_chars(buf, buf + 12, cs / 360000).ptr;
+    *p++ = ':';
+    p = writeTwoDigits(p, cs / 6000 % 60);
+    *p++ = ':';
+    p = writeTwoDigits(p, cs / 100 % 60);
+    *p++ = '.';
+    p = writeTwoDigits(p, cs % 100);
+    writer.appendAscii(buf, p - buf);
+}
+
+// Cue text with its line breaks as "\N".
+void appendEventText(SrtWriter &writer, QStringView text) {
+    qsizetype from = 0;
+    for (qsizetype nl; (nl = text.indexOf(u'\n', from)) >= 0; from = nl + 1) {
+        writer.appendEncoded(text.sliced(from, nl - from));
+        writer.appendAscii("\\N", 2);
+    }
+    writer.appendEncoded(text.sliced(from));
+}
+
+} // namespace
+
+bool AssFormat::sniff(QStringView head) const {
+    return head.trimmed().startsWith(QLatin1StringView("[Script Info]"), Qt::CaseInsensitive);
+}
+
+void AssFormat::read(const char *begin, const char *end, TextEncoding::Kind encoding,
+                     SubtitleStore &out) const
+{
+    withUnits(begin, end, encoding, [&](auto b, auto e, auto decoder) {
+        readUnits(b, e, out, decoder);
+    });
+}
+
+void AssFormat::write(SrtWriter &writer, const SubtitleStore &store) const {
+    // header and footer are kept only when they came from an ASS file
+    const bool ownHeader = sniff(store.header());
+    const QString header = ownHeader ? store.header() : defaultHeader();
+    writer.appendText(header);
+    if (!header.endsWith(u'\n')) writer.appendLineBreak();
+    const Fields fields = formatOf(header);
+    // cues read from SubRip or WebVTT carry tags, not override blocks
+    QString converted;
+
+    for (qsizetype i = 0; i < store.size() && !writer.failed(); ++i) {
+        const CueLayout layout = store.layout(i);
+        if (layout.comment) writer.appendAscii("Comment: ", 9);
+        else writer.appendAscii("Dialogue: ", 10);
+        for (qsizetype f = 0; f < fields.size(); ++f) {
+            if (f > 0) writer.appendAscii(",", 1);
+            switch (fields.at(f)) {
+            case Field::Layer:
+                appendNumber(writer, layout.layer);
+                break;
+            case Field::Start:
+                appendTime(writer, store.startMs(i));
+                break;
+            case Field::End:
+                appendTime(writer, store.endMs(i));
+                break;
+            case Field::Style:
+                if (layout.style) writer.appendEncoded(store.layoutString(layout.style));
+                else writer.appendAscii("Default", 7);
+                break;
+            case Field::Name:
+                writer.appendEncoded(store.layoutString(layout.actor));
+                break;
+            case Field::MarginL:
+                appendNumber(writer, layout.marginL);
+                break;
+            case Field::MarginR:
+                appendNumber(writer, layout.marginR);
+                break;
+            case Field::MarginV:
+                appendNumber(writer, layout.marginV);
+                break;
+            case Field::Effect:
+                writer.appendEncoded(store.layoutString(layout.effect));
+                break;
+            case Field::Text:
+                if (!ownHeader && SubtitleMarkup::needsAss(store.textView(i))) {
+                    SubtitleMarkup::toAss(store.textView(i), converted);
+                    appendEventText(writer, converted);
+                } else {
+                    appendEventText(writer, store.textView(i));
+                }
+                break;
+            case Field::Marked:
+                writer.appendAscii("Marked=0", 8);
+                break;
+            case Field::Other:
+                break;
+            }
+        }
+        writer.appendLineBreak();
+    }
+
+    if (ownHeader && !store.footer().isEmpty()) {
+        writer.appendLineBreak();
+        writer.appendText(store.footer());
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "subtitleformat.h"
+
+// Advanced SubStation Alpha (and SSA v4). Everything up to the first event
+// is kept verbatim as the store's header, sections after [Events] ([Fonts],
+// [Graphics]) as its footer. Dialogue and Comment events become cues, their
+// fields read in the order of the [Events] Format line; layer, style, actor,
+// margins and effect go to the CueLayout side table. "\N" hard breaks are
+// stored as '\n', like SRT line breaks, and turned back on write.
+class AssFormat : public SubtitleFormat {
+public:
+    Id id() const override { return Ass; }
+    QString name() const override { return QStringLiteral("Advanced SubStation Alpha"); }
+    QString key() const override { return QStringLiteral("ass"); }
+    QStringList suffixes() const override { return { QStringLiteral("ass"), QStringLiteral("ssa") }; }
+    bool sniff(QStringView head) const override;
+    void read(const char *begin, const char *end, TextEncoding::Kind encoding,
+              SubtitleStore &out) const override;
+    void write(SrtWriter &writer, const SubtitleStore &store) const override;
+};
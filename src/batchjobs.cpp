@@ -0,0 +1,261 @@
+#include "batchjobs.h"
+#include "subtitlefile.h"
+#include "subtitlestore.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <algorithm>
+#include <numeric>
+
+using namespace Qt::StringLiterals;
+
+namespace {
+
+constexpr int MaxIssuesPerFile = 100; // counts stay exact, the lists are cut
+
+void report(QJsonArray &list, int &count, qsizetype row, QLatin1StringView type) {
+    if (count++ < MaxIssuesPerFile)
+        list.append(QJsonObject{ { "row", int(row + 1) }, { "type", type } });
+}
+
+void validate(const SubtitleStore &store, const QVector<int> &fallbackRows,
+              const BatchOptions &options, QJsonObject &result)
+{
+    QJsonArray errors, warnings;
+    int errorCount = 0, warningCount = 0;
+    qsizetype nextFallback = 0;
+    int prevEnd = SubtitleStore::NoTime;
+    for (qsizetype i = 0; i < store.size(); ++i) {
+        if (nextFallback < fallbackRows.size() && fallbackRows.at(nextFallback) == i) {
+            report(errors, errorCount, i, "bad-index"_L1);
+            ++nextFallback;
+        }
+        const int s = store.startMs(i);
+        const int e = store.endMs(i);
+        if (s == SubtitleStore::NoTime || e == SubtitleStore::NoTime) {
+            report(errors, errorCount, i, "missing-timing"_L1);
+        } else {
+            if (e < s) report(errors, errorCount, i, "end-before-start"_L1);
+            if (prevEnd != SubtitleStore::NoTime && s < prevEnd)
+                report(warnings, warningCount, i, "overlap"_L1);
+            prevEnd = e;
+        }
+        if (store.textView(i).trimmed().isEmpty()) report(warnings, warningCount, i, "empty-text"_L1);
+        if (store.cps(i) > options.cpsError) report(warnings, warningCount, i, "cps-error"_L1);
+    }
+    result["ok"_L1] = errorCount == 0;
+    result["errorCount"_L1] = errorCount;
+    result["errors"_L1] = errors;
+    result["warningCount"_L1] = warningCount;
+    result["warnings"_L1] = warnings;
+}
+
+// Cues starting before an earlier-starting cue has ended.
+int countOverlaps(const SubtitleStore &store) {
+    QVector<qsizetype> timed;
+    timed.reserve(store.size());
+    for (qsizetype i = 0; i < store.size(); ++i) {
+        if (store.startMs(i) != SubtitleStore::NoTime && store.endMs(i) != SubtitleStore::NoTime)
+            timed.append(i);
+    }
+    std::stable_sort(timed.begin(), timed.end(), [&](qsizetype a, qsizetype b) {
+        return store.startMs(a) < store.startMs(b);
+    });
+    int overlaps = 0;
+    int maxEnd = -1;
+    for (qsizetype i : timed) {
+        if (store.startMs(i) < maxEnd) ++overlaps;
+        maxEnd = qMax(maxEnd, store.endMs(i));
+    }
+    return overlaps;
+}
+
+void stats(const SubtitleStore &store, const BatchOptions &options, QJsonObject &result) {
+    QVector<int> cps;
+    cps.reserve(store.size());
+    qint64 totalMs = 0;
+    for (qsizetype i = 0; i < store.size(); ++i) {
+        const int d = store.durationMs(i);
+        totalMs += d;
+        if (d > 0) cps.append(store.cps(i));
+    }
+    std::sort(cps.begin(), cps.end());
+
+    QJsonObject c;
+    QJsonArray histogram;
+    if (!cps.isEmpty()) {
+        const qsizetype n = cps.size();
+        // nearest-rank percentile
+        auto percentile = [&](int p) { return cps.at(qMax<qsizetype>(0, (n * p + 99) / 100 - 1)); };
+        int buckets[BatchJobs::HistogramBuckets] = {};
+        int overWarning = 0, overError = 0;
+        for (int v : cps) {
+            ++buckets[qMin(v / BatchJobs::HistogramBucketCps, BatchJobs::HistogramBuckets - 1)];
+            overWarning += v > options.cpsWarning;
+            overError += v > options.cpsError;
+        }
+        for (int b : buckets) histogram.append(b);
+        c["min"_L1] = cps.first();
+        c["max"_L1] = cps.last();
+        c["mean"_L1] = std::accumulate(cps.begin(), cps.end(), qint64(0)) / double(n);
+        c["median"_L1] = percentile(50);
+        c["p90"_L1] = percentile(90);
+        c["p95"_L1] = percentile(95);
+        c["overWarning"_L1] = overWarning;
+        c["overError"_L1] = overError;
+    }
+    c["histogram"_L1] = histogram;
+
+    result["ok"_L1] = true;
+    result["durationMs"_L1] = totalMs;
+    result["overlaps"_L1] = countOverlaps(store);
+    result["cps"_L1] = c;
+}
+
+void retime(SubtitleStore &store, const BatchOptions &options) {
+    const qsizetype n = store.size();
+    if (n == 0) return;
+    auto both = [&](auto op) {
+        op(store.startMsData());
+        op(store.endMsData());
+    };
+    if (options.convertFramerate) {
+        both([&](int *t) { TimingEngine::convertFramerate(t, n, options.fromFps, options.toFps, SubtitleStore::NoTime); });
+    }
+    if (options.shiftMs != 0) {
+        both([&](int *t) { TimingEngine::shift(t, n, options.shiftMs, SubtitleStore::NoTime); });
+    }
+    if (options.snap) {
+        both([&](int *t) { TimingEngine::snapToFrame(t, n, options.snapFps, SubtitleStore::NoTime); });
+    }
+    store.updateCps(0, n - 1);
+}
+
+void writeOutput(const BatchFile &file, const SubtitleStore &store, const BatchOptions &options,
+                 const TextFormat &format, SubtitleFormat::Id documentFormat, QJsonObject &result)
+{
+    QString target = options.inPlace ? file.path
+                                     : QDir(options.outputDir).filePath(file.relativePath);
+    if (options.command == BatchOptions::Convert) {
+        // "in place" puts the converted file next to its input
+        documentFormat = options.outputFormat;
+        const QFileInfo fi(target);
+        target = fi.dir().filePath(fi.completeBaseName() + u'.'
+                                   + SubtitleFormat::get(documentFormat).suffixes().constFirst());
+    }
+    if (!options.inPlace && !QDir().mkpath(QFileInfo(target).absolutePath())) {
+        result["ok"_L1] = false;
+        result["error"_L1] = "cannot create output directory"_L1;
+        return;
+    }
+    SrtWriteOptions write;
+    write.encoding = options.keepFormat ? format.encoding : options.outputEncoding;
+    write.byteOrderMark = options.keepFormat ? format.byteOrderMark : options.byteOrderMark;
+    write.crlf = options.keepFormat ? format.crlf : options.crlf;
+    write.format = documentFormat;
+    SrtWriter writer(write);
+    const bool ok = SubtitleFile::write(target, store, writer);
+    result["ok"_L1] = ok;
+    result["output"_L1] = target;
+    if (ok) return;
+    if (writer.unencodable().isEmpty()) result["error"_L1] = "cannot write file"_L1;
+    else result["error"_L1] = "characters the output encoding cannot represent: "_L1 + writer.unencodable();
+}
+
+void add(QJsonObject &o, QLatin1StringView key, qint64 value) {
+    o[key] = o.value(key).toInteger() + value;
+}
+
+} // namespace
+
+QVector<BatchFile> BatchJobs::collectFiles(const QStringList &paths) {
+    QVector<BatchFile> files;
+    for (const QString &p : paths) {
+        const QFileInfo fi(p);
+        if (!fi.isDir()) {
+            files.append({ p, fi.fileName() });
+            continue;
+        }
+        const QDir root(p);
+        QVector<BatchFile> found;
+        QDirIterator it(p, QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            const QString f = it.next();
+            const QString suffix = it.fileInfo().suffix().toLower();
+            const bool supported = std::any_of(SubtitleFormat::all().begin(), SubtitleFormat::all().end(),
+                                               [&](const SubtitleFormat *format) {
+                                                   return format->suffixes().contains(suffix);
+                                               });
+            if (supported) found.append({ f, root.relativeFilePath(f) });
+        }
+        std::sort(found.begin(), found.end(), [](const BatchFile &a, const BatchFile &b) {
+            return a.path < b.path;
+        });
+        files += found;
+    }
+    return files;
+}
+
+QJsonObject BatchJobs::run(const BatchFile &file, const BatchOptions &options) {
+    QJsonObject result { { "file", file.path } };
+
+    SrtReadOptions read;
+    read.encoding = options.inputEncoding;
+    read.parallel = options.parallelParse;
+    QVector<int> fallbackRows;
+    if (options.command == BatchOptions::Validate) read.fallbackRows = &fallbackRows;
+
+    SubtitleStore store;
+    TextFormat format;
+    SubtitleFormat::Id documentFormat = SubtitleFormat::Srt;
+    if (!SubtitleFile::read(file.path, store, read, &format, &documentFormat)) {
+        result["ok"_L1] = false;
+        result["error"_L1] = "cannot read file"_L1;
+        return result;
+    }
+    result["cues"_L1] = store.size();
+
+    switch (options.command) {
+    case BatchOptions::Validate:
+        validate(store, fallbackRows, options, result);
+        break;
+    case BatchOptions::Stats:
+        stats(store, options, result);
+        break;
+    case BatchOptions::Retime:
+        retime(store, options);
+        writeOutput(file, store, options, format, documentFormat, result);
+        break;
+    case BatchOptions::Reencode:
+        writeOutput(file, store, options, format, documentFormat, result);
+        result["encoding"_L1] = QString::fromLatin1(options.outputEncoding);
+        break;
+    case BatchOptions::Convert:
+        writeOutput(file, store, options, format, documentFormat, result);
+        result["from"_L1] = SubtitleFormat::get(documentFormat).key();
+        result["to"_L1] = SubtitleFormat::get(options.outputFormat).key();
+        break;
+    }
+    return result;
+}
+
+void BatchJobs::accumulate(QJsonObject &summary, const QJsonObject &result) {
+    add(summary, "files"_L1, 1);
+    add(summary, result.value("ok"_L1).toBool() ? "ok"_L1 : "failed"_L1, 1);
+    add(summary, "cues"_L1, result.value("cues"_L1).toInteger());
+    if (result.contains("errorCount"_L1)) {
+        add(summary, "errors"_L1, result.value("errorCount"_L1).toInteger());
+        add(summary, "warnings"_L1, result.value("warningCount"_L1).toInteger());
+    }
+    if (result.contains("cps"_L1)) {
+        add(summary, "durationMs"_L1, result.value("durationMs"_L1).toInteger());
+        add(summary, "overlaps"_L1, result.value("overlaps"_L1).toInteger());
+        const QJsonArray h = result.value("cps"_L1).toObject().value("histogram"_L1).toArray();
+        QJsonArray total = summary.value("histogram"_L1).toArray();
+        while (total.size() < h.size()) total.append(0);
+        for (qsizetype i = 0; i < h.size(); ++i)
+            total[i] = total.at(i).toInteger() + h.at(i).toInteger();
+        summary["histogram"_L1] = total;
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <QByteArray>
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+#include "subtitleformat.h"
+#include "timingengine.h"
+
+// One input file of a batch run. 'relativePath' is the path below the
+// directory it was found in, used to mirror the tree into --output-dir.
+struct BatchFile {
+    QString path;
+    QString relativePath;
+};
+
+struct BatchOptions {
+    enum Command { Validate, Stats, Retime, Reencode, Convert };
+    Command command = Validate;
+
+    // retime, applied in this order
+    bool convertFramerate = false;
+    Framerate fromFps { 25, 1 };
+    Framerate toFps { 25, 1 };
+    int shiftMs = 0;
+    bool snap = false;
+    Framerate snapFps { 25, 1 };
+
+    // reading and writing
+    QByteArray inputEncoding;  // empty: detect per file
+    QByteArray outputEncoding = "UTF-8";
+    bool byteOrderMark = false;
+    bool crlf = false;
+    bool keepFormat = false;   // write each file as it was read instead of the three above
+    // convert writes this format (and its suffix); the others keep each
+    // file's own
+    SubtitleFormat::Id outputFormat = SubtitleFormat::Srt;
+    QString outputDir;     // mirror of the input tree
+    bool inPlace = false;  // overwrite the input instead
+    bool parallelParse = false;
+
+    // stats / validate thresholds, same defaults as the editor
+    int cpsWarning = 15;
+    int cpsError = 25;
+};
+
+// The per-file work of substudio-cli. Every function is thread-safe and
+// returns one JSON object per file: {"file": ..., "ok": ..., ...}.
+class BatchJobs {
+public:
+    // Expands directories (recursively, every suffix of SubtitleFormat::all())
+    // and keeps plain files as given.
+    // The result is sorted so output order does not depend on the file system.
+    static QVector<BatchFile> collectFiles(const QStringList &paths);
+
+    static QJsonObject run(const BatchFile &file, const BatchOptions &options);
+
+    // Folds one file result into the running totals printed as "summary".
+    static void accumulate(QJsonObject &summary, const QJsonObject &result);
+
+    // Width of one bucket of the "cps.histogram" arrays.
+    static constexpr int HistogramBucketCps = 5;
+    static constexpr int HistogramBuckets = 8; // the last one is open-ended
+};
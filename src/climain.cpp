@@ -0,0 +1,185 @@
+// substudio-cli: headless batch processing of subtitle files (SRT, ASS/SSA,
+// WebVTT).
+//
+//   substudio-cli validate|stats|retime|reencode|convert [options] <paths...>
+//
+// Prints one JSON object per file (in input order, one per line) and a final
+// {"summary": {...}} line. Files are processed on a thread pool; exit code is
+// 0 when every file succeeded, 1 when some failed and 2 on usage errors.
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <cstdio>
+#include "batchjobs.h"
+#include "subtitlefile.h"
+
+namespace {
+
+void printJson(const QJsonObject &o) {
+    QByteArray line = QJsonDocument(o).toJson(QJsonDocument::Compact);
+    line += '\n';
+    std::fwrite(line.constData(), 1, size_t(line.size()), stdout);
+}
+
+int usageError(const QString &message) {
+    std::fprintf(stderr, "substudio-cli: %s\n", qPrintable(message));
+    return 2;
+}
+
+// "25", "23.976" (one of the common rates) or "24000/1001".
+bool parseFramerate(const QString &text, Framerate &out) {
+    for (const Framerate &r : Framerate::common()) {
+        if (r.name() == text) {
+            out = r;
+            return true;
+        }
+    }
+    const QStringList parts = text.split(u'/');
+    if (parts.size() > 2) return false;
+    bool ok = false;
+    const int num = parts.at(0).toInt(&ok);
+    if (!ok || num <= 0) return false;
+    int den = 1;
+    if (parts.size() == 2) {
+        den = parts.at(1).toInt(&ok);
+        if (!ok || den <= 0) return false;
+    }
+    out = { num, den };
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("substudio-cli");
+    QCoreApplication::setApplicationVersion("0.1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Batch processing of SubRip, ASS/SSA and WebVTT files.\n\n"
+        "Commands:\n"
+        "  validate  report broken cues (bad index, missing/inverted timing) and warnings\n"
+        "  stats     CPS distribution, total duration and overlaps\n"
+        "  retime    --framerate, then --shift, then --snap; writes the result in the\n"
+        "            file's own encoding and line endings unless --encoding, --bom or --crlf are set\n"
+        "  reencode  re-save with --encoding, --bom and --crlf\n"
+        "  convert   re-save as --to (srt, ass or vtt), with that format's suffix; keeps the\n"
+        "            file's own encoding and line endings unless --encoding, --bom or --crlf are set");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("command", "validate, stats, retime, reencode or convert.");
+    parser.addPositionalArgument("paths", "Files or directories (searched recursively for *.srt, *.ass, *.ssa and *.vtt).",
+                                 "<paths...>");
+
+    const QCommandLineOption jobsOpt({ "j", "jobs" }, "Worker threads (default: all cores).", "n");
+    const QCommandLineOption outputDirOpt({ "o", "output-dir" }, "Write results below <dir>, mirroring the input tree.", "dir");
+    const QCommandLineOption inPlaceOpt("in-place", "Overwrite the input files.");
+    const QCommandLineOption shiftOpt("shift", "Shift by <time> (e.g. -00:00:01,500 or 250).", "time");
+    const QCommandLineOption framerateOpt("framerate", "Convert from one framerate to another, e.g. 25:23.976.", "from:to");
+    const QCommandLineOption snapOpt("snap", "Snap times to frames of <fps>.", "fps");
+    const QCommandLineOption inputEncodingOpt("input-encoding", "Encoding of the input files (default: detected per file).", "name");
+    const QCommandLineOption encodingOpt("encoding", "Encoding of written files (default UTF-8).", "name");
+    const QCommandLineOption bomOpt("bom", "Write a byte order mark.");
+    const QCommandLineOption crlfOpt("crlf", "Write CRLF line endings.");
+    const QCommandLineOption cpsWarningOpt("cps-warning", "CPS warning threshold (default 15).", "n");
+    const QCommandLineOption cpsErrorOpt("cps-error", "CPS error threshold (default 25).", "n");
+    const QCommandLineOption toOpt("to", "Format written by convert: srt, ass or vtt.", "format");
+    const QCommandLineOption summaryOnlyOpt("summary-only", "Print only the summary line.");
+    parser.addOptions({ jobsOpt, outputDirOpt, inPlaceOpt, shiftOpt, framerateOpt, snapOpt,
+                        inputEncodingOpt, encodingOpt, bomOpt, crlfOpt, toOpt, cpsWarningOpt, cpsErrorOpt,
+                        summaryOnlyOpt });
+    parser.process(app);
+
+    const QStringList args = parser.positionalArguments();
+    if (args.size() < 2) return usageError("expected a command and at least one path (see --help)");
+
+    BatchOptions options;
+    const QString command = args.first();
+    if (command == "validate") options.command = BatchOptions::Validate;
+    else if (command == "stats") options.command = BatchOptions::Stats;
+    else if (command == "retime") options.command = BatchOptions::Retime;
+    else if (command == "reencode") options.command = BatchOptions::Reencode;
+    else if (command == "convert") options.command = BatchOptions::Convert;
+    else return usageError(QString("unknown command '%1'").arg(command));
+
+    bool ok = true;
+    if (parser.isSet(shiftOpt)) {
+        options.shiftMs = TimingEngine::parseTime(parser.value(shiftOpt), &ok);
+        if (!ok) return usageError("invalid --shift time");
+    }
+    if (parser.isSet(framerateOpt)) {
+        const QStringList rates = parser.value(framerateOpt).split(u':');
+        if (rates.size() != 2 || !parseFramerate(rates.at(0), options.fromFps)
+            || !parseFramerate(rates.at(1), options.toFps)) {
+            return usageError("invalid --framerate, expected <from>:<to>");
+        }
+        options.convertFramerate = true;
+    }
+    if (parser.isSet(snapOpt)) {
+        if (!parseFramerate(parser.value(snapOpt), options.snapFps)) return usageError("invalid --snap framerate");
+        options.snap = true;
+    }
+    if (parser.isSet(inputEncodingOpt)) options.inputEncoding = parser.value(inputEncodingOpt).toLatin1();
+    if (parser.isSet(encodingOpt)) options.outputEncoding = parser.value(encodingOpt).toLatin1();
+    for (const QByteArray &enc : { options.inputEncoding, options.outputEncoding }) {
+        if (!enc.isEmpty() && !SubtitleFile::isSupportedEncoding(enc))
+            return usageError(QString("unsupported encoding '%1'").arg(QString::fromLatin1(enc)));
+    }
+    options.byteOrderMark = parser.isSet(bomOpt);
+    options.crlf = parser.isSet(crlfOpt);
+    options.keepFormat = (options.command == BatchOptions::Retime || options.command == BatchOptions::Convert)
+                         && !parser.isSet(encodingOpt) && !options.byteOrderMark && !options.crlf;
+    if (options.command == BatchOptions::Convert) {
+        const SubtitleFormat *to = SubtitleFormat::forKey(parser.value(toOpt));
+        if (!to) return usageError("convert needs --to srt, ass or vtt");
+        options.outputFormat = to->id();
+    }
+    if (parser.isSet(cpsWarningOpt)) options.cpsWarning = parser.value(cpsWarningOpt).toInt();
+    if (parser.isSet(cpsErrorOpt)) options.cpsError = parser.value(cpsErrorOpt).toInt();
+
+    options.inPlace = parser.isSet(inPlaceOpt);
+    options.outputDir = parser.value(outputDirOpt);
+    const bool writes = options.command == BatchOptions::Retime || options.command == BatchOptions::Reencode
+                        || options.command == BatchOptions::Convert;
+    if (writes && options.inPlace == !options.outputDir.isEmpty())
+        return usageError(QString("%1 needs exactly one of --output-dir or --in-place").arg(command));
+
+    const QVector<BatchFile> files = BatchJobs::collectFiles(args.mid(1));
+
+    // Files are handed out a few at a time to whichever thread is free, so a
+    // few huge files don't hold back the rest. Per-file parallel
+    // parsing only pays off when there are fewer files than threads.
+    QThreadPool pool;
+    const int jobs = qMax(1, parser.isSet(jobsOpt) ? parser.value(jobsOpt).toInt() : QThread::idealThreadCount());
+    pool.setMaxThreadCount(jobs);
+    // the parallel parser runs on the global pool: -j bounds it too (file
+    // threads only wait while their file is parsed there)
+    QThreadPool::globalInstance()->setMaxThreadCount(jobs);
+    options.parallelParse = files.size() < pool.maxThreadCount();
+
+    QElapsedTimer clock;
+    clock.start();
+    QFuture<QJsonObject> future = QtConcurrent::mapped(&pool, files, [options](const BatchFile &file) {
+        return BatchJobs::run(file, options);
+    });
+
+    const bool summaryOnly = parser.isSet(summaryOnlyOpt);
+    QJsonObject summary { { "command", command }, { "files", 0 }, { "ok", 0 }, { "failed", 0 } };
+    for (int i = 0; i < files.size(); ++i) {
+        // results come back in input order; resultAt() waits for file i
+        const QJsonObject result = future.resultAt(i);
+        if (!summaryOnly) printJson(result);
+        BatchJobs::accumulate(summary, result);
+    }
+    summary["threads"] = pool.maxThreadCount();
+    summary["elapsedMs"] = clock.elapsed();
+    printJson(QJsonObject { { "summary", summary } });
+    std::fflush(stdout);
+
+    return summary.value("failed").toInteger() > 0 ? 1 : 0;
+}
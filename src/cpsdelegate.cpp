@@ -0,0 +1,87 @@
+#include "cpsdelegate.h"
+#include "appsettings.h"
+#include "highlightdelegate.h"
+#include "trace.h"
+#include <QPainter>
+#include <algorithm>
+
+CPSDelegate::CPSDelegate(QObject *parent) : QStyledItemDelegate(parent) {
+    connect(AppSettings::instance(), &AppSettings::cpsColoursChanged, this, [this] { invalidate(); });
+}
+
+QColor CPSDelegate::blend(const QColor &fg, const QColor &bg, double alpha) {
+    alpha = std::min(std::max(alpha, 0.0), 1.0);
+    int r = qRound(fg.red()   * alpha + bg.red()   * (1.0 - alpha));
+    int g = qRound(fg.green() * alpha + bg.green() * (1.0 - alpha));
+    int b = qRound(fg.blue()  * alpha + bg.blue()  * (1.0 - alpha));
+    return QColor(r, g, b);
+}
+
+void CPSDelegate::invalidate() {
+    for (Gradient &g : gradients_) g.valid = false;
+}
+
+const CPSDelegate::Gradient &CPSDelegate::gradient(QRgb base, QRgb text, bool alternate) const {
+    Gradient &g = gradients_[alternate ? 1 : 0];
+    if (g.valid && g.base == base && g.text == text) return g;
+
+    const AppSettings *settings = AppSettings::instance();
+    const int span = settings->cpsError() - settings->cpsWarning();
+    const QColor errorColor = settings->cpsErrorColour();
+    const int n = qMax(1, span);
+    g.background.resize(n);
+    g.foreground.resize(n);
+    for (int k = 1; k <= n; ++k) {
+        // same alpha as before the table: (cps - warn + 1) / (error - warn + 1)
+        const double alpha = std::clamp(double(k + 1) / double(span + 1), 0.0, 1.0);
+        g.background[k - 1] = blend(errorColor, QColor(base), alpha).rgb();
+        g.foreground[k - 1] = blend(QColor(0, 0, 0), QColor(text), alpha).rgb();
+    }
+    g.base = base;
+    g.text = text;
+    g.valid = true;
+    return g;
+}
+
+void CPSDelegate::initStyleOption(QStyleOptionViewItem *option, const QModelIndex &index) const {
+    QStyledItemDelegate::initStyleOption(option, index);
+    const QBrush diff = HighlightDelegate::diffBackground(index);
+    if (diff.style() != Qt::NoBrush) option->backgroundBrush = diff;
+}
+
+void CPSDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option,
+                        const QModelIndex &index) const
+{
+    TRACE_SCOPE("CPSDelegate::paint");
+    if (option.state & QStyle::State_Selected) {
+        QStyledItemDelegate::paint(painter, option, index);
+        return;
+    }
+
+    QVariant v = index.data(Qt::DisplayRole);
+    bool ok = false;
+    int cps = v.toInt(&ok);
+    const int warn = AppSettings::instance()->cpsWarning();
+    if (!ok || cps <= 0 || cps <= warn) {
+        QStyledItemDelegate::paint(painter, option, index);
+        return;
+    }
+
+    // background base (considera alternate rows)
+    const bool alternate = option.features.testFlag(QStyleOptionViewItem::Alternate);
+    const QRgb baseBg = option.palette.color(alternate ? QPalette::AlternateBase : QPalette::Base).rgb();
+    const QRgb origText = option.palette.color(QPalette::Text).rgb();
+    const Gradient &g = gradient(baseBg, origText, alternate);
+    const int k = qMin(cps - warn, int(g.background.size())) - 1;
+
+    painter->save();
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(QColor(g.background.at(k)));
+    QRect r = option.rect;
+    r.adjust(0, 1, 0, 0);
+    painter->drawRect(r);
+
+    painter->setPen(QColor(g.foreground.at(k)));
+    painter->drawText(option.rect, Qt::AlignCenter, QString::number(cps));
+    painter->restore();
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <QColor>
+#include <QStyledItemDelegate>
+#include <QVector>
+
+// Paints the CPS column: above the warning threshold the cell fades towards
+// the error colour, fully reached at the error threshold.
+//
+// The colours come from a lookup table indexed by integer CPS, built from
+// AppSettings and the view palette; it is rebuilt only when the thresholds,
+// the error colour or the palette change, so painting a cell does no
+// settings access and no floating-point blending.
+class CPSDelegate : public QStyledItemDelegate {
+public:
+    explicit CPSDelegate(QObject *parent = nullptr);
+
+    // Blends 'fg' over 'bg' according to alpha (alpha ∈ [0,1])
+    static QColor blend(const QColor &fg, const QColor &bg, double alpha);
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option,
+               const QModelIndex &index) const override;
+
+protected:
+    // Cells below the warning threshold keep the comparison background.
+    void initStyleOption(QStyleOptionViewItem *option, const QModelIndex &index) const override;
+
+private:
+    // Colours for CPS warning+1 .. error (the last entry also serves anything
+    // above) over one background.
+    struct Gradient {
+        QRgb base = 0;
+        QRgb text = 0;
+        bool valid = false;
+        QVector<QRgb> background;
+        QVector<QRgb> foreground;
+    };
+
+    const Gradient &gradient(QRgb base, QRgb text, bool alternate) const;
+    void invalidate();
+
+    mutable Gradient gradients_[2]; // Base, AlternateBase rows
+};
@@ -0,0 +1,288 @@
+#include "diffpanel.h"
+#include "hashing.h"
+#include "subtitlemodel.h"
+#include <QGridLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+#include <QtConcurrent>
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+constexpr int RecomputeDelayMs = 300;
+constexpr quint64 RemovedKeyBit = quint64(1) << 63;
+
+// Identity of a change that survives edits elsewhere in the document: the
+// row of the other version it brings in, or, for removals, the removed cue
+// itself.
+quint64 changeKey(const CueChange &c, const SubtitleStore &document) {
+    if (c.kind != CueChange::Removed) return (quint64(c.kind) << 32) | quint32(c.other);
+    const QStringView text = document.textView(c.row);
+    const int times[] = { document.startMs(c.row), document.endMs(c.row) };
+    const quint64 seed = hash64(times, qsizetype(sizeof(times)));
+    return hash64(text.utf16(), text.size() * qsizetype(sizeof(QChar)), seed) | RemovedKeyBit;
+}
+
+struct Category {
+    const char *name;
+    int flags;
+};
+
+const Category categories[] = {
+    { QT_TRANSLATE_NOOP("DiffPanel", "Changed"), SubtitleDiff::RowModified },
+    { QT_TRANSLATE_NOOP("DiffPanel", "Added"), SubtitleDiff::RowAddedBefore | SubtitleDiff::RowAddedAfter },
+    { QT_TRANSLATE_NOOP("DiffPanel", "Removed"), SubtitleDiff::RowRemoved },
+    { QT_TRANSLATE_NOOP("DiffPanel", "Conflicts"), SubtitleDiff::RowConflict },
+};
+
+} // namespace
+
+DiffPanel::DiffPanel(SubtitleModel *model, QWidget *parent)
+    : QWidget(parent), model_(model), tree_(new QTreeWidget(this)), summary_(new QLabel(this)),
+      acceptSelected_(new QPushButton(tr("Accept Selected"), this)),
+      acceptAll_(new QPushButton(tr("Accept All"), this)),
+      rejectSelected_(new QPushButton(tr("Reject Selected"), this)),
+      rejectAll_(new QPushButton(tr("Reject All"), this)),
+      recomputeTimer_(new QTimer(this))
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(4, 4, 4, 4);
+    summary_->setWordWrap(true);
+    layout->addWidget(summary_);
+    layout->addWidget(tree_);
+    QGridLayout *buttons = new QGridLayout;
+    buttons->addWidget(acceptSelected_, 0, 0);
+    buttons->addWidget(rejectSelected_, 0, 1);
+    buttons->addWidget(acceptAll_, 1, 0);
+    buttons->addWidget(rejectAll_, 1, 1);
+    QPushButton *close = new QPushButton(tr("Close"), this);
+    buttons->addWidget(close, 2, 1);
+    layout->addLayout(buttons);
+
+    acceptAll_->setToolTip(tr("Accept every change that is not a conflict"));
+    connect(acceptSelected_, &QPushButton::clicked, this, &DiffPanel::acceptSelectedRequested);
+    connect(acceptAll_, &QPushButton::clicked, this, &DiffPanel::acceptAllRequested);
+    connect(rejectSelected_, &QPushButton::clicked, this, &DiffPanel::rejectSelectedRequested);
+    connect(rejectAll_, &QPushButton::clicked, this, [this] { reject(changes(true)); });
+    connect(close, &QPushButton::clicked, this, &DiffPanel::closeRequested);
+
+    tree_->setColumnCount(2);
+    tree_->setHeaderLabels({ tr("Change"), tr("Cues") });
+    tree_->setRootIsDecorated(false);
+    tree_->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    tree_->header()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
+    tree_->header()->setStretchLastSection(false);
+    for (const Category &c : categories) {
+        QTreeWidgetItem *item = new QTreeWidgetItem(tree_);
+        item->setText(0, tr(c.name));
+        item->setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
+        item->setData(0, Qt::UserRole, c.flags);
+        item->setToolTip(0, tr("Double-click to go to the next such cue"));
+    }
+    connect(tree_, &QTreeWidget::itemActivated, this, [this](QTreeWidgetItem *item) {
+        emit flagsActivated(item->data(0, Qt::UserRole).toInt());
+    });
+
+    recomputeTimer_->setSingleShot(true);
+    recomputeTimer_->setInterval(RecomputeDelayMs);
+    connect(recomputeTimer_, &QTimer::timeout, this, &DiffPanel::recompute);
+    connect(&watcher_, &QFutureWatcher<Result>::finished, this, &DiffPanel::computed);
+
+    // only edits of the cues count; the marks, QC flags and search matches
+    // change other roles
+    connect(model_, &QAbstractItemModel::dataChanged, this,
+            [this](const QModelIndex &, const QModelIndex &, const QList<int> &roles) {
+        if (roles.isEmpty() || roles.contains(Qt::DisplayRole)) documentChanged();
+    });
+    connect(model_, &QAbstractItemModel::rowsInserted, this, &DiffPanel::documentChanged);
+    connect(model_, &QAbstractItemModel::rowsRemoved, this, &DiffPanel::documentChanged);
+    connect(model_, &QAbstractItemModel::modelReset, this, &DiffPanel::documentChanged);
+    refresh();
+}
+
+void DiffPanel::compareWith(const SubtitleStore &other, const QString &name) {
+    merging_ = false;
+    other_ = other;
+    base_ = SubtitleStore();
+    name_ = name;
+    start();
+}
+
+void DiffPanel::mergeWith(const SubtitleStore &base, const SubtitleStore &theirs, const QString &name) {
+    merging_ = true;
+    other_ = theirs;
+    base_ = base;
+    name_ = name;
+    start();
+}
+
+void DiffPanel::start() {
+    active_ = true;
+    rejected_.clear();
+    result_ = Result();
+    ++generation_;
+    recompute();
+}
+
+void DiffPanel::stop() {
+    active_ = false;
+    recomputeTimer_->stop();
+    other_ = SubtitleStore();
+    base_ = SubtitleStore();
+    rejected_.clear();
+    result_ = Result();
+    ++generation_; // a diff still running is dropped when it finishes
+    model_->setDiffFlags({});
+    refresh();
+}
+
+bool DiffPanel::isCurrent() const {
+    return active_ && !watcher_.isRunning() && computedGeneration_ == generation_;
+}
+
+void DiffPanel::documentChanged() {
+    ++generation_;
+    if (!active_) return;
+    refresh();
+    recomputeTimer_->start();
+}
+
+void DiffPanel::recompute() {
+    // one diff at a time; computed() starts the next one if edits came in
+    if (!active_ || watcher_.isRunning()) return;
+    computedGeneration_ = generation_;
+    const SubtitleStore document = model_->cues();
+    watcher_.setFuture(QtConcurrent::run([document, other = other_, base = base_, merging = merging_,
+                                          rejected = rejected_] {
+        const QVector<CueChange> all = merging ? SubtitleDiff::merge(base, document, other)
+                                               : SubtitleDiff::compare(document, other);
+        Result r;
+        r.changes.reserve(all.size());
+        r.keys.reserve(all.size());
+        for (const CueChange &c : all) {
+            const quint64 key = changeKey(c, document);
+            if (rejected.contains(key)) continue;
+            r.changes.append(c);
+            r.keys.append(key);
+        }
+        return r;
+    }));
+    refresh();
+}
+
+void DiffPanel::computed() {
+    if (!active_) return;
+    if (computedGeneration_ != generation_) {
+        // the document moved on while this ran: its rows are stale
+        recompute();
+        return;
+    }
+    result_ = watcher_.result();
+    model_->setDiffFlags(SubtitleDiff::rowFlags(result_.changes, model_->rowCount()));
+    refresh();
+}
+
+void DiffPanel::refresh() {
+    int counts[std::size(categories)] = {};
+    for (const CueChange &c : std::as_const(result_.changes)) {
+        const quint8 flags = SubtitleDiff::changeFlags(c, model_->rowCount());
+        for (size_t i = 0; i < std::size(categories); ++i) {
+            if (categories[i].flags & flags) ++counts[i];
+        }
+    }
+    for (int i = 0; i < int(std::size(categories)); ++i) {
+        QTreeWidgetItem *item = tree_->topLevelItem(i);
+        item->setText(1, active_ ? QString::number(counts[i]) : QString());
+        item->setDisabled(counts[i] == 0);
+    }
+
+    const bool current = isCurrent();
+    const bool any = current && !result_.changes.isEmpty();
+    acceptSelected_->setEnabled(any);
+    acceptAll_->setEnabled(any);
+    rejectSelected_->setEnabled(any);
+    rejectAll_->setEnabled(any);
+
+    if (!active_) {
+        summary_->setText(tr("Use File > Compare With or Merge to compare the document with another version."));
+        return;
+    }
+    QString text = merging_ ? tr("Merging the changes of %1").arg(name_) : tr("Compared with %1").arg(name_);
+    if (!current) text += QStringLiteral("\n") + tr("Comparing...");
+    else if (result_.changes.isEmpty()) text += QStringLiteral("\n") + tr("No differences");
+    else text += QStringLiteral("\n") + tr("%n difference(s)", nullptr, int(result_.changes.size()));
+    summary_->setText(text);
+}
+
+int DiffPanel::markedRow(const CueChange &change) const {
+    // additions at the end are marked on the last row
+    return qMin(change.row, model_->rowCount() - 1);
+}
+
+QVector<CueChange> DiffPanel::changes(bool withConflicts) const {
+    if (!isCurrent()) return {};
+    if (withConflicts) return result_.changes;
+    QVector<CueChange> out;
+    out.reserve(result_.changes.size());
+    for (const CueChange &c : result_.changes) {
+        if (!c.conflict) out.append(c);
+    }
+    return out;
+}
+
+QVector<CueChange> DiffPanel::changesAt(QVector<int> rows) const {
+    if (!isCurrent()) return {};
+    std::sort(rows.begin(), rows.end());
+    QVector<CueChange> out;
+    auto row = rows.cbegin();
+    for (const CueChange &c : result_.changes) {
+        const int marked = markedRow(c);
+        while (row != rows.cend() && *row < marked) ++row;
+        if (row == rows.cend()) break;
+        if (*row == marked) out.append(c);
+    }
+    return out;
+}
+
+QVector<CueSplice> DiffPanel::splices(const QVector<CueChange> &changes) const {
+    return SubtitleDiff::splices(changes, other_);
+}
+
+void DiffPanel::reject(const QVector<CueChange> &changes) {
+    if (changes.isEmpty() || !isCurrent()) return;
+    // both lists are ascending: walk them together
+    Result kept;
+    qsizetype k = 0;
+    for (qsizetype i = 0; i < result_.changes.size(); ++i) {
+        const CueChange &c = result_.changes.at(i);
+        while (k < changes.size() && changes.at(k).row < c.row) ++k;
+        bool dropped = false;
+        for (qsizetype j = k; j < changes.size() && changes.at(j).row == c.row && !dropped; ++j)
+            dropped = changes.at(j).kind == c.kind && changes.at(j).other == c.other;
+        if (dropped) {
+            rejected_.insert(result_.keys.at(i));
+        } else {
+            kept.changes.append(c);
+            kept.keys.append(result_.keys.at(i));
+        }
+    }
+    result_ = std::move(kept);
+    model_->setDiffFlags(SubtitleDiff::rowFlags(result_.changes, model_->rowCount()));
+    refresh();
+}
+
+int DiffPanel::nextRow(int flags, int row) const {
+    int first = -1;
+    for (const CueChange &c : result_.changes) {
+        if (!(SubtitleDiff::changeFlags(c, model_->rowCount()) & flags)) continue;
+        const int marked = markedRow(c);
+        if (marked > row) return marked;
+        if (first < 0) first = marked;
+    }
+    return first;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <QFutureWatcher>
+#include <QSet>
+#include <QWidget>
+#include "subtitlediff.h"
+
+class QLabel;
+class QPushButton;
+class QTimer;
+class QTreeWidget;
+class SubtitleModel;
+
+// Comparison of the document with another version of it, or a three-way
+// merge of the changes a second version made to a common base. The diff is
+// computed in the background and again after every edit (debounced); the
+// changed rows are marked in the table through SubtitleModel::DiffRole.
+//
+// Accepting changes is handed to the main window, which owns the undo
+// history (SpliceCuesCommand). Rejected changes stay hidden until the
+// comparison ends.
+class DiffPanel : public QWidget {
+    Q_OBJECT
+public:
+    explicit DiffPanel(SubtitleModel *model, QWidget *parent = nullptr);
+
+    // 'name' labels the other version in the panel.
+    void compareWith(const SubtitleStore &other, const QString &name);
+    void mergeWith(const SubtitleStore &base, const SubtitleStore &theirs, const QString &name);
+    // Ends the comparison and clears the row marks.
+    void stop();
+    bool isActive() const { return active_; }
+    // The change list matches the document (no edit since it was computed).
+    bool isCurrent() const;
+
+    // Pending changes, ascending: all of them (conflicts only when asked
+    // for) or those marked on 'rows'.
+    QVector<CueChange> changes(bool withConflicts) const;
+    QVector<CueChange> changesAt(QVector<int> rows) const;
+    // Splices accepting 'changes', with the cues of the other version.
+    QVector<CueSplice> splices(const QVector<CueChange> &changes) const;
+    void reject(const QVector<CueChange> &changes);
+    // First row after 'row' (wrapping) with any of the SubtitleDiff::RowFlag
+    // bits in 'flags', or -1.
+    int nextRow(int flags, int row) const;
+
+signals:
+    void flagsActivated(int flags);
+    void acceptSelectedRequested();
+    void acceptAllRequested();
+    void rejectSelectedRequested();
+    void closeRequested();
+
+private:
+    struct Result {
+        QVector<CueChange> changes;
+        QVector<quint64> keys; // per change, see changeKey()
+    };
+    void start();
+    void documentChanged();
+    void recompute();
+    void computed();
+    void refresh();
+    int markedRow(const CueChange &change) const;
+
+    SubtitleModel *model_;
+    QTreeWidget *tree_;
+    QLabel *summary_;
+    QPushButton *acceptSelected_;
+    QPushButton *acceptAll_;
+    QPushButton *rejectSelected_;
+    QPushButton *rejectAll_;
+    QTimer *recomputeTimer_; // coalesces the edits of a burst of typing
+    QFutureWatcher<Result> watcher_;
+
+    bool active_ = false;
+    bool merging_ = false;
+    QString name_;
+    SubtitleStore other_; // the other version; in a merge, theirs
+    SubtitleStore base_;
+    QSet<quint64> rejected_;
+    quint64 generation_ = 0;         // bumped by every document edit
+    quint64 computedGeneration_ = 0; // generation the running or last diff was started at
+    Result result_;
+};
@@ -0,0 +1,454 @@
+#include "edithistory.h"
+#include "editjournal.h"
+#include "subtitlemodel.h"
+#include "subtitlestore.h"
+#include "trace.h"
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace {
+
+constexpr qsizetype DefaultMemoryLimit = 64 * 1024 * 1024;
+
+// Timing/line-number columns plus the text of every cue.
+qsizetype storeBytes(const SubtitleStore &cues) {
+    qsizetype bytes = cues.size() * 6 * qsizetype(sizeof(int));
+    for (qsizetype i = 0; i < cues.size(); ++i)
+        bytes += cues.textView(i).size() * qsizetype(sizeof(QChar));
+    return bytes;
+}
+
+// Lengths of the common prefix and suffix of two texts (not overlapping).
+std::pair<qsizetype, qsizetype> commonEnds(const QString &before, const QString &after) {
+    const qsizetype maxCommon = qMin(before.size(), after.size());
+    qsizetype prefix = 0;
+    while (prefix < maxCommon && before.at(prefix) == after.at(prefix)) ++prefix;
+    qsizetype suffix = 0;
+    while (suffix < maxCommon - prefix
+           && before.at(before.size() - 1 - suffix) == after.at(after.size() - 1 - suffix)) {
+        ++suffix;
+    }
+    return { prefix, suffix };
+}
+
+} // namespace
+
+TextSpliceCommand::TextSpliceCommand(int row, int pos, const QString &removed, const QString &inserted)
+    : row_(row), pos_(pos), removed_(removed), inserted_(inserted) {}
+
+std::unique_ptr<TextSpliceCommand> TextSpliceCommand::fromTexts(int row, const QString &before,
+                                                                const QString &after)
+{
+    if (before == after) return nullptr;
+    const auto [prefix, suffix] = commonEnds(before, after);
+    return std::make_unique<TextSpliceCommand>(row, int(prefix),
+                                               before.mid(prefix, before.size() - prefix - suffix),
+                                               after.mid(prefix, after.size() - prefix - suffix));
+}
+
+void TextSpliceCommand::redo(SubtitleModel *model) {
+    QString t = model->textAt(row_);
+    t.replace(pos_, removed_.size(), inserted_);
+    model->setTextAt(row_, t);
+}
+
+void TextSpliceCommand::undo(SubtitleModel *model) {
+    QString t = model->textAt(row_);
+    t.replace(pos_, inserted_.size(), removed_);
+    model->setTextAt(row_, t);
+}
+
+QString TextSpliceCommand::text() const {
+    return QObject::tr("Edit row %1").arg(row_ + 1);
+}
+
+qsizetype TextSpliceCommand::memoryUsage() const {
+    return qsizetype(sizeof(*this)) + (removed_.size() + inserted_.size()) * qsizetype(sizeof(QChar));
+}
+
+bool TextSpliceCommand::mergeWith(const EditCommand *next) {
+    const auto *n = dynamic_cast<const TextSpliceCommand *>(next);
+    if (!n || n->row_ != row_) return false;
+
+    // Both splices in "middle" coordinates (after this one, before 'n'): this
+    // one produced [pos, pos + ins), 'n' replaced [npos, npos + nrem). They
+    // compose into one splice when the two ranges touch or overlap.
+    const qsizetype pos = pos_;
+    const qsizetype ins = inserted_.size();
+    const qsizetype npos = n->pos_;
+    const qsizetype nrem = n->removed_.size();
+    if (npos > pos + ins || npos + nrem < pos) return false;
+
+    const qsizetype lo = qMin(pos, npos);
+    const qsizetype hi = qMax(pos + ins, npos + nrem);
+
+    // text of the original covered by [lo, hi): whatever 'n' removed outside
+    // our range, around what we removed
+    QString removed;
+    if (lo < pos) removed += n->removed_.mid(lo - npos, pos - lo);
+    removed += removed_;
+    if (hi > pos + ins) removed += n->removed_.mid(pos + ins - npos, hi - (pos + ins));
+
+    // final text of [lo, hi): what is left of our insertion around n's one
+    QString inserted;
+    if (lo < npos) inserted += inserted_.left(npos - lo);
+    inserted += n->inserted_;
+    if (hi > npos + nrem) inserted += inserted_.mid(npos + nrem - pos);
+
+    pos_ = int(lo);
+    removed_ = removed;
+    inserted_ = inserted;
+    return true;
+}
+
+void TextSpliceCommand::journal(EditJournal *journal, bool undone) const {
+    if (undone) journal->recordSplice(row_, pos_, int(inserted_.size()), removed_);
+    else journal->recordSplice(row_, pos_, int(removed_.size()), inserted_);
+}
+
+RetimeCommand::RetimeCommand(const QVector<QPair<int, int>> &runs, const QString &text, Operation op)
+    : text_(text), op_(std::move(op)) {
+    runs_.reserve(runs.size());
+    for (const QPair<int, int> &run : runs) runs_.append({ run.first, run.second });
+}
+
+void RetimeCommand::redo(SubtitleModel *model) {
+    if (applied_) {
+        for (const Run &run : std::as_const(runs_)) {
+            if (run.constant) model->shiftTimes(run.first, run.last, run.constantDelta);
+            else model->addTimingDeltas(run.first, run.startDeltas, run.endDeltas, +1);
+        }
+        return;
+    }
+
+    for (Run &run : runs_) {
+        QVector<int> oldStarts, oldEnds;
+        model->timingsInRange(run.first, run.last, oldStarts, oldEnds);
+        op_(model, run.first, run.last);
+        QVector<int> newStarts, newEnds;
+        model->timingsInRange(run.first, run.last, newStarts, newEnds);
+
+        const qsizetype n = oldStarts.size();
+        run.startDeltas.resize(n);
+        run.endDeltas.resize(n);
+        run.constant = true;
+        bool seen = false;
+        for (qsizetype i = 0; i < n; ++i) {
+            run.startDeltas[i] = newStarts.at(i) - oldStarts.at(i);
+            run.endDeltas[i] = newEnds.at(i) - oldEnds.at(i);
+            // untimed entries never move, they don't break a constant shift
+            const bool timed[] = { oldStarts.at(i) != SubtitleStore::NoTime, oldEnds.at(i) != SubtitleStore::NoTime };
+            const int deltas[] = { run.startDeltas.at(i), run.endDeltas.at(i) };
+            for (int k = 0; k < 2; ++k) {
+                if (!timed[k]) continue;
+                if (!seen) {
+                    run.constantDelta = deltas[k];
+                    seen = true;
+                } else if (deltas[k] != run.constantDelta) {
+                    run.constant = false;
+                }
+            }
+        }
+        if (run.constant) {
+            // a plain shift that never clamped: one int is enough to replay it
+            run.startDeltas = QVector<int>();
+            run.endDeltas = QVector<int>();
+        }
+    }
+    op_ = nullptr;
+    applied_ = true;
+}
+
+void RetimeCommand::undo(SubtitleModel *model) {
+    for (const Run &run : std::as_const(runs_)) {
+        if (run.constant) model->shiftTimes(run.first, run.last, -run.constantDelta);
+        else model->addTimingDeltas(run.first, run.startDeltas, run.endDeltas, -1);
+    }
+}
+
+qsizetype RetimeCommand::memoryUsage() const {
+    qsizetype bytes = qsizetype(sizeof(*this)) + text_.size() * qsizetype(sizeof(QChar))
+                    + runs_.capacity() * qsizetype(sizeof(Run));
+    for (const Run &run : runs_)
+        bytes += (run.startDeltas.capacity() + run.endDeltas.capacity()) * qsizetype(sizeof(int));
+    return bytes;
+}
+
+void RetimeCommand::journal(EditJournal *journal, bool undone) const {
+    for (const Run &run : runs_) {
+        if (run.constant) journal->recordShift(run.first, run.last, undone ? -run.constantDelta : run.constantDelta);
+        else journal->recordTimingDeltas(run.first, run.startDeltas, run.endDeltas, undone ? -1 : +1);
+    }
+}
+
+InsertCuesCommand::InsertCuesCommand(int row, const SubtitleStore &cues, const QString &text)
+    : row_(row), cues_(cues), text_(text) {}
+
+void InsertCuesCommand::redo(SubtitleModel *model) {
+    model->insertCues(row_, cues_);
+}
+
+void InsertCuesCommand::undo(SubtitleModel *model) {
+    model->removeCues(row_, int(cues_.size()));
+}
+
+qsizetype InsertCuesCommand::memoryUsage() const {
+    return qsizetype(sizeof(*this)) + storeBytes(cues_) + text_.size() * qsizetype(sizeof(QChar));
+}
+
+void InsertCuesCommand::journal(EditJournal *journal, bool undone) const {
+    if (undone) journal->recordRemove(row_, int(cues_.size()));
+    else journal->recordInsert(row_, cues_);
+}
+
+RemoveCuesCommand::RemoveCuesCommand(QVector<int> rows) {
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    for (int row : rows) {
+        if (!runs_.isEmpty() && runs_.last().first + runs_.last().count == row) ++runs_.last().count;
+        else runs_.append({ row, 1, SubtitleStore() });
+    }
+}
+
+void RemoveCuesCommand::redo(SubtitleModel *model) {
+    // back to front, so earlier rows keep their numbers
+    for (qsizetype i = runs_.size() - 1; i >= 0; --i) {
+        Run &run = runs_[i];
+        if (run.cues.isEmpty()) run.cues = model->cuesAt(run.first, run.count);
+        model->removeCues(run.first, run.count);
+    }
+}
+
+void RemoveCuesCommand::undo(SubtitleModel *model) {
+    for (const Run &run : std::as_const(runs_))
+        model->insertCues(run.first, run.cues);
+}
+
+QString RemoveCuesCommand::text() const {
+    int count = 0;
+    for (const Run &run : runs_) count += run.count;
+    return QObject::tr("Delete %n cue(s)", nullptr, count);
+}
+
+qsizetype RemoveCuesCommand::memoryUsage() const {
+    qsizetype bytes = qsizetype(sizeof(*this));
+    for (const Run &run : runs_) bytes += qsizetype(sizeof(Run)) + storeBytes(run.cues);
+    return bytes;
+}
+
+void RemoveCuesCommand::journal(EditJournal *journal, bool undone) const {
+    if (undone) {
+        for (const Run &run : runs_) journal->recordInsert(run.first, run.cues);
+    } else {
+        for (qsizetype i = runs_.size() - 1; i >= 0; --i)
+            journal->recordRemove(runs_.at(i).first, runs_.at(i).count);
+    }
+}
+
+SpliceCuesCommand::SpliceCuesCommand(QVector<CueSplice> splices, const QString &text)
+    : splices_(std::move(splices)), text_(text) {}
+
+void SpliceCuesCommand::redo(SubtitleModel *model) {
+    if (reverse_.isEmpty()) {
+        int shift = 0; // rows gained by the splices before this one
+        reverse_.reserve(splices_.size());
+        for (const CueSplice &s : std::as_const(splices_)) {
+            reverse_.append({ s.row + shift, int(s.inserted.size()), model->cuesAt(s.row, s.removed) });
+            shift += int(s.inserted.size()) - s.removed;
+        }
+    }
+    model->spliceCues(splices_);
+}
+
+void SpliceCuesCommand::undo(SubtitleModel *model) {
+    model->spliceCues(reverse_);
+}
+
+qsizetype SpliceCuesCommand::memoryUsage() const {
+    qsizetype bytes = qsizetype(sizeof(*this)) + text_.size() * qsizetype(sizeof(QChar));
+    for (const QVector<CueSplice> *splices : { &splices_, &reverse_ }) {
+        for (const CueSplice &s : *splices) bytes += qsizetype(sizeof(CueSplice)) + storeBytes(s.inserted);
+    }
+    return bytes;
+}
+
+void SpliceCuesCommand::journal(EditJournal *journal, bool undone) const {
+    const QVector<CueSplice> &splices = undone ? reverse_ : splices_;
+    for (qsizetype i = splices.size() - 1; i >= 0; --i) {
+        const CueSplice &s = splices.at(i);
+        if (s.removed > 0) journal->recordRemove(s.row, s.removed);
+        if (!s.inserted.isEmpty()) journal->recordInsert(s.row, s.inserted);
+    }
+}
+
+std::unique_ptr<ReplaceTextsCommand> ReplaceTextsCommand::replaceAll(const SubtitleModel *model,
+                                                                    const QVector<int> &rows,
+                                                                    const QString &needle,
+                                                                    const QString &replacement,
+                                                                    Qt::CaseSensitivity cs)
+{
+    if (needle.isEmpty() || rows.isEmpty()) return nullptr;
+    // the store is only read here, so the rows can be done concurrently
+    const QList<Splice> splices = QtConcurrent::blockingMapped<QList<Splice>>(rows, [&](int row) {
+        const QString before = model->textAt(row);
+        QString after = before;
+        after.replace(needle, replacement, cs);
+        Splice s;
+        if (after == before) return s;
+        const auto [prefix, suffix] = commonEnds(before, after);
+        s.row = row;
+        s.pos = int(prefix);
+        s.removed = before.mid(prefix, before.size() - prefix - suffix);
+        s.inserted = after.mid(prefix, after.size() - prefix - suffix);
+        return s;
+    });
+    QVector<Splice> changed;
+    changed.reserve(splices.size());
+    for (const Splice &s : splices) {
+        if (s.row >= 0) changed.append(s);
+    }
+    if (changed.isEmpty()) return nullptr;
+    return std::unique_ptr<ReplaceTextsCommand>(new ReplaceTextsCommand(std::move(changed)));
+}
+
+void ReplaceTextsCommand::apply(SubtitleModel *model, bool undo) const {
+    QVector<int> rows;
+    QStringList texts;
+    rows.reserve(splices_.size());
+    texts.reserve(splices_.size());
+    for (const Splice &s : splices_) {
+        QString t = model->textAt(s.row);
+        if (undo) t.replace(s.pos, s.inserted.size(), s.removed);
+        else t.replace(s.pos, s.removed.size(), s.inserted);
+        rows.append(s.row);
+        texts.append(t);
+    }
+    model->setTexts(rows, texts);
+}
+
+void ReplaceTextsCommand::redo(SubtitleModel *model) {
+    apply(model, false);
+}
+
+void ReplaceTextsCommand::undo(SubtitleModel *model) {
+    apply(model, true);
+}
+
+QString ReplaceTextsCommand::text() const {
+    return QObject::tr("Replace in %n cue(s)", nullptr, int(splices_.size()));
+}
+
+qsizetype ReplaceTextsCommand::memoryUsage() const {
+    qsizetype bytes = qsizetype(sizeof(*this));
+    for (const Splice &s : splices_)
+        bytes += qsizetype(sizeof(Splice)) + (s.removed.size() + s.inserted.size()) * qsizetype(sizeof(QChar));
+    return bytes;
+}
+
+void ReplaceTextsCommand::journal(EditJournal *journal, bool undone) const {
+    for (const Splice &s : splices_) {
+        if (undone) journal->recordSplice(s.row, s.pos, int(s.inserted.size()), s.removed);
+        else journal->recordSplice(s.row, s.pos, int(s.removed.size()), s.inserted);
+    }
+}
+
+EditHistory::EditHistory(SubtitleModel *model, QObject *parent)
+    : QObject(parent), model_(model), memoryLimit_(DefaultMemoryLimit) {}
+
+EditHistory::~EditHistory() = default;
+
+void EditHistory::push(std::unique_ptr<EditCommand> command) {
+    TRACE_SCOPE("EditHistory::push");
+    if (!command) return;
+    // a new edit discards everything that could be redone
+    while (commands_.size() > index_) {
+        memoryUsage_ -= commands_.back()->memoryUsage();
+        commands_.pop_back();
+        states_.pop_back();
+    }
+
+    command->redo(model_);
+    if (journal_) command->journal(journal_, false);
+    if (!sealed_ && index_ > 0) {
+        EditCommand *top = commands_.back().get();
+        const qsizetype before = top->memoryUsage();
+        if (top->mergeWith(command.get())) {
+            memoryUsage_ += top->memoryUsage() - before;
+            states_.back() = ++lastState_;
+            enforceLimit();
+            emit changed();
+            return;
+        }
+    }
+
+    memoryUsage_ += command->memoryUsage();
+    commands_.push_back(std::move(command));
+    states_.push_back(++lastState_);
+    index_ = commands_.size();
+    sealed_ = false;
+    enforceLimit();
+    emit changed();
+}
+
+void EditHistory::clear() {
+    commands_.clear();
+    states_.clear();
+    index_ = 0;
+    baseState_ = ++lastState_;
+    memoryUsage_ = 0;
+    sealed_ = true;
+    emit changed();
+}
+
+QString EditHistory::undoText() const {
+    return canUndo() ? commands_[index_ - 1]->text() : QString();
+}
+
+QString EditHistory::redoText() const {
+    return canRedo() ? commands_[index_]->text() : QString();
+}
+
+void EditHistory::setMemoryLimit(qsizetype bytes) {
+    memoryLimit_ = bytes;
+    enforceLimit();
+    emit changed();
+}
+
+void EditHistory::undo() {
+    TRACE_SCOPE("EditHistory::undo");
+    if (!canUndo()) return;
+    --index_;
+    commands_[index_]->undo(model_);
+    if (journal_) commands_[index_]->journal(journal_, true);
+    sealed_ = true;
+    emit changed();
+}
+
+void EditHistory::redo() {
+    TRACE_SCOPE("EditHistory::redo");
+    if (!canRedo()) return;
+    commands_[index_]->redo(model_);
+    if (journal_) commands_[index_]->journal(journal_, false);
+    ++index_;
+    sealed_ = true;
+    emit changed();
+}
+
+void EditHistory::enforceLimit() {
+    // drop the oldest undo steps first, then the far end of the redo tail;
+    // the most recent step is always kept
+    while (memoryUsage_ > memoryLimit_ && commands_.size() > 1) {
+        if (index_ > 0) {
+            memoryUsage_ -= commands_.front()->memoryUsage();
+            commands_.pop_front();
+            // undo now stops at the state that step led to
+            baseState_ = states_.front();
+            states_.pop_front();
+            --index_;
+        } else {
+            memoryUsage_ -= commands_.back()->memoryUsage();
+            commands_.pop_back();
+            states_.pop_back();
+        }
+    }
+}
@@ -0,0 +1,220 @@
+#pragma once
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <deque>
+#include <functional>
+#include <memory>
+
+#include "subtitlestore.h"
+
+class EditJournal;
+class SubtitleModel;
+
+// One reversible document edit. Commands keep deltas (a text splice, timing
+// differences), never snapshots of the document.
+class EditCommand {
+public:
+    virtual ~EditCommand() = default;
+    virtual void redo(SubtitleModel *model) = 0;
+    virtual void undo(SubtitleModel *model) = 0;
+    virtual QString text() const = 0;
+    // Approximate heap + object size, counted against the history limit.
+    virtual qsizetype memoryUsage() const = 0;
+    // Folds 'next' (already applied) into this command; false if unrelated.
+    virtual bool mergeWith(const EditCommand *next) { Q_UNUSED(next); return false; }
+    // Logs what the last redo() (or undo(), when 'undone') did to the model.
+    virtual void journal(EditJournal *journal, bool undone) const = 0;
+};
+
+// Replaces [pos, pos + removed.size()) of one cue's text with 'inserted'.
+class TextSpliceCommand : public EditCommand {
+public:
+    TextSpliceCommand(int row, int pos, const QString &removed, const QString &inserted);
+    // Smallest splice turning 'before' into 'after' (common prefix/suffix).
+    static std::unique_ptr<TextSpliceCommand> fromTexts(int row, const QString &before, const QString &after);
+
+    void redo(SubtitleModel *model) override;
+    void undo(SubtitleModel *model) override;
+    QString text() const override;
+    qsizetype memoryUsage() const override;
+    bool mergeWith(const EditCommand *next) override;
+    void journal(EditJournal *journal, bool undone) const override;
+
+private:
+    int row_;
+    int pos_;
+    QString removed_;
+    QString inserted_;
+};
+
+// A bulk timing operation over runs of rows (ascending, non-overlapping
+// [first, last] pairs). The first redo() runs the operation on each run and
+// keeps per-row deltas; a run moved by a constant shift keeps a single value.
+class RetimeCommand : public EditCommand {
+public:
+    using Operation = std::function<void(SubtitleModel *model, int first, int last)>;
+    RetimeCommand(const QVector<QPair<int, int>> &runs, const QString &text, Operation op);
+
+    void redo(SubtitleModel *model) override;
+    void undo(SubtitleModel *model) override;
+    QString text() const override { return text_; }
+    qsizetype memoryUsage() const override;
+    void journal(EditJournal *journal, bool undone) const override;
+
+private:
+    struct Run {
+        int first;
+        int last;
+        bool constant = false;  // every timed cue moved by constantDelta
+        int constantDelta = 0;
+        QVector<int> startDeltas;
+        QVector<int> endDeltas;
+    };
+    QVector<Run> runs_;
+    QString text_;
+    Operation op_;           // only used by the first redo()
+    bool applied_ = false;
+};
+
+// Inserts 'cues' before 'row'.
+class InsertCuesCommand : public EditCommand {
+public:
+    InsertCuesCommand(int row, const SubtitleStore &cues, const QString &text);
+
+    void redo(SubtitleModel *model) override;
+    void undo(SubtitleModel *model) override;
+    QString text() const override { return text_; }
+    qsizetype memoryUsage() const override;
+    void journal(EditJournal *journal, bool undone) const override;
+
+private:
+    int row_;
+    SubtitleStore cues_;
+    QString text_;
+};
+
+// Removes the given rows (any order, duplicates ignored). The cues are kept
+// as contiguous runs so undo can put them back.
+class RemoveCuesCommand : public EditCommand {
+public:
+    explicit RemoveCuesCommand(QVector<int> rows);
+
+    void redo(SubtitleModel *model) override;
+    void undo(SubtitleModel *model) override;
+    QString text() const override;
+    qsizetype memoryUsage() const override;
+    void journal(EditJournal *journal, bool undone) const override;
+
+private:
+    struct Run {
+        int first;
+        int count;
+        SubtitleStore cues;
+    };
+    QVector<Run> runs_; // ascending, non-adjacent
+};
+
+// Applies ascending cue splices (accepting the changes of a compare or merge)
+// as one undo step. The first redo() keeps the cues it replaces, so undo is
+// the reverse splices.
+class SpliceCuesCommand : public EditCommand {
+public:
+    SpliceCuesCommand(QVector<CueSplice> splices, const QString &text);
+
+    void redo(SubtitleModel *model) override;
+    void undo(SubtitleModel *model) override;
+    QString text() const override { return text_; }
+    qsizetype memoryUsage() const override;
+    void journal(EditJournal *journal, bool undone) const override;
+
+private:
+    QVector<CueSplice> splices_;
+    QVector<CueSplice> reverse_; // in post-edit rows; empty until the first redo()
+    QString text_;
+};
+
+// Replace-all over a set of rows as one undo step. The replacements are
+// computed in parallel and kept as one splice per changed row; redo and undo
+// apply them in a single batched model update.
+class ReplaceTextsCommand : public EditCommand {
+public:
+    // Null when no row changes.
+    static std::unique_ptr<ReplaceTextsCommand> replaceAll(const SubtitleModel *model, const QVector<int> &rows,
+                                                           const QString &needle, const QString &replacement,
+                                                           Qt::CaseSensitivity cs);
+
+    void redo(SubtitleModel *model) override;
+    void undo(SubtitleModel *model) override;
+    QString text() const override;
+    qsizetype memoryUsage() const override;
+    void journal(EditJournal *journal, bool undone) const override;
+
+private:
+    struct Splice {
+        int row = -1;
+        int pos = 0;
+        QString removed;
+        QString inserted;
+    };
+    explicit ReplaceTextsCommand(QVector<Splice> splices) : splices_(std::move(splices)) {}
+    void apply(SubtitleModel *model, bool undo) const;
+
+    QVector<Splice> splices_; // ascending rows
+};
+
+// Undo/redo stack in the spirit of QUndoStack. push() applies the command,
+// consecutive typing in one cue merges into a single step, and the oldest
+// steps are dropped once the deltas exceed a memory limit.
+class EditHistory : public QObject {
+    Q_OBJECT
+public:
+    explicit EditHistory(SubtitleModel *model, QObject *parent = nullptr);
+    ~EditHistory() override;
+
+    void push(std::unique_ptr<EditCommand> command);
+    void clear();
+    // Stops the next push from merging into the current top (e.g. after the
+    // user moves to another row or saves).
+    void seal() { sealed_ = true; }
+
+    bool canUndo() const { return index_ > 0; }
+    bool canRedo() const { return index_ < commands_.size(); }
+    QString undoText() const;
+    QString redoText() const;
+
+    // Every applied redo/undo is also logged here (may be null).
+    void setJournal(EditJournal *journal) { journal_ = journal; }
+
+    // Identifies the document as the history left it: undo and redo return
+    // to earlier values, every other change (a push, a merge, clear()) makes
+    // a new one. Never NoState, which callers can use for "no state of this
+    // history" (e.g. the file on disk after edits made outside it).
+    static constexpr quint64 NoState = 0;
+    quint64 state() const { return index_ > 0 ? states_[index_ - 1] : baseState_; }
+
+    void setMemoryLimit(qsizetype bytes);
+    qsizetype memoryLimit() const { return memoryLimit_; }
+    qsizetype memoryUsage() const { return memoryUsage_; }
+
+public slots:
+    void undo();
+    void redo();
+
+signals:
+    void changed(); // can undo/redo or their texts changed
+
+private:
+    void enforceLimit();
+
+    SubtitleModel *model_;
+    EditJournal *journal_ = nullptr;
+    std::deque<std::unique_ptr<EditCommand>> commands_;
+    std::deque<quint64> states_; // state() after each of commands_
+    size_t index_ = 0; // commands_[0, index_) are applied
+    quint64 baseState_ = 1; // state() with nothing applied
+    quint64 lastState_ = 1;
+    qsizetype memoryUsage_ = 0;
+    qsizetype memoryLimit_;
+    bool sealed_ = true;
+};
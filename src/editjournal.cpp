@@ -0,0 +1,380 @@
+#include "editjournal.h"
+#include "hashing.h"
+#include "subtitlemodel.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSettings>
+#include <QTimer>
+#include <QtEndian>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr quint32 Magic = 0x53534A31; // "SSJ1"
+// 2: inserted cues carry their CueLayout. Journals of other versions are
+// not offered for recovery.
+constexpr quint16 Version = 2;
+constexpr qint64 HeaderSize = 4 + 2 + 8 + 8;
+constexpr int DefaultSyncIntervalMs = 1000;
+const char *const DocumentsGroup = "Journal/Documents";
+
+// Settings key of the journal of 'documentPath': one per journal file, so
+// instances editing different documents keep theirs apart.
+QString documentKey(const QString &documentPath) {
+    const QString journal = EditJournal::journalPath(documentPath);
+    const quint64 h = hash64(journal.constData(), journal.size() * qsizetype(sizeof(QChar)));
+    return QStringLiteral("%1/%2").arg(QLatin1String(DocumentsGroup)).arg(h, 16, 16, QLatin1Char('0'));
+}
+
+QString lockPath(const QString &documentPath) {
+    return EditJournal::journalPath(documentPath) + QStringLiteral(".lock");
+}
+
+// Pushes the OS buffers of 'f' to the disk.
+void syncToDisk(QFile &f) {
+#ifdef Q_OS_WIN
+    FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(f.handle())));
+#else
+    ::fsync(f.handle());
+#endif
+}
+
+qint64 lastModified(const QFileInfo &fi) {
+    return fi.lastModified().toMSecsSinceEpoch();
+}
+
+QDataStream &setup(QDataStream &ds) {
+    ds.setVersion(QDataStream::Qt_6_0);
+    return ds;
+}
+
+// Reads the header; false if this is not a journal we can read.
+bool readHeader(const QByteArray &data, qint64 &baseSize, qint64 &baseMtime) {
+    if (data.size() < HeaderSize) return false;
+    QDataStream ds(data);
+    setup(ds);
+    quint32 magic = 0;
+    quint16 version = 0;
+    ds >> magic >> version >> baseSize >> baseMtime;
+    return ds.status() == QDataStream::Ok && magic == Magic && version == Version;
+}
+
+// The layout strings go by value: ids only mean something in one store.
+void writeLayout(QDataStream &ds, const SubtitleStore &cues, qsizetype i) {
+    const CueLayout l = cues.layout(i);
+    for (int id : { l.style, l.actor, l.effect, l.identifier, l.settings })
+        ds << cues.layoutString(id).toString();
+    ds << qint32(l.layer) << l.marginL << l.marginR << l.marginV << l.comment;
+}
+
+CueLayout readLayout(QDataStream &ds, SubtitleStore &cues) {
+    CueLayout l;
+    for (int *id : { &l.style, &l.actor, &l.effect, &l.identifier, &l.settings }) {
+        QString text;
+        ds >> text;
+        *id = cues.layoutStringId(text);
+    }
+    qint32 layer = 0;
+    ds >> layer >> l.marginL >> l.marginR >> l.marginV >> l.comment;
+    l.layer = layer;
+    return l;
+}
+
+} // namespace
+
+EditJournal::EditJournal(QObject *parent) : QObject(parent), syncTimer_(new QTimer(this)) {
+    syncTimer_->setSingleShot(true);
+    syncTimer_->setInterval(DefaultSyncIntervalMs);
+    connect(syncTimer_, &QTimer::timeout, this, &EditJournal::sync);
+}
+
+EditJournal::~EditJournal() {
+    // keep the file: only discard() means the edits are no longer needed
+    sync();
+}
+
+QString EditJournal::journalPath(const QString &documentPath) {
+    return documentPath + QStringLiteral(".journal");
+}
+
+bool EditJournal::writeHeader() {
+    const QFileInfo fi(documentPath_);
+    QByteArray header;
+    QDataStream ds(&header, QIODevice::WriteOnly);
+    setup(ds) << Magic << Version << qint64(fi.size()) << qint64(lastModified(fi));
+    return file_.write(header) == header.size() && file_.flush();
+}
+
+bool EditJournal::lock(const QString &documentPath) {
+    lock_ = std::make_unique<QLockFile>(lockPath(documentPath));
+    // held as long as the journal is open; only a dead owner makes it stale
+    lock_->setStaleLockTime(0);
+    if (lock_->tryLock(0)) return true;
+    lock_.reset();
+    return false;
+}
+
+bool EditJournal::open(const QString &documentPath) {
+    discard();
+    // another instance is editing the document: its journal is not ours
+    if (!lock(documentPath)) return false;
+    documentPath_ = documentPath;
+    file_.setFileName(journalPath(documentPath));
+    if (!file_.open(QIODevice::ReadWrite | QIODevice::Truncate) || !writeHeader()) {
+        file_.close();
+        lock_.reset();
+        return false;
+    }
+    syncToDisk(file_);
+    QSettings().setValue(documentKey(documentPath), documentPath);
+    return true;
+}
+
+bool EditJournal::resume(const QString &documentPath, qint64 validEnd) {
+    discard();
+    if (!lock(documentPath)) return false;
+    documentPath_ = documentPath;
+    file_.setFileName(journalPath(documentPath));
+    if (!file_.open(QIODevice::ReadWrite) || !file_.resize(qMax(validEnd, HeaderSize))
+        || !file_.seek(file_.size())) {
+        file_.close();
+        lock_.reset();
+        return false;
+    }
+    QSettings().setValue(documentKey(documentPath), documentPath);
+    return true;
+}
+
+bool EditJournal::rebase(const QString &documentPath, qint64 from) {
+    QByteArray tail;
+    if (isOpen() && file_.seek(from)) tail = file_.readAll();
+    if (!open(documentPath)) return false;
+    if (!tail.isEmpty()) {
+        file_.write(tail);
+        file_.flush();
+    }
+    syncToDisk(file_);
+    return true;
+}
+
+void EditJournal::discard() {
+    syncTimer_->stop();
+    unsynced_ = false;
+    if (isOpen()) {
+        file_.close();
+        QFile::remove(file_.fileName());
+        QSettings().remove(documentKey(documentPath_));
+    }
+    lock_.reset(); // unlocks and deletes the lock file
+    documentPath_.clear();
+}
+
+void EditJournal::close() {
+    sync();
+    syncTimer_->stop();
+    file_.close();
+    lock_.reset();
+    documentPath_.clear();
+}
+
+void EditJournal::setSyncInterval(int ms) {
+    syncTimer_->setInterval(qMax(0, ms));
+}
+
+void EditJournal::append(const QByteArray &record) {
+    if (!isOpen()) return;
+    QByteArray frame;
+    frame.reserve(record.size() + 6);
+    QDataStream ds(&frame, QIODevice::WriteOnly);
+    setup(ds) << quint32(record.size());
+    ds.writeRawData(record.constData(), int(record.size()));
+    ds << quint16(qChecksum(record));
+    file_.write(frame);
+    // in the OS cache right away, so a crash of the process loses nothing;
+    // the fsync for power loss is batched
+    file_.flush();
+    unsynced_ = true;
+    if (syncTimer_->interval() == 0) sync();
+    else if (!syncTimer_->isActive()) syncTimer_->start();
+}
+
+void EditJournal::sync() {
+    if (!unsynced_ || !isOpen()) return;
+    syncToDisk(file_);
+    unsynced_ = false;
+}
+
+void EditJournal::recordSplice(int row, int pos, int removedLength, const QString &inserted) {
+    if (!isOpen()) return;
+    QByteArray r;
+    QDataStream ds(&r, QIODevice::WriteOnly);
+    setup(ds) << quint8(Splice) << qint32(row) << qint32(pos) << qint32(removedLength) << inserted;
+    append(r);
+}
+
+void EditJournal::recordShift(int first, int last, int deltaMs) {
+    if (!isOpen()) return;
+    QByteArray r;
+    QDataStream ds(&r, QIODevice::WriteOnly);
+    setup(ds) << quint8(Shift) << qint32(first) << qint32(last) << qint32(deltaMs);
+    append(r);
+}
+
+void EditJournal::recordTimingDeltas(int first, const QVector<int> &startDeltas,
+                                     const QVector<int> &endDeltas, int sign)
+{
+    if (!isOpen()) return;
+    QByteArray r;
+    QDataStream ds(&r, QIODevice::WriteOnly);
+    setup(ds) << quint8(TimingDeltas) << qint32(first) << qint32(sign) << startDeltas << endDeltas;
+    append(r);
+}
+
+void EditJournal::recordInsert(int row, const SubtitleStore &cues) {
+    if (!isOpen()) return;
+    QByteArray r;
+    QDataStream ds(&r, QIODevice::WriteOnly);
+    setup(ds) << quint8(Insert) << qint32(row) << quint32(cues.size()) << cues.hasLayout();
+    for (qsizetype i = 0; i < cues.size(); ++i) {
+        ds << qint32(cues.lineNumber(i)) << qint32(cues.startMs(i)) << qint32(cues.endMs(i))
+           << cues.text(i);
+        if (cues.hasLayout()) writeLayout(ds, cues, i);
+    }
+    append(r);
+}
+
+void EditJournal::recordRemove(int first, int count) {
+    if (!isOpen()) return;
+    QByteArray r;
+    QDataStream ds(&r, QIODevice::WriteOnly);
+    setup(ds) << quint8(Remove) << qint32(first) << qint32(count);
+    append(r);
+}
+
+QStringList EditJournal::pendingDocuments() {
+    QSettings s;
+    s.beginGroup(QLatin1String(DocumentsGroup));
+    QStringList documents;
+    for (const QString &key : s.childKeys()) {
+        const QString path = s.value(key).toString();
+        // locked by a live instance: still being edited, not left behind
+        QLockFile probe(lockPath(path));
+        probe.setStaleLockTime(0);
+        if (!probe.tryLock(0)) continue;
+        probe.unlock();
+        documents.append(path);
+    }
+    return documents;
+}
+
+EditJournal::Recovery EditJournal::recoveryState(const QString &documentPath) {
+    QFile f(journalPath(documentPath));
+    if (!f.open(QIODevice::ReadOnly) || f.size() <= HeaderSize) return Recovery::None;
+    qint64 baseSize = 0, baseMtime = 0;
+    if (!readHeader(f.read(HeaderSize), baseSize, baseMtime)) return Recovery::None;
+    const QFileInfo fi(documentPath);
+    if (!fi.exists() || fi.size() != baseSize || lastModified(fi) != baseMtime)
+        return Recovery::BaseChanged;
+    return Recovery::Available;
+}
+
+int EditJournal::replay(const QString &documentPath, SubtitleModel *model, qint64 *validEnd) {
+    if (validEnd) *validEnd = HeaderSize;
+    QFile f(journalPath(documentPath));
+    if (!f.open(QIODevice::ReadOnly)) return 0;
+    const QByteArray data = f.readAll();
+    qint64 baseSize = 0, baseMtime = 0;
+    if (!readHeader(data, baseSize, baseMtime)) return 0;
+
+    int applied = 0;
+    qint64 pos = HeaderSize;
+    while (pos + 4 <= data.size()) {
+        const quint32 len = qFromBigEndian<quint32>(data.constData() + pos);
+        if (len == 0 || pos + 4 + len + 2 > data.size()) break;
+        const QByteArray record = QByteArray::fromRawData(data.constData() + pos + 4, len);
+        if (qChecksum(record) != qFromBigEndian<quint16>(data.constData() + pos + 4 + len)) break;
+
+        QDataStream ds(record);
+        setup(ds);
+        quint8 type = 0;
+        ds >> type;
+        // every record is checked against the model before it is applied:
+        // one that does not fit means the journal does not belong to this
+        // document, and nothing from there on is
+        const int rows = model->rowCount();
+        auto valid = [&ds](bool fits) { return fits && ds.status() == QDataStream::Ok; };
+        bool ok = false;
+        switch (type) {
+        case Splice: {
+            qint32 row, at, removed;
+            QString inserted;
+            ds >> row >> at >> removed >> inserted;
+            if (!valid(row >= 0 && row < rows)) break;
+            QString text = model->textAt(row);
+            ok = at >= 0 && removed >= 0 && at <= text.size() && removed <= text.size() - at;
+            if (ok) model->setTextAt(row, text.replace(at, removed, inserted));
+            break;
+        }
+        case Shift: {
+            qint32 first, last, delta;
+            ds >> first >> last >> delta;
+            ok = valid(first >= 0 && first <= last && last < rows);
+            if (ok) model->shiftTimes(first, last, delta);
+            break;
+        }
+        case TimingDeltas: {
+            qint32 first, sign;
+            QVector<int> starts, ends;
+            ds >> first >> sign >> starts >> ends;
+            ok = valid(first >= 0 && (sign == 1 || sign == -1) && starts.size() == ends.size()
+                       && starts.size() <= rows - first);
+            if (ok) model->addTimingDeltas(first, starts, ends, sign);
+            break;
+        }
+        case Insert: {
+            qint32 row;
+            quint32 n;
+            bool layouts = false;
+            ds >> row >> n >> layouts;
+            if (!valid(row >= 0 && row <= rows && n > 0)) break;
+            SubtitleStore cues;
+            for (quint32 i = 0; i < n && ds.status() == QDataStream::Ok; ++i) {
+                qint32 lineNumber, start, end;
+                QString text;
+                ds >> lineNumber >> start >> end >> text;
+                cues.append(lineNumber, start, end, text);
+                if (layouts) cues.setLayout(cues.size() - 1, readLayout(ds, cues));
+            }
+            ok = valid(cues.size() == qsizetype(n));
+            if (ok) model->insertCues(row, cues);
+            break;
+        }
+        case Remove: {
+            qint32 first, count;
+            ds >> first >> count;
+            ok = valid(first >= 0 && count > 0 && count <= rows - first);
+            if (ok) model->removeCues(first, count);
+            break;
+        }
+        default:
+            break;
+        }
+        if (!ok) break;
+        pos += 4 + len + 2;
+        ++applied;
+    }
+    if (validEnd) *validEnd = pos;
+    return applied;
+}
+
+void EditJournal::remove(const QString &documentPath) {
+    QFile::remove(journalPath(documentPath));
+    QSettings().remove(documentKey(documentPath));
+}
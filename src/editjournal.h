@@ -0,0 +1,94 @@
+#pragma once
+#include <QFile>
+#include <QLockFile>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+#include "subtitlestore.h"
+
+class QTimer;
+class SubtitleModel;
+
+// Append-only binary log of the edits applied to a document since it was
+// last loaded or saved, kept next to it as "<document>.journal". Every edit
+// costs a few bytes instead of rewriting the file, and after a crash the
+// journal is replayed onto the file on disk to get the edits back.
+//
+// Layout: a header (magic, version, size and mtime of the base document)
+// followed by records [u32 length][type + payload][u16 CRC]. Replay stops at
+// the first record that is cut short, fails its checksum or does not fit the
+// document (rows out of range).
+//
+// An open journal is locked ("<document>.journal.lock"), so a second
+// instance neither writes to it nor offers it for recovery while its owner
+// runs. Each open journal has its own settings key, so instances do not
+// overwrite each other's.
+class EditJournal : public QObject {
+    Q_OBJECT
+public:
+    explicit EditJournal(QObject *parent = nullptr);
+    ~EditJournal() override;
+
+    static QString journalPath(const QString &documentPath);
+
+    // Starts an empty journal for 'documentPath' as it is on disk now.
+    bool open(const QString &documentPath);
+    // Continues an existing journal after replay(), dropping anything past
+    // 'validEnd' (a torn last record).
+    bool resume(const QString &documentPath, qint64 validEnd);
+    // After a save: the saved file (possibly at a new path) becomes the base
+    // and only the records from 'from' on, made while saving, are kept.
+    bool rebase(const QString &documentPath, qint64 from);
+    // Closes and deletes the journal: the document was saved or its changes
+    // were thrown away.
+    void discard();
+    // Closes the journal but keeps it, to be offered for recovery: the
+    // document left the editor without being saved.
+    void close();
+
+    bool isOpen() const { return file_.isOpen(); }
+    qint64 position() const { return isOpen() ? file_.size() : 0; }
+    QString documentPath() const { return documentPath_; }
+
+    // Records reach the OS right away; fsync happens at most every 'ms'
+    // milliseconds (0: after every record).
+    void setSyncInterval(int ms);
+
+    void recordSplice(int row, int pos, int removedLength, const QString &inserted);
+    void recordShift(int first, int last, int deltaMs);
+    void recordTimingDeltas(int first, const QVector<int> &startDeltas,
+                            const QVector<int> &endDeltas, int sign);
+    void recordInsert(int row, const SubtitleStore &cues);
+    void recordRemove(int first, int count);
+
+    enum class Recovery {
+        None,        // no journal, or one without edits
+        Available,   // journal matches the file on disk
+        BaseChanged  // the file changed after the journal was started
+    };
+    // Documents whose journals previous runs left behind (they did not exit
+    // cleanly), skipping journals another running instance holds.
+    static QStringList pendingDocuments();
+    static Recovery recoveryState(const QString &documentPath);
+    // Applies the journal of 'documentPath' to 'model', which must hold the
+    // document as it is on disk. Returns the number of edits applied and
+    // sets 'validEnd' to the end of the last intact record.
+    static int replay(const QString &documentPath, SubtitleModel *model, qint64 *validEnd = nullptr);
+    static void remove(const QString &documentPath);
+
+private:
+    enum RecordType : quint8 { Splice = 1, Shift, TimingDeltas, Insert, Remove };
+
+    bool lock(const QString &documentPath);
+    bool writeHeader();
+    void append(const QByteArray &record);
+    void sync();
+
+    QString documentPath_;
+    QFile file_;
+    std::unique_ptr<QLockFile> lock_;
+    QTimer *syncTimer_;
+    bool unsynced_ = false;
+};
@@ -0,0 +1,135 @@
+#include "filemonitor.h"
+#include "subtitlefile.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QTimer>
+#include <QtConcurrent>
+
+namespace {
+
+// Long enough for a program to finish writing the file in a few steps.
+constexpr int ChangeDelayMs = 200;
+
+} // namespace
+
+FileMonitor::FileMonitor(QObject *parent) : QObject(parent), delay_(new QTimer(this)) {
+    delay_->setSingleShot(true);
+    delay_->setInterval(ChangeDelayMs);
+    connect(delay_, &QTimer::timeout, this, &FileMonitor::check);
+    connect(&watcher_, &QFileSystemWatcher::fileChanged, this, &FileMonitor::pathChanged);
+    // a file replaced by a rename drops out of the watch list; the directory
+    // sees it come back
+    connect(&watcher_, &QFileSystemWatcher::directoryChanged, this, [this] {
+        if (!path_.isEmpty() && !watcher_.files().contains(path_)) pathChanged();
+    });
+    connect(&job_, &QFutureWatcher<Result>::finished, this, &FileMonitor::finished);
+}
+
+FileMonitor::~FileMonitor() {
+    job_.waitForFinished();
+}
+
+void FileMonitor::watch(const QString &path, const TextFormat &format, SubtitleFormat::Id documentFormat) {
+    stop();
+    path_ = path;
+    format_ = format;
+    documentFormat_ = documentFormat;
+    const QFileInfo info(path);
+    size_ = info.size();
+    modified_ = info.lastModified();
+    watcher_.addPath(path);
+    watcher_.addPath(info.absolutePath());
+    startJob(true);
+}
+
+void FileMonitor::stop() {
+    delay_->stop();
+    if (!watcher_.files().isEmpty()) watcher_.removePaths(watcher_.files());
+    if (!watcher_.directories().isEmpty()) watcher_.removePaths(watcher_.directories());
+    path_.clear();
+    index_.clear();
+    pending_ = false;
+    ++generation_; // a job still running is dropped when it finishes
+}
+
+void FileMonitor::pathChanged() {
+    delay_->start();
+}
+
+void FileMonitor::check() {
+    if (path_.isEmpty()) return;
+    const QFileInfo info(path_);
+    // removed, or in the middle of being replaced: wait for the directory
+    if (!info.exists()) return;
+    if (!watcher_.files().contains(path_)) watcher_.addPath(path_);
+    if (info.size() == size_ && info.lastModified() == modified_) return;
+    // one job at a time: each one starts from the index the last one left
+    if (job_.isRunning()) {
+        pending_ = true;
+        return;
+    }
+    startJob(false);
+}
+
+void FileMonitor::startJob(bool indexOnly) {
+    jobGeneration_ = generation_;
+    // captures copies only: a dropped job may outlive the monitor's state
+    job_.setFuture(QtConcurrent::run([path = path_, index = index_, format = format_,
+                                      documentFormat = documentFormat_, indexOnly] {
+        Result r;
+        r.indexOnly = indexOnly;
+        r.index = index;
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) return r;
+        r.size = file.size();
+        r.modified = QFileInfo(path).lastModified();
+        const char *data = nullptr;
+        qint64 size = file.size();
+        QByteArray buffer; // when the file cannot be memory-mapped
+        if (size > 0) {
+            if (uchar *mapped = file.map(0, size))
+                data = reinterpret_cast<const char *>(mapped);
+        }
+        if (!data) {
+            buffer = file.readAll();
+            data = buffer.constData();
+            size = buffer.size();
+        }
+
+        if (indexOnly) {
+            if (documentFormat == SubtitleFormat::Srt) r.index.build(data, size, format);
+            return r;
+        }
+        // still SRT, read the same way: parse only the blocks that changed
+        if (r.index.isValid()) {
+            const TextEncoding::Kind kind = TextEncoding::kindForName(r.index.format().encoding);
+            const qsizetype bom = TextEncoding::bomLength(kind, data, size);
+            if (SubtitleFormat::detect(path, data + bom, size - bom, kind) == SubtitleFormat::Srt
+                && r.index.update(data, size, r.change.cues)) {
+                r.change.partial = true;
+                r.change.format = r.index.format();
+                r.read = true;
+                return r;
+            }
+        }
+        r.read = SubtitleFile::read(path, r.change.document, {}, &r.change.format, &r.change.documentFormat);
+        r.index.clear();
+        if (r.read && r.change.documentFormat == SubtitleFormat::Srt) r.index.build(data, size, r.change.format);
+        return r;
+    }));
+}
+
+void FileMonitor::finished() {
+    if (jobGeneration_ != generation_) return; // stopped or watching anew since
+    Result r = job_.result();
+    job_.setFuture(QFuture<Result>()); // drop the copy the future holds
+    if (r.indexOnly || r.read) index_ = std::move(r.index);
+    if (r.read) {
+        size_ = r.size;
+        modified_ = r.modified;
+        format_ = r.change.format;
+        documentFormat_ = r.change.documentFormat;
+    }
+    if (std::exchange(pending_, false)) check();
+    if (r.read) emit changed(r.change);
+}
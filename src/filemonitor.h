@@ -0,0 +1,72 @@
+#pragma once
+#include <QDateTime>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QObject>
+#include "srtblockindex.h"
+#include "subtitleformat.h"
+
+class QTimer;
+
+// A new version of the watched file: the rows of the version last seen that
+// changed, or, when the file could not be compared in part, all of it.
+struct FileChange {
+    bool partial = false;
+    SrtBlockIndex::Change cues; // when partial
+    SubtitleStore document;     // otherwise
+    TextFormat format;
+    SubtitleFormat::Id documentFormat = SubtitleFormat::Srt;
+};
+
+// Notices when another program rewrites the open file and reads the new
+// version off the GUI thread. An SRT file in an encoding the scanner reads in
+// place is indexed once (SrtBlockIndex) and compared block by block, so only
+// the cues that changed are parsed; anything else is read in full.
+//
+// Replacing the file (write to a temporary, then rename) is followed through
+// the directory; bursts of writes are coalesced.
+class FileMonitor : public QObject {
+    Q_OBJECT
+public:
+    explicit FileMonitor(QObject *parent = nullptr);
+    ~FileMonitor() override;
+
+    // Starts watching 'path', which holds the document as it is shown (just
+    // loaded or saved), and indexes it in the background.
+    void watch(const QString &path, const TextFormat &format, SubtitleFormat::Id documentFormat);
+    // Stops watching: while the document itself writes the file, or once it
+    // is closed. A read in progress is dropped.
+    void stop();
+
+signals:
+    // The file changed on disk; 'change' is relative to the version the last
+    // watch() or change described.
+    void changed(const FileChange &change);
+
+private:
+    struct Result {
+        SrtBlockIndex index;
+        bool indexOnly = false; // from watch(): nothing to report
+        bool read = false;
+        FileChange change;
+        qint64 size = -1;
+        QDateTime modified;
+    };
+    void pathChanged();
+    void check();
+    void finished();
+    void startJob(bool indexOnly);
+
+    QFileSystemWatcher watcher_;
+    QTimer *delay_; // coalesces the writes of one save by the other program
+    QFutureWatcher<Result> job_;
+    QString path_;
+    TextFormat format_;
+    SubtitleFormat::Id documentFormat_ = SubtitleFormat::Srt;
+    SrtBlockIndex index_; // of the version last seen; copied into each job
+    qint64 size_ = -1;    // size and time of the version last seen
+    QDateTime modified_;
+    bool pending_ = false; // changed again while a job ran
+    quint64 generation_ = 0;
+    quint64 jobGeneration_ = 0;
+};
@@ -0,0 +1,121 @@
+#include "findpanel.h"
+#include "subtitlemodel.h"
+#include <QAbstractListModel>
+#include <QCheckBox>
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QListView>
+#include <QPushButton>
+#include <QTimer>
+#include <QVBoxLayout>
+
+namespace {
+
+constexpr int RefreshDelayMs = 100;
+
+} // namespace
+
+// One line per matching cue: its number and its (summarized) text, read
+// from the subtitle model on demand.
+class MatchListModel : public QAbstractListModel {
+public:
+    explicit MatchListModel(SubtitleModel *model, QObject *parent)
+        : QAbstractListModel(parent), model_(model) {}
+
+    void setRows(const QVector<int> &rows) {
+        beginResetModel();
+        rows_ = rows;
+        endResetModel();
+    }
+    int rowAt(int i) const { return rows_.value(i, -1); }
+
+    int rowCount(const QModelIndex &parent = {}) const override {
+        return parent.isValid() ? 0 : int(rows_.size());
+    }
+    QVariant data(const QModelIndex &index, int role) const override {
+        if (!index.isValid() || role != Qt::DisplayRole) return {};
+        const int row = rows_.at(index.row());
+        if (row >= model_->rowCount()) return {};
+        return QStringLiteral("%1\t%2")
+            .arg(model_->data(model_->index(row, SubtitleModel::LineNumber)).toString(),
+                 model_->data(model_->index(row, SubtitleModel::Text)).toString());
+    }
+
+private:
+    SubtitleModel *model_;
+    QVector<int> rows_;
+};
+
+FindPanel::FindPanel(SubtitleModel *model, QWidget *parent)
+    : QWidget(parent), model_(model), findEdit_(new QLineEdit(this)), replaceEdit_(new QLineEdit(this)),
+      caseBox_(new QCheckBox(tr("Match case"), this)), summary_(new QLabel(this)),
+      results_(new QListView(this)), matches_(new MatchListModel(model, this)), refreshTimer_(new QTimer(this))
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(4, 4, 4, 4);
+    QFormLayout *form = new QFormLayout;
+    findEdit_->setClearButtonEnabled(true);
+    findEdit_->setPlaceholderText(tr("Search cue text"));
+    form->addRow(tr("Find:"), findEdit_);
+    form->addRow(tr("Replace:"), replaceEdit_);
+    layout->addLayout(form);
+    QHBoxLayout *row = new QHBoxLayout;
+    row->addWidget(caseBox_);
+    row->addStretch();
+    QPushButton *replaceAll = new QPushButton(tr("Replace All"), this);
+    row->addWidget(replaceAll);
+    layout->addLayout(row);
+    layout->addWidget(summary_);
+    layout->addWidget(results_);
+
+    // a large file can match everywhere: keep the list virtual and cheap
+    results_->setModel(matches_);
+    results_->setUniformItemSizes(true);
+    results_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+    connect(findEdit_, &QLineEdit::textChanged, this, &FindPanel::updateSearch);
+    connect(caseBox_, &QCheckBox::toggled, this, &FindPanel::updateSearch);
+    connect(findEdit_, &QLineEdit::returnPressed, this, [this] {
+        if (matches_->rowCount() == 0) return;
+        results_->setCurrentIndex(matches_->index(0));
+        emit rowActivated(matches_->rowAt(0));
+    });
+    connect(results_, &QListView::activated, this, [this](const QModelIndex &index) {
+        emit rowActivated(matches_->rowAt(index.row()));
+    });
+    connect(replaceAll, &QPushButton::clicked, this, [this] {
+        if (findEdit_->text().isEmpty()) return;
+        emit replaceAllRequested(findEdit_->text(), replaceEdit_->text(),
+                                 caseBox_->isChecked() ? Qt::CaseSensitive : Qt::CaseInsensitive);
+    });
+
+    refreshTimer_->setSingleShot(true);
+    refreshTimer_->setInterval(RefreshDelayMs);
+    connect(refreshTimer_, &QTimer::timeout, this, &FindPanel::refresh);
+    connect(model_, &SubtitleModel::searchChanged, this, [this] {
+        if (!refreshTimer_->isActive()) refreshTimer_->start();
+    });
+    refresh();
+}
+
+void FindPanel::focusSearch() {
+    findEdit_->setFocus();
+    findEdit_->selectAll();
+}
+
+void FindPanel::updateSearch() {
+    // the index answers in milliseconds: no need to wait for a typing pause
+    model_->setSearch(findEdit_->text(), caseBox_->isChecked() ? Qt::CaseSensitive : Qt::CaseInsensitive);
+    refreshTimer_->stop();
+    refresh();
+}
+
+void FindPanel::refresh() {
+    const QVector<int> &rows = model_->searchMatches();
+    matches_->setRows(rows);
+    if (model_->searchText().isEmpty()) summary_->clear();
+    else if (rows.isEmpty()) summary_->setText(tr("No matches"));
+    else summary_->setText(tr("%n matching cue(s)", nullptr, int(rows.size())));
+}
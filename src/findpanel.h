@@ -0,0 +1,40 @@
+#pragma once
+#include <QWidget>
+
+class QCheckBox;
+class QLabel;
+class QLineEdit;
+class QListView;
+class QTimer;
+class MatchListModel;
+class SubtitleModel;
+
+// Find and replace over the cue text. The search runs as you type (see
+// SubtitleModel::setSearch) and the matching cues are listed below the
+// fields; activating one asks to go to it. Replace All is handed to the
+// main window, which owns the undo history.
+class FindPanel : public QWidget {
+    Q_OBJECT
+public:
+    explicit FindPanel(SubtitleModel *model, QWidget *parent = nullptr);
+
+    // Focuses the search field with its text selected.
+    void focusSearch();
+
+signals:
+    void rowActivated(int row);
+    void replaceAllRequested(const QString &needle, const QString &replacement, Qt::CaseSensitivity cs);
+
+private:
+    void updateSearch();
+    void refresh();
+
+    SubtitleModel *model_;
+    QLineEdit *findEdit_;
+    QLineEdit *replaceEdit_;
+    QCheckBox *caseBox_;
+    QLabel *summary_;
+    QListView *results_;
+    MatchListModel *matches_;
+    QTimer *refreshTimer_; // coalesces the match updates of edits and loads
+};
@@ -0,0 +1,83 @@
+#include "hashing.h"
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+constexpr quint64 Prime1 = 0x9E3779B185EBCA87ULL;
+constexpr quint64 Prime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr quint64 Prime3 = 0x165667B19E3779F9ULL;
+constexpr quint64 Prime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr quint64 Prime5 = 0x27D4EB2F165667C5ULL;
+
+inline quint64 rotl(quint64 x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// Unaligned little-endian loads.
+inline quint64 read64(const uchar *p) {
+    quint64 v;
+    std::memcpy(&v, p, sizeof(v));
+    return qFromLittleEndian(v);
+}
+
+inline quint32 read32(const uchar *p) {
+    quint32 v;
+    std::memcpy(&v, p, sizeof(v));
+    return qFromLittleEndian(v);
+}
+
+inline quint64 round(quint64 acc, quint64 input) {
+    acc += input * Prime2;
+    return rotl(acc, 31) * Prime1;
+}
+
+inline quint64 mergeRound(quint64 acc, quint64 val) {
+    acc ^= round(0, val);
+    return acc * Prime1 + Prime4;
+}
+
+} // namespace
+
+quint64 hash64(const void *data, qsizetype size, quint64 seed) {
+    const uchar *p = static_cast<const uchar *>(data);
+    const uchar *const end = p + size;
+    quint64 h;
+
+    if (size >= 32) {
+        quint64 v1 = seed + Prime1 + Prime2;
+        quint64 v2 = seed + Prime2;
+        quint64 v3 = seed;
+        quint64 v4 = seed - Prime1;
+        const uchar *const limit = end - 32;
+        do {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = seed + Prime5;
+    }
+    h += quint64(size);
+
+    for (; p + 8 <= end; p += 8) h = rotl(h ^ round(0, read64(p)), 27) * Prime1 + Prime4;
+    if (p + 4 <= end) {
+        h = rotl(h ^ (quint64(read32(p)) * Prime1), 23) * Prime2 + Prime3;
+        p += 4;
+    }
+    for (; p < end; ++p) h = rotl(h ^ (*p * Prime5), 11) * Prime1;
+
+    h ^= h >> 33;
+    h *= Prime2;
+    h ^= h >> 29;
+    h *= Prime3;
+    h ^= h >> 32;
+    return h;
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include <QtGlobal>
+
+// Fast non-cryptographic 64-bit hash (the XXH64 algorithm), for cache keys and
+// change detection over large buffers. Processes 32 bytes per step, so hashing
+// a whole subtitle file costs a fraction of parsing it.
+quint64 hash64(const void *data, qsizetype size, quint64 seed = 0);
@@ -0,0 +1,20 @@
+#include "highlightdelegate.h"
+#include "appsettings.h"
+#include "subtitlemodel.h"
+
+void HighlightDelegate::initStyleOption(QStyleOptionViewItem *option, const QModelIndex &index) const {
+    QStyledItemDelegate::initStyleOption(option, index);
+    const QBrush diff = diffBackground(index);
+    if (diff.style() != Qt::NoBrush) option->backgroundBrush = diff;
+    if (index.data(role_).toBool()) option->backgroundBrush = colour_();
+}
+
+QBrush HighlightDelegate::diffBackground(const QModelIndex &index) {
+    const int flags = index.data(SubtitleModel::DiffRole).toInt();
+    if (!flags) return QBrush();
+    const AppSettings *settings = AppSettings::instance();
+    if (flags & SubtitleDiff::RowConflict) return settings->diffConflictColour();
+    if (flags & SubtitleDiff::RowRemoved) return settings->diffRemovedColour();
+    if (flags & SubtitleDiff::RowModified) return settings->diffChangedColour();
+    return settings->diffAddedColour();
+}
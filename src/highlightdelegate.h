@@ -0,0 +1,27 @@
+#pragma once
+#include <QBrush>
+#include <QColor>
+#include <QStyledItemDelegate>
+#include <functional>
+
+// Default painting, on a highlight background for cells whose 'role' data
+// is true/non-zero (e.g. the times of overlapping cues, the '#' of cues with
+// QC issues). The colour is looked up at paint time so settings changes
+// apply on the next repaint.
+class HighlightDelegate : public QStyledItemDelegate {
+public:
+    HighlightDelegate(int role, std::function<QColor()> colour, QObject *parent = nullptr)
+        : QStyledItemDelegate(parent), role_(role), colour_(std::move(colour)) {}
+
+    // Row background for the comparison marks of the row's cue
+    // (SubtitleModel::DiffRole); a null brush when it has none. Shared by the
+    // delegates of every column, under their own highlight.
+    static QBrush diffBackground(const QModelIndex &index);
+
+protected:
+    void initStyleOption(QStyleOptionViewItem *option, const QModelIndex &index) const override;
+
+private:
+    int role_;
+    std::function<QColor()> colour_;
+};
@@ -0,0 +1,335 @@
+#include "intervalindex.h"
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace {
+
+// Past this many changed rows, merging them back in one pass (and sweeping
+// the overlaps once) beats placing them one by one.
+constexpr int MaxPlacedRows = 32;
+
+} // namespace
+
+bool IntervalIndex::isInterval(int start, int end) {
+    return start != SubtitleStore::NoTime && end != SubtitleStore::NoTime && end > start;
+}
+
+void IntervalIndex::clear() {
+    *this = IntervalIndex();
+}
+
+void IntervalIndex::rebuild(const SubtitleStore &store) {
+    clear();
+    QVector<int> rows;
+    rows.reserve(store.size());
+    for (int r = 0; r < int(store.size()); ++r) {
+        if (isInterval(store.startMs(r), store.endMs(r))) rows.append(r);
+    }
+    sortRows(store, rows);
+    mergeRows(store, rows);
+}
+
+void IntervalIndex::sortRows(const SubtitleStore &store, QVector<int> &rows) const {
+    const int *starts = store.startMsData();
+    std::sort(rows.begin(), rows.end(), [starts](int a, int b) {
+        return starts[a] != starts[b] ? starts[a] < starts[b] : a < b;
+    });
+}
+
+void IntervalIndex::mergeRows(const SubtitleStore &store, const QVector<int> &rows) {
+    if (!rows.isEmpty()) {
+        const int *starts = store.startMsData();
+        QVector<int> merged;
+        merged.reserve(order_.size() + rows.size());
+        std::merge(order_.cbegin(), order_.cend(), rows.cbegin(), rows.cend(), std::back_inserter(merged),
+                   [starts](int a, int b) {
+                       return starts[a] != starts[b] ? starts[a] < starts[b] : a < b;
+                   });
+        order_ = std::move(merged);
+    }
+
+    const qsizetype n = order_.size();
+    starts_.resize(n);
+    ends_.resize(n);
+    pos_.resize(store.size());
+    std::fill(pos_.begin(), pos_.end(), -1);
+    for (qsizetype i = 0; i < n; ++i) {
+        const int row = order_.at(i);
+        starts_[i] = store.startMs(row);
+        ends_[i] = store.endMs(row);
+        pos_[row] = int(i);
+    }
+    rebuildTree();
+    sweepOverlaps();
+}
+
+void IntervalIndex::rebuildTree() {
+    const int n = int(order_.size());
+    leafBase_ = 1;
+    while (leafBase_ < n) leafBase_ *= 2;
+    maxEnd_.fill(SubtitleStore::NoTime, 2 * leafBase_);
+    std::copy(ends_.cbegin(), ends_.cend(), maxEnd_.begin() + leafBase_);
+    for (int i = leafBase_ - 1; i >= 1; --i) maxEnd_[i] = qMax(maxEnd_.at(2 * i), maxEnd_.at(2 * i + 1));
+}
+
+void IntervalIndex::updateTree(int lo, int hi) {
+    if (lo > hi) return;
+    // leaves past the last entry (it was just removed) are empty
+    for (int i = lo; i <= hi; ++i) maxEnd_[leafBase_ + i] = i < ends_.size() ? ends_.at(i) : SubtitleStore::NoTime;
+    for (lo = (leafBase_ + lo) / 2, hi = (leafBase_ + hi) / 2; lo >= 1; lo /= 2, hi /= 2) {
+        for (int i = lo; i <= hi; ++i) maxEnd_[i] = qMax(maxEnd_.at(2 * i), maxEnd_.at(2 * i + 1));
+    }
+}
+
+int IntervalIndex::maxEndBefore(int p) const {
+    int m = SubtitleStore::NoTime;
+    for (int lo = leafBase_, hi = leafBase_ + p; lo < hi; lo /= 2, hi /= 2) {
+        if (lo & 1) m = qMax(m, maxEnd_.at(lo++));
+        if (hi & 1) m = qMax(m, maxEnd_.at(--hi));
+    }
+    return m;
+}
+
+void IntervalIndex::placeRow(const SubtitleStore &store, int row) {
+    const int start = store.startMs(row);
+    const int end = store.endMs(row);
+    const bool interval = isInterval(start, end);
+    int p = pos_.at(row);
+    if (p < 0 && !interval) return;
+    if (p < 0) {
+        // new entry: appended, then moved into place like any other
+        order_.append(row);
+        starts_.append(start);
+        ends_.append(end);
+        p = int(order_.size()) - 1;
+        pos_[row] = p;
+        if (p >= leafBase_) rebuildTree();
+    }
+    const int n = int(order_.size());
+
+    // new place: the others are still in order around p; an entry that is
+    // no interval any more goes to the end and is dropped there
+    int q = n - 1;
+    if (interval) {
+        auto less = [&](int i) {
+            return starts_.at(i) != start ? starts_.at(i) < start : order_.at(i) < row;
+        };
+        // first position in [lo, hi) not before the new timings
+        auto firstNotLess = [&](int lo, int hi) {
+            while (lo < hi) {
+                const int mid = (lo + hi) / 2;
+                if (less(mid)) lo = mid + 1;
+                else hi = mid;
+            }
+            return lo;
+        };
+        q = p;
+        if (p > 0 && !less(p - 1)) q = firstNotLess(0, p);
+        else if (p + 1 < n && less(p + 1)) q = firstNotLess(p + 1, n) - 1;
+    }
+    auto move = [p, q](QVector<int> &v) {
+        if (q < p) std::rotate(v.begin() + q, v.begin() + p, v.begin() + p + 1);
+        else if (q > p) std::rotate(v.begin() + p, v.begin() + p + 1, v.begin() + q + 1);
+    };
+    move(order_);
+    move(starts_);
+    move(ends_);
+    starts_[q] = start;
+    ends_[q] = end;
+    const int lo = qMin(p, q);
+    const int hi = qMax(p, q);
+    if (!interval) {
+        order_.removeLast();
+        starts_.removeLast();
+        ends_.removeLast();
+        pos_[row] = -1;
+    }
+    for (int i = lo; i <= hi && i < order_.size(); ++i) pos_[order_.at(i)] = i;
+    updateTree(lo, hi);
+}
+
+void IntervalIndex::insertRows(const SubtitleStore &store, int first, int count) {
+    if (count <= 0) return;
+    // rows at or after 'first' move down by 'count'
+    for (int &row : order_) {
+        if (row >= first) row += count;
+    }
+    pos_.insert(first, count, -1);
+    overlapping_.insert(first, count, false);
+    if (count > MaxPlacedRows) {
+        QVector<int> rows;
+        for (int r = first; r < first + count; ++r) {
+            if (isInterval(store.startMs(r), store.endMs(r))) rows.append(r);
+        }
+        sortRows(store, rows);
+        mergeRows(store, rows);
+        return;
+    }
+    overlapChanges_.clear();
+    allOverlapsChanged_ = false;
+    for (int r = first; r < first + count; ++r) placeRow(store, r);
+    // the new rows, and the rows they overlap, may have gained an overlap
+    for (int r = first; r < first + count; ++r) {
+        refreshOverlap(r);
+        for (int other : overlapsWith(r)) refreshOverlap(other);
+    }
+}
+
+void IntervalIndex::removeRows(int first, int count) {
+    if (count <= 0) return;
+    const int last = first + count - 1;
+    const bool incremental = count <= MaxPlacedRows;
+    // rows that overlapped removed ones may have lost their only overlap
+    QVector<int> affected;
+    if (incremental) {
+        for (int r = first; r <= last; ++r) {
+            for (int other : overlapsWith(r)) {
+                if (other < first) affected.append(other);
+                else if (other > last) affected.append(other - count);
+            }
+        }
+    }
+
+    const qsizetype n = order_.size();
+    qsizetype out = 0;
+    qsizetype firstMoved = n;
+    for (qsizetype i = 0; i < n; ++i) {
+        const int row = order_.at(i);
+        if (row >= first && row <= last) {
+            firstMoved = qMin(firstMoved, i);
+            continue;
+        }
+        order_[out] = row > last ? row - count : row;
+        starts_[out] = starts_.at(i);
+        ends_[out] = ends_.at(i);
+        ++out;
+    }
+    order_.resize(out);
+    starts_.resize(out);
+    ends_.resize(out);
+    pos_.remove(first, count);
+    overlapping_.remove(first, count);
+    // entries before the first removed one kept their places
+    for (qsizetype i = firstMoved; i < out; ++i) pos_[order_.at(i)] = int(i);
+    updateTree(int(firstMoved), int(n) - 1);
+
+    if (!incremental) {
+        sweepOverlaps();
+        return;
+    }
+    overlapChanges_.clear();
+    allOverlapsChanged_ = false;
+    for (int r : std::as_const(affected)) refreshOverlap(r);
+}
+
+void IntervalIndex::updateRows(const SubtitleStore &store, int first, int last) {
+    if (first > last) return;
+    if (last - first + 1 > MaxPlacedRows) {
+        // take the changed rows out, keeping the others in order, then merge
+        // them back in at their new places
+        qsizetype out = 0;
+        for (qsizetype i = 0; i < order_.size(); ++i) {
+            const int row = order_.at(i);
+            if (row >= first && row <= last) continue;
+            order_[out++] = row;
+        }
+        order_.resize(out);
+        QVector<int> rows;
+        for (int r = first; r <= last; ++r) {
+            if (isInterval(store.startMs(r), store.endMs(r))) rows.append(r);
+        }
+        sortRows(store, rows);
+        mergeRows(store, rows);
+        return;
+    }
+    overlapChanges_.clear();
+    allOverlapsChanged_ = false;
+    // the flags that can change: the moved rows' own, and those of the rows
+    // they overlapped before or overlap now
+    QVector<int> affected;
+    for (int r = first; r <= last; ++r) affected += overlapsWith(r);
+    for (int r = first; r <= last; ++r) placeRow(store, r);
+    for (int r = first; r <= last; ++r) {
+        affected += overlapsWith(r);
+        affected.append(r);
+    }
+    for (int r : std::as_const(affected)) refreshOverlap(r);
+}
+
+void IntervalIndex::collect(int node, int lo, int hi, int limit, int afterMs, QVector<int> &out) const {
+    // node covers positions [lo, hi); only [0, limit) is wanted
+    if (lo >= limit || maxEnd_.at(node) <= afterMs) return;
+    if (node >= leafBase_) {
+        out.append(order_.at(lo));
+        return;
+    }
+    const int mid = (lo + hi) / 2;
+    collect(2 * node, lo, mid, limit, afterMs, out);
+    collect(2 * node + 1, mid, hi, limit, afterMs, out);
+}
+
+QVector<int> IntervalIndex::inRange(int fromMs, int toMs) const {
+    QVector<int> out;
+    if (order_.isEmpty() || toMs <= fromMs) return out;
+    // starts before the range ends, and ends after it starts
+    const int limit = int(std::lower_bound(starts_.cbegin(), starts_.cend(), toMs) - starts_.cbegin());
+    collect(1, 0, leafBase_, limit, fromMs, out);
+    return out;
+}
+
+QVector<int> IntervalIndex::activeAt(int ms) const {
+    return inRange(ms, ms + 1);
+}
+
+QVector<int> IntervalIndex::overlapsWith(int row) const {
+    if (row < 0 || row >= pos_.size() || pos_.at(row) < 0) return {};
+    const int p = pos_.at(row);
+    QVector<int> out = inRange(starts_.at(p), ends_.at(p));
+    out.removeOne(row);
+    return out;
+}
+
+int IntervalIndex::firstStartingFrom(int ms) const {
+    const auto it = std::lower_bound(starts_.cbegin(), starts_.cend(), ms);
+    return it == starts_.cend() ? -1 : order_.at(it - starts_.cbegin());
+}
+
+void IntervalIndex::sweepOverlaps() {
+    overlapping_.fill(false, pos_.size());
+    // in start order, a row overlaps an earlier one iff it starts before the
+    // largest end so far, and a later one iff the next row starts before its
+    // own end
+    int maxEnd = SubtitleStore::NoTime;
+    const qsizetype n = order_.size();
+    for (qsizetype i = 0; i < n; ++i) {
+        const bool earlier = starts_.at(i) < maxEnd;
+        const bool later = i + 1 < n && starts_.at(i + 1) < ends_.at(i);
+        overlapping_[order_.at(i)] = earlier || later;
+        maxEnd = qMax(maxEnd, ends_.at(i));
+    }
+    overlapChanges_.clear();
+    allOverlapsChanged_ = true;
+}
+
+void IntervalIndex::refreshOverlap(int row) {
+    // the sweep's test, for one entry: the tree gives the largest end so far
+    const int p = pos_.at(row);
+    const bool has = p >= 0
+        && ((p + 1 < order_.size() && starts_.at(p + 1) < ends_.at(p)) || maxEndBefore(p) > starts_.at(p));
+    if (overlapping_.at(row) == has) return;
+    overlapping_[row] = has;
+    overlapChanges_.append(row);
+}
+
+bool IntervalIndex::isOverlapping(int row) const {
+    return row >= 0 && row < overlapping_.size() && overlapping_.at(row);
+}
+
+QVector<int> IntervalIndex::overlappingRows() const {
+    QVector<int> out;
+    for (int r = 0; r < int(overlapping_.size()); ++r) {
+        if (overlapping_.at(r)) out.append(r);
+    }
+    return out;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <QVector>
+#include "subtitlestore.h"
+
+// Index over the [start, end) timings of a SubtitleStore for time queries:
+// the rows sorted by start time plus a max-end segment tree over that order
+// (an augmented interval tree laid out as an array). Rows without both
+// timings, or with end <= start, are not intervals and never match.
+//
+// Queries cost O(log n) per match. A few changed rows are moved to their new
+// places one by one: the entries between the old and the new place shift by
+// one and only their part of the tree is updated, so a retime that keeps the
+// order costs O(log n) per row. Larger batches are merged back into the
+// order in one O(n + k log k) pass instead. Row insertions and removals
+// still renumber every indexed row after them (a tight O(n) loop).
+//
+// The overlap flags are kept up to date the same way: after a small change
+// only the rows overlapping the changed ones, before and after it, are
+// looked at again; a batch or rebuild sweeps them all once.
+class IntervalIndex {
+public:
+    void clear();
+    void rebuild(const SubtitleStore &store);
+
+    // Keep the index in step with the store: rows [first, first + count)
+    // were inserted / removed, or the timings of rows [first, last] changed.
+    void insertRows(const SubtitleStore &store, int first, int count);
+    void removeRows(int first, int count);
+    void updateRows(const SubtitleStore &store, int first, int last);
+
+    // Rows whose interval contains 'ms', ordered by start time.
+    QVector<int> activeAt(int ms) const;
+    // Rows whose interval intersects [fromMs, toMs), ordered by start time.
+    QVector<int> inRange(int fromMs, int toMs) const;
+    // Rows overlapping row 'row' (without it).
+    QVector<int> overlapsWith(int row) const;
+    // First row, in start order, starting at or after 'ms'; -1 if none.
+    int firstStartingFrom(int ms) const;
+
+    // Whether row 'row' overlaps any other row, and all such rows.
+    bool isOverlapping(int row) const;
+    QVector<int> overlappingRows() const;
+    // The same flags, indexed by row.
+    const QVector<bool> &overlapFlags() const { return overlapping_; }
+    // Rows whose flag the last update changed, in row numbers after it;
+    // meaningless when allOverlapsChanged() (a rebuild or a batch).
+    const QVector<int> &overlapChanges() const { return overlapChanges_; }
+    bool allOverlapsChanged() const { return allOverlapsChanged_; }
+
+    qsizetype size() const { return order_.size(); }
+
+private:
+    static bool isInterval(int start, int end);
+    // Sorts 'rows' by (start, row) using the timings in 'store'.
+    void sortRows(const SubtitleStore &store, QVector<int> &rows) const;
+    // Merges the already sorted 'rows' into the order and rebuilds the rest.
+    void mergeRows(const SubtitleStore &store, const QVector<int> &rows);
+    void rebuildTree();
+    // Refreshes leaves [lo, hi] from ends_ and their ancestors.
+    void updateTree(int lo, int hi);
+    // Largest end of positions [0, p).
+    int maxEndBefore(int p) const;
+    // Puts 'row' at its place for its timings in 'store' (taking it out when
+    // they are no interval), shifting the entries in between.
+    void placeRow(const SubtitleStore &store, int row);
+    void collect(int node, int lo, int hi, int limit, int afterMs, QVector<int> &out) const;
+    void sweepOverlaps();
+    // Recomputes the flag of 'row'; a change is added to overlapChanges_.
+    void refreshOverlap(int row);
+
+    QVector<int> order_;  // rows by (start, row)
+    QVector<int> starts_; // start time of order_[i]
+    QVector<int> ends_;   // end time of order_[i]
+    QVector<int> pos_;    // row -> position in order_, -1 if not indexed
+    QVector<int> maxEnd_; // segment tree over ends_, leaves at leafBase_
+    int leafBase_ = 0;
+
+    QVector<bool> overlapping_; // by row
+    QVector<int> overlapChanges_;
+    bool allOverlapsChanged_ = false;
+};
@@ -1,11 +1,29 @@
 #include <QApplication>
+#include <QCommandLineParser>
 #include "mainwindow.h"
+#include "trace.h"
 
 int main(int argc, char *argv[]) {
     QApplication app(argc, argv);
     QApplication::setApplicationName("SubStudio");
+
+    // --trace FILE (or SUBSTUDIO_TRACE=FILE): record spans while running and
+    // write them as Chrome/Perfetto trace JSON on exit
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption traceOpt("trace", "Write a Chrome/Perfetto trace of the session to <file> on exit.", "file");
+    parser.addOption(traceOpt);
+    parser.process(app);
+    const QString tracePath = parser.isSet(traceOpt) ? parser.value(traceOpt) : qEnvironmentVariable("SUBSTUDIO_TRACE");
+    Trace::setEnabled(!tracePath.isEmpty());
+
     MainWindow w;
     w.setWindowTitle("SubStudio");
     w.show();
-    return app.exec();
+    const int status = app.exec();
+    if (!tracePath.isEmpty()) {
+        Trace::setEnabled(false);
+        if (!Trace::writeJson(tracePath)) qWarning("Could not write the trace to %s", qPrintable(tracePath));
+    }
+    return status;
 }
@@ -1,5 +1,23 @@
 #include "mainwindow.h"
+#include "appsettings.h"
+#include "cpsdelegate.h"
+#include "diffpanel.h"
+#include "edithistory.h"
+#include "highlightdelegate.h"
+#include "editjournal.h"
+#include "filemonitor.h"
+#include "findpanel.h"
+#include "qcpanel.h"
+#include "spelldictionary.h"
+#include "spellhighlighter.h"
+#include "subtitlefile.h"
+#include "subtitleformat.h"
+#include "subtitleloader.h"
 #include "subtitlemodel.h"
+#include "subtitlesaver.h"
+#include "subtitletableview.h"
+#include "textdelegate.h"
+#include "trace.h"
 
 #include <QMenuBar>
 #include <QStatusBar>
@@ -7,6 +25,8 @@
 #include <QFileDialog>
 #include <QTableView>
 #include <QHeaderView>
+#include <QFontMetrics>
+#include <QStyle>
 #include <QMenu>
 #include <QAction>
 #include <QVBoxLayout>
@@ -14,84 +34,101 @@
 #include <QTextEdit>
 #include <QItemSelectionModel>
 #include <QMessageBox>
-#include <QStyledItemDelegate>
-#include <QPainter>
+#include <QPushButton>
 #include <QSettings>
 #include <QCloseEvent>
 #include <QFileInfo>
 #include <QDir>
+#include <QProgressBar>
+#include <QToolButton>
+#include <QInputDialog>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QSpinBox>
+#include <QColorDialog>
+#include <QDockWidget>
+#include <QLineEdit>
+#include <QLabel>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QHBoxLayout>
+#include <QTextDocument>
+#include <QTextCursor>
+#include <QLocale>
+#include <QFutureWatcher>
+#include <QScrollBar>
+#include <QtConcurrent>
+#include <algorithm>
+#include <utility>
 
-class CPSDelegate : public QStyledItemDelegate {
-public:
-    explicit CPSDelegate(QObject *parent = nullptr) : QStyledItemDelegate(parent) {}
-
-    // Blends 'fg' over 'bg' according to alpha (alpha ∈ [0,1])
-    static QColor blend(const QColor &fg, const QColor &bg, double alpha) {
-        alpha = std::min(std::max(alpha, 0.0), 1.0);
-        int r = qRound(fg.red()   * alpha + bg.red()   * (1.0 - alpha));
-        int g = qRound(fg.green() * alpha + bg.green() * (1.0 - alpha));
-        int b = qRound(fg.blue()  * alpha + bg.blue()  * (1.0 - alpha));
-        return QColor(r, g, b);
-    }
-
-    void paint(QPainter *painter, const QStyleOptionViewItem &option,
-               const QModelIndex &index) const override
-    {
-        if (option.state & QStyle::State_Selected) {
-            QStyledItemDelegate::paint(painter, option, index);
-            return;
-        }
-
-        QVariant v = index.data(Qt::DisplayRole);
-        bool ok = false;
-        int cps = v.toInt(&ok);
-        if (!ok || cps <= 0) {
-            QStyledItemDelegate::paint(painter, option, index);
-            return;
-        }
-
-        QSettings s;
-        int warn = s.value("Subtitle/CPSWarning", 15).toInt();
-        int error = s.value("Subtitle/CPSError", 25).toInt();
-        QColor errorColor = s.value("Colour/CpsError", QColor(255,0,0)).value<QColor>();
-
-        if (error < warn) error = warn;
-
-        if (cps <= warn) {
-            QStyledItemDelegate::paint(painter, option, index);
-            return;
-        }
+namespace {
 
-        double alpha = (double)(cps - warn + 1) / (double)(error - warn + 1);
-        alpha = std::clamp(alpha, 0.0, 1.0);
+constexpr int EditIdleMs = 150;     // commit after this much typing pause
+constexpr int MaxEditDelayMs = 250; // never keep an edit pending longer
+constexpr int HudIntervalMs = 1000; // performance HUD refresh
 
-        // background base (considera alternate rows)
-        QColor baseBg = option.palette.color(QPalette::Base);
-        if (option.features.testFlag(QStyleOptionViewItem::Alternate))
-            baseBg = option.palette.color(QPalette::AlternateBase);
-
-        QColor blendedBg = blend(errorColor, baseBg, alpha);
+// Small form asking for several times at once; returns false on cancel or when
+// a field does not parse.
+bool askTimes(QWidget *parent, const QString &title, const QStringList &labels,
+              const QStringList &defaults, QVector<int> &out)
+{
+    QDialog dlg(parent);
+    dlg.setWindowTitle(title);
+    QFormLayout *form = new QFormLayout(&dlg);
+    QVector<QLineEdit *> edits;
+    for (int i = 0; i < labels.size(); ++i) {
+        QLineEdit *e = new QLineEdit(defaults.value(i), &dlg);
+        form->addRow(labels.at(i), e);
+        edits.append(e);
+    }
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dlg);
+    QObject::connect(buttons, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
+    QObject::connect(buttons, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+    form->addRow(buttons);
+    if (dlg.exec() != QDialog::Accepted) return false;
 
-        painter->save();
-        painter->setPen(Qt::NoPen);
-        painter->setBrush(blendedBg);
-        QRect r = option.rect;
-        r.adjust(0, 1, 0, 0);
-        painter->drawRect(r);
+    out.clear();
+    for (QLineEdit *e : edits) {
+        bool ok = false;
+        out.append(TimingEngine::parseTime(e->text(), &ok));
+        if (!ok) return false;
+    }
+    return true;
+}
 
-        QString text = index.data(Qt::DisplayRole).toString();
-        QColor origText = option.palette.color(QPalette::Text);
-        QColor textColor = blend(QColor(0,0,0), origText, alpha);
+// Asks for a subtitle file and reads it whole; returns its path, or an empty
+// string on cancel or failure.
+QString askVersion(QWidget *parent, const QString &title, SubtitleStore &out) {
+    const QString path = QFileDialog::getOpenFileName(parent, title, QString(), SubtitleFormat::fileFilter(true));
+    if (path.isEmpty()) return QString();
+    if (!SubtitleFile::read(path, out)) {
+        QMessageBox::warning(parent, title, QObject::tr("Could not read %1").arg(QFileInfo(path).fileName()));
+        return QString();
+    }
+    return path;
+}
 
-        painter->setPen(textColor);
-        painter->drawText(option.rect, Qt::AlignCenter, text);
-        painter->restore();
+// Where row 'row' ends up once 'splices' (ascending) are applied; a removed
+// row goes to the first row of its splice.
+int rowAfterSplices(int row, const QVector<CueSplice> &splices) {
+    int shift = 0;
+    for (const CueSplice &s : splices) {
+        if (s.row > row) break;
+        if (row < s.row + s.removed) return s.row + shift;
+        shift += int(s.inserted.size()) - s.removed;
     }
-};
+    return row + shift;
+}
+
+} // namespace
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     setupActions();
     setupUi();
+    loadSpellDictionary();
+    // once the window is up: offer the edits a crashed session left behind
+    QTimer::singleShot(0, this, &MainWindow::checkRecovery);
 }
 
 void MainWindow::updateWindowTitle() {
@@ -109,19 +146,165 @@ void MainWindow::updateWindowTitle() {
 
 bool MainWindow::saveFile() {
     // si no hay path, pedimos Save As
-    if (currentFilePath_.isEmpty()) {
-        onSaveAs();
-        // onSaveAs seteara currentFilePath_ si el usuario guardo
-        if (currentFilePath_.isEmpty()) return false; // usuario canceló Save As
-    }
-    if (model_->saveSrt(currentFilePath_)) {
-        dirty_ = false;
-        statusBar()->showMessage(tr("Saved: %1").arg(currentFilePath_), 3000);
-        updateWindowTitle();
+    QString path = currentFilePath_;
+    if (path.isEmpty()) {
+        path = askSavePath();
+        if (path.isEmpty()) return false; // usuario canceló Save As
+    }
+    return startSave(path, documentFormat_);
+}
+
+QString MainWindow::askSavePath() {
+    return QFileDialog::getSaveFileName(this, tr("Save subtitle as"), QString(),
+                                        SubtitleFormat::fileFilter(false));
+}
+
+bool MainWindow::startSave(const QString &filePath, SubtitleFormat::Id format) {
+    commitPendingEdit();
+    // one save at a time; one asked for meanwhile writes the document as it
+    // is when the running one lands on disk
+    if (saver_->isRunning()) {
+        queuedSavePath_ = filePath;
+        queuedSaveFormat_ = format;
+        statusBar()->showMessage(tr("Saving after the current save: %1").arg(filePath));
         return true;
+    }
+    savingState_ = history_->state();
+    journalMark_ = journal_->position();
+    savingFormat_ = format;
+    const SrtWriteOptions options { fileFormat_.encoding, fileFormat_.byteOrderMark, fileFormat_.crlf, format };
+    const SubtitleStore snapshot = model_->snapshot();
+    if (!saver_->start(filePath, snapshot, options)) return false;
+    // our own write is not an outside change
+    monitor_->stop();
+    savingSnapshot_ = snapshot;
+    history_->seal();
+    setSaving(true);
+    statusBar()->showMessage(tr("Saving: %1").arg(filePath));
+    return true;
+}
+
+void MainWindow::onSaveFinished(bool ok, const QString &filePath) {
+    setSaving(false);
+    if (ok) {
+        currentFilePath_ = filePath;
+        documentFormat_ = savingFormat_;
+        savedState_ = savingState_;
+        // the file now holds everything up to the snapshot; the journal keeps
+        // only what was edited while saving
+        journal_->rebase(filePath, journalMark_);
+        // edits made while saving keep the document dirty
+        updateDirty();
+        diskVersion_ = savingSnapshot_;
+        statusBar()->showMessage(tr("Saved: %1").arg(filePath), 3000);
+    } else if (const QString lost = saver_->unencodable(); !lost.isEmpty()) {
+        // the file was left as it was rather than written with '?' in place
+        // of these
+        const QString encoding = QString::fromLatin1(fileFormat_.encoding);
+        const QString text = tr("%1 cannot represent these characters: %2").arg(encoding, lost);
+        const TextEncoding::Kind kind = TextEncoding::kindForName(fileFormat_.encoding);
+        if (kind == TextEncoding::Utf8 || kind == TextEncoding::Utf16LE || kind == TextEncoding::Utf16BE) {
+            // only broken text (a lone surrogate) gets here
+            QMessageBox::warning(this, tr("Save"), text + u'\n' + tr("The file was not saved."));
+            statusBar()->showMessage(tr("Failed to save file"), 3000);
+        } else if (QMessageBox::question(this, tr("Save"), text + u'\n' + tr("Save as UTF-8 instead?"))
+                   == QMessageBox::Yes) {
+            fileFormat_.encoding = "UTF-8";
+            fileFormat_.byteOrderMark = false;
+            startSave(filePath, savingFormat_);
+        } else {
+            statusBar()->showMessage(tr("Not saved: the encoding cannot represent every character"), 3000);
+        }
     } else {
         statusBar()->showMessage(tr("Failed to save file"), 3000);
-        return false;
+    }
+    // a save asked for while this one ran goes next
+    if (!queuedSavePath_.isEmpty()) startSave(std::exchange(queuedSavePath_, QString()), queuedSaveFormat_);
+    if (!saver_->isRunning()) {
+        savingSnapshot_ = SubtitleStore();
+        watchFile();
+    }
+    updateWindowTitle();
+    updateEncodingLabel();
+}
+
+bool MainWindow::finishSaves() {
+    bool ok = true;
+    // each finished save is reported in place, which starts the queued one
+    while (saver_->isRunning()) ok = saver_->waitForFinished() && ok;
+    return ok;
+}
+
+void MainWindow::watchFile() {
+    if (currentFilePath_.isEmpty()) monitor_->stop();
+    else monitor_->watch(currentFilePath_, fileFormat_, documentFormat_);
+}
+
+void MainWindow::onFileChanged(const FileChange &change) {
+    TRACE_SCOPE("MainWindow::onFileChanged");
+    if (change.partial && change.cues.isEmpty()) return; // rewritten as it was
+    commitPendingEdit();
+    const SubtitleStore base = diskVersion_;
+    diskVersion_ = change.partial
+        ? base.spliced({ CueSplice { change.cues.firstRow, change.cues.removedRows, change.cues.cues } })
+        : change.document;
+    fileFormat_ = change.format;
+    documentFormat_ = change.documentFormat;
+    updateEncodingLabel();
+    const QString name = QFileInfo(currentFilePath_).fileName();
+
+    if (!dirty_ && !reloadPrompt_) {
+        // nothing to lose: take the new version, touching only the rows that
+        // changed so the selection and scroll position stay
+        if (change.partial) {
+            model_->replaceCues(change.cues.firstRow, change.cues.removedRows, change.cues.cues);
+        } else {
+            const QVector<CueChange> changes = SubtitleDiff::compare(model_->cues(), diskVersion_);
+            const QVector<CueSplice> splices = SubtitleDiff::splices(changes, diskVersion_);
+            const QModelIndex current = tableView_->selectionModel()->currentIndex();
+            const int scroll = tableView_->verticalScrollBar()->value();
+            model_->spliceCues(splices);
+            // the diff ignores line numbers: the cues it lined up take theirs
+            // (and anything else that differs) in place
+            model_->replaceCues(0, model_->rowCount(), diskVersion_);
+            model_->setHeaderAndFooter(diskVersion_.header(), diskVersion_.footer());
+            // many splices reset the model, which loses the current row
+            if (current.isValid() && !tableView_->selectionModel()->currentIndex().isValid()) {
+                const int row = qMin(rowAfterSplices(current.row(), splices), model_->rowCount() - 1);
+                if (row >= 0) tableView_->setCurrentIndex(model_->index(row, current.column()));
+                tableView_->verticalScrollBar()->setValue(scroll);
+            }
+        }
+        // the steps in the history were taken on the old version
+        history_->clear();
+        savedState_ = history_->state();
+        journal_->open(currentFilePath_);
+        statusBar()->showMessage(tr("Reloaded: %1 changed on disk").arg(name), 3000);
+        return;
+    }
+    // undoing our edits no longer gets back to what is on disk
+    savedState_ = EditHistory::NoState;
+    // a prompt already open acts on the latest version
+    if (reloadPrompt_) return;
+
+    reloadPrompt_ = true;
+    QMessageBox msg(this);
+    msg.setIcon(QMessageBox::Question);
+    msg.setWindowTitle(tr("File changed on disk"));
+    msg.setText(tr("%1 was changed by another program while the document has unsaved edits.").arg(name));
+    msg.setInformativeText(tr("Merge its changes into the document, reload it and lose your edits, "
+                              "or keep your version?"));
+    QPushButton *merge = msg.addButton(tr("Merge"), QMessageBox::AcceptRole);
+    QPushButton *reload = msg.addButton(tr("Reload"), QMessageBox::DestructiveRole);
+    msg.addButton(tr("Keep Mine"), QMessageBox::RejectRole);
+    msg.setDefaultButton(merge);
+    msg.exec();
+    reloadPrompt_ = false;
+    if (msg.clickedButton() == merge) {
+        diffPanel_->mergeWith(base, diskVersion_, tr("%1 on disk").arg(name));
+        showDiff();
+    } else if (msg.clickedButton() == reload) {
+        openPath(currentFilePath_);
     }
 }
 
@@ -137,11 +320,100 @@ void MainWindow::setupActions() {
     saveAsAction_ = new QAction(tr("Save As."), this);
     connect(saveAsAction_, &QAction::triggered, this, &MainWindow::onSaveAs);
 
+    compareAction_ = new QAction(tr("Compare With."), this);
+    connect(compareAction_, &QAction::triggered, this, &MainWindow::onCompareWith);
+    mergeAction_ = new QAction(tr("Merge."), this);
+    connect(mergeAction_, &QAction::triggered, this, &MainWindow::onMerge);
+
     QMenu *fileMenu = menuBar()->addMenu(tr("File"));
     fileMenu->addAction(openAction_);
     fileMenu->addAction(saveAction_);
     fileMenu->addAction(saveAsAction_);
+    fileMenu->addSeparator();
+    fileMenu->addAction(compareAction_);
+    fileMenu->addAction(mergeAction_);
+    fileMenu->addSeparator();
     fileMenu->addAction(tr("Exit"), this, &QMainWindow::close);
+
+    undoAction_ = new QAction(tr("Undo"), this);
+    undoAction_->setShortcut(QKeySequence::Undo);
+    undoAction_->setEnabled(false);
+    connect(undoAction_, &QAction::triggered, this, &MainWindow::onUndo);
+
+    redoAction_ = new QAction(tr("Redo"), this);
+    redoAction_->setShortcut(QKeySequence::Redo);
+    redoAction_->setEnabled(false);
+    connect(redoAction_, &QAction::triggered, this, &MainWindow::onRedo);
+
+    insertCueAction_ = new QAction(tr("Insert Cue"), this);
+    insertCueAction_->setShortcut(Qt::CTRL | Qt::Key_I);
+    connect(insertCueAction_, &QAction::triggered, this, &MainWindow::onInsertCue);
+
+    deleteCuesAction_ = new QAction(tr("Delete Cues"), this);
+    deleteCuesAction_->setShortcut(Qt::CTRL | Qt::Key_Delete);
+    connect(deleteCuesAction_, &QAction::triggered, this, &MainWindow::onDeleteCues);
+
+    QMenu *editMenu = menuBar()->addMenu(tr("Edit"));
+    editMenu->addAction(undoAction_);
+    editMenu->addAction(redoAction_);
+    editMenu->addSeparator();
+    editMenu->addAction(insertCueAction_);
+    editMenu->addAction(deleteCuesAction_);
+    editMenu->addSeparator();
+    QAction *goToTime = editMenu->addAction(tr("Go to Time."), this, &MainWindow::onGoToTime);
+    goToTime->setShortcut(Qt::CTRL | Qt::Key_G);
+    editMenu->addSeparator();
+    QAction *find = editMenu->addAction(tr("Find and Replace."), this, &MainWindow::onFind);
+    find->setShortcut(QKeySequence::Find);
+    findNextAction_ = editMenu->addAction(tr("Find Next"), this, &MainWindow::onFindNext);
+    findNextAction_->setShortcut(QKeySequence::FindNext);
+    findPreviousAction_ = editMenu->addAction(tr("Find Previous"), this, &MainWindow::onFindPrevious);
+    findPreviousAction_->setShortcut(QKeySequence::FindPrevious);
+
+    // bulk timing: the selected rows; with none selected, the whole document
+    // after a confirmation
+    timingMenu_ = menuBar()->addMenu(tr("Timing"));
+    timingMenu_->addAction(tr("Shift Times."), this, &MainWindow::onShiftTimes);
+    timingMenu_->addAction(tr("Synchronize."), this, &MainWindow::onSyncTimes);
+    timingMenu_->addAction(tr("Change Framerate."), this, &MainWindow::onChangeFramerate);
+    timingMenu_->addAction(tr("Snap to Frames."), this, &MainWindow::onSnapToFrames);
+
+    viewMenu_ = menuBar()->addMenu(tr("View"));
+
+    QMenu *settingsMenu = menuBar()->addMenu(tr("Settings"));
+    settingsMenu->addAction(tr("CPS Thresholds."), this, &MainWindow::onCpsThresholds);
+    settingsMenu->addAction(tr("CPS Error Colour."), this, &MainWindow::onCpsErrorColour);
+    settingsMenu->addAction(tr("Quality Check Rules."), this, &MainWindow::onQcRules);
+    QAction *renderTags = settingsMenu->addAction(tr("Render Formatting Tags"));
+    renderTags->setCheckable(true);
+    renderTags->setChecked(AppSettings::instance()->renderTextTags());
+    connect(renderTags, &QAction::toggled, AppSettings::instance(), &AppSettings::setRenderTextTags);
+    settingsMenu->addSeparator();
+    QAction *countSpaces = settingsMenu->addAction(tr("Count Spaces in CPS"));
+    countSpaces->setCheckable(true);
+    countSpaces->setChecked(AppSettings::instance()->cpsOptions().countSpaces);
+    connect(countSpaces, &QAction::toggled, this, [](bool on) {
+        CpsOptions options = AppSettings::instance()->cpsOptions();
+        options.countSpaces = on;
+        AppSettings::instance()->setCpsOptions(options);
+    });
+    QAction *countBreaks = settingsMenu->addAction(tr("Count Line Breaks in CPS"));
+    countBreaks->setCheckable(true);
+    countBreaks->setChecked(AppSettings::instance()->cpsOptions().countLineBreaks);
+    connect(countBreaks, &QAction::toggled, this, [](bool on) {
+        CpsOptions options = AppSettings::instance()->cpsOptions();
+        options.countLineBreaks = on;
+        AppSettings::instance()->setCpsOptions(options);
+    });
+    settingsMenu->addSeparator();
+    QAction *spellCheck = settingsMenu->addAction(tr("Check Spelling"));
+    spellCheck->setCheckable(true);
+    spellCheck->setChecked(AppSettings::instance()->spellCheck());
+    connect(spellCheck, &QAction::toggled, AppSettings::instance(), &AppSettings::setSpellCheck);
+    connect(AppSettings::instance(), &AppSettings::spellingChanged, spellCheck, [spellCheck] {
+        spellCheck->setChecked(AppSettings::instance()->spellCheck());
+    });
+    settingsMenu->addAction(tr("Spelling Dictionary."), this, &MainWindow::onSpellDictionary);
 }
 
 void MainWindow::setupUi() {
@@ -159,32 +431,102 @@ void MainWindow::setupUi() {
     vlay->setContentsMargins(4,4,4,4);
     vlay->setSpacing(6);
 
-    // editor: fixed height 141 px, full width
+    // editor: fixed height 141 px, full width; live CPS shown next to it
+    QHBoxLayout *editorRow = new QHBoxLayout();
     editor_ = new QTextEdit(central);
     editor_->setFixedHeight(141); // requested fixed height
     editor_->setAcceptRichText(false); // plain text
-    vlay->addWidget(editor_);
+    editor_->setUndoRedoEnabled(false); // the window-level EditHistory owns undo
+    editorRow->addWidget(editor_);
+    cpsLabel_ = new QLabel(central);
+    cpsLabel_->setMinimumWidth(70);
+    cpsLabel_->setAlignment(Qt::AlignTop | Qt::AlignHCenter);
+    editorRow->addWidget(cpsLabel_);
+    vlay->addLayout(editorRow);
 
-    // connect editor changes to update model immediately
+    // editor changes are batched: see onEditorTextChanged/commitPendingEdit
+    editIdleTimer_ = new QTimer(this);
+    editIdleTimer_->setSingleShot(true);
+    editIdleTimer_->setInterval(EditIdleMs);
+    connect(editIdleTimer_, &QTimer::timeout, this, &MainWindow::commitPendingEdit);
+    editMaxDelayTimer_ = new QTimer(this);
+    editMaxDelayTimer_->setSingleShot(true);
+    editMaxDelayTimer_->setInterval(MaxEditDelayMs);
+    connect(editMaxDelayTimer_, &QTimer::timeout, this, &MainWindow::commitPendingEdit);
     connect(editor_, &QTextEdit::textChanged, this, &MainWindow::onEditorTextChanged);
+    spellHighlighter_ = new SpellHighlighter(editor_->document());
 
     // table
     model_ = new SubtitleModel(this);
-    tableView_ = new QTableView(central);
+    SubtitleTableView *table = new SubtitleTableView(central);
+    tableView_ = table;
     tableView_->setModel(model_);
     tableView_->setItemDelegateForColumn(SubtitleModel::CPS, new CPSDelegate(this));
+    // overlapping cues get their times highlighted, cues with QC issues their '#'
+    HighlightDelegate *overlapDelegate = new HighlightDelegate(SubtitleModel::OverlapRole, [] {
+        return AppSettings::instance()->overlapColour();
+    }, this);
+    tableView_->setItemDelegateForColumn(SubtitleModel::StartTime, overlapDelegate);
+    tableView_->setItemDelegateForColumn(SubtitleModel::EndTime, overlapDelegate);
+    tableView_->setItemDelegateForColumn(SubtitleModel::LineNumber,
+        new HighlightDelegate(SubtitleModel::QcFlagsRole, [] { return AppSettings::instance()->qcIssueColour(); }, this));
+    model_->setQcOptions(AppSettings::instance()->qcOptions());
+    connect(AppSettings::instance(), &AppSettings::qcOptionsChanged, this, [this] {
+        model_->setQcOptions(AppSettings::instance()->qcOptions());
+    });
+    model_->setCpsOptions(AppSettings::instance()->cpsOptions());
+    connect(AppSettings::instance(), &AppSettings::cpsOptionsChanged, this, [this] {
+        model_->setCpsOptions(AppSettings::instance()->cpsOptions());
+    });
+    // cue text is painted from a per-row cache of laid out text
+    textDelegate_ = new TextDelegate(model_, SubtitleModel::Text, this);
+    textDelegate_->setHighlight(SubtitleModel::MatchRole, [] { return AppSettings::instance()->searchMatchColour(); });
+    textDelegate_->setUnderline(SubtitleModel::SpellingRole, [] { return AppSettings::instance()->misspellingColour(); });
+    textDelegate_->setCacheLimit(qsizetype(QSettings().value("Table/TextCacheMB", 8).toInt()) * 1024 * 1024);
+    tableView_->setItemDelegateForColumn(SubtitleModel::Text, textDelegate_);
+    connect(AppSettings::instance(), &AppSettings::cpsColoursChanged,
+            tableView_->viewport(), qOverload<>(&QWidget::update));
+    connect(AppSettings::instance(), &AppSettings::textRenderingChanged,
+            tableView_->viewport(), qOverload<>(&QWidget::update));
+    connect(model_, &SubtitleModel::dataChanged, this, &MainWindow::onModelDataChanged);
+    // misspelled words are looked up once per edit, in a dictionary loaded
+    // off the GUI thread
+    connect(AppSettings::instance(), &AppSettings::spellingChanged, this, &MainWindow::loadSpellDictionary);
+
+    // undo history keeps deltas only, bounded by History/MemoryLimitMB
+    history_ = new EditHistory(model_, this);
+    history_->setMemoryLimit(qsizetype(QSettings().value("History/MemoryLimitMB", 64).toInt()) * 1024 * 1024);
+    connect(history_, &EditHistory::changed, this, &MainWindow::updateUndoActions);
+    savedState_ = history_->state(); // an empty document has nothing to save
+
+    // every applied edit is also appended to "<file>.journal" for crash recovery
+    journal_ = new EditJournal(this);
+    journal_->setSyncInterval(QSettings().value("Journal/SyncIntervalMs", 1000).toInt());
+    history_->setJournal(journal_);
 
     // hide the default vertical row header (we use our own '#' column)
     tableView_->verticalHeader()->setVisible(false);
 
-    // column resize policy: make 'Text' stretch, others resize to contents
+    // column resize policy: make 'Text' stretch, the others get a fixed width
+    // worked out from their widest possible value (see updateColumnWidths);
+    // ResizeToContents would measure every row on each layout pass
     for (int c = 0; c < model_->columnCount(); ++c) {
         if (c == SubtitleModel::Text) {
             tableView_->horizontalHeader()->setSectionResizeMode(c, QHeaderView::Stretch);
         } else {
-            tableView_->horizontalHeader()->setSectionResizeMode(c, QHeaderView::ResizeToContents);
+            tableView_->horizontalHeader()->setSectionResizeMode(c, QHeaderView::Fixed);
         }
     }
+    // one line per row, same height for all: multi-line cues are summarized
+    // by the model and elided by the view
+    tableView_->setWordWrap(false);
+    tableView_->setTextElideMode(Qt::ElideRight);
+    tableView_->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    updateColumnWidths();
+    connect(model_, &QAbstractItemModel::rowsInserted, this, &MainWindow::updateColumnWidths);
+    connect(model_, &QAbstractItemModel::modelReset, this, &MainWindow::updateColumnWidths);
+    // and again for a new font or style (see eventFilter)
+    tableView_->installEventFilter(this);
 
     tableView_->setSelectionBehavior(QAbstractItemView::SelectRows);
     tableView_->setAlternatingRowColors(true);
@@ -198,46 +540,414 @@ void MainWindow::setupUi() {
     vlay->addWidget(tableView_);
     setCentralWidget(central);
 
+    // QC summary; checks run on load and after every edit (see QcEngine)
+    QDockWidget *qcDock = new QDockWidget(tr("Quality Check"), this);
+    qcDock->setObjectName("QcDock");
+    QcPanel *qcPanel = new QcPanel(model_, qcDock);
+    qcDock->setWidget(qcPanel);
+    addDockWidget(Qt::RightDockWidgetArea, qcDock);
+    connect(qcPanel, &QcPanel::issueActivated, this, &MainWindow::onQcIssueActivated);
+    viewMenu_->addAction(qcDock->toggleViewAction());
+
+    // find as you type over an incrementally kept trigram index (SearchIndex)
+    findDock_ = new QDockWidget(tr("Find and Replace"), this);
+    findDock_->setObjectName("FindDock");
+    findPanel_ = new FindPanel(model_, findDock_);
+    findDock_->setWidget(findPanel_);
+    addDockWidget(Qt::RightDockWidgetArea, findDock_);
+    findDock_->hide();
+    connect(findPanel_, &FindPanel::rowActivated, this, [this](int row) {
+        if (row < 0) return;
+        tableView_->selectRow(row);
+        tableView_->scrollTo(model_->index(row, SubtitleModel::Text), QAbstractItemView::PositionAtCenter);
+    });
+    connect(findPanel_, &FindPanel::replaceAllRequested, this, &MainWindow::onReplaceAll);
+    connect(model_, &SubtitleModel::searchChanged, this, &MainWindow::updateEditorMatches);
+    viewMenu_->addAction(findDock_->toggleViewAction());
+
+    // cue-level compare and three-way merge with another version (SubtitleDiff)
+    diffDock_ = new QDockWidget(tr("Compare"), this);
+    diffDock_->setObjectName("DiffDock");
+    diffPanel_ = new DiffPanel(model_, diffDock_);
+    diffDock_->setWidget(diffPanel_);
+    addDockWidget(Qt::RightDockWidgetArea, diffDock_);
+    diffDock_->hide();
+    connect(diffPanel_, &DiffPanel::flagsActivated, this, &MainWindow::onDiffFlagsActivated);
+    connect(diffPanel_, &DiffPanel::acceptSelectedRequested, this, [this] { onAcceptDiff(true); });
+    connect(diffPanel_, &DiffPanel::acceptAllRequested, this, [this] { onAcceptDiff(false); });
+    connect(diffPanel_, &DiffPanel::rejectSelectedRequested, this, &MainWindow::onRejectDiffSelected);
+    connect(diffPanel_, &DiffPanel::closeRequested, this, [this] {
+        diffPanel_->stop();
+        diffDock_->hide();
+    });
+    viewMenu_->addAction(diffDock_->toggleViewAction());
+
     // selection -> when user selects a row, show text in editor
     connect(tableView_->selectionModel(), &QItemSelectionModel::currentRowChanged,
             this, &MainWindow::onSelectionChanged);
 
+    // loading runs in the background; progress + cancel live in the status bar
+    loader_ = new SubtitleLoader(model_, this);
+    loader_->setCacheEnabled(QSettings().value("Cache/Enabled", true).toBool());
+    connect(loader_, &SubtitleLoader::finished, this, &MainWindow::onLoadFinished);
+    saver_ = new SubtitleSaver(this);
+    connect(saver_, &SubtitleSaver::finished, this, &MainWindow::onSaveFinished);
+    monitor_ = new FileMonitor(this);
+    connect(monitor_, &FileMonitor::changed, this, &MainWindow::onFileChanged);
+
     QStatusBar *s = statusBar();
+    loadProgress_ = new QProgressBar(s);
+    loadProgress_->setRange(0, 100);
+    loadProgress_->setMaximumWidth(200);
+    loadProgress_->setVisible(false);
+    connect(loader_, &SubtitleLoader::progressChanged, loadProgress_, &QProgressBar::setValue);
+    cancelLoadButton_ = new QToolButton(s);
+    cancelLoadButton_->setText(tr("Cancel"));
+    cancelLoadButton_->setVisible(false);
+    connect(cancelLoadButton_, &QToolButton::clicked, loader_, &SubtitleLoader::cancel);
+    encodingLabel_ = new QLabel(s);
+    s->addPermanentWidget(loadProgress_);
+    s->addPermanentWidget(cancelLoadButton_);
+    s->addPermanentWidget(encodingLabel_);
+    updateEncodingLabel();
+
+    // performance HUD: last load and the table's repaint times, refreshed
+    // once a second while shown
+    hudLabel_ = new QLabel(s);
+    hudLabel_->setToolTip(tr("Run with --trace FILE to record every step as a Chrome/Perfetto trace"));
+    s->insertPermanentWidget(0, hudLabel_);
+    hudTimer_ = new QTimer(this);
+    hudTimer_->setInterval(HudIntervalMs);
+    connect(hudTimer_, &QTimer::timeout, this, &MainWindow::updateHud);
+    connect(table, &SubtitleTableView::framePainted, this, [this](qint64 ns) {
+        ++frames_;
+        frameNs_ += ns;
+        maxFrameNs_ = qMax(maxFrameNs_, ns);
+    });
+    QAction *hud = viewMenu_->addAction(tr("Performance HUD"));
+    hud->setCheckable(true);
+    connect(hud, &QAction::toggled, this, [this](bool on) {
+        QSettings().setValue("View/PerformanceHud", on);
+        hudLabel_->setVisible(on);
+        if (on) {
+            updateHud();
+            hudTimer_->start();
+        } else {
+            hudTimer_->stop();
+        }
+    });
+    hud->setChecked(QSettings().value("View/PerformanceHud", false).toBool());
+    hudLabel_->setVisible(hud->isChecked());
     s->showMessage(tr("Ready"));
 }
 
+void MainWindow::updateHud() {
+    QStringList parts;
+    if (lastLoadMs_ >= 0) {
+        parts << tr("Load %1 ms").arg(lastLoadMs_);
+        if (lastLoadMs_ > 0) parts << tr("%L1 cues/s").arg(qint64(lastLoadCues_ * 1000.0 / lastLoadMs_));
+    }
+    if (frames_ > 0) {
+        parts << tr("Paint %1 ms avg, %2 ms max")
+                     .arg(frameNs_ / frames_ / 1e6, 0, 'f', 1)
+                     .arg(maxFrameNs_ / 1e6, 0, 'f', 1);
+    } else {
+        parts << tr("Paint idle");
+    }
+    hudLabel_->setText(parts.join(QStringLiteral(" · ")));
+    frames_ = 0;
+    frameNs_ = 0;
+    maxFrameNs_ = 0;
+}
+
+void MainWindow::updateEncodingLabel() {
+    QString text = SubtitleFormat::get(documentFormat_).name() + QStringLiteral(" · ")
+                   + QString::fromLatin1(fileFormat_.encoding);
+    if (fileFormat_.byteOrderMark) text += tr(" with BOM");
+    encodingLabel_->setText(text + (fileFormat_.crlf ? QStringLiteral(" · CRLF") : QStringLiteral(" · LF")));
+}
+
+void MainWindow::setLoading(bool loading) {
+    loadProgress_->setValue(0);
+    loadProgress_->setVisible(loading);
+    cancelLoadButton_->setVisible(loading);
+    // a partially loaded document must never be written over the original
+    saveAction_->setEnabled(!loading);
+    saveAsAction_->setEnabled(!loading);
+    timingMenu_->setEnabled(!loading);
+    insertCueAction_->setEnabled(!loading);
+    deleteCuesAction_->setEnabled(!loading);
+    compareAction_->setEnabled(!loading);
+    mergeAction_->setEnabled(!loading);
+    if (loading) {
+        undoAction_->setEnabled(false);
+        redoAction_->setEnabled(false);
+    } else {
+        updateUndoActions();
+    }
+    editor_->setReadOnly(loading);
+}
+
+void MainWindow::setSaving(bool saving) {
+    // editing stays enabled: the saver works on a snapshot
+    saveAction_->setEnabled(!saving);
+    saveAsAction_->setEnabled(!saving);
+}
+
+void MainWindow::updateDirty() {
+    // clean when the history is back at the state last written to disk; a
+    // keystroke not yet committed is an edit either way
+    const bool dirty = editRow_ >= 0 || history_->state() != savedState_;
+    if (dirty != dirty_) {
+        dirty_ = dirty;
+        updateWindowTitle();
+    }
+}
+
+bool MainWindow::timingRuns(const QString &title, QVector<QPair<int, int>> &runs) {
+    runs.clear();
+    const int count = model_->rowCount();
+    if (count == 0) return false;
+    QVector<int> rows;
+    for (const QModelIndex &i : tableView_->selectionModel()->selectedRows()) rows.append(i.row());
+    if (rows.isEmpty()) {
+        // no selection: the whole document, but only when asked for
+        const auto answer = QMessageBox::question(this, title,
+            tr("No cues are selected. Apply to all %1 cues?").arg(count),
+            QMessageBox::Yes | QMessageBox::No, QMessageBox::No);
+        if (answer != QMessageBox::Yes) return false;
+        runs.append({ 0, count - 1 });
+        return true;
+    }
+    // contiguous runs of the selected rows; the rows between them stay put
+    std::sort(rows.begin(), rows.end());
+    for (int row : std::as_const(rows)) {
+        if (!runs.isEmpty() && runs.last().second + 1 >= row) runs.last().second = row;
+        else runs.append({ row, row });
+    }
+    return true;
+}
+
+int MainWindow::rowCount(const QVector<QPair<int, int>> &runs) {
+    int rows = 0;
+    for (const QPair<int, int> &run : runs) rows += run.second - run.first + 1;
+    return rows;
+}
+
+void MainWindow::onShiftTimes() {
+    QVector<QPair<int, int>> runs;
+    if (!timingRuns(tr("Shift Times"), runs)) return;
+    bool ok = false;
+    const QString text = QInputDialog::getText(this, tr("Shift Times"),
+                                               tr("Offset (e.g. 00:00:01,500 or -1500 ms):"),
+                                               QLineEdit::Normal, QString(), &ok);
+    if (!ok) return;
+    const int delta = TimingEngine::parseTime(text, &ok);
+    if (!ok) {
+        statusBar()->showMessage(tr("Invalid time: %1").arg(text), 3000);
+        return;
+    }
+    history_->push(std::make_unique<RetimeCommand>(runs, tr("Shift Times"),
+        [delta](SubtitleModel *m, int f, int l) { m->shiftTimes(f, l, delta); }));
+    updateDirty();
+    statusBar()->showMessage(tr("Shifted %1 cues").arg(rowCount(runs)), 3000);
+}
+
+void MainWindow::onSyncTimes() {
+    QVector<QPair<int, int>> runs;
+    if (!timingRuns(tr("Synchronize"), runs)) return;
+    // one linear map through the first and last selected cues, applied per run
+    const int first = runs.constFirst().first;
+    const int last = runs.constLast().second;
+    const QString a = model_->data(model_->index(first, SubtitleModel::StartTime)).toString();
+    const QString b = model_->data(model_->index(last, SubtitleModel::StartTime)).toString();
+    QVector<int> t;
+    if (!askTimes(this, tr("Synchronize"),
+                  { tr("First cue now at:"), tr("First cue should be at:"),
+                    tr("Last cue now at:"), tr("Last cue should be at:") },
+                  { a, a, b, b }, t)) {
+        return;
+    }
+    if (t[0] == t[2]) {
+        statusBar()->showMessage(tr("The two sync points must differ"), 3000);
+        return;
+    }
+    history_->push(std::make_unique<RetimeCommand>(runs, tr("Synchronize"),
+        [t](SubtitleModel *m, int f, int l) { m->syncTimes(f, l, t[0], t[1], t[2], t[3]); }));
+    updateDirty();
+    statusBar()->showMessage(tr("Synchronized %1 cues").arg(rowCount(runs)), 3000);
+}
+
+void MainWindow::onChangeFramerate() {
+    QVector<QPair<int, int>> runs;
+    if (!timingRuns(tr("Change Framerate"), runs)) return;
+    const QVector<Framerate> rates = Framerate::common();
+    QStringList names;
+    for (const Framerate &r : rates) names << r.name();
+    bool ok = false;
+    const QString from = QInputDialog::getItem(this, tr("Change Framerate"), tr("From:"), names, 0, false, &ok);
+    if (!ok) return;
+    const QString to = QInputDialog::getItem(this, tr("Change Framerate"), tr("To:"), names, 2, false, &ok);
+    if (!ok || from == to) return;
+    const Framerate fromRate = rates.at(names.indexOf(from));
+    const Framerate toRate = rates.at(names.indexOf(to));
+    history_->push(std::make_unique<RetimeCommand>(runs, tr("Change Framerate"),
+        [fromRate, toRate](SubtitleModel *m, int f, int l) { m->convertFramerate(f, l, fromRate, toRate); }));
+    updateDirty();
+    statusBar()->showMessage(tr("Converted %1 cues from %2 to %3 fps").arg(rowCount(runs)).arg(from, to), 3000);
+}
+
+void MainWindow::onSnapToFrames() {
+    QVector<QPair<int, int>> runs;
+    if (!timingRuns(tr("Snap to Frames"), runs)) return;
+    const QVector<Framerate> rates = Framerate::common();
+    QStringList names;
+    for (const Framerate &r : rates) names << r.name();
+    bool ok = false;
+    const QString fps = QInputDialog::getItem(this, tr("Snap to Frames"), tr("Framerate:"), names, 2, false, &ok);
+    if (!ok) return;
+    const Framerate rate = rates.at(names.indexOf(fps));
+    history_->push(std::make_unique<RetimeCommand>(runs, tr("Snap to Frames"),
+        [rate](SubtitleModel *m, int f, int l) { m->snapToFrames(f, l, rate); }));
+    updateDirty();
+    statusBar()->showMessage(tr("Snapped %1 cues to %2 fps").arg(rowCount(runs)).arg(fps), 3000);
+}
+
 void MainWindow::onOpenFile() {
     const QString path = QFileDialog::getOpenFileName(this, tr("Open subtitle"), QString(),
-                                                      tr("SubRip files (*.srt *.str);;All files (*.*)"));
+                                                      SubtitleFormat::fileFilter(true));
     if (path.isEmpty()) return;
-    bool ok = model_->loadSrt(path);
-    if (!ok) {
+    openPath(path);
+}
+
+void MainWindow::openPath(const QString &path) {
+    TRACE_SCOPE("MainWindow::openPath");
+    if (saver_->isRunning()) {
+        statusBar()->showMessage(tr("Wait for the current save to finish"), 3000);
+        return;
+    }
+    commitPendingEdit();
+    // rows are appended while the file is parsed; see onLoadFinished
+    if (!loader_->start(path)) {
         statusBar()->showMessage(tr("Failed to load file"));
+        recovering_ = false;
+        return;
+    }
+    // a comparison with the previous document is gone with it; its journal
+    // goes once the new one has loaded (onLoadFinished)
+    diffPanel_->stop();
+    monitor_->stop();
+    diskVersion_ = SubtitleStore();
+    loadClock_.start();
+    currentFilePath_ = path;
+    dirty_ = false;
+    history_->clear();
+    savedState_ = history_->state();
+    setLoading(true);
+    statusBar()->showMessage(tr("Loading: %1").arg(path));
+    // clear editor
+    editor_->clear();
+    updateWindowTitle();
+}
+
+void MainWindow::onLoadFinished(bool ok) {
+    TRACE_SCOPE("MainWindow::onLoadFinished");
+    if (ok) {
+        lastLoadMs_ = loadClock_.elapsed();
+        lastLoadCues_ = model_->rowCount();
+        if (hudLabel_->isVisible()) updateHud();
+    }
+    setLoading(false);
+    fileFormat_ = ok ? loader_->format() : TextFormat();
+    documentFormat_ = ok ? loader_->documentFormat() : SubtitleFormat::Srt;
+    updateEncodingLabel();
+    if (ok && recovering_) {
+        QElapsedTimer clock;
+        clock.start();
+        qint64 validEnd = 0;
+        diskVersion_ = model_->snapshot();
+        const int edits = EditJournal::replay(currentFilePath_, model_, &validEnd);
+        journal_->resume(currentFilePath_, validEnd);
+        if (edits > 0) {
+            // the recovered edits are not in the history: no state of it is on disk
+            savedState_ = EditHistory::NoState;
+            updateDirty();
+        }
+        statusBar()->showMessage(tr("Recovered %n edit(s) in %1 ms", nullptr, edits).arg(clock.elapsed()));
+    } else if (ok) {
+        diskVersion_ = model_->snapshot();
+        journal_->open(currentFilePath_);
+        statusBar()->showMessage(loader_->loadedFromCache() ? tr("Loaded from cache: %1").arg(currentFilePath_)
+                                                            : tr("Loaded: %1").arg(currentFilePath_));
     } else {
-        currentFilePath_ = path;
-        dirty_ = false;
-        statusBar()->showMessage(tr("Loaded: %1").arg(path));
-        tableView_->resizeColumnsToContents();
-        // clear editor
-        editor_->clear();
-        updateWindowTitle();
+        // cancelled: drop the partial document instead of leaving half a file;
+        // the previous document's edits stay in its journal, for recovery
+        journal_->close();
+        model_->clear();
+        currentFilePath_.clear();
+        statusBar()->showMessage(tr("Loading cancelled"), 3000);
+    }
+    recovering_ = false;
+    if (ok) {
+        watchFile();
+        // the rows were appended unchecked while loading
+        model_->checkSpelling();
+    }
+    updateWindowTitle();
+}
+
+void MainWindow::checkRecovery() {
+    // one document can be recovered per start; the journals of any others
+    // are kept and offered next time
+    for (const QString &path : EditJournal::pendingDocuments()) {
+        const QString name = QDir::toNativeSeparators(path);
+        switch (EditJournal::recoveryState(path)) {
+        case EditJournal::Recovery::None:
+            EditJournal::remove(path);
+            continue;
+        case EditJournal::Recovery::BaseChanged:
+            QMessageBox::warning(this, tr("Recover edits"),
+                                 tr("%1 changed on disk after SubStudio last closed unexpectedly; "
+                                    "its unsaved edits cannot be recovered.").arg(name));
+            EditJournal::remove(path);
+            continue;
+        case EditJournal::Recovery::Available:
+            break;
+        }
+        const auto answer = QMessageBox::question(this, tr("Recover edits"),
+            tr("SubStudio did not close properly. Recover the unsaved edits to %1?").arg(name),
+            QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes);
+        if (answer != QMessageBox::Yes) {
+            EditJournal::remove(path);
+            continue;
+        }
+        recovering_ = true;
+        openPath(path);
+        return;
     }
 }
 
 void MainWindow::onSelectionChanged(const QModelIndex &current, const QModelIndex & /*previous*/) {
+    // the editor still holds the previous row's text: commit it first
+    commitPendingEdit();
+    history_->seal();
     if (!current.isValid()) {
         editor_->blockSignals(true);
         editor_->clear();
         editor_->blockSignals(false);
+        updateLiveCps();
         return;
     }
     const int row = current.row();
-    const QVariant v = model_->data(model_->index(row, SubtitleModel::Text), Qt::DisplayRole);
+    // the table shows multi-line cues summarized; the editor gets the real text
+    const QString text = model_->textAt(row);
 
     // Block signals so setPlainText does NOT call onEditorTextChanged
     editor_->blockSignals(true);
-    editor_->setPlainText(v.toString());
+    editor_->setPlainText(text);
     editor_->blockSignals(false);
+    updateLiveCps();
+    updateEditorMatches();
 }
 
 void MainWindow::onSave() {
@@ -245,38 +955,463 @@ void MainWindow::onSave() {
 }
 
 void MainWindow::onSaveAs() {
-    const QString path = QFileDialog::getSaveFileName(this, tr("Save subtitle as"), QString(),
-                                                      tr("SubRip files (*.srt);;All files (*.*)"));
+    const QString path = askSavePath();
     if (path.isEmpty()) return;
-    if (model_->saveSrt(path)) {
-        currentFilePath_ = path;
-        dirty_ = false;
-        statusBar()->showMessage(tr("Saved: %1").arg(path));
-        updateWindowTitle();
-    } else {
-        statusBar()->showMessage(tr("Failed to save file"));
-    }
+    // the suffix picks the format; an unknown one keeps the document's
+    startSave(path, SubtitleFormat::forPath(path, documentFormat_));
 }
 
 void MainWindow::onEditorTextChanged() {
+    TRACE_SCOPE("MainWindow::onEditorTextChanged");
+    // Runs on every keystroke, so it must stay cheap: no model or view work,
+    // only the live CPS of the cue's own text. The text is committed later
+    // by commitPendingEdit.
+    QElapsedTimer clock;
+    clock.start();
+
     // get currently selected row
     const QModelIndex current = tableView_->selectionModel()->currentIndex();
     if (!current.isValid()) return;
 
-    const int row = current.row();
-    const QString newText = editor_->toPlainText();
-
-    // update model immediately (this updates Text and CPS columns and emits dataChanged)
-    model_->setTextAt(row, newText);
+    if (editRow_ < 0) {
+        editRow_ = current.row();
+        editMaxDelayTimer_->start();
+    }
+    editIdleTimer_->start();
+    updateLiveCps();
 
     // marcar como cambios sin guardar y actualizar title
-    if (!dirty_) {
-        dirty_ = true;
-        updateWindowTitle();
-    }
+    updateDirty();
+
+    maxKeystrokeNs_ = qMax(maxKeystrokeNs_, clock.nsecsElapsed());
+}
+
+void MainWindow::commitPendingEdit() {
+    TRACE_SCOPE("MainWindow::commitPendingEdit");
+    editIdleTimer_->stop();
+    editMaxDelayTimer_->stop();
+    if (editRow_ < 0) return;
+
+    QElapsedTimer clock;
+    clock.start();
+    const int row = editRow_;
+    editRow_ = -1;
+    // only the changed span goes to the history; it updates Text and CPS
+    // with a single dataChanged
+    auto splice = TextSpliceCommand::fromTexts(row, model_->textAt(row), editor_->toPlainText());
+    if (splice) history_->push(std::move(splice));
+    maxCommitNs_ = qMax(maxCommitNs_, clock.nsecsElapsed());
 
-    // optionally show a small status message
     statusBar()->showMessage(tr("Edited row %1").arg(row + 1), 1500);
+    cpsLabel_->setToolTip(tr("Worst-case latency: %1 us per keystroke, %2 us per commit")
+                              .arg(maxKeystrokeNs_ / 1000).arg(maxCommitNs_ / 1000));
+}
+
+void MainWindow::onGoToTime() {
+    commitPendingEdit();
+    const int current = tableView_->selectionModel()->currentIndex().row();
+    const QString initial = current >= 0
+        ? model_->data(model_->index(current, SubtitleModel::StartTime)).toString()
+        : SubtitleStore::formatTime(0);
+    bool ok = false;
+    const QString text = QInputDialog::getText(this, tr("Go to Time"), tr("Time (HH:MM:SS,mmm):"),
+                                               QLineEdit::Normal, initial, &ok);
+    if (!ok) return;
+    const int ms = TimingEngine::parseTime(text, &ok);
+    if (!ok) {
+        statusBar()->showMessage(tr("Invalid time: %1").arg(text), 3000);
+        return;
+    }
+    // the cue on screen at that time, else the next one to start
+    const QVector<int> active = model_->intervals().activeAt(ms);
+    const int row = active.isEmpty() ? model_->intervals().firstStartingFrom(ms) : active.constFirst();
+    if (row < 0) {
+        statusBar()->showMessage(tr("No cue at or after %1").arg(SubtitleStore::formatTime(ms)), 3000);
+        return;
+    }
+    tableView_->selectRow(row);
+    tableView_->scrollTo(model_->index(row, SubtitleModel::Text), QAbstractItemView::PositionAtCenter);
+}
+
+void MainWindow::onCpsThresholds() {
+    AppSettings *settings = AppSettings::instance();
+    QDialog dlg(this);
+    dlg.setWindowTitle(tr("CPS Thresholds"));
+    QFormLayout *form = new QFormLayout(&dlg);
+    QSpinBox *warning = new QSpinBox(&dlg);
+    warning->setRange(1, 999);
+    warning->setValue(settings->cpsWarning());
+    form->addRow(tr("Warning above:"), warning);
+    QSpinBox *error = new QSpinBox(&dlg);
+    error->setRange(1, 999);
+    error->setValue(settings->cpsError());
+    form->addRow(tr("Error at:"), error);
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dlg);
+    connect(buttons, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+    form->addRow(buttons);
+    if (dlg.exec() != QDialog::Accepted) return;
+    // the CPS column repaints from AppSettings::cpsColoursChanged
+    settings->setCpsThresholds(warning->value(), error->value());
+}
+
+void MainWindow::onQcIssueActivated(int issue) {
+    const int current = tableView_->selectionModel()->currentIndex().row();
+    const int row = model_->qc().nextRow(QcEngine::Issue(issue), current);
+    if (row < 0) return;
+    tableView_->selectRow(row);
+    tableView_->scrollTo(model_->index(row, SubtitleModel::Text), QAbstractItemView::PositionAtCenter);
+}
+
+void MainWindow::onFind() {
+    findDock_->show();
+    findDock_->raise();
+    findPanel_->focusSearch();
+}
+
+void MainWindow::onFindNext() {
+    const QVector<int> &rows = model_->searchMatches();
+    if (rows.isEmpty()) return;
+    const int current = tableView_->selectionModel()->currentIndex().row();
+    auto it = std::upper_bound(rows.cbegin(), rows.cend(), current);
+    const int row = it == rows.cend() ? rows.constFirst() : *it; // wraps around
+    tableView_->selectRow(row);
+    tableView_->scrollTo(model_->index(row, SubtitleModel::Text), QAbstractItemView::PositionAtCenter);
+}
+
+void MainWindow::onFindPrevious() {
+    const QVector<int> &rows = model_->searchMatches();
+    if (rows.isEmpty()) return;
+    const int current = tableView_->selectionModel()->currentIndex().row();
+    auto it = std::lower_bound(rows.cbegin(), rows.cend(), current);
+    const int row = it == rows.cbegin() ? rows.constLast() : *(it - 1); // wraps around
+    tableView_->selectRow(row);
+    tableView_->scrollTo(model_->index(row, SubtitleModel::Text), QAbstractItemView::PositionAtCenter);
+}
+
+void MainWindow::onReplaceAll(const QString &needle, const QString &replacement, Qt::CaseSensitivity cs) {
+    if (loader_->isRunning()) return;
+    commitPendingEdit();
+    history_->seal();
+    // candidates come from the index; the replacements run in parallel and
+    // land as one model update and one undo step
+    if (model_->searchText() != needle || model_->searchCaseSensitivity() != cs) model_->setSearch(needle, cs);
+    auto command = ReplaceTextsCommand::replaceAll(model_, model_->searchMatches(), needle, replacement, cs);
+    if (!command) {
+        statusBar()->showMessage(tr("Nothing to replace"), 3000);
+        return;
+    }
+    const QString text = command->text();
+    history_->push(std::move(command));
+    history_->seal();
+    updateDirty();
+    statusBar()->showMessage(text, 3000);
+}
+
+void MainWindow::onCompareWith() {
+    if (loader_->isRunning()) return;
+    SubtitleStore other;
+    const QString path = askVersion(this, tr("Compare with"), other);
+    if (path.isEmpty()) return;
+    diffPanel_->compareWith(other, QFileInfo(path).fileName());
+    showDiff();
+}
+
+void MainWindow::onMerge() {
+    if (loader_->isRunning()) return;
+    // the version both sides started from, then the one to take changes from
+    SubtitleStore base;
+    if (askVersion(this, tr("Merge: common base version"), base).isEmpty()) return;
+    SubtitleStore theirs;
+    const QString path = askVersion(this, tr("Merge: version to merge"), theirs);
+    if (path.isEmpty()) return;
+    diffPanel_->mergeWith(base, theirs, QFileInfo(path).fileName());
+    showDiff();
+}
+
+void MainWindow::showDiff() {
+    diffDock_->show();
+    diffDock_->raise();
+}
+
+void MainWindow::onDiffFlagsActivated(int flags) {
+    const int current = tableView_->selectionModel()->currentIndex().row();
+    const int row = diffPanel_->nextRow(flags, current);
+    if (row < 0) return;
+    tableView_->selectRow(row);
+    tableView_->scrollTo(model_->index(row, SubtitleModel::Text), QAbstractItemView::PositionAtCenter);
+}
+
+QVector<int> MainWindow::selectedRows() const {
+    QVector<int> rows;
+    for (const QModelIndex &i : tableView_->selectionModel()->selectedRows()) rows.append(i.row());
+    const int current = tableView_->selectionModel()->currentIndex().row();
+    if (rows.isEmpty() && current >= 0) rows.append(current);
+    return rows;
+}
+
+void MainWindow::onAcceptDiff(bool selectedOnly) {
+    if (loader_->isRunning()) return;
+    if (!diffPanel_->isCurrent()) {
+        statusBar()->showMessage(tr("Wait for the comparison to finish"), 3000);
+        return;
+    }
+    // conflicts are taken only when picked by hand
+    const QVector<CueChange> changes = selectedOnly ? diffPanel_->changesAt(selectedRows())
+                                                    : diffPanel_->changes(false);
+    if (changes.isEmpty()) {
+        statusBar()->showMessage(tr("No changes to accept"), 3000);
+        return;
+    }
+    // a pending text edit does not move rows, so the changes stay valid
+    commitPendingEdit();
+    history_->seal();
+    const QString text = tr("Accept %n change(s)", nullptr, int(changes.size()));
+    // the other version's numbers may be taken here
+    QVector<CueSplice> splices = diffPanel_->splices(changes);
+    model_->numberInsertedCues(splices);
+    history_->push(std::make_unique<SpliceCuesCommand>(std::move(splices), text));
+    history_->seal();
+    updateDirty();
+    statusBar()->showMessage(text, 3000);
+}
+
+void MainWindow::onRejectDiffSelected() {
+    diffPanel_->reject(diffPanel_->changesAt(selectedRows()));
+}
+
+void MainWindow::updateEditorMatches() {
+    // the current cue's occurrences, as extra selections that follow edits
+    QList<QTextEdit::ExtraSelection> selections;
+    const QString needle = model_->searchText();
+    if (!needle.isEmpty()) {
+        const QTextDocument::FindFlags flags = model_->searchCaseSensitivity() == Qt::CaseSensitive
+                                             ? QTextDocument::FindCaseSensitively : QTextDocument::FindFlags();
+        QTextEdit::ExtraSelection match;
+        match.format.setBackground(AppSettings::instance()->searchMatchColour());
+        for (QTextCursor c = editor_->document()->find(needle, 0, flags); !c.isNull();
+             c = editor_->document()->find(needle, c, flags)) {
+            match.cursor = c;
+            selections.append(match);
+        }
+    }
+    editor_->setExtraSelections(selections);
+}
+
+void MainWindow::onQcRules() {
+    QcOptions options = AppSettings::instance()->qcOptions();
+    QDialog dlg(this);
+    dlg.setWindowTitle(tr("Quality Check Rules"));
+    QFormLayout *form = new QFormLayout(&dlg);
+    struct Field { QString label; int *value; int max; };
+    const Field fields[] = {
+        { tr("Minimum duration (ms):"), &options.minDurationMs, 60000 },
+        { tr("Maximum duration (ms):"), &options.maxDurationMs, 600000 },
+        { tr("Minimum gap (ms):"), &options.minGapMs, 60000 },
+        { tr("Maximum line length:"), &options.maxLineLength, 999 },
+        { tr("Maximum lines:"), &options.maxLines, 99 },
+        { tr("Maximum CPS:"), &options.maxCps, 999 },
+    };
+    QVector<QSpinBox *> boxes;
+    for (const Field &f : fields) {
+        QSpinBox *box = new QSpinBox(&dlg);
+        box->setRange(0, f.max);
+        box->setValue(*f.value);
+        form->addRow(f.label, box);
+        boxes.append(box);
+    }
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dlg);
+    connect(buttons, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+    form->addRow(buttons);
+    if (dlg.exec() != QDialog::Accepted) return;
+    for (int i = 0; i < boxes.size(); ++i) *fields[i].value = boxes.at(i)->value();
+    // the model re-checks everything from AppSettings::qcOptionsChanged
+    AppSettings::instance()->setQcOptions(options);
+}
+
+void MainWindow::onSpellDictionary() {
+    AppSettings *settings = AppSettings::instance();
+    QString dir = QFileInfo(settings->spellDictionary()).absolutePath();
+    if (settings->spellDictionary().isEmpty()) {
+        const QStringList paths = SpellDictionary::searchPaths();
+        const auto it = std::find_if(paths.begin(), paths.end(), [](const QString &p) { return QFileInfo(p).isDir(); });
+        dir = it != paths.end() ? *it : QString();
+    }
+    const QString path = QFileDialog::getOpenFileName(this, tr("Spelling Dictionary"), dir,
+                                                      tr("Hunspell dictionaries (*.dic)"));
+    if (path.isEmpty()) return;
+    // the dictionary is reloaded from AppSettings::spellingChanged
+    settings->setSpellDictionary(path);
+    settings->setSpellCheck(true);
+}
+
+void MainWindow::loadSpellDictionary() {
+    const quint64 generation = ++dictionaryGeneration_;
+    AppSettings *settings = AppSettings::instance();
+    if (!settings->spellCheck()) {
+        setSpellDictionary(nullptr);
+        return;
+    }
+    QString path = settings->spellDictionary();
+    if (path.isEmpty()) path = SpellDictionary::find(QLocale::system().name());
+    if (path.isEmpty()) {
+        setSpellDictionary(nullptr);
+        statusBar()->showMessage(tr("No spelling dictionary installed for %1").arg(QLocale::system().name()), 5000);
+        return;
+    }
+    // the first load of a dictionary expands its affixes; later ones map
+    // the cached automaton
+    auto *job = new QFutureWatcher<std::shared_ptr<const SpellDictionary>>(this);
+    connect(job, &QFutureWatcherBase::finished, this, [this, job, generation, path] {
+        job->deleteLater();
+        if (generation != dictionaryGeneration_) return; // the settings changed since
+        const std::shared_ptr<const SpellDictionary> dictionary = job->result();
+        if (!dictionary) {
+            statusBar()->showMessage(tr("Could not read the spelling dictionary %1").arg(QDir::toNativeSeparators(path)), 5000);
+        }
+        setSpellDictionary(dictionary);
+    });
+    job->setFuture(QtConcurrent::run([path]() -> std::shared_ptr<const SpellDictionary> {
+        auto dictionary = std::make_shared<SpellDictionary>();
+        if (!dictionary->load(path)) return nullptr;
+        return dictionary;
+    }));
+}
+
+void MainWindow::setSpellDictionary(const std::shared_ptr<const SpellDictionary> &dictionary) {
+    model_->setSpellDictionary(dictionary);
+    spellHighlighter_->setDictionary(dictionary);
+}
+
+void MainWindow::onCpsErrorColour() {
+    AppSettings *settings = AppSettings::instance();
+    const QColor c = QColorDialog::getColor(settings->cpsErrorColour(), this, tr("CPS Error Colour"));
+    if (c.isValid()) settings->setCpsErrorColour(c);
+}
+
+void MainWindow::onInsertCue() {
+    commitPendingEdit();
+    const int current = tableView_->selectionModel()->currentIndex().row();
+    const int row = current >= 0 ? current + 1 : model_->rowCount();
+    // a two second cue right after the previous one
+    int start = 0;
+    if (row > 0) {
+        QVector<int> starts, ends;
+        model_->timingsInRange(row - 1, row - 1, starts, ends);
+        if (!ends.isEmpty() && ends.first() != SubtitleStore::NoTime) start = ends.first();
+    }
+    SubtitleStore cue;
+    // a number no cue has: writers keep the numbers they are given
+    cue.append(model_->maxLineNumber() + 1, start, start + 2000, QStringView());
+    history_->push(std::make_unique<InsertCuesCommand>(row, cue, tr("Insert cue")));
+    updateDirty();
+    tableView_->selectRow(row);
+    editor_->setFocus();
+}
+
+void MainWindow::onDeleteCues() {
+    commitPendingEdit();
+    const QVector<int> rows = selectedRows();
+    if (rows.isEmpty()) return;
+    history_->push(std::make_unique<RemoveCuesCommand>(rows));
+    updateDirty();
+}
+
+void MainWindow::onUndo() {
+    commitPendingEdit();
+    if (!history_->canUndo()) return;
+    history_->undo();
+    updateDirty();
+}
+
+void MainWindow::onRedo() {
+    commitPendingEdit();
+    if (!history_->canRedo()) return;
+    history_->redo();
+    updateDirty();
+}
+
+void MainWindow::updateUndoActions() {
+    const bool loading = loader_->isRunning();
+    undoAction_->setEnabled(!loading && history_->canUndo());
+    redoAction_->setEnabled(!loading && history_->canRedo());
+    undoAction_->setText(history_->canUndo() ? tr("Undo %1").arg(history_->undoText()) : tr("Undo"));
+    redoAction_->setText(history_->canRedo() ? tr("Redo %1").arg(history_->redoText()) : tr("Redo"));
+}
+
+void MainWindow::onModelDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+    const int row = tableView_->selectionModel()->currentIndex().row();
+    if (row < topLeft.row() || row > bottomRight.row()) return;
+    // undo/redo can change the row being shown; our own commits leave the
+    // editor untouched since its text already matches
+    if (editRow_ < 0 && bottomRight.column() >= SubtitleModel::Text) {
+        const QString text = model_->textAt(row);
+        if (editor_->toPlainText() != text) {
+            editor_->blockSignals(true);
+            editor_->setPlainText(text);
+            editor_->blockSignals(false);
+            updateEditorMatches();
+        }
+    }
+    updateLiveCps();
+}
+
+void MainWindow::updateLiveCps() {
+    const QModelIndex current = tableView_->selectionModel()->currentIndex();
+    if (!current.isValid()) {
+        cpsLabel_->clear();
+        return;
+    }
+    const int row = current.row();
+    if (editRow_ != row) {
+        cpsLabel_->setText(tr("CPS: %1").arg(model_->data(model_->index(row, SubtitleModel::CPS)).toInt()));
+        return;
+    }
+    // while typing the model still has the committed text: count the
+    // editor's, one pass over a cue's worth of characters
+    const int cps = SubtitleStore::computeCPS(editor_->toPlainText(), model_->durationMsAt(row));
+    cpsLabel_->setText(tr("CPS: %1").arg(cps));
+}
+
+void MainWindow::updateColumnWidths() {
+    TRACE_SCOPE("MainWindow::updateColumnWidths");
+    // only the '#' column depends on the data, and only on its digit count
+    int digits = 1;
+    for (int n = model_->maxLineNumber(); n >= 10; n /= 10) ++digits;
+    digits = qMax(digits, 4);
+    if (digits == lineNumberDigits_) return;
+    lineNumberDigits_ = digits;
+
+    const QFontMetrics fm(tableView_->font());
+    const QFontMetrics headerFm(tableView_->horizontalHeader()->font());
+    int digitWidth = 0;
+    for (char c = '0'; c <= '9'; ++c) digitWidth = qMax(digitWidth, fm.horizontalAdvance(QLatin1Char(c)));
+    // cell margins of the default delegate, plus room for the sort indicator
+    const int padding = 2 * (tableView_->style()->pixelMetric(QStyle::PM_FocusFrameHMargin, nullptr, tableView_) + 1) + 8;
+    auto setWidth = [&](int column, int contentWidth) {
+        const int headerWidth = headerFm.horizontalAdvance(model_->headerData(column, Qt::Horizontal, Qt::DisplayRole).toString());
+        tableView_->horizontalHeader()->resizeSection(column, qMax(contentWidth, headerWidth) + padding);
+    };
+    const int timeWidth = 9 * digitWidth + fm.horizontalAdvance(QStringLiteral("::,"));
+    setWidth(SubtitleModel::LineNumber, digits * digitWidth);
+    setWidth(SubtitleModel::StartTime, timeWidth);
+    setWidth(SubtitleModel::EndTime, timeWidth);
+    int cpsDigits = 1;
+    for (int n = SubtitleStore::MaxCps; n >= 10; n /= 10) ++cpsDigits;
+    setWidth(SubtitleModel::CPS, cpsDigits * digitWidth);
+
+    tableView_->verticalHeader()->setDefaultSectionSize(fm.height() + padding / 2);
+}
+
+bool MainWindow::eventFilter(QObject *watched, QEvent *event) {
+    if (watched == tableView_ && (event->type() == QEvent::FontChange || event->type() == QEvent::StyleChange)) {
+        // the widths were measured with the old metrics: measure them all
+        // again, whatever the digit count
+        lineNumberDigits_ = 0;
+        updateColumnWidths();
+    }
+    return QMainWindow::eventFilter(watched, event);
 }
 
 void MainWindow::onHeaderContextMenuRequested(const QPoint &pos) {
@@ -319,7 +1454,9 @@ void MainWindow::toggleColumnVisible() {
 }
 
 void MainWindow::closeEvent(QCloseEvent *event) {
+    commitPendingEdit();
     if (!dirty_) {
+        journal_->discard();
         event->accept();
         return;
     }
@@ -336,12 +1473,14 @@ void MainWindow::closeEvent(QCloseEvent *event) {
     int ret = msg.exec();
     if (ret == QMessageBox::Yes) {
         // intentar guardar; si el guardado falla o usuario cancela SaveAs, NO cerramos
-        if (saveFile()) {
+        if (saveFile() && finishSaves()) {
+            journal_->discard();
             event->accept();
         } else {
             event->ignore();
         }
     } else if (ret == QMessageBox::No) {
+        journal_->discard();
         event->accept();
     } else { // Cancel
         event->ignore();
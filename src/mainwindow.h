@@ -1,11 +1,33 @@
 #pragma once
+#include <QElapsedTimer>
 #include <QMainWindow>
+#include <memory>
+#include "subtitleformat.h"
+#include "subtitlestore.h"
+#include "textencoding.h"
 
 class QTableView;
 class QAction;
 class SubtitleModel;
+class SubtitleLoader;
+class SubtitleSaver;
+class EditHistory;
+class EditJournal;
 class QTextEdit;
 class QCloseEvent;
+class QProgressBar;
+class QToolButton;
+class QMenu;
+class QLabel;
+class QTimer;
+class TextDelegate;
+class FindPanel;
+class DiffPanel;
+class QDockWidget;
+class FileMonitor;
+struct FileChange;
+class SpellDictionary;
+class SpellHighlighter;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -21,23 +43,136 @@ private slots:
     void onSave();
     void onSaveAs();
     void onEditorTextChanged();
+    void onLoadFinished(bool ok);
+    void onSaveFinished(bool ok, const QString &filePath);
+    void onShiftTimes();
+    void onSyncTimes();
+    void onChangeFramerate();
+    void onSnapToFrames();
+    void onGoToTime();
+    void onCpsThresholds();
+    void onCpsErrorColour();
+    void onQcRules();
+    void onSpellDictionary();
+    void onQcIssueActivated(int issue);
+    void onFind();
+    void onFindNext();
+    void onFindPrevious();
+    void onReplaceAll(const QString &needle, const QString &replacement, Qt::CaseSensitivity cs);
+    void onCompareWith();
+    void onMerge();
+    void onDiffFlagsActivated(int flags);
+    void onAcceptDiff(bool selectedOnly);
+    void onRejectDiffSelected();
+    void updateEditorMatches();
+    void commitPendingEdit();
+    void onUndo();
+    void onRedo();
+    void onInsertCue();
+    void onDeleteCues();
+    void checkRecovery();
+    void updateUndoActions();
+    void onModelDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    void updateColumnWidths();
 
 private:
     void setupActions();
     void setupUi();
+    void setLoading(bool loading);
+    void setSaving(bool saving);
+    void updateDirty();
+    void updateLiveCps();
+    // Contiguous runs of the selected rows for a bulk timing operation; with
+    // no selection, the whole document if the user confirms it.
+    bool timingRuns(const QString &title, QVector<QPair<int, int>> &runs);
+    static int rowCount(const QVector<QPair<int, int>> &runs);
+    // Rows selected in the table, else the current row.
+    QVector<int> selectedRows() const;
+    void showDiff();
 
     bool saveFile();
+    void openPath(const QString &path);
+    bool startSave(const QString &filePath, SubtitleFormat::Id format);
+    // Blocks until the running save and the one queued after it are done;
+    // false if either failed.
+    bool finishSaves();
+    QString askSavePath();
     void updateWindowTitle();
+    void updateEncodingLabel();
+    // Watches the open file for changes by other programs.
+    void watchFile();
+    void onFileChanged(const FileChange &change);
+    void updateHud();
+    // Loads the dictionary the settings name, in the background.
+    void loadSpellDictionary();
+    void setSpellDictionary(const std::shared_ptr<const SpellDictionary> &dictionary);
 
     QTableView *tableView_ = nullptr;
     SubtitleModel *model_ = nullptr;
+    TextDelegate *textDelegate_ = nullptr;
+    SubtitleLoader *loader_ = nullptr;
+    SubtitleSaver *saver_ = nullptr;
+    FileMonitor *monitor_ = nullptr;
+    SubtitleStore diskVersion_;      // the cues the file on disk holds; base of a merge with outside changes
+    SubtitleStore savingSnapshot_;   // what the running save writes
+    bool reloadPrompt_ = false;      // asking what to do with an outside change
+    EditHistory *history_ = nullptr;
+    EditJournal *journal_ = nullptr;
+    qint64 journalMark_ = 0;         // journal size when the running save started
+    bool recovering_ = false;        // the load in progress gets the journal replayed
+    QProgressBar *loadProgress_ = nullptr;
+    QToolButton *cancelLoadButton_ = nullptr;
     QAction *openAction_ = nullptr;
     QAction *saveAction_ = nullptr;
     QAction *saveAsAction_ = nullptr;
+    QAction *undoAction_ = nullptr;
+    QAction *redoAction_ = nullptr;
+    QAction *insertCueAction_ = nullptr;
+    QAction *deleteCuesAction_ = nullptr;
+    QAction *compareAction_ = nullptr;
+    QAction *mergeAction_ = nullptr;
+    QMenu *timingMenu_ = nullptr;
+    QMenu *viewMenu_ = nullptr;
+    QDockWidget *findDock_ = nullptr;
+    FindPanel *findPanel_ = nullptr;
+    QAction *findNextAction_ = nullptr;
+    QAction *findPreviousAction_ = nullptr;
+    QDockWidget *diffDock_ = nullptr;
+    DiffPanel *diffPanel_ = nullptr;
+    int lineNumberDigits_ = 0;       // digits the '#' column is currently sized for, 0: none
     QTextEdit *editor_ = nullptr;
+    QLabel *cpsLabel_ = nullptr;
+    SpellHighlighter *spellHighlighter_ = nullptr;
+    quint64 dictionaryGeneration_ = 0; // of the latest dictionary load
+    // keystrokes are coalesced and committed to the model on idle, or after
+    // at most MaxEditDelayMs while typing continuously
+    QTimer *editIdleTimer_ = nullptr;
+    QTimer *editMaxDelayTimer_ = nullptr;
+    int editRow_ = -1;               // row with uncommitted editor text
+    qint64 maxKeystrokeNs_ = 0;      // worst-case cost of onEditorTextChanged
+    qint64 maxCommitNs_ = 0;         // worst-case cost of commitPendingEdit
     QString currentFilePath_;
+    TextFormat fileFormat_;          // what the file was read as; saves write it back the same way
+    SubtitleFormat::Id documentFormat_ = SubtitleFormat::Srt; // likewise: SRT, ASS or WebVTT
+    SubtitleFormat::Id savingFormat_ = SubtitleFormat::Srt;   // format of the save in flight
+    QString queuedSavePath_;         // save asked for while one ran; empty if none
+    SubtitleFormat::Id queuedSaveFormat_ = SubtitleFormat::Srt;
+    QLabel *encodingLabel_ = nullptr;
+    QLabel *hudLabel_ = nullptr;
+    QTimer *hudTimer_ = nullptr;
+    QElapsedTimer loadClock_;
+    qint64 lastLoadMs_ = -1;         // of the last load that finished, -1 before any
+    int lastLoadCues_ = 0;
+    int frames_ = 0;                 // table repaints since the HUD was last refreshed
+    qint64 frameNs_ = 0;             // their total and worst time
+    qint64 maxFrameNs_ = 0;
     bool dirty_ = false;             // flag 'unsaved changes'
+    // saves run in the background while editing goes on: the document is
+    // clean only if the history is at the state of the snapshot written
+    quint64 savedState_ = 0;  // EditHistory::state() of the file on disk, NoState if none
+    quint64 savingState_ = 0; // of the snapshot being saved
 
 protected:
     void closeEvent(QCloseEvent *event) override;
+    bool eventFilter(QObject *watched, QEvent *event) override;
 };
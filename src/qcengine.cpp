@@ -0,0 +1,180 @@
+#include "qcengine.h"
+#include "trace.h"
+#include <QCoreApplication>
+#include <QStringList>
+#include <QtConcurrent>
+
+namespace {
+
+// Below this many rows a range is checked on the calling thread.
+constexpr int ParallelThreshold = 16 * 1024;
+constexpr int ChunkRows = 8 * 1024;
+
+} // namespace
+
+QString QcEngine::issueName(Issue issue) {
+    switch (issue) {
+    case NoTiming: return QCoreApplication::translate("QcEngine", "Missing timing");
+    case TooShort: return QCoreApplication::translate("QcEngine", "Duration too short");
+    case TooLong: return QCoreApplication::translate("QcEngine", "Duration too long");
+    case SmallGap: return QCoreApplication::translate("QcEngine", "Gap to next cue too small");
+    case LineTooLong: return QCoreApplication::translate("QcEngine", "Line too long");
+    case TooManyLines: return QCoreApplication::translate("QcEngine", "Too many lines");
+    case ReadingSpeed: return QCoreApplication::translate("QcEngine", "Reading speed too high");
+    case Overlap: return QCoreApplication::translate("QcEngine", "Overlaps another cue");
+    }
+    return QString();
+}
+
+QString QcEngine::describe(quint16 flags) {
+    QStringList lines;
+    for (int i = 0; i < IssueCount; ++i) {
+        if (flags & issueAt(i)) lines.append(issueName(issueAt(i)));
+    }
+    return lines.join(u'\n');
+}
+
+void QcEngine::clear() {
+    flags_.clear();
+    std::fill(std::begin(counts_), std::end(counts_), 0);
+}
+
+quint16 QcEngine::check(const SubtitleStore &store, const QVector<bool> &overlaps, int row) const {
+    quint16 f = 0;
+    const int start = store.startMs(row);
+    const int end = store.endMs(row);
+    if (start == SubtitleStore::NoTime || end == SubtitleStore::NoTime) {
+        f |= NoTiming;
+    } else {
+        const int duration = end - start;
+        if (duration < options_.minDurationMs) f |= TooShort;
+        if (duration > options_.maxDurationMs) f |= TooLong;
+        if (row + 1 < store.size()) {
+            const int next = store.startMs(row + 1);
+            // an overlap is reported as such, not as a negative gap
+            if (next != SubtitleStore::NoTime && next >= end && next - end < options_.minGapMs) f |= SmallGap;
+        }
+        if (store.cps(row) > options_.maxCps) f |= ReadingSpeed;
+    }
+
+    // line length as a viewer sees it: no markup, graphemes, spaces included
+    constexpr CpsOptions LineRules{ true, false };
+    const QStringView text = store.textView(row);
+    int lines = 1;
+    qsizetype lineStart = 0;
+    for (qsizetype i = 0; i <= text.size(); ++i) {
+        if (i < text.size() && text.at(i) != u'\n') continue;
+        if (i - lineStart > options_.maxLineLength
+            && SubtitleStore::visibleCharacters(text.sliced(lineStart, i - lineStart), LineRules) > options_.maxLineLength)
+            f |= LineTooLong;
+        if (i < text.size()) ++lines;
+        lineStart = i + 1;
+    }
+    if (lines > options_.maxLines) f |= TooManyLines;
+
+    if (row < overlaps.size() && overlaps.at(row)) f |= Overlap;
+    return f;
+}
+
+void QcEngine::setFlags(int row, quint16 flags) {
+    const quint16 old = flags_.at(row);
+    if (old == flags) return;
+    const quint16 changed = old ^ flags;
+    for (int i = 0; i < IssueCount; ++i) {
+        if (changed & issueAt(i)) counts_[i] += (flags & issueAt(i)) ? 1 : -1;
+    }
+    flags_[row] = flags;
+}
+
+void QcEngine::recount() {
+    std::fill(std::begin(counts_), std::end(counts_), 0);
+    for (quint16 f : std::as_const(flags_)) {
+        for (int i = 0; f && i < IssueCount; ++i, f >>= 1) counts_[i] += f & 1;
+    }
+}
+
+void QcEngine::checkRange(const SubtitleStore &store, const QVector<bool> &overlaps, int first, int last) {
+    first = qMax(0, first);
+    last = qMin(last, int(flags_.size()) - 1);
+    if (first > last) return;
+    if (last - first + 1 < ParallelThreshold) {
+        for (int r = first; r <= last; ++r) setFlags(r, check(store, overlaps, r));
+        return;
+    }
+    // chunks write disjoint slots; the counts are redone afterwards
+    QVector<QPair<int, int>> chunks;
+    for (int r = first; r <= last; r += ChunkRows) chunks.append({ r, qMin(last, r + ChunkRows - 1) });
+    quint16 *flags = flags_.data();
+    QtConcurrent::blockingMap(chunks, [&](const QPair<int, int> &chunk) {
+        for (int r = chunk.first; r <= chunk.second; ++r) flags[r] = check(store, overlaps, r);
+    });
+    recount();
+}
+
+void QcEngine::refreshOverlaps(const IntervalIndex &intervals) {
+    const QVector<bool> &overlaps = intervals.overlapFlags();
+    auto refresh = [&](int r) {
+        const bool has = r < overlaps.size() && overlaps.at(r);
+        if (bool(flags_.at(r) & Overlap) != has) setFlags(r, flags_.at(r) ^ Overlap);
+    };
+    // the index knows which flags its last update changed
+    if (!intervals.allOverlapsChanged()) {
+        for (int r : intervals.overlapChanges()) {
+            if (r < flags_.size()) refresh(r);
+        }
+        return;
+    }
+    for (int r = 0; r < int(flags_.size()); ++r) refresh(r);
+}
+
+void QcEngine::checkAll(const SubtitleStore &store, const IntervalIndex &intervals) {
+    TRACE_SCOPE("QcEngine::checkAll");
+    clear();
+    flags_.resize(store.size());
+    checkRange(store, intervals.overlapFlags(), 0, int(store.size()) - 1);
+}
+
+void QcEngine::insertRows(const SubtitleStore &store, const IntervalIndex &intervals, int first, int count) {
+    if (count <= 0) return;
+    flags_.insert(first, count, 0);
+    const QVector<bool> &overlaps = intervals.overlapFlags();
+    // the row before now has a different next cue
+    checkRange(store, overlaps, first - 1, first + count - 1);
+    refreshOverlaps(intervals);
+}
+
+void QcEngine::removeRows(const SubtitleStore &store, const IntervalIndex &intervals, int first, int count) {
+    if (count <= 0) return;
+    for (int r = first; r < first + count; ++r) setFlags(r, 0);
+    flags_.remove(first, count);
+    checkRange(store, intervals.overlapFlags(), first - 1, first - 1);
+    refreshOverlaps(intervals);
+}
+
+void QcEngine::recheck(const SubtitleStore &store, const IntervalIndex &intervals, int first, int last,
+                       bool timingsChanged)
+{
+    const QVector<bool> &overlaps = intervals.overlapFlags();
+    if (!timingsChanged) {
+        checkRange(store, overlaps, first, last);
+        return;
+    }
+    checkRange(store, overlaps, first - 1, last);
+    refreshOverlaps(intervals);
+}
+
+int QcEngine::count(Issue issue) const {
+    for (int i = 0; i < IssueCount; ++i) {
+        if (issue == issueAt(i)) return counts_[i];
+    }
+    return 0;
+}
+
+int QcEngine::nextRow(Issue issue, int row) const {
+    const int n = int(flags_.size());
+    for (int k = 1; k <= n; ++k) {
+        const int r = (row + k) % n;
+        if (r >= 0 && (flags_.at(r) & issue)) return r;
+    }
+    return -1;
+}
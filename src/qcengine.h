@@ -0,0 +1,71 @@
+#pragma once
+#include <QString>
+#include <QVector>
+#include "intervalindex.h"
+#include "subtitlestore.h"
+
+// Delivery-spec limits checked by QcEngine.
+struct QcOptions {
+    int minDurationMs = 833;  // 20 frames at 24 fps
+    int maxDurationMs = 7000;
+    int minGapMs = 84;        // 2 frames at 24 fps
+    int maxLineLength = 42;
+    int maxLines = 2;
+    int maxCps = 25;          // reading speed
+};
+
+// Rule-based quality check over a SubtitleStore. Every row gets a set of
+// Issue bits; the engine keeps them, and the per-rule counts, in step with
+// the edits so that only the touched rows (and their neighbours, when
+// timings move) are checked again. A full pass runs in parallel over row
+// chunks.
+class QcEngine {
+public:
+    enum Issue : quint16 {
+        NoTiming     = 1 << 0,
+        TooShort     = 1 << 1,
+        TooLong      = 1 << 2,
+        SmallGap     = 1 << 3, // next cue starts less than minGapMs after this one ends
+        LineTooLong  = 1 << 4,
+        TooManyLines = 1 << 5,
+        ReadingSpeed = 1 << 6,
+        Overlap      = 1 << 7
+    };
+    static constexpr int IssueCount = 8;
+    static Issue issueAt(int i) { return Issue(1 << i); }
+    static QString issueName(Issue issue);
+    // One line per issue in 'flags'.
+    static QString describe(quint16 flags);
+
+    void setOptions(const QcOptions &options) { options_ = options; }
+    const QcOptions &options() const { return options_; }
+
+    void clear();
+    void checkAll(const SubtitleStore &store, const IntervalIndex &intervals);
+    // Rows [first, first + count) were inserted / removed in the store.
+    void insertRows(const SubtitleStore &store, const IntervalIndex &intervals, int first, int count);
+    void removeRows(const SubtitleStore &store, const IntervalIndex &intervals, int first, int count);
+    // Rows [first, last] changed: their text only, or also their timings
+    // (then the previous row's gap and the overlap flags the index changed
+    // are updated too). Each call must follow the index update it reflects.
+    void recheck(const SubtitleStore &store, const IntervalIndex &intervals, int first, int last,
+                 bool timingsChanged);
+
+    quint16 flags(int row) const { return row >= 0 && row < flags_.size() ? flags_.at(row) : 0; }
+    int count(Issue issue) const;
+    // Next row after 'row' with 'issue', wrapping around; -1 if none.
+    int nextRow(Issue issue, int row) const;
+
+private:
+    quint16 check(const SubtitleStore &store, const QVector<bool> &overlaps, int row) const;
+    // Checks rows [first, last], in parallel when the range is large.
+    void checkRange(const SubtitleStore &store, const QVector<bool> &overlaps, int first, int last);
+    // Takes over the overlap flags the last update of 'intervals' changed.
+    void refreshOverlaps(const IntervalIndex &intervals);
+    void setFlags(int row, quint16 flags);
+    void recount();
+
+    QcOptions options_;
+    QVector<quint16> flags_;
+    int counts_[IssueCount] = {};
+};
@@ -0,0 +1,61 @@
+#include "qcpanel.h"
+#include "subtitlemodel.h"
+#include <QHeaderView>
+#include <QLabel>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+namespace {
+
+constexpr int RefreshDelayMs = 100;
+
+} // namespace
+
+QcPanel::QcPanel(SubtitleModel *model, QWidget *parent)
+    : QWidget(parent), model_(model), tree_(new QTreeWidget(this)), summary_(new QLabel(this)),
+      refreshTimer_(new QTimer(this))
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(4, 4, 4, 4);
+    layout->addWidget(summary_);
+    layout->addWidget(tree_);
+
+    tree_->setColumnCount(2);
+    tree_->setHeaderLabels({ tr("Rule"), tr("Cues") });
+    tree_->setRootIsDecorated(false);
+    tree_->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    tree_->header()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
+    tree_->header()->setStretchLastSection(false);
+    for (int i = 0; i < QcEngine::IssueCount; ++i) {
+        QTreeWidgetItem *item = new QTreeWidgetItem(tree_);
+        item->setText(0, QcEngine::issueName(QcEngine::issueAt(i)));
+        item->setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
+        item->setData(0, Qt::UserRole, int(QcEngine::issueAt(i)));
+        item->setToolTip(0, tr("Double-click to go to the next cue with this issue"));
+    }
+    connect(tree_, &QTreeWidget::itemActivated, this, [this](QTreeWidgetItem *item) {
+        emit issueActivated(QcEngine::Issue(item->data(0, Qt::UserRole).toInt()));
+    });
+
+    refreshTimer_->setSingleShot(true);
+    refreshTimer_->setInterval(RefreshDelayMs);
+    connect(refreshTimer_, &QTimer::timeout, this, &QcPanel::refresh);
+    connect(model_, &SubtitleModel::qcChanged, this, [this] {
+        if (!refreshTimer_->isActive()) refreshTimer_->start();
+    });
+    refresh();
+}
+
+void QcPanel::refresh() {
+    const QcEngine &qc = model_->qc();
+    int total = 0;
+    for (int i = 0; i < QcEngine::IssueCount; ++i) {
+        const int n = qc.count(QcEngine::issueAt(i));
+        QTreeWidgetItem *item = tree_->topLevelItem(i);
+        item->setText(1, QString::number(n));
+        item->setDisabled(n == 0);
+        total += n;
+    }
+    summary_->setText(total == 0 ? tr("No issues") : tr("%n issue(s)", nullptr, total));
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <QWidget>
+#include "qcengine.h"
+
+class QLabel;
+class QTimer;
+class QTreeWidget;
+class SubtitleModel;
+
+// Summary of the quality check: one line per rule with the number of cues
+// breaking it. Activating a line asks to go to the next such cue.
+class QcPanel : public QWidget {
+    Q_OBJECT
+public:
+    explicit QcPanel(SubtitleModel *model, QWidget *parent = nullptr);
+
+signals:
+    void issueActivated(QcEngine::Issue issue);
+
+private:
+    void refresh();
+
+    SubtitleModel *model_;
+    QTreeWidget *tree_;
+    QLabel *summary_;
+    QTimer *refreshTimer_; // coalesces the updates of a load or bulk edit
+};
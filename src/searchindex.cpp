@@ -0,0 +1,162 @@
+#include "searchindex.h"
+#include "trace.h"
+#include <QVarLengthArray>
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace {
+
+// Above this many cues the postings are built in parallel chunks.
+constexpr int ParallelThreshold = 16384;
+constexpr int ChunkRows = 8192;
+// Dead ids tolerated before the postings are rebuilt, at minimum.
+constexpr int MinDeadIds = 4096;
+
+using Postings = QHash<quint64, QVector<int>>;
+using Trigrams = QVarLengthArray<quint64, 128>;
+
+char16_t fold(char16_t c) {
+    if (c < 0x80) return (c >= u'A' && c <= u'Z') ? char16_t(c | 0x20) : c;
+    return char16_t(QChar::toCaseFolded(char32_t(c)));
+}
+
+// Distinct folded trigrams of 'text', sorted.
+void trigramsOf(QStringView text, Trigrams &out) {
+    out.clear();
+    const char16_t *p = text.utf16();
+    const qsizetype n = text.size();
+    if (n < 3) return;
+    quint64 key = (quint64(fold(p[0])) << 16) | fold(p[1]);
+    for (qsizetype i = 2; i < n; ++i) {
+        key = ((key << 16) | fold(p[i])) & 0xFFFFFFFFFFFFull;
+        out.append(key);
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+// Needles the trigrams cannot answer for: too short, or with code points
+// whose case folding is not a per-unit one.
+bool needsScan(QStringView needle) {
+    if (needle.size() < 3) return true;
+    return std::any_of(needle.begin(), needle.end(), [](QChar c) { return c.isSurrogate(); });
+}
+
+} // namespace
+
+void SearchIndex::clear() {
+    postings_.clear();
+    ids_.clear();
+    rows_.clear();
+    staleFrom_ = -1;
+    deadIds_ = 0;
+    built_ = false;
+}
+
+void SearchIndex::rebuild(const SubtitleStore &store) {
+    TRACE_SCOPE("SearchIndex::rebuild");
+    clear();
+    const int n = int(store.size());
+    ids_.resize(n);
+    rows_.resize(n);
+    for (int r = 0; r < n; ++r) ids_[r] = rows_[r] = r;
+    built_ = true;
+    if (n < ParallelThreshold) {
+        Trigrams trigrams;
+        for (int r = 0; r < n; ++r) {
+            trigramsOf(store.textView(r), trigrams);
+            for (quint64 key : trigrams) postings_[key].append(r);
+        }
+        return;
+    }
+    // per-chunk postings, merged in chunk order
+    QVector<QPair<int, int>> chunks;
+    for (int r = 0; r < n; r += ChunkRows) chunks.append({ r, qMin(n - 1, r + ChunkRows - 1) });
+    const QList<Postings> parts = QtConcurrent::blockingMapped<QList<Postings>>(chunks,
+        [&store](const QPair<int, int> &chunk) {
+            Postings local;
+            Trigrams trigrams;
+            for (int r = chunk.first; r <= chunk.second; ++r) {
+                trigramsOf(store.textView(r), trigrams);
+                for (quint64 key : trigrams) local[key].append(r);
+            }
+            return local;
+        });
+    for (const Postings &part : parts) {
+        for (auto it = part.cbegin(); it != part.cend(); ++it) postings_[it.key()].append(it.value());
+    }
+}
+
+int SearchIndex::addCue(QStringView text, int row) {
+    const int id = int(rows_.size());
+    rows_.append(row);
+    Trigrams trigrams;
+    trigramsOf(text, trigrams);
+    for (quint64 key : trigrams) postings_[key].append(id);
+    return id;
+}
+
+void SearchIndex::markStale(int first) {
+    if (first < ids_.size() && (staleFrom_ < 0 || first < staleFrom_)) staleFrom_ = first;
+}
+
+void SearchIndex::renumber() const {
+    if (staleFrom_ < 0) return;
+    for (int r = staleFrom_; r < ids_.size(); ++r) rows_[ids_.at(r)] = r;
+    staleFrom_ = -1;
+}
+
+void SearchIndex::insertRows(const SubtitleStore &store, int first, int count) {
+    if (!built_ || count <= 0) return;
+    ids_.insert(first, count, -1);
+    for (int r = first; r < first + count; ++r) ids_[r] = addCue(store.textView(r), r);
+    // the rows after them moved down: their entries wait for the next find
+    markStale(first + count);
+}
+
+void SearchIndex::removeRows(const SubtitleStore &store, int first, int count) {
+    if (!built_ || count <= 0) return;
+    // ids_ is always current; only rows_ lags behind it
+    for (int r = first; r < first + count; ++r) rows_[ids_.at(r)] = -1;
+    deadIds_ += count;
+    ids_.remove(first, count);
+    markStale(first);
+    if (deadIds_ > qMax<qsizetype>(MinDeadIds, ids_.size())) rebuild(store);
+}
+
+void SearchIndex::updateRow(const SubtitleStore &store, int row) {
+    if (!built_) return;
+    rows_[ids_.at(row)] = -1;
+    ++deadIds_;
+    ids_[row] = addCue(store.textView(row), row);
+    if (deadIds_ > qMax<qsizetype>(MinDeadIds, ids_.size())) rebuild(store);
+}
+
+QVector<int> SearchIndex::find(const SubtitleStore &store, QStringView needle, Qt::CaseSensitivity cs) const {
+    QVector<int> rows;
+    if (needle.isEmpty()) return rows;
+    if (!built_ || needsScan(needle)) {
+        for (int r = 0; r < store.size(); ++r) {
+            if (matches(store.textView(r), needle, cs)) rows.append(r);
+        }
+        return rows;
+    }
+
+    renumber();
+    // every match contains all the needle's trigrams: verify the cues of
+    // the rarest one
+    Trigrams trigrams;
+    trigramsOf(needle, trigrams);
+    const QVector<int> *candidates = nullptr;
+    for (quint64 key : trigrams) {
+        const auto it = postings_.constFind(key);
+        if (it == postings_.cend()) return rows;
+        if (!candidates || it->size() < candidates->size()) candidates = &*it;
+    }
+    for (int id : *candidates) {
+        const int row = rows_.at(id);
+        if (row >= 0 && matches(store.textView(row), needle, cs)) rows.append(row);
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
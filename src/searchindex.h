@@ -0,0 +1,50 @@
+#pragma once
+#include <QHash>
+#include <QStringView>
+#include <QVector>
+#include "subtitlestore.h"
+
+// Trigram index over cue text for find: every distinct case-folded run of
+// three UTF-16 units maps to the cues containing it. A query only verifies
+// the cues listed under its rarest trigram, so it touches a small part of a
+// large file instead of every cue.
+//
+// Postings hold cue ids, not rows, so inserting or removing rows never
+// rewrites them. An edited cue gets a new id and its old one is left to
+// die; the postings are rebuilt once dead ids outnumber live ones. The
+// id -> row map is renumbered lazily: edits only note the first row whose
+// entry went stale, and the next find() renumbers from there once.
+class SearchIndex {
+public:
+    bool isBuilt() const { return built_; }
+    void clear();
+    void rebuild(const SubtitleStore &store);
+
+    // Keep the index in step with the store (after the store changed): rows
+    // [first, first + count) were inserted / removed, or the text of 'row'
+    // changed. Nothing to do until the index is built.
+    void insertRows(const SubtitleStore &store, int first, int count);
+    void removeRows(const SubtitleStore &store, int first, int count);
+    void updateRow(const SubtitleStore &store, int row);
+
+    // Rows whose text contains 'needle', ascending. Needles shorter than a
+    // trigram (or outside the BMP) fall back to scanning every cue.
+    QVector<int> find(const SubtitleStore &store, QStringView needle, Qt::CaseSensitivity cs) const;
+
+    static bool matches(QStringView text, QStringView needle, Qt::CaseSensitivity cs) {
+        return !needle.isEmpty() && text.contains(needle, cs);
+    }
+
+private:
+    int addCue(QStringView text, int row);
+    void markStale(int first);
+    // Brings rows_ up to date with ids_.
+    void renumber() const;
+
+    QHash<quint64, QVector<int>> postings_; // trigram -> ids, unordered
+    QVector<int> ids_;                      // row -> id
+    mutable QVector<int> rows_;             // id -> row, -1 once dead
+    mutable int staleFrom_ = -1;            // rows_ of rows from here on may be off; -1: none
+    int deadIds_ = 0;
+    bool built_ = false;
+};
@@ -0,0 +1,161 @@
+#include "spellchecker.h"
+#include "trace.h"
+#include <QtConcurrent>
+#include <utility>
+
+namespace {
+
+// rows per task of a full check
+constexpr int ChunkRows = 8 * 1024;
+
+// Code units of the letter (or combining mark) at text[i], 0 if it is none.
+qsizetype letterAt(QStringView text, qsizetype i) {
+    const QChar c = text.at(i);
+    if (c.isHighSurrogate() && i + 1 < text.size() && text.at(i + 1).isLowSurrogate()) {
+        const char32_t ucs4 = QChar::surrogateToUcs4(c, text.at(i + 1));
+        return QChar::isLetter(ucs4) || QChar::isMark(ucs4) ? 2 : 0;
+    }
+    return c.isLetter() || c.isMark() ? 1 : 0;
+}
+
+} // namespace
+
+SpellChecker::SpellChecker(const SubtitleStore &store, QObject *parent) : QObject(parent), store_(store) {
+    connect(&job_, &QFutureWatcher<QVector<Words>>::finished, this, &SpellChecker::jobFinished);
+}
+
+SpellChecker::~SpellChecker() {
+    job_.waitForFinished();
+}
+
+SpellChecker::Words SpellChecker::misspellings(const SpellDictionary &dictionary, QStringView text) {
+    Words out;
+    const qsizetype n = text.size();
+    qsizetype i = 0;
+    while (i < n) {
+        const QChar c = text.at(i);
+        // <i>, </font> and ASS override blocks are not text
+        if (c == u'<' || c == u'{') {
+            const qsizetype close = text.indexOf(c == u'<' ? u'>' : u'}', i + 1);
+            if (close >= 0) {
+                i = close + 1;
+                continue;
+            }
+        }
+        if (!letterAt(text, i) && !c.isDigit()) {
+            ++i;
+            continue;
+        }
+        // letters, digits, and apostrophes followed by a letter ("don't")
+        const qsizetype begin = i;
+        bool digits = false;
+        while (i < n) {
+            const QChar d = text.at(i);
+            if (const qsizetype units = letterAt(text, i)) {
+                i += units;
+            } else if (d.isDigit()) {
+                digits = true;
+                ++i;
+            } else if ((d == u'\'' || d == u'\u2019') && i + 1 < n && letterAt(text, i + 1)) {
+                ++i;
+            } else {
+                break;
+            }
+        }
+        // "3rd", "MP3": not words a dictionary holds
+        if (digits) continue;
+        if (!dictionary.check(text.mid(begin, i - begin))) out.append(Word { int(begin), int(i - begin) });
+    }
+    return out;
+}
+
+void SpellChecker::setDictionary(std::shared_ptr<const SpellDictionary> dictionary) {
+    dictionary_ = std::move(dictionary);
+    words_.clear();
+    ++generation_; // a running check used the previous dictionary
+    if (dictionary_) checkAll();
+}
+
+void SpellChecker::clear() {
+    words_.clear();
+    ++generation_;
+    pending_ = false;
+}
+
+void SpellChecker::checkAll() {
+    if (!dictionary_) return;
+    // rows keep their current words until the new ones are in
+    words_.resize(store_.size());
+    // one job at a time; a check asked for meanwhile starts after it
+    if (job_.isRunning()) {
+        pending_ = true;
+        return;
+    }
+    startJob();
+}
+
+void SpellChecker::startJob() {
+    jobGeneration_ = generation_;
+    recheckedDuringJob_.fill(false, store_.size());
+    // copies only: the store's data is shared until its next edit
+    job_.setFuture(QtConcurrent::run([store = store_, dictionary = dictionary_] {
+        TRACE_SCOPE("SpellChecker::checkAll");
+        QVector<Words> out(store.size());
+        QVector<QPair<int, int>> chunks;
+        for (int r = 0; r < store.size(); r += ChunkRows)
+            chunks.append({ r, qMin(int(store.size()) - 1, r + ChunkRows - 1) });
+        // chunks write disjoint slots
+        Words *words = out.data();
+        QtConcurrent::blockingMap(chunks, [&](const QPair<int, int> &chunk) {
+            for (int r = chunk.first; r <= chunk.second; ++r)
+                words[r] = misspellings(*dictionary, store.textView(r));
+        });
+        return out;
+    }));
+}
+
+void SpellChecker::jobFinished() {
+    const bool current = jobGeneration_ == generation_;
+    if (current) {
+        QVector<Words> result = job_.result();
+        for (qsizetype r = 0; r < result.size() && r < words_.size(); ++r) {
+            if (!recheckedDuringJob_.at(r)) words_[r] = std::move(result[r]);
+        }
+    }
+    job_.setFuture(QFuture<QVector<Words>>()); // drop the copy the future holds
+    recheckedDuringJob_.clear();
+    if (std::exchange(pending_, false) && dictionary_) startJob();
+    if (current) emit finished();
+}
+
+void SpellChecker::insertRows(int first, int count, bool check) {
+    if (!dictionary_) return;
+    words_.insert(first, count, Words());
+    if (check) {
+        for (int r = first; r < first + count; ++r) words_[r] = misspellings(*dictionary_, store_.textView(r));
+    }
+    // the running check's rows no longer line up: check again after it
+    ++generation_;
+    if (job_.isRunning()) pending_ = true;
+}
+
+void SpellChecker::removeRows(int first, int count) {
+    if (!dictionary_ || first >= words_.size()) return;
+    words_.remove(first, qMin(count, int(words_.size()) - first));
+    ++generation_;
+    if (job_.isRunning()) pending_ = true;
+}
+
+bool SpellChecker::recheck(int row) {
+    if (!dictionary_ || row < 0 || row >= words_.size()) return false;
+    if (row < recheckedDuringJob_.size()) recheckedDuringJob_[row] = true;
+    Words words = misspellings(*dictionary_, store_.textView(row));
+    if (words == words_.at(row)) return false;
+    words_[row] = std::move(words);
+    return true;
+}
+
+const SpellChecker::Words &SpellChecker::words(int row) const {
+    static const Words none;
+    return row >= 0 && row < words_.size() ? words_.at(row) : none;
+}
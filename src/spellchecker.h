@@ -0,0 +1,71 @@
+#pragma once
+#include <QFutureWatcher>
+#include <QObject>
+#include <QVector>
+#include <memory>
+#include "spelldictionary.h"
+#include "subtitlestore.h"
+
+// Misspelled words of every row of a SubtitleStore, against a
+// SpellDictionary. A full check runs on the thread pool over a snapshot of
+// the store (after a load, or when the dictionary changes); edits re-check
+// the rows they touch on the spot, which costs a few lookups per word. The
+// results are kept per row, so painting never looks words up.
+class SpellChecker : public QObject {
+    Q_OBJECT
+public:
+    // Position of a word in the cue text.
+    struct Word {
+        int start;
+        int length;
+
+        bool operator==(const Word &) const = default;
+    };
+    using Words = QVector<Word>;
+
+    explicit SpellChecker(const SubtitleStore &store, QObject *parent = nullptr);
+    ~SpellChecker() override;
+
+    // Words of 'text' the dictionary does not hold. Markup (<i>, {\an8}) and
+    // words with digits are skipped; apostrophes inside a word are part of it.
+    static Words misspellings(const SpellDictionary &dictionary, QStringView text);
+
+    // Null turns checking off. Starts a full check.
+    void setDictionary(std::shared_ptr<const SpellDictionary> dictionary);
+    const std::shared_ptr<const SpellDictionary> &dictionary() const { return dictionary_; }
+
+    // Forgets every row (the store was cleared).
+    void clear();
+    // Checks every row in the background; finished() once the results are
+    // in. Rows edited meanwhile keep the results of their own re-check.
+    void checkAll();
+    bool isChecking() const { return job_.isRunning(); }
+    // Rows [first, first + count) were inserted in / removed from the store.
+    // Inserted rows are checked now, unless 'check' is false (a load appends
+    // them unchecked and calls checkAll() at the end).
+    void insertRows(int first, int count, bool check = true);
+    void removeRows(int first, int count);
+    // The text of 'row' changed; true if its misspellings did.
+    bool recheck(int row);
+
+    const Words &words(int row) const;
+
+signals:
+    // A full check finished: any row's words may have changed.
+    void finished();
+
+private:
+    void startJob();
+    void jobFinished();
+
+    const SubtitleStore &store_;
+    std::shared_ptr<const SpellDictionary> dictionary_;
+    QVector<Words> words_; // by row; empty when checking is off
+    QFutureWatcher<QVector<Words>> job_;
+    // bumped by row insertions and removals: the rows a running job checks
+    // are then not the rows of the store any more
+    quint64 generation_ = 0;
+    quint64 jobGeneration_ = 0;
+    bool pending_ = false; // checkAll() or row changes while a job ran
+    QVector<bool> recheckedDuringJob_;
+};
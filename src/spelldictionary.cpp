@@ -0,0 +1,638 @@
+#include "spelldictionary.h"
+#include "hashing.h"
+#include "textencoding.h"
+#include "trace.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QStringDecoder>
+#include <QVector>
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+constexpr quint32 Magic = 0x53534431; // "SSD1"
+constexpr quint16 Version = 1;
+constexpr quint16 ByteOrderMark = 0xFEFF;
+
+struct Header {
+    quint32 magic;
+    quint16 version;
+    quint16 byteOrder;
+    quint64 sourceKey; // of the .aff and .dic, see sourceKey()
+    quint32 words;
+    quint32 root;
+    quint32 edges;
+    quint32 reserved;
+};
+static_assert(sizeof(Header) == 32);
+
+using Edge = SpellDictionary::Edge;
+using Flag = quint32;
+using Flags = QVector<Flag>;
+constexpr Flag NoFlag = 0xFFFFFFFFu;
+
+QString affPathFor(const QString &dicPath) {
+    const QFileInfo info(dicPath);
+    return info.path() + u'/' + info.completeBaseName() + QStringLiteral(".aff");
+}
+
+// Paths, sizes and modification times of the two files.
+quint64 sourceKey(const QString &dicPath) {
+    QByteArray key;
+    for (const QString &path : { dicPath, affPathFor(dicPath) }) {
+        const QFileInfo info(path);
+        key += info.absoluteFilePath().toUtf8() + '\0' + QByteArray::number(info.size()) + '\0'
+               + QByteArray::number(info.lastModified().toMSecsSinceEpoch()) + '\0';
+    }
+    return hash64(key.constData(), key.size());
+}
+
+// Decodes a dictionary file in its SET encoding, named the Hunspell way
+// ("ISO8859-1", "microsoft-cp1251").
+bool decode(const QByteArray &bytes, QByteArray set, QString &out) {
+    set = set.trimmed();
+    if (set.isEmpty()) set = "ISO8859-1"; // Hunspell's default
+    if (set.startsWith("ISO8859")) set.insert(3, '-');
+    else if (set.startsWith("microsoft-cp")) set = "windows-" + set.mid(12);
+    switch (TextEncoding::kindForName(set)) {
+    case TextEncoding::Utf8:
+        out = QString::fromUtf8(bytes);
+        return true;
+    case TextEncoding::Latin1:
+        out = QString::fromLatin1(bytes);
+        return true;
+    case TextEncoding::Windows1252: {
+        const char16_t *upper = TextEncoding::upperHalf(TextEncoding::Windows1252);
+        out.resize(bytes.size());
+        QChar *d = out.data();
+        for (qsizetype i = 0; i < bytes.size(); ++i) {
+            const uchar c = uchar(bytes.at(i));
+            d[i] = c < 0x80 ? QChar(c) : QChar(upper[c - 0x80]);
+        }
+        return true;
+    }
+    default:
+        break;
+    }
+    QStringDecoder decoder(set.constData());
+    if (!decoder.isValid()) return false;
+    out = decoder(bytes);
+    return !decoder.hasError();
+}
+
+// Whitespace-separated fields of a line.
+QVector<QStringView> fields(QStringView line) {
+    QVector<QStringView> out;
+    qsizetype i = 0;
+    while (i < line.size()) {
+        while (i < line.size() && line.at(i).isSpace()) ++i;
+        const qsizetype begin = i;
+        while (i < line.size() && !line.at(i).isSpace()) ++i;
+        if (i > begin) out.append(line.mid(begin, i - begin));
+    }
+    return out;
+}
+
+// One position of an affix condition: a character class, or any character.
+struct CharClass {
+    QString chars;
+    bool negated = false;
+    bool any = false;
+
+    bool matches(QChar c) const { return any || chars.contains(c) != negated; }
+};
+
+struct AffixEntry {
+    QString strip;
+    QString add;
+    Flags continuation; // classes that may follow this affix
+    QVector<CharClass> condition;
+};
+
+struct AffixClass {
+    bool prefix = false;
+    bool cross = false; // combines with affixes of the other kind
+    QVector<AffixEntry> entries;
+};
+
+QVector<CharClass> parseCondition(QStringView s) {
+    QVector<CharClass> out;
+    if (s == u".") return out;
+    for (qsizetype i = 0; i < s.size(); ++i) {
+        CharClass c;
+        if (s.at(i) == u'[') {
+            qsizetype close = s.indexOf(u']', i + 1);
+            if (close < 0) close = s.size();
+            QStringView set = s.mid(i + 1, close - i - 1);
+            if (set.startsWith(u'^')) {
+                c.negated = true;
+                set = set.mid(1);
+            }
+            c.chars = set.toString();
+            i = close;
+        } else if (s.at(i) == u'.') {
+            c.any = true;
+        } else {
+            c.chars = s.at(i);
+        }
+        out.append(c);
+    }
+    return out;
+}
+
+// The parts of a .aff file that decide which forms a stem has.
+class AffixRules {
+public:
+    void parse(QStringView aff);
+    Flags parseFlags(QStringView s) const;
+    // Every form of 'stem' with 'flags', appended to 'out'.
+    void expand(const QString &stem, const Flags &flags, QVector<QString> &out) const;
+
+    Flag forbidden = NoFlag;
+
+private:
+    enum class FlagMode { Char, Long, Number, Utf8 };
+
+    Flag parseFlag(QStringView s) const {
+        const Flags f = parseFlags(s);
+        return f.isEmpty() ? NoFlag : f.first();
+    }
+    static bool applies(const AffixClass &c, const AffixEntry &e, QStringView word);
+    static QString apply(const AffixClass &c, const AffixEntry &e, QStringView word);
+    // Forms of the affixed 'form' made by the classes in 'continuation'.
+    void continueWith(const QString &form, const Flags &continuation, QVector<QString> &out) const;
+
+    FlagMode mode_ = FlagMode::Char;
+    QVector<Flags> aliases_; // AF: flag sets referred to by number
+    QHash<Flag, AffixClass> classes_;
+    Flag needAffix_ = NoFlag;
+    Flag onlyInCompound_ = NoFlag;
+};
+
+void AffixRules::parse(QStringView aff) {
+    // FLAG and AF first: the affix lines are read with them
+    QVector<Flags> aliases;
+    bool aliasCount = true;
+    for (QStringView line : aff.tokenize(u'\n')) {
+        const QVector<QStringView> f = fields(line);
+        if (f.size() < 2) continue;
+        if (f.at(0) == u"FLAG") {
+            if (f.at(1) == u"long") mode_ = FlagMode::Long;
+            else if (f.at(1) == u"num") mode_ = FlagMode::Number;
+            else if (f.at(1) == u"UTF-8") mode_ = FlagMode::Utf8;
+        } else if (f.at(0) == u"AF") {
+            // the first AF line is the count
+            if (!std::exchange(aliasCount, false)) aliases.append(parseFlags(f.at(1)));
+        }
+    }
+    for (QStringView line : aff.tokenize(u'\n')) {
+        const QVector<QStringView> f = fields(line);
+        if (f.size() < 2) continue;
+        const QStringView key = f.at(0);
+        if (key == u"NEEDAFFIX" || key == u"PSEUDOROOT") {
+            needAffix_ = parseFlag(f.at(1));
+        } else if (key == u"ONLYINCOMPOUND") {
+            onlyInCompound_ = parseFlag(f.at(1));
+        } else if (key == u"FORBIDDENWORD") {
+            forbidden = parseFlag(f.at(1));
+        } else if ((key == u"PFX" || key == u"SFX") && f.size() >= 4) {
+            const Flag flag = parseFlag(f.at(1));
+            auto it = classes_.find(flag);
+            if (it == classes_.end()) {
+                // header: PFX flag cross-product count
+                AffixClass c;
+                c.prefix = key == u"PFX";
+                c.cross = f.at(2) == u"Y";
+                classes_.insert(flag, c);
+                continue;
+            }
+            // entry: PFX flag strip add[/flags] [condition]
+            AffixEntry e;
+            if (f.at(2) != u"0") e.strip = f.at(2).toString();
+            QStringView add = f.at(3);
+            if (const qsizetype slash = add.indexOf(u'/'); slash >= 0) {
+                // aliases apply to the continuation classes too
+                aliases_ = aliases;
+                e.continuation = parseFlags(add.mid(slash + 1));
+                aliases_.clear();
+                add = add.left(slash);
+            }
+            if (add != u"0") e.add = add.toString();
+            e.condition = parseCondition(f.size() > 4 ? f.at(4) : QStringView(u"."));
+            it->entries.append(e);
+        }
+    }
+    aliases_ = aliases;
+}
+
+Flags AffixRules::parseFlags(QStringView s) const {
+    Flags out;
+    if (!aliases_.isEmpty()) {
+        bool ok = false;
+        const int n = s.toInt(&ok);
+        if (ok && n >= 1 && n <= aliases_.size()) return aliases_.at(n - 1);
+    }
+    switch (mode_) {
+    case FlagMode::Long:
+        for (qsizetype i = 0; i < s.size(); i += 2)
+            out.append(Flag(s.at(i).unicode()) << 16 | (i + 1 < s.size() ? s.at(i + 1).unicode() : 0));
+        break;
+    case FlagMode::Number:
+        for (QStringView n : s.tokenize(u',')) {
+            bool ok = false;
+            const uint v = n.toUInt(&ok);
+            if (ok) out.append(v);
+        }
+        break;
+    case FlagMode::Utf8:
+        for (qsizetype i = 0; i < s.size(); ++i) {
+            if (s.at(i).isHighSurrogate() && i + 1 < s.size() && s.at(i + 1).isLowSurrogate()) {
+                out.append(QChar::surrogateToUcs4(s.at(i), s.at(i + 1)));
+                ++i;
+            } else {
+                out.append(s.at(i).unicode());
+            }
+        }
+        break;
+    case FlagMode::Char:
+        for (QChar c : s) out.append(c.unicode());
+        break;
+    }
+    return out;
+}
+
+bool AffixRules::applies(const AffixClass &c, const AffixEntry &e, QStringView word) {
+    const qsizetype n = e.condition.size();
+    if (word.size() <= e.strip.size() && e.add.isEmpty()) return false;
+    if (word.size() < qMax(n, e.strip.size())) return false;
+    if (c.prefix) {
+        if (!word.startsWith(e.strip)) return false;
+        for (qsizetype i = 0; i < n; ++i) {
+            if (!e.condition.at(i).matches(word.at(i))) return false;
+        }
+    } else {
+        if (!word.endsWith(e.strip)) return false;
+        const qsizetype from = word.size() - n;
+        for (qsizetype i = 0; i < n; ++i) {
+            if (!e.condition.at(i).matches(word.at(from + i))) return false;
+        }
+    }
+    return true;
+}
+
+QString AffixRules::apply(const AffixClass &c, const AffixEntry &e, QStringView word) {
+    if (c.prefix) return e.add + word.mid(e.strip.size()).toString();
+    return word.chopped(e.strip.size()).toString() + e.add;
+}
+
+void AffixRules::continueWith(const QString &form, const Flags &continuation, QVector<QString> &out) const {
+    for (Flag flag : continuation) {
+        const auto it = classes_.constFind(flag);
+        if (it == classes_.cend()) continue;
+        for (const AffixEntry &e : it->entries) {
+            if (applies(*it, e, form)) out.append(apply(*it, e, form));
+        }
+    }
+}
+
+void AffixRules::expand(const QString &stem, const Flags &flags, QVector<QString> &out) const {
+    if (!flags.contains(needAffix_) && !flags.contains(onlyInCompound_)) out.append(stem);
+
+    // suffixes first: cross products put prefixes on the suffixed forms
+    QVector<QString> crossForms;
+    for (Flag flag : flags) {
+        const auto it = classes_.constFind(flag);
+        if (it == classes_.cend() || it->prefix) continue;
+        for (const AffixEntry &e : it->entries) {
+            if (!applies(*it, e, stem)) continue;
+            const QString form = apply(*it, e, stem);
+            if (!e.continuation.contains(needAffix_) && !e.continuation.contains(onlyInCompound_))
+                out.append(form);
+            continueWith(form, e.continuation, out);
+            if (it->cross) crossForms.append(form);
+        }
+    }
+    for (Flag flag : flags) {
+        const auto it = classes_.constFind(flag);
+        if (it == classes_.cend() || !it->prefix) continue;
+        for (const AffixEntry &e : it->entries) {
+            if (!applies(*it, e, stem)) continue;
+            const QString form = apply(*it, e, stem);
+            if (!e.continuation.contains(needAffix_) && !e.continuation.contains(onlyInCompound_))
+                out.append(form);
+            continueWith(form, e.continuation, out);
+            if (!it->cross) continue;
+            for (const QString &suffixed : std::as_const(crossForms)) {
+                if (applies(*it, e, suffixed)) out.append(apply(*it, e, suffixed));
+            }
+        }
+    }
+}
+
+// Word and flag field of a .dic line ("word/flags\tmorphology"); "\/" is a
+// slash in the word.
+void splitEntry(QStringView line, QString &word, QStringView &flags) {
+    word.clear();
+    flags = QStringView();
+    qsizetype i = 0;
+    for (; i < line.size(); ++i) {
+        const QChar c = line.at(i);
+        if (c == u'\\' && i + 1 < line.size() && line.at(i + 1) == u'/') {
+            word += u'/';
+            ++i;
+        } else if (c == u'/') {
+            qsizetype end = i + 1;
+            while (end < line.size() && !line.at(end).isSpace()) ++end;
+            flags = line.mid(i + 1, end - i - 1);
+            return;
+        } else if (c.isSpace()) {
+            return;
+        } else {
+            word += c;
+        }
+    }
+}
+
+// Incremental construction of the minimal automaton from words in
+// ascending order (Daciuk et al.): the nodes past the prefix a word shares
+// with the previous one are complete, and are merged with an equal node
+// already written, or written, before the word's own nodes are added. The
+// automaton never holds more than the minimal one plus one word's path.
+class DawgBuilder {
+public:
+    DawgBuilder() {
+        edges_.append(Edge { 0, 0, 0 }); // index 0 is never a node: targets of 0 mean "none"
+        path_.resize(1);
+    }
+
+    void add(QStringView word) {
+        qsizetype common = 0;
+        while (common < word.size() && common < last_.size() && word.at(common) == last_.at(common)) ++common;
+        freezePath(common + 1);
+        for (qsizetype i = common; i < word.size(); ++i) {
+            path_[i].append(Edge { 0, word.at(i).unicode(), 0 });
+            path_.append(QVector<Edge>());
+        }
+        path_[word.size() - 1].last().flags |= SpellDictionary::FinalEdge;
+        last_ = word.toString();
+    }
+
+    // The root; 0 when no word was added.
+    quint32 finish() {
+        freezePath(1);
+        return freeze(path_[0]);
+    }
+
+    const QVector<Edge> &edges() const { return edges_; }
+
+private:
+    void freezePath(qsizetype depth) {
+        while (path_.size() > depth) {
+            QVector<Edge> node = path_.takeLast();
+            path_.last().last().target = freeze(node);
+        }
+    }
+
+    quint32 freeze(QVector<Edge> &node) {
+        if (node.isEmpty()) return 0;
+        node.last().flags |= SpellDictionary::LastEdge;
+        // the edges (labels, targets, finality) are the node's whole identity
+        const QByteArray key(reinterpret_cast<const char *>(node.constData()), node.size() * qsizetype(sizeof(Edge)));
+        const auto it = register_.constFind(key);
+        if (it != register_.cend()) return *it;
+        const quint32 at = quint32(edges_.size());
+        edges_.append(node);
+        register_.insert(key, at);
+        return at;
+    }
+
+    QVector<Edge> edges_;
+    QVector<QVector<Edge>> path_; // nodes of the last word's path, root first
+    QString last_;
+    QHash<QByteArray, quint32> register_;
+};
+
+bool buildEdges(const QByteArray &affBytes, const QByteArray &dicBytes, QByteArray &edges,
+                quint32 &root, quint32 &words) {
+    TRACE_SCOPE("SpellDictionary::build");
+    // SET names the encoding of both files; it is ASCII in any of them
+    QByteArray set;
+    qsizetype at = affBytes.startsWith("SET ") ? 0 : affBytes.indexOf("\nSET ");
+    if (at >= 0) {
+        at = affBytes.indexOf(' ', at + 1) + 1;
+        const qsizetype end = affBytes.indexOf('\n', at);
+        set = affBytes.mid(at, end < 0 ? -1 : end - at).trimmed();
+    }
+    QString aff;
+    QString dic;
+    if (!decode(affBytes, set, aff) || !decode(dicBytes, set, dic)) return false;
+
+    AffixRules rules;
+    rules.parse(aff);
+    QVector<QString> forms;
+    QSet<QString> forbidden;
+    QString word;
+    QStringView flagField;
+    bool first = true;
+    for (QStringView line : QStringView(dic).tokenize(u'\n')) {
+        // the first line is the approximate word count
+        if (std::exchange(first, false)) continue;
+        if (line.isEmpty() || line.front().isSpace()) continue;
+        splitEntry(line, word, flagField);
+        if (word.isEmpty()) continue;
+        const Flags flags = rules.parseFlags(flagField);
+        if (flags.contains(rules.forbidden)) {
+            forbidden.insert(word);
+            continue;
+        }
+        rules.expand(word, flags, forms);
+    }
+
+    // code unit order: the order lookups walk the edges in
+    std::sort(forms.begin(), forms.end(), [](const QString &a, const QString &b) {
+        return std::lexicographical_compare(a.utf16(), a.utf16() + a.size(), b.utf16(), b.utf16() + b.size());
+    });
+    DawgBuilder builder;
+    words = 0;
+    const QString *previous = nullptr;
+    for (const QString &form : std::as_const(forms)) {
+        if (form.isEmpty() || (previous && form == *previous) || forbidden.contains(form)) continue;
+        builder.add(form);
+        previous = &form;
+        ++words;
+    }
+    root = builder.finish();
+    const QVector<Edge> &built = builder.edges();
+    edges = QByteArray(reinterpret_cast<const char *>(built.constData()), built.size() * qsizetype(sizeof(Edge)));
+    return true;
+}
+
+} // namespace
+
+QString SpellDictionary::cacheFilePath(const QString &dicPath) {
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/spell/")
+         + QFileInfo(dicPath).completeBaseName() + u'-' + QString::number(sourceKey(dicPath), 16)
+         + QStringLiteral(".dawg");
+}
+
+bool SpellDictionary::load(const QString &dicPath) {
+    TRACE_SCOPE("SpellDictionary::load");
+    const quint64 key = sourceKey(dicPath);
+    const QString cachePath = cacheFilePath(dicPath);
+    file_.close();
+    owned_.clear();
+    edges_ = nullptr;
+    edgeCount_ = 0;
+    name_ = QFileInfo(dicPath).completeBaseName();
+
+    file_.setFileName(cachePath);
+    if (file_.open(QIODevice::ReadOnly) && file_.size() >= qint64(sizeof(Header))) {
+        if (const uchar *p = file_.map(0, file_.size())) {
+            Header h;
+            std::memcpy(&h, p, sizeof(h));
+            if (h.magic == Magic && h.version == Version && h.byteOrder == ByteOrderMark
+                && h.sourceKey == key
+                && file_.size() == qint64(sizeof(Header)) + qint64(h.edges) * qint64(sizeof(Edge))
+                && setEdges(reinterpret_cast<const char *>(p + sizeof(Header)), h.edges, h.root, h.words)) {
+                return true;
+            }
+        }
+    }
+    file_.close(); // also unmaps
+
+    // a miss: build from the files, and cache the result for the next run
+    QFile dic(dicPath);
+    QFile aff(affPathFor(dicPath));
+    if (!dic.open(QIODevice::ReadOnly) || !aff.open(QIODevice::ReadOnly)) return false;
+    QByteArray edges;
+    quint32 root = 0;
+    quint32 words = 0;
+    if (!buildEdges(aff.readAll(), dic.readAll(), edges, root, words)) return false;
+    owned_ = std::move(edges);
+    if (!setEdges(owned_.constData(), quint32(owned_.size() / qsizetype(sizeof(Edge))), root, words)) return false;
+
+    if (!QDir().mkpath(QFileInfo(cachePath).absolutePath())) return true;
+    Header h;
+    h.magic = Magic;
+    h.version = Version;
+    h.byteOrder = ByteOrderMark;
+    h.sourceKey = key;
+    h.words = words_;
+    h.root = root_;
+    h.edges = edgeCount_;
+    h.reserved = 0;
+    QSaveFile f(cachePath);
+    if (!f.open(QIODevice::WriteOnly)) return true;
+    if (f.write(reinterpret_cast<const char *>(&h), sizeof(h)) != qint64(sizeof(h))
+        || f.write(owned_) != owned_.size()) {
+        f.cancelWriting();
+        return true;
+    }
+    f.commit();
+    return true;
+}
+
+bool SpellDictionary::build(const QByteArray &aff, const QByteArray &dic) {
+    file_.close();
+    name_.clear();
+    edges_ = nullptr;
+    edgeCount_ = 0;
+    quint32 root = 0;
+    quint32 words = 0;
+    if (!buildEdges(aff, dic, owned_, root, words)) return false;
+    return setEdges(owned_.constData(), quint32(owned_.size() / qsizetype(sizeof(Edge))), root, words);
+}
+
+bool SpellDictionary::setEdges(const char *data, quint32 count, quint32 root, quint32 words) {
+    const auto *edges = reinterpret_cast<const Edge *>(data);
+    // every node ends before the array does, so lookups stay inside it
+    if (count == 0 || root >= count || (count > 1 && !(edges[count - 1].flags & LastEdge))) return false;
+    edges_ = edges;
+    edgeCount_ = count;
+    root_ = root;
+    words_ = words;
+    return true;
+}
+
+bool SpellDictionary::contains(QStringView word) const {
+    if (!edges_ || word.isEmpty()) return false;
+    quint32 node = root_;
+    bool final = false;
+    for (QChar c : word) {
+        if (node == 0 || node >= edgeCount_) return false;
+        const char16_t label = c.unicode();
+        const Edge *e = edges_ + node;
+        while (e->label != label) {
+            // labels ascend within a node
+            if (e->label > label || (e->flags & LastEdge)) return false;
+            ++e;
+        }
+        final = e->flags & FinalEdge;
+        node = e->target;
+    }
+    return final;
+}
+
+bool SpellDictionary::check(QStringView word) const {
+    if (contains(word)) return true;
+    if (word.contains(u'\u2019')) {
+        QString ascii = word.toString();
+        ascii.replace(u'\u2019', u'\'');
+        return check(ascii);
+    }
+    qsizetype upper = 0;
+    qsizetype lower = 0;
+    for (QChar c : word) {
+        if (c.isUpper()) ++upper;
+        else if (c.isLower()) ++lower;
+    }
+    if (upper == 0) return false;
+    const QString lowered = word.toString().toLower();
+    // "Word" at the start of a sentence
+    if (upper == 1 && word.front().isUpper()) return contains(lowered);
+    // "WORD": a lowercase word or a name
+    if (lower == 0) {
+        if (contains(lowered)) return true;
+        QString capitalized = lowered;
+        capitalized[0] = capitalized.at(0).toUpper();
+        return contains(capitalized);
+    }
+    return false;
+}
+
+QStringList SpellDictionary::searchPaths() {
+    QStringList paths;
+    for (const QString &dir : QStandardPaths::standardLocations(QStandardPaths::GenericDataLocation)) {
+        paths << dir + QStringLiteral("/hunspell") << dir + QStringLiteral("/myspell")
+              << dir + QStringLiteral("/myspell/dicts");
+    }
+    paths << QCoreApplication::applicationDirPath() + QStringLiteral("/dictionaries");
+    return paths;
+}
+
+QString SpellDictionary::find(const QString &language) {
+    const QStringList paths = searchPaths();
+    for (const QString &dir : paths) {
+        const QString path = dir + u'/' + language + QStringLiteral(".dic");
+        if (QFileInfo::exists(path) && QFileInfo::exists(affPathFor(path))) return path;
+    }
+    // another variant of the language
+    const QString prefix = language.section(u'_', 0, 0);
+    for (const QString &dir : paths) {
+        const QStringList names = QDir(dir).entryList({ prefix + QStringLiteral(".dic"), prefix + QStringLiteral("_*.dic") },
+                                                      QDir::Files, QDir::Name);
+        for (const QString &name : names) {
+            const QString path = dir + u'/' + name;
+            if (QFileInfo::exists(affPathFor(path))) return path;
+        }
+    }
+    return QString();
+}
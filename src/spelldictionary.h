@@ -0,0 +1,74 @@
+#pragma once
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+
+// Word list of a Hunspell dictionary (a .dic and the .aff next to it) for
+// spell checking. Every form the affix rules produce is expanded once and
+// stored as a minimal acyclic automaton (DAWG): words sharing a prefix share
+// its edges and words sharing an ending share its tail, so a few hundred
+// thousand forms take a few megabytes. The automaton is written to the user
+// cache directory and later runs memory-map it from there: only the pages
+// lookups touch are read, and nothing is parsed.
+//
+// The .aff subset read: SET, FLAG (long, num, UTF-8), AF, PFX/SFX with cross
+// products and one level of continuation classes, NEEDAFFIX, ONLYINCOMPOUND
+// and FORBIDDENWORD. Compound rules are not supported: compounds the word
+// list does not hold are reported as misspelled.
+//
+// Lookups only read the automaton: one dictionary can serve any number of
+// threads.
+class SpellDictionary {
+public:
+    // Loads the dictionary at 'dicPath', from the cache when one was built
+    // from the same two files. False if they cannot be read or decoded.
+    bool load(const QString &dicPath);
+    // Builds the automaton from the contents of a .aff and a .dic file,
+    // without the cache.
+    bool build(const QByteArray &aff, const QByteArray &dic);
+    bool isValid() const { return edges_ != nullptr; }
+    // Base name of the .dic file ("en_US"); empty when built in memory.
+    QString name() const { return name_; }
+    int wordCount() const { return int(words_); }
+    // Size of the automaton (mapped or in memory).
+    qsizetype byteSize() const { return qsizetype(edgeCount_) * qsizetype(sizeof(Edge)); }
+
+    // True if 'word' is one of the forms, as written.
+    bool contains(QStringView word) const;
+    // Spell check of one word: its form as written, or, for a capitalized
+    // or all-capitals word, its lowercase (and capitalized) form. Typographic
+    // apostrophes match ASCII ones.
+    bool check(QStringView word) const;
+
+    // Directories searched for installed dictionaries.
+    static QStringList searchPaths();
+    // Installed .dic for 'language' ("en_US", else any "en_*"); empty if none.
+    static QString find(const QString &language);
+    // Cache entry of the automaton of 'dicPath'; named after the paths, sizes
+    // and times of the two files, so editing either one builds a new entry.
+    static QString cacheFilePath(const QString &dicPath);
+
+    // One outgoing edge of the automaton. A node is a run of edges in label
+    // order, the last one flagged; 'target' is the first edge of the node
+    // the edge leads to, 0 when no word continues past it.
+    struct Edge {
+        quint32 target;
+        char16_t label;
+        quint16 flags;
+    };
+    enum EdgeFlag : quint16 { LastEdge = 1, FinalEdge = 2 }; // FinalEdge: a word ends here
+    static_assert(sizeof(Edge) == 8);
+
+private:
+    bool setEdges(const char *data, quint32 count, quint32 root, quint32 words);
+
+    QString name_;
+    QFile file_;       // the mapped cache file
+    QByteArray owned_; // the edges, when not mapped
+    const Edge *edges_ = nullptr;
+    quint32 edgeCount_ = 0;
+    quint32 root_ = 0;
+    quint32 words_ = 0;
+};
@@ -0,0 +1,20 @@
+#include "spellhighlighter.h"
+#include "appsettings.h"
+#include "spellchecker.h"
+#include <QTextCharFormat>
+
+SpellHighlighter::SpellHighlighter(QTextDocument *document) : QSyntaxHighlighter(document) {}
+
+void SpellHighlighter::setDictionary(std::shared_ptr<const SpellDictionary> dictionary) {
+    dictionary_ = std::move(dictionary);
+    rehighlight();
+}
+
+void SpellHighlighter::highlightBlock(const QString &text) {
+    if (!dictionary_) return;
+    QTextCharFormat format;
+    format.setUnderlineStyle(QTextCharFormat::SpellCheckUnderline);
+    format.setUnderlineColor(AppSettings::instance()->misspellingColour());
+    for (const SpellChecker::Word &word : SpellChecker::misspellings(*dictionary_, text))
+        setFormat(word.start, word.length, format);
+}
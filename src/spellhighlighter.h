@@ -0,0 +1,21 @@
+#pragma once
+#include <QSyntaxHighlighter>
+#include <memory>
+#include "spelldictionary.h"
+
+// Underlines the misspelled words of the cue being edited. Lines are checked
+// as they change, straight against the dictionary: a line is a few lookups.
+class SpellHighlighter : public QSyntaxHighlighter {
+    Q_OBJECT
+public:
+    explicit SpellHighlighter(QTextDocument *document);
+
+    // Null turns the underlines off.
+    void setDictionary(std::shared_ptr<const SpellDictionary> dictionary);
+
+protected:
+    void highlightBlock(const QString &text) override;
+
+private:
+    std::shared_ptr<const SpellDictionary> dictionary_;
+};
@@ -0,0 +1,180 @@
+#include "srtblockindex.h"
+#include "hashing.h"
+#include "srtparser.h"
+#include "texttokenizer.h"
+#include "trace.h"
+#include <QtConcurrent>
+
+namespace {
+
+using namespace TextScan;
+
+// Whether the text [begin, end) ends right after a blank line (or is empty):
+// the parser state every block starts in.
+template<typename Unit, typename Decoder>
+bool endsAfterBlankLine(const Unit *begin, const Unit *end, const Decoder &decoder) {
+    if (end == begin) return true;
+    if (end[-1] != '\n') return false;
+    const Unit *line = end - 1;
+    while (line > begin && line[-1] != '\n') --line;
+    return isBlank(line, end - 1, decoder);
+}
+
+bool endsAfterBlankLine(const char *begin, const char *end, TextEncoding::Kind kind) {
+    bool blank = false;
+    withUnits(begin, end, kind, [&blank](auto b, auto e, auto decoder) {
+        blank = endsAfterBlankLine(b, e, decoder);
+    });
+    return blank;
+}
+
+} // namespace
+
+bool SrtBlockIndex::build(const char *data, qsizetype size, const TextFormat &format) {
+    TRACE_SCOPE("SrtBlockIndex::build");
+    clear();
+    const TextEncoding::Kind kind = TextEncoding::kindForName(format.encoding);
+    // other encodings are converted, and UTF-16 in the other byte order
+    // swapped, before they are scanned: the cues do not map back to the bytes
+    if (kind == TextEncoding::Other || (isUtf16(kind) && kind != TextEncoding::HostUtf16)) return false;
+    const qsizetype bom = TextEncoding::bomLength(kind, data, size);
+    if (isUtf16(kind) && (size - bom) % 2) return false;
+
+    format_ = format;
+    kind_ = kind;
+    size_ = size - bom;
+    const char *begin = data + bom;
+    blocks_ = parseBlocks(begin, begin, begin + size_, 0, nullptr);
+    valid_ = true;
+    return true;
+}
+
+void SrtBlockIndex::clear() {
+    blocks_.clear();
+    size_ = 0;
+    format_ = TextFormat();
+    kind_ = TextEncoding::Utf8;
+    valid_ = false;
+}
+
+int SrtBlockIndex::cueCount() const {
+    int count = 0;
+    for (const Block &b : blocks_) count += b.cues;
+    return count;
+}
+
+QVector<SrtBlockIndex::Block> SrtBlockIndex::parseBlocks(const char *base, const char *begin, const char *end,
+                                                         int fallbackCounter, SubtitleStore *cues) const {
+    if (begin == end) return {};
+    struct Parsed {
+        Block block;
+        SubtitleStore cues;
+        QVector<int> fallbackRows;
+    };
+    const TextEncoding::Kind kind = kind_;
+    const bool keep = cues != nullptr;
+    const QVector<SrtParser::Chunk> chunks = SrtParser::splitChunks(begin, end, BlockSize, kind);
+    QVector<Parsed> parsed = QtConcurrent::blockingMapped<QVector<Parsed>>(chunks,
+            [base, kind, keep](const SrtParser::Chunk &chunk) {
+        Parsed p;
+        const qsizetype size = chunk.second - chunk.first;
+        int fallbacks = 0;
+        SrtParser::parse(chunk.first, chunk.second, p.cues, fallbacks, keep ? &p.fallbackRows : nullptr, kind);
+        p.block = { chunk.first - base, size, hash64(chunk.first, size), int(p.cues.size()), fallbacks };
+        if (!keep) p.cues = SubtitleStore(); // only counted
+        return p;
+    });
+
+    QVector<Block> blocks;
+    blocks.reserve(parsed.size());
+    for (Parsed &p : parsed) {
+        if (cues) {
+            // numbered from 0 per block, as in SrtParser::parseChunks
+            for (int row : std::as_const(p.fallbackRows))
+                p.cues.setLineNumber(row, p.cues.lineNumber(row) + fallbackCounter);
+            cues->append(p.cues);
+        }
+        fallbackCounter += p.block.fallbacks;
+        blocks.append(p.block);
+    }
+    return blocks;
+}
+
+bool SrtBlockIndex::update(const char *data, qsizetype size, Change &change) {
+    TRACE_SCOPE("SrtBlockIndex::update");
+    if (!valid_) return false;
+    const qsizetype bom = TextEncoding::bomLength(kind_, data, size);
+    if ((bom > 0) != format_.byteOrderMark) return false;
+    const char *begin = data + bom;
+    const qsizetype newSize = size - bom;
+    if (isUtf16(kind_) && newSize % 2) return false;
+    auto unchanged = [begin](const Block &b, qsizetype offset) {
+        return hash64(begin + offset, b.size) == b.hash;
+    };
+
+    // unchanged blocks from the front; the last one must still end its last
+    // cue (text appended to a file without a final blank line continues it)
+    qsizetype front = 0;
+    qsizetype spanBegin = 0;
+    int frontRows = 0;
+    int frontFallbacks = 0;
+    for (; front < blocks_.size(); ++front) {
+        const Block &b = blocks_.at(front);
+        const qsizetype blockEnd = b.offset + b.size;
+        if (blockEnd > newSize || !unchanged(b, b.offset)) break;
+        if (blockEnd < newSize && !endsAfterBlankLine(begin, begin + blockEnd, kind_)) break;
+        spanBegin = blockEnd;
+        frontRows += b.cues;
+        frontFallbacks += b.fallbacks;
+    }
+
+    // then from the back, at the same distance from the end of the file
+    const qsizetype delta = newSize - size_;
+    qsizetype back = blocks_.size(); // blocks_[back, end) are unchanged
+    while (back > front) {
+        const Block &b = blocks_.at(back - 1);
+        const qsizetype offset = b.offset + delta;
+        if (offset < spanBegin || !unchanged(b, offset)) break;
+        --back;
+    }
+    // the changed span must end after a blank line, where the unchanged tail
+    // starts parsing; otherwise the tail's first lines may belong to its last cue
+    auto spanEnd = [&] { return back < blocks_.size() ? blocks_.at(back).offset + delta : newSize; };
+    while (back < blocks_.size() && !endsAfterBlankLine(begin, begin + spanEnd(), kind_)) ++back;
+
+    // only the span is decoded: check it reads in the indexed encoding
+    const qsizetype spanSize = spanEnd() - spanBegin;
+    if (kind_ == TextEncoding::Utf8 && TextEncoding::validUtf8Prefix(begin + spanBegin, spanSize) != spanSize)
+        return false;
+
+    change = Change();
+    change.firstRow = frontRows;
+    QVector<Block> span = parseBlocks(begin, begin + spanBegin, begin + spanBegin + spanSize,
+                                      frontFallbacks, &change.cues);
+    // unnumbered cues of the tail are numbered after those of the span: if
+    // the span now has more or fewer, the tail is parsed again too
+    int oldFallbacks = 0;
+    int tailFallbacks = 0;
+    int newFallbacks = 0;
+    for (qsizetype i = front; i < back; ++i) oldFallbacks += blocks_.at(i).fallbacks;
+    for (qsizetype i = back; i < blocks_.size(); ++i) tailFallbacks += blocks_.at(i).fallbacks;
+    for (const Block &b : std::as_const(span)) newFallbacks += b.fallbacks;
+    if (tailFallbacks > 0 && newFallbacks != oldFallbacks) {
+        span += parseBlocks(begin, begin + spanBegin + spanSize, begin + newSize,
+                            frontFallbacks + newFallbacks, &change.cues);
+        back = blocks_.size();
+    }
+    for (qsizetype i = front; i < back; ++i) change.removedRows += blocks_.at(i).cues;
+
+    QVector<Block> blocks = blocks_.mid(0, front);
+    blocks.reserve(front + span.size() + (blocks_.size() - back));
+    blocks += span;
+    for (qsizetype i = back; i < blocks_.size(); ++i) {
+        Block b = blocks_.at(i);
+        b.offset += delta;
+        blocks.append(b);
+    }
+    blocks_ = std::move(blocks);
+    size_ = newSize;
+    return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <QVector>
+#include "subtitlestore.h"
+#include "textencoding.h"
+
+// Hashes of an SRT file in cue-aligned blocks (see SrtParser::splitChunks),
+// with the number of cues in each, so that a new version of the file can be
+// read incrementally: the blocks whose bytes are unchanged, found from both
+// ends of the file, keep their cues and only the span between them is parsed
+// again. Unchanged bytes are only hashed, so the parsing (and the model
+// updates after it) cost what the change costs.
+class SrtBlockIndex {
+public:
+    // Rows [firstRow, firstRow + removedRows) of the indexed version are
+    // replaced by 'cues'.
+    struct Change {
+        int firstRow = 0;
+        int removedRows = 0;
+        SubtitleStore cues;
+
+        bool isEmpty() const { return removedRows == 0 && cues.isEmpty(); }
+    };
+
+    // Target size of a block; a block ends after the first blank line past it.
+    static constexpr qsizetype BlockSize = 64 * 1024;
+
+    // Indexes 'data', a whole SRT file in 'format' (as TextEncoding::detect
+    // found it). False, leaving the index invalid, for encodings the SRT
+    // scanner does not read in place.
+    bool build(const char *data, qsizetype size, const TextFormat &format);
+    bool isValid() const { return valid_; }
+    void clear();
+    const TextFormat &format() const { return format_; }
+    int cueCount() const;
+
+    // Compares 'data', a new version of the indexed file, with the indexed
+    // one and parses the bytes that changed into 'change'; the index then
+    // describes 'data'. False when the new version does not read the same
+    // way (byte order mark or encoding changed): read the whole file then.
+    bool update(const char *data, qsizetype size, Change &change);
+
+private:
+    struct Block {
+        qsizetype offset; // from the end of the byte order mark
+        qsizetype size;
+        quint64 hash;
+        int cues;
+        int fallbacks; // cues numbered by the parser's fallback counter
+    };
+    // Parses the blocks of [begin, end) (positions relative to 'base') in
+    // parallel; appends the cues to 'cues' if given.
+    QVector<Block> parseBlocks(const char *base, const char *begin, const char *end,
+                               int fallbackCounter, SubtitleStore *cues) const;
+
+    QVector<Block> blocks_;
+    qsizetype size_ = 0; // bytes after the byte order mark
+    TextFormat format_;
+    TextEncoding::Kind kind_ = TextEncoding::Utf8;
+    bool valid_ = false;
+};
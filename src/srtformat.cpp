@@ -0,0 +1,57 @@
+#include "srtformat.h"
+#include "srtparser.h"
+#include "srtwriter.h"
+#include "subtitlemarkup.h"
+#include <charconv>
+#include <cstring>
+
+void SrtFormat::read(const char *begin, const char *end, TextEncoding::Kind encoding,
+                     SubtitleStore &out) const
+{
+    int fallbackCounter = 0;
+    SrtParser::parseParallel(begin, end, out, fallbackCounter, encoding);
+}
+
+void SrtFormat::write(SrtWriter &writer, const SubtitleStore &store) const {
+    const bool crlf = writer.options().crlf;
+    const char *eol = crlf ? "\r\n" : "\n";
+    const size_t eolSize = crlf ? 2 : 1;
+    const bool layout = store.hasLayout();
+    // ASS comment events have no place in SubRip; when there are any, the
+    // cues written are numbered 1, 2, 3... so the numbers leave no gaps
+    bool renumber = false;
+    for (qsizetype i = 0; layout && !renumber && i < store.size(); ++i) renumber = store.layout(i).comment;
+    const bool overrides = SubtitleMarkup::usesOverrides(store);
+    QString converted;
+    int written = 0;
+
+    for (qsizetype i = 0; i < store.size() && !writer.failed(); ++i) {
+        if (layout && store.layout(i).comment) continue;
+        ++written;
+        // index (the original lineNumber when present; otherwise i+1) and
+        // the timing line, formatted into one small stack buffer
+        char line[96];
+        char *p = line;
+        const int idx = renumber ? written : (store.lineNumber(i) > 0) ? store.lineNumber(i) : int(i + 1);
+        p = std::to_chars(p, line + 16, idx).ptr;
+        std::memcpy(p, eol, eolSize);
+        p += eolSize;
+        p = SubtitleStore::formatTime(store.startMs(i), p);
+        std::memcpy(p, " --> ", 5);
+        p += 5;
+        p = SubtitleStore::formatTime(store.endMs(i), p);
+        std::memcpy(p, eol, eolSize);
+        p += eolSize;
+        writer.appendAscii(line, p - line);
+
+        QStringView text = store.textView(i);
+        if (overrides && SubtitleMarkup::needsTags(text, Srt)) {
+            SubtitleMarkup::toTags(text, Srt, converted);
+            text = converted;
+        }
+        writer.appendText(text);
+
+        // end of the text line plus the blank separator
+        writer.appendAscii(crlf ? "\r\n\r\n" : "\n\n", qsizetype(2 * eolSize));
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "subtitleformat.h"
+
+// SubRip. Reading is SrtParser::parseParallel; the side tables are left
+// alone, so an SRT document never allocates them.
+class SrtFormat : public SubtitleFormat {
+public:
+    Id id() const override { return Srt; }
+    QString name() const override { return QStringLiteral("SubRip"); }
+    QString key() const override { return QStringLiteral("srt"); }
+    QStringList suffixes() const override { return { QStringLiteral("srt"), QStringLiteral("str") }; }
+    bool sniff(QStringView) const override { return false; }
+    void read(const char *begin, const char *end, TextEncoding::Kind encoding,
+              SubtitleStore &out) const override;
+    void write(SrtWriter &writer, const SubtitleStore &store) const override;
+};
@@ -0,0 +1,242 @@
+#include "srtparser.h"
+#include "texttokenizer.h"
+#include "trace.h"
+#include <QThreadPool>
+#include <QtConcurrent>
+
+namespace {
+
+using namespace TextScan;
+
+// SrtParser::TimingLine for any code unit.
+template<typename Unit>
+struct Timing {
+    const Unit *startBegin = nullptr;
+    const Unit *startEnd = nullptr;
+    const Unit *endBegin = nullptr;
+    const Unit *endEnd = nullptr;
+    int startMs = 0;
+    int endMs = 0;
+};
+
+template<typename Unit, typename Decoder>
+bool scanTiming(const Unit *begin, const Unit *end, Timing<Unit> &t, const Decoder &decoder) {
+    const Unit *p = begin;
+    while (end - p >= 3) {
+        const Unit *arrow = findUnit(p, end, Unit('-'));
+        if (!arrow || end - arrow < 3) return false;
+        p = arrow + 1;
+        if (arrow[1] != '-' || arrow[2] != '>') continue;
+
+        // left side: HH:MM:SS[,.]d{1,3} followed only by whitespace up to the arrow
+        const Unit *l = arrow;
+        l = skipSpaceBack(begin, l, decoder);
+        int fracDigits = 0;
+        while (fracDigits < 4 && l - fracDigits > begin && isDigit(l[-fracDigits - 1])) ++fracDigits;
+        if (fracDigits < 1 || fracDigits > 3) continue;
+        if (l - begin < fracDigits + 1 + 8) continue;
+        const Unit *sep = l - fracDigits - 1;
+        if (!isFractionSeparator(*sep) || !isClock(sep - 8)) continue;
+
+        // right side: whitespace, then HH:MM:SS[,.]d{1,3} (greedy)
+        const Unit *r = arrow + 3;
+        r = skipSpace(r, end, decoder);
+        if (end - r < 10 || !isClock(r) || !isFractionSeparator(r[8]) || !isDigit(r[9])) continue;
+        int rDigits = 1;
+        while (rDigits < 3 && r + 9 + rDigits < end && isDigit(r[9 + rDigits])) ++rDigits;
+
+        t.startBegin = sep - 8;
+        t.startEnd = l;
+        t.endBegin = r;
+        t.endEnd = r + 9 + rDigits;
+        t.startMs = clockMs(sep - 8) + fractionMs(sep + 1, fracDigits);
+        t.endMs = clockMs(r) + fractionMs(r + 9, rDigits);
+        return true;
+    }
+    return false;
+}
+
+template<typename Unit, typename Decoder>
+void parseUnits(const Unit *begin, const Unit *end, SubtitleStore &out, int &fallbackCounter,
+                QVector<int> *fallbackRows, Decoder decoder)
+{
+    enum State { ExpectIndex, ExpectTime, ExpectText } state = ExpectIndex;
+    int lineNumber = 0;
+    int startMs = SubtitleStore::NoTime;
+    int endMs = SubtitleStore::NoTime;
+    bool isFallback = false;
+    // cue text is kept as a raw span and decoded once when the cue ends
+    const Unit *textBegin = nullptr;
+    const Unit *textEnd = nullptr;
+
+    auto finishCue = [&] {
+        const qsizetype len = textBegin ? textEnd - textBegin : 0;
+        QChar *text = out.beginText(decoder.requiredSpace(len));
+        QChar *written = text;
+        if (len > 0) {
+            written = decoder.append(text, textBegin, len);
+            if (findUnit(textBegin, textEnd, Unit('\r'))) written = foldCrLf(text, written);
+        }
+        if (isFallback && fallbackRows) fallbackRows->append(int(out.size()));
+        out.commitCue(lineNumber, startMs, endMs, written);
+        startMs = endMs = SubtitleStore::NoTime;
+        isFallback = false;
+        textBegin = textEnd = nullptr;
+    };
+
+    const Unit *p = begin;
+    while (p < end) {
+        const Unit *next;
+        const Unit *le = lineEnd(p, end, next);
+
+        if (isBlank(p, le, decoder)) {
+            if (state == ExpectText) finishCue();
+            state = ExpectIndex;
+        } else if (state == ExpectIndex) {
+            int num;
+            isFallback = !parseInt(p, le, num, decoder);
+            lineNumber = isFallback ? ++fallbackCounter : num;
+            startMs = endMs = SubtitleStore::NoTime;
+            state = ExpectTime;
+        } else if (state == ExpectTime) {
+            Timing<Unit> t;
+            if (scanTiming(p, le, t, decoder)) {
+                startMs = t.startMs;
+                endMs = t.endMs;
+            }
+            state = ExpectText;
+        } else {
+            if (!textBegin) textBegin = p;
+            textEnd = le;
+        }
+        p = next;
+    }
+
+    if (state == ExpectText && textBegin) finishCue();
+}
+
+template<typename Unit, typename Decoder>
+QVector<SrtParser::Chunk> splitUnits(const Unit *begin, const Unit *end, qsizetype chunkUnits,
+                                     const Decoder &decoder)
+{
+    QVector<SrtParser::Chunk> chunks;
+    auto bytes = [](const Unit *p) { return reinterpret_cast<const char *>(p); };
+    const Unit *chunkBegin = begin;
+    while (end - chunkBegin > chunkUnits) {
+        // start at the first full line after the target size and stop after
+        // the first blank line found from there
+        const Unit *p = findUnit(chunkBegin + chunkUnits, end, Unit('\n'));
+        const Unit *cut = end;
+        while (p && ++p < end) {
+            const Unit *next;
+            const Unit *le = lineEnd(p, end, next);
+            if (isBlank(p, le, decoder)) {
+                cut = next;
+                break;
+            }
+            p = next - 1;
+        }
+        if (cut >= end) break;
+        chunks.append(qMakePair(bytes(chunkBegin), bytes(cut)));
+        chunkBegin = cut;
+    }
+    chunks.append(qMakePair(bytes(chunkBegin), bytes(end)));
+    return chunks;
+}
+
+} // namespace
+
+bool SrtParser::scanTimingLine(const char *begin, const char *end, TimingLine &t) {
+    static const Utf8Text utf8;
+    Timing<char> timing;
+    if (!scanTiming(begin, end, timing, utf8)) return false;
+    t.startBegin = timing.startBegin;
+    t.startEnd = timing.startEnd;
+    t.endBegin = timing.endBegin;
+    t.endEnd = timing.endEnd;
+    t.startMs = timing.startMs;
+    t.endMs = timing.endMs;
+    return true;
+}
+
+void SrtParser::parse(const char *begin, const char *end,
+                      SubtitleStore &out, int &fallbackCounter,
+                      QVector<int> *fallbackRows, TextEncoding::Kind encoding)
+{
+    TRACE_SCOPE("SrtParser::parse");
+    withUnits(begin, end, encoding, [&](auto b, auto e, auto decoder) {
+        parseUnits(b, e, out, fallbackCounter, fallbackRows, decoder);
+    });
+}
+
+QVector<SrtParser::Chunk> SrtParser::splitChunks(const char *begin, const char *end, qsizetype chunkSize,
+                                                 TextEncoding::Kind encoding)
+{
+    QVector<Chunk> chunks;
+    withUnits(begin, end, encoding, [&](auto b, auto e, auto decoder) {
+        const qsizetype chunkUnits = qMax<qsizetype>(1, chunkSize / qsizetype(sizeof(*b)));
+        chunks = splitUnits(b, e, chunkUnits, decoder);
+    });
+    return chunks;
+}
+
+qsizetype SrtParser::parallelChunkSize(qsizetype size) {
+    constexpr qsizetype MinChunkSize = 1024 * 1024;
+    // a few chunks per thread so an uneven chunk does not stall the pool
+    const int threads = QThreadPool::globalInstance()->maxThreadCount();
+    return qMax(MinChunkSize, size / (qsizetype(qMax(1, threads)) * 4));
+}
+
+void SrtParser::parseChunks(const QVector<Chunk> &chunks, int &fallbackCounter, int wave,
+                            const ChunkSink &sink, TextEncoding::Kind encoding)
+{
+    struct ChunkResult {
+        SubtitleStore cues;
+        QVector<int> fallbackRows;
+        int fallbackCount = 0;
+        const char *end = nullptr;
+    };
+    auto parseOne = [encoding](const Chunk &chunk) {
+        ChunkResult r;
+        const qsizetype bytes = chunk.second - chunk.first;
+        r.cues.reserve(bytes / 48, bytes / 2); // ~48 bytes per cue on typical files
+        parse(chunk.first, chunk.second, r.cues, r.fallbackCount, &r.fallbackRows, encoding);
+        r.end = chunk.second;
+        return r;
+    };
+
+    wave = qMax(1, wave);
+    for (qsizetype first = 0; first < chunks.size(); first += wave) {
+        const QVector<Chunk> slice = chunks.mid(first, wave);
+        QVector<ChunkResult> results = QtConcurrent::blockingMapped<QVector<ChunkResult>>(slice, parseOne);
+
+        // fallback numbers were counted per chunk from 0, so shift them by the
+        // fallbacks consumed in all earlier chunks
+        for (ChunkResult &r : results) {
+            for (int row : r.fallbackRows) r.cues.setLineNumber(row, r.cues.lineNumber(row) + fallbackCounter);
+            fallbackCounter += r.fallbackCount;
+            if (!sink(std::move(r.cues), r.end)) return;
+        }
+    }
+}
+
+void SrtParser::parseParallel(const char *begin, const char *end,
+                              SubtitleStore &out, int &fallbackCounter, TextEncoding::Kind encoding)
+{
+    // below this a single thread is faster than the split/stitch overhead
+    constexpr qsizetype ParallelThreshold = 4 * 1024 * 1024;
+
+    const qsizetype size = end - begin;
+    if (size < ParallelThreshold || QThreadPool::globalInstance()->maxThreadCount() < 2) {
+        parse(begin, end, out, fallbackCounter, nullptr, encoding);
+        return;
+    }
+
+    const QVector<Chunk> chunks = splitChunks(begin, end, parallelChunkSize(size), encoding);
+    parseChunks(chunks, fallbackCounter, int(chunks.size()),
+                [&out](SubtitleStore &&cues, const char *) {
+                    out.append(cues);
+                    return true;
+                },
+                encoding);
+}
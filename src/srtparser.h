@@ -0,0 +1,72 @@
+#pragma once
+#include <QPair>
+#include <QVector>
+#include <functional>
+#include "subtitlestore.h"
+#include "textencoding.h"
+
+// Byte-level SRT scanner. It works directly on a (usually memory-mapped)
+// buffer and only decodes the cue text, straight into the store's text arena;
+// indices and timings are scanned by hand instead of going through
+// QTextStream/QRegularExpression. UTF-8, Windows-1252, Latin-1 and UTF-16 in
+// the host byte order are scanned as they are, so decoding happens in the
+// same pass as the line splitting; chunk pointers stay byte pointers.
+//
+// The state machine is the one loadSrt always had: blank (whitespace-only)
+// lines end a cue, a non-numeric index line gets a fallback number, ',' and
+// '.' both accepted as the millisecond separator. Callers skip the byte order
+// mark (TextEncoding::bomLength).
+class SrtParser {
+public:
+    using Chunk = QPair<const char *, const char *>;
+    // Receives the cues of one chunk and the end of that chunk in the buffer;
+    // returning false stops the parse.
+    using ChunkSink = std::function<bool(SubtitleStore &&cues, const char *chunkEnd)>;
+
+    // Spans of "HH:MM:SS,mmm --> HH:MM:SS,mmm" inside a line, plus the values
+    // in milliseconds.
+    struct TimingLine {
+        const char *startBegin = nullptr;
+        const char *startEnd = nullptr;
+        const char *endBegin = nullptr;
+        const char *endEnd = nullptr;
+        int startMs = 0;
+        int endMs = 0;
+    };
+
+    // Parses [begin, end) and appends the cues to 'out'. Cues whose index line
+    // is not a number get lineNumber = ++fallbackCounter. When 'fallbackRows'
+    // is given, the positions in 'out' of those cues are appended to it.
+    // Cues without a timing line get SubtitleStore::NoTime.
+    // 'encoding' must not be TextEncoding::Other; UTF-16 must be HostUtf16.
+    static void parse(const char *begin, const char *end,
+                      SubtitleStore &out, int &fallbackCounter,
+                      QVector<int> *fallbackRows = nullptr,
+                      TextEncoding::Kind encoding = TextEncoding::Utf8);
+
+    // Same result as parse(), but large buffers are split at blank lines and
+    // the chunks are parsed on the global thread pool, then stitched in order.
+    static void parseParallel(const char *begin, const char *end,
+                              SubtitleStore &out, int &fallbackCounter,
+                              TextEncoding::Kind encoding = TextEncoding::Utf8);
+
+    // Splits [begin, end) into chunks of about 'chunkSize' bytes. Every chunk
+    // except the last ends right after a blank line, so each one starts in the
+    // "expect index" state and can be parsed on its own.
+    static QVector<Chunk> splitChunks(const char *begin, const char *end, qsizetype chunkSize,
+                                      TextEncoding::Kind encoding = TextEncoding::Utf8);
+
+    // Parses 'chunks' on the global thread pool, 'wave' chunks at a time, and
+    // hands each chunk's cues to 'sink' in file order with the fallback
+    // numbers already continued from 'fallbackCounter'.
+    static void parseChunks(const QVector<Chunk> &chunks, int &fallbackCounter, int wave,
+                            const ChunkSink &sink, TextEncoding::Kind encoding = TextEncoding::Utf8);
+
+    // Chunk size that gives every pool thread a few chunks of a 'size' buffer.
+    static qsizetype parallelChunkSize(qsizetype size);
+
+    // Finds the first timing arrow in [begin, end) of an ASCII-compatible
+    // line. Same matching rules as the old regex:
+    // \d{2}:\d{2}:\d{2}[,.]\d{1,3}\s*-->\s*\d{2}:\d{2}:\d{2}[,.]\d{1,3}
+    static bool scanTimingLine(const char *begin, const char *end, TimingLine &t);
+};
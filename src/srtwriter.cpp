@@ -0,0 +1,154 @@
+#include "srtwriter.h"
+#include "textencoding.h"
+#include <QIODevice>
+#include <cstring>
+
+namespace {
+
+constexpr qsizetype BufferSize = 1024 * 1024;
+// UTF-16 units of unencodable characters kept for the message.
+constexpr qsizetype MaxUnencodable = 64;
+
+} // namespace
+
+SrtWriter::SrtWriter(const SrtWriteOptions &options)
+    : options_(options), encoder_(options.encoding.constData())
+{
+    const TextEncoding::Kind kind = TextEncoding::kindForName(options.encoding);
+    if (kind == TextEncoding::Windows1252 || kind == TextEncoding::Latin1) {
+        singleByte_ = TextEncoding::upperHalf(kind);
+        asciiCompatible_ = true;
+        return;
+    }
+    // UTF-8, Latin-1 and friends encode the digits, separators and line
+    // breaks as themselves; UTF-16/32 need everything to go through encoder_
+    const char16_t probe[] = u"0123456789:,-> \r\n";
+    QStringEncoder test(options.encoding.constData());
+    asciiCompatible_ = test.isValid()
+                       && QByteArray(test(QStringView(probe))) == QByteArrayView("0123456789:,-> \r\n");
+}
+
+char *SrtWriter::reserve(qsizetype bytes) {
+    if (used_ + bytes > buffer_.size()) {
+        flush();
+        if (bytes > buffer_.size()) buffer_.resize(bytes);
+    }
+    return buffer_.data() + used_;
+}
+
+void SrtWriter::flush() {
+    if (used_ > 0 && !failed_)
+        failed_ = device_->write(buffer_.constData(), used_) != used_;
+    used_ = 0;
+}
+
+void SrtWriter::noteUnencodable(QStringView character) {
+    if (unencodable_.size() + character.size() <= MaxUnencodable && !unencodable_.contains(character))
+        unencodable_.append(character);
+}
+
+void SrtWriter::findUnencodable(QStringView text) {
+    QStringEncoder probe(options_.encoding.constData());
+    for (qsizetype i = 0; i < text.size();) {
+        const qsizetype units = text.at(i).isHighSurrogate() && i + 1 < text.size()
+                                        && text.at(i + 1).isLowSurrogate() ? 2 : 1;
+        const QStringView character = text.sliced(i, units);
+        const QByteArray bytes = probe(character);
+        if (probe.hasError()) {
+            noteUnencodable(character);
+            probe.resetState();
+        }
+        i += units;
+    }
+}
+
+void SrtWriter::appendSingleByte(QStringView text) {
+    char *out = reserve(text.size());
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        const char16_t c = text.at(i).unicode();
+        char byte = '?'; // not in the code page
+        if (c < 0x80 || (c >= 0xA0 && c <= 0xFF)) {
+            byte = char(c); // both code pages agree with Latin-1 here
+        } else {
+            for (int k = 0; k < 32; ++k) {
+                if (singleByte_[k] == c) {
+                    byte = char(0x80 + k);
+                    break;
+                }
+            }
+        }
+        if (byte == '?' && c != u'?') {
+            // a surrogate pair is one character, written as "??"
+            const bool pair = QChar::isHighSurrogate(c) && i + 1 < text.size() && text.at(i + 1).isLowSurrogate();
+            noteUnencodable(text.sliced(i, pair ? 2 : 1));
+            if (pair) {
+                *out++ = byte;
+                ++i;
+            }
+        }
+        *out++ = byte;
+    }
+    used_ += text.size();
+}
+
+void SrtWriter::appendEncoded(QStringView text) {
+    if (singleByte_) {
+        appendSingleByte(text);
+        return;
+    }
+    char *out = reserve(encoder_.requiredSpace(text.size()));
+    used_ += encoder_.appendToBuffer(out, text) - out;
+    // the encoder writes a replacement and keeps going; its error flag
+    // stays set, so it is cleared for the next text
+    if (encoder_.hasError()) {
+        findUnencodable(text);
+        encoder_.resetState();
+    }
+}
+
+void SrtWriter::appendAscii(const char *s, qsizetype n) {
+    if (asciiCompatible_) {
+        std::memcpy(reserve(n), s, size_t(n));
+        used_ += n;
+        return;
+    }
+    char16_t wide[64];
+    for (qsizetype from = 0; from < n; from += 64) {
+        const qsizetype count = qMin<qsizetype>(64, n - from);
+        for (qsizetype i = 0; i < count; ++i) wide[i] = char16_t(uchar(s[from + i]));
+        appendEncoded(QStringView(wide, count));
+    }
+}
+
+void SrtWriter::appendText(QStringView text) {
+    // text lines are stored with '\n' separators
+    if (!options_.crlf) {
+        appendEncoded(text);
+        return;
+    }
+    qsizetype from = 0;
+    for (qsizetype nl; (nl = text.indexOf(u'\n', from)) >= 0; from = nl + 1) {
+        appendEncoded(text.sliced(from, nl - from));
+        appendAscii("\r\n", 2);
+    }
+    appendEncoded(text.sliced(from));
+}
+
+bool SrtWriter::write(QIODevice *device, const SubtitleStore &store) {
+    if (!isValid()) return false;
+    device_ = device;
+    failed_ = false;
+    unencodable_.clear();
+    encoder_.resetState();
+    used_ = 0;
+    if (buffer_.size() < BufferSize) buffer_.resize(BufferSize);
+
+    if (options_.byteOrderMark && !singleByte_) {
+        const QChar bom = QChar::ByteOrderMark;
+        appendEncoded(QStringView(&bom, 1));
+    }
+    SubtitleFormat::get(options_.format).write(*this, store);
+    flush();
+    device_ = nullptr;
+    return !failed_ && unencodable_.isEmpty();
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <QByteArray>
+#include <QString>
+#include <QStringEncoder>
+#include "subtitleformat.h"
+#include "subtitlestore.h"
+
+class QIODevice;
+
+struct SrtWriteOptions {
+    QByteArray encoding = "UTF-8";
+    bool byteOrderMark = false;
+    bool crlf = false;
+    SubtitleFormat::Id format = SubtitleFormat::Srt;
+
+    bool operator==(const SrtWriteOptions &) const = default;
+};
+
+// Serializes a SubtitleStore into one reusable buffer, as SubRip or in the
+// format of options().format. Numbers and timings are formatted in place and
+// cue text is encoded straight out of the store's arena, so nothing is
+// allocated per cue. The buffer goes to the device whenever it fills up and
+// is kept for the next write().
+class SrtWriter {
+public:
+    explicit SrtWriter(const SrtWriteOptions &options = {});
+
+    bool isValid() const { return singleByte_ || encoder_.isValid(); }
+    const SrtWriteOptions &options() const { return options_; }
+    bool write(QIODevice *device, const SubtitleStore &store);
+
+    // Building blocks for SubtitleFormat::write().
+    void appendAscii(const char *s, qsizetype n);
+    // Text as it is, no line break translation.
+    void appendEncoded(QStringView text);
+    // Text whose '\n' line breaks become the configured line ending.
+    void appendText(QStringView text);
+    void appendLineBreak() { options_.crlf ? appendAscii("\r\n", 2) : appendAscii("\n", 1); }
+    // True once the device refused data; writers may stop early.
+    bool failed() const { return failed_; }
+    // Characters of the last write() the encoding has no bytes for, each
+    // once (the first few dozen). write() fails when there are any: the
+    // file would hold '?' in their place.
+    const QString &unencodable() const { return unencodable_; }
+
+private:
+    char *reserve(qsizetype bytes); // room for 'bytes' more, flushing if needed
+    void appendSingleByte(QStringView text);
+    void noteUnencodable(QStringView character);
+    // Finds the characters of 'text' encoder_ could not encode.
+    void findUnencodable(QStringView text);
+    void flush();
+
+    SrtWriteOptions options_;
+    QStringEncoder encoder_;
+    // Windows-1252 and Latin-1 are encoded here (Qt only has Windows-1252
+    // with ICU); characters of bytes 0x80..0xFF, else null
+    const char16_t *singleByte_ = nullptr;
+    bool asciiCompatible_ = false; // ASCII bytes can be copied as they are
+    QByteArray buffer_;
+    qsizetype used_ = 0;
+    QIODevice *device_ = nullptr;
+    bool failed_ = false;
+    QString unencodable_;
+};
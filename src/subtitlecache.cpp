@@ -0,0 +1,177 @@
+#include "subtitlecache.h"
+#include "hashing.h"
+#include "trace.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <cstring>
+
+namespace {
+
+constexpr quint32 Magic = 0x53534331; // "SSC1"
+// Bump whenever the layout or the meaning of a column (e.g. how CPS is
+// computed) changes.
+constexpr quint16 Version = 3;
+constexpr quint16 ByteOrderMark = 0xFEFF;
+
+struct Header {
+    quint32 magic;
+    quint16 version;
+    quint16 byteOrder;
+    qint64 documentSize;
+    qint64 documentMtime;
+    quint64 contentHash;
+    qint64 cues;
+    qint64 arenaChars;
+    quint32 cpsRules;     // packed CpsOptions the character counts were made with
+    quint32 reserved;
+};
+static_assert(sizeof(Header) == 56);
+
+// Columns stored as int32 arrays, in this order, after the header.
+constexpr int IntColumns = 6;
+
+quint32 packCpsRules(const CpsOptions &options) {
+    return (options.countSpaces ? 1u : 0u) | (options.countLineBreaks ? 2u : 0u);
+}
+
+qint64 expectedSize(qint64 cues, qint64 arenaChars) {
+    return qint64(sizeof(Header)) + cues * IntColumns * qint64(sizeof(qint32))
+         + arenaChars * qint64(sizeof(QChar));
+}
+
+template <typename T>
+bool writeArray(QSaveFile &f, const QVector<T> &v) {
+    const qint64 bytes = v.size() * qint64(sizeof(T));
+    return f.write(reinterpret_cast<const char *>(v.constData()), bytes) == bytes;
+}
+
+template <typename T>
+const uchar *readArray(const uchar *p, QVector<T> &v, qsizetype n) {
+    v.resize(n);
+    std::memcpy(v.data(), p, n * sizeof(T));
+    return p + n * sizeof(T);
+}
+
+} // namespace
+
+SubtitleCache::Key SubtitleCache::keyFor(const QString &path, const char *data, qint64 size) {
+    const QFileInfo fi(path);
+    Key key;
+    key.path = fi.absoluteFilePath();
+    key.size = size;
+    key.mtimeMs = fi.lastModified().toMSecsSinceEpoch();
+    key.contentHash = hash64(data, size);
+    return key;
+}
+
+QString SubtitleCache::cacheFilePath(const QString &path) {
+    const QByteArray utf8 = QFileInfo(path).absoluteFilePath().toUtf8();
+    const QString name = QString::number(hash64(utf8.constData(), utf8.size()), 16);
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+         + QStringLiteral("/cues/") + name + QStringLiteral(".ssc");
+}
+
+bool SubtitleCache::load(const Key &key, SubtitleStore &out) {
+    TRACE_SCOPE("SubtitleCache::load");
+    QFile f(cacheFilePath(key.path));
+    if (!f.open(QIODevice::ReadOnly) || f.size() < qint64(sizeof(Header))) return false;
+    const uchar *p = f.map(0, f.size());
+    if (!p) return false;
+
+    Header h;
+    std::memcpy(&h, p, sizeof(h));
+    if (h.magic != Magic || h.version != Version || h.byteOrder != ByteOrderMark
+        || h.documentSize != key.size || h.documentMtime != key.mtimeMs
+        || h.contentHash != key.contentHash
+        || h.cpsRules != packCpsRules(SubtitleStore::cpsOptions()) || h.cues < 0 || h.arenaChars < 0
+        || f.size() != expectedSize(h.cues, h.arenaChars)) {
+        return false;
+    }
+
+    SubtitleStore s;
+    const qsizetype n = qsizetype(h.cues);
+    p += sizeof(Header);
+    p = readArray(p, s.lineNumbers_, n);
+    p = readArray(p, s.startMs_, n);
+    p = readArray(p, s.endMs_, n);
+    p = readArray(p, s.cps_, n);
+    p = readArray(p, s.chars_, n);
+    p = readArray(p, s.textLengths_, n);
+    s.arena_.resize(qsizetype(h.arenaChars));
+    std::memcpy(s.arena_.data(), p, h.arenaChars * sizeof(QChar));
+
+    // the text is stored in row order, so the offsets are a running sum;
+    // a corrupt length must not point any row outside the arena
+    s.textOffsets_.resize(n);
+    qsizetype offset = 0;
+    for (qsizetype i = 0; i < n; ++i) {
+        const int length = s.textLengths_.at(i);
+        if (length < 0 || length > s.arena_.size() - offset) return false;
+        s.textOffsets_[i] = offset;
+        offset += length;
+    }
+    if (offset != s.arena_.size()) return false;
+    s.liveChars_ = offset;
+    out = std::move(s);
+    return true;
+}
+
+bool SubtitleCache::save(const Key &key, const SubtitleStore &store) {
+    TRACE_SCOPE("SubtitleCache::save");
+    if (store.hasLayout() || !store.header().isEmpty() || !store.footer().isEmpty()) return false;
+    const QString path = cacheFilePath(key.path);
+    if (!QDir().mkpath(QFileInfo(path).absolutePath())) return false;
+
+    Header h;
+    h.magic = Magic;
+    h.version = Version;
+    h.byteOrder = ByteOrderMark;
+    h.documentSize = key.size;
+    h.documentMtime = key.mtimeMs;
+    h.contentHash = key.contentHash;
+    h.cues = store.size();
+    h.arenaChars = store.liveChars_;
+    h.cpsRules = packCpsRules(SubtitleStore::cpsOptions());
+    h.reserved = 0;
+
+    QSaveFile f(path);
+    if (!f.open(QIODevice::WriteOnly)) return false;
+    bool ok = f.write(reinterpret_cast<const char *>(&h), sizeof(h)) == qint64(sizeof(h))
+              && writeArray(f, store.lineNumbers_) && writeArray(f, store.startMs_)
+              && writeArray(f, store.endMs_) && writeArray(f, store.cps_)
+              && writeArray(f, store.chars_)
+              && writeArray(f, store.textLengths_);
+    // row by row: edits and inserts leave the arena out of row order
+    for (qsizetype i = 0; ok && i < store.size(); ++i) {
+        const QStringView text = store.textView(i);
+        const qint64 bytes = text.size() * qint64(sizeof(QChar));
+        ok = f.write(reinterpret_cast<const char *>(text.data()), bytes) == bytes;
+    }
+    if (!ok) {
+        f.cancelWriting();
+        return false;
+    }
+    return f.commit();
+}
+
+bool SubtitleCache::read(const QString &path, SubtitleStore &out) {
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) return false;
+    qint64 size = f.size();
+    QByteArray buffer;
+    const char *data = nullptr;
+    if (size > 0) {
+        if (uchar *mapped = f.map(0, size))
+            data = reinterpret_cast<const char *>(mapped);
+    }
+    if (!data) {
+        buffer = f.readAll();
+        data = buffer.constData();
+        size = buffer.size();
+    }
+    return load(keyFor(path, data, size), out);
+}
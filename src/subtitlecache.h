@@ -0,0 +1,36 @@
+#pragma once
+#include <QString>
+#include "subtitlestore.h"
+
+// Binary copy of the parsed cues of a subtitle file, kept in the user cache
+// directory so that reopening a large file skips the text parse. The cache
+// file holds the store's columns (line numbers, timings, CPS, character
+// counts, text lengths) followed by the text arena; loading it is a map and
+// a few memcpys.
+//
+// An entry is only used when the size, mtime and content hash of the file
+// still match the ones it was built from and the CPS counting rules are the
+// current ones. The format is native-endian and versioned: anything
+// unexpected counts as a miss.
+class SubtitleCache {
+public:
+    struct Key {
+        QString path;          // absolute path of the subtitle file
+        qint64 size = 0;
+        qint64 mtimeMs = 0;
+        quint64 contentHash = 0;
+    };
+
+    // Key of the file at 'path', whose contents are [data, data + size).
+    static Key keyFor(const QString &path, const char *data, qint64 size);
+    static QString cacheFilePath(const QString &path);
+
+    // Replaces 'out' with the cached cues; false on a miss.
+    static bool load(const Key &key, SubtitleStore &out);
+    // Writes (atomically) the cache entry for 'key'. Only SubRip documents
+    // are cached: stores with side tables (SubtitleStore::hasLayout(), a
+    // header) are refused.
+    static bool save(const Key &key, const SubtitleStore &store);
+    // Maps 'path', computes its key and loads the cached cues.
+    static bool read(const QString &path, SubtitleStore &out);
+};
@@ -0,0 +1,351 @@
+#include "subtitlediff.h"
+#include "hashing.h"
+#include "trace.h"
+#include <QCoreApplication>
+#include <QHash>
+#include <QStringList>
+#include <QVarLengthArray>
+#include <algorithm>
+
+namespace {
+
+// Gaps of at most this many cells (rows x rows) are aligned with a plain LCS
+// table instead of anchors.
+constexpr qint64 SmallGapCells = 4096;
+
+bool isBlank(char16_t c) {
+    return c == u' ' || c == u'\t' || c == u'\n' || c == u'\r';
+}
+
+// Sequence alignment of two hash lists; match[i] is the row of 'b' aligned
+// with row i of 'a', or -1. Matches are increasing in both.
+class Aligner {
+public:
+    Aligner(const QVector<quint64> &a, const QVector<quint64> &b)
+        : a_(a), b_(b), match_(a.size(), -1) {}
+
+    QVector<int> run();
+
+private:
+    struct Range {
+        int a0, a1, b0, b1;
+    };
+    struct Count {
+        int inA = 0;
+        int inB = 0;
+        int rowB = -1;
+    };
+
+    // Anchors of a range: rows of 'a' unique on both sides, with their row in
+    // 'b', longest increasing subsequence of the latter.
+    QVector<QPair<int, int>> anchors(const Range &r);
+    void lcs(const Range &r);
+
+    const QVector<quint64> &a_;
+    const QVector<quint64> &b_;
+    QVector<int> match_;
+    QHash<quint64, Count> counts_;
+};
+
+QVector<int> Aligner::run() {
+    QVector<Range> pending { { 0, int(a_.size()), 0, int(b_.size()) } };
+    while (!pending.isEmpty()) {
+        Range r = pending.takeLast();
+        while (r.a0 < r.a1 && r.b0 < r.b1 && a_.at(r.a0) == b_.at(r.b0)) match_[r.a0++] = r.b0++;
+        while (r.a0 < r.a1 && r.b0 < r.b1 && a_.at(r.a1 - 1) == b_.at(r.b1 - 1)) match_[--r.a1] = --r.b1;
+        if (r.a0 == r.a1 || r.b0 == r.b1) continue;
+        if (qint64(r.a1 - r.a0) * (r.b1 - r.b0) <= SmallGapCells) {
+            lcs(r);
+            continue;
+        }
+        const QVector<QPair<int, int>> found = anchors(r);
+        // without anchors the gap stays as it is: its cues are paired by time
+        int a0 = r.a0;
+        int b0 = r.b0;
+        for (const auto &[i, j] : found) {
+            match_[i] = j;
+            pending.append({ a0, i, b0, j });
+            a0 = i + 1;
+            b0 = j + 1;
+        }
+        if (!found.isEmpty()) pending.append({ a0, r.a1, b0, r.b1 });
+    }
+    return match_;
+}
+
+QVector<QPair<int, int>> Aligner::anchors(const Range &r) {
+    counts_.clear();
+    counts_.reserve(r.a1 - r.a0);
+    for (int i = r.a0; i < r.a1; ++i) ++counts_[a_.at(i)].inA;
+    for (int j = r.b0; j < r.b1; ++j) {
+        auto it = counts_.find(b_.at(j));
+        if (it == counts_.end()) continue;
+        ++it->inB;
+        it->rowB = j;
+    }
+    QVector<QPair<int, int>> unique;
+    for (int i = r.a0; i < r.a1; ++i) {
+        const Count c = counts_.value(a_.at(i));
+        if (c.inA == 1 && c.inB == 1) unique.append({ i, c.rowB });
+    }
+    if (unique.isEmpty()) return unique;
+
+    // patience sorting: tails[k] ends the best run of length k + 1
+    QVector<int> tails;
+    QVector<int> previous(unique.size(), -1);
+    for (int k = 0; k < unique.size(); ++k) {
+        const int j = unique.at(k).second;
+        const auto pos = std::lower_bound(tails.cbegin(), tails.cend(), j, [&](int t, int value) {
+            return unique.at(t).second < value;
+        }) - tails.cbegin();
+        if (pos > 0) previous[k] = tails.at(pos - 1);
+        if (pos == tails.size()) tails.append(k);
+        else tails[pos] = k;
+    }
+    QVector<QPair<int, int>> run(tails.size());
+    for (int k = tails.constLast(), n = int(tails.size()); k >= 0; k = previous.at(k))
+        run[--n] = unique.at(k);
+    return run;
+}
+
+void Aligner::lcs(const Range &r) {
+    const int n = r.a1 - r.a0;
+    const int m = r.b1 - r.b0;
+    // length[i][j]: LCS of the suffixes from i and j
+    QVarLengthArray<quint16, SmallGapCells + 256> length((n + 1) * (m + 1));
+    auto at = [&](int i, int j) -> quint16 & { return length[i * (m + 1) + j]; };
+    for (int i = n; i >= 0; --i) {
+        for (int j = m; j >= 0; --j) {
+            if (i == n || j == m) at(i, j) = 0;
+            else if (a_.at(r.a0 + i) == b_.at(r.b0 + j)) at(i, j) = at(i + 1, j + 1) + 1;
+            else at(i, j) = qMax(at(i + 1, j), at(i, j + 1));
+        }
+    }
+    for (int i = 0, j = 0; i < n && j < m;) {
+        if (a_.at(r.a0 + i) == b_.at(r.b0 + j)) {
+            match_[r.a0 + i++] = r.b0 + j++;
+        } else if (at(i + 1, j) >= at(i, j + 1)) {
+            ++i;
+        } else {
+            ++j;
+        }
+    }
+}
+
+bool overlaps(const SubtitleStore &a, qsizetype i, const SubtitleStore &b, qsizetype j) {
+    const int sa = a.startMs(i);
+    const int sb = b.startMs(j);
+    if (sa == sb) return true;
+    const int ea = a.endMs(i);
+    const int eb = b.endMs(j);
+    if (sa == SubtitleStore::NoTime || sb == SubtitleStore::NoTime
+        || ea == SubtitleStore::NoTime || eb == SubtitleStore::NoTime) {
+        return false;
+    }
+    return sa < eb && sb < ea;
+}
+
+// Rows [a0, a1) of the document and [b0, b1) of the other version, none of
+// them aligned: overlapping cues become modifications, the rest additions and
+// removals in time order.
+void pairGap(const SubtitleStore &a, int a0, int a1, const SubtitleStore &b, int b0, int b1,
+             QVector<CueChange> &out)
+{
+    while (a0 < a1 || b0 < b1) {
+        if (a0 < a1 && b0 < b1 && overlaps(a, a0, b, b0)) {
+            if (const quint8 parts = SubtitleDiff::differences(a, a0, b, b0))
+                out.append({ CueChange::Modified, parts, false, a0, b0 });
+            ++a0;
+            ++b0;
+        } else if (b0 == b1 || (a0 < a1 && a.startMs(a0) <= b.startMs(b0))) {
+            out.append({ CueChange::Removed, 0, false, a0++, -1 });
+        } else {
+            out.append({ CueChange::Added, 0, false, a0, b0++ });
+        }
+    }
+}
+
+// Where the rows of a base version ended up in a later one, from
+// compare(base, later).
+struct RowMap {
+    QVector<int> row;          // per base row: row in the later version, -1 if removed
+    QVector<quint8> parts;     // per base row: what was modified
+    QVector<int> addedFirst;   // per gap before base row g (g up to size): first added row
+    QVector<int> addedCount;
+
+    RowMap(const QVector<CueChange> &changes, int baseSize) {
+        row.resize(baseSize);
+        parts.resize(baseSize);
+        addedFirst.resize(baseSize + 1);
+        addedCount.resize(baseSize + 1);
+        int next = 0; // next row of the later version
+        qsizetype c = 0;
+        for (int g = 0; g <= baseSize; ++g) {
+            addedFirst[g] = next;
+            while (c < changes.size() && changes.at(c).row == g && changes.at(c).kind == CueChange::Added) {
+                next = changes.at(c++).other + 1;
+                ++addedCount[g];
+            }
+            if (g == baseSize) break;
+            if (c < changes.size() && changes.at(c).row == g) {
+                const CueChange &change = changes.at(c++);
+                if (change.kind == CueChange::Removed) {
+                    row[g] = -1;
+                    continue;
+                }
+                parts[g] = change.parts;
+            }
+            row[g] = next++;
+        }
+    }
+};
+
+} // namespace
+
+QVector<quint8> SubtitleDiff::rowFlags(const QVector<CueChange> &changes, int rows) {
+    QVector<quint8> flags(rows);
+    if (rows == 0) return flags;
+    for (const CueChange &c : changes) flags[qMin(c.row, rows - 1)] |= changeFlags(c, rows);
+    return flags;
+}
+
+quint8 SubtitleDiff::changeFlags(const CueChange &change, int rows) {
+    quint8 flags = change.kind == CueChange::Modified ? RowModified
+                 : change.kind == CueChange::Removed  ? RowRemoved
+                 : change.row < rows                  ? RowAddedBefore
+                                                      : RowAddedAfter;
+    if (change.conflict) flags |= RowConflict;
+    return flags;
+}
+
+QString SubtitleDiff::describe(quint8 flags) {
+    QStringList lines;
+    if (flags & RowModified) lines.append(QCoreApplication::translate("SubtitleDiff", "Changed in the other version"));
+    if (flags & RowAddedBefore) lines.append(QCoreApplication::translate("SubtitleDiff", "Cues added before it"));
+    if (flags & RowAddedAfter) lines.append(QCoreApplication::translate("SubtitleDiff", "Cues added after it"));
+    if (flags & RowRemoved) lines.append(QCoreApplication::translate("SubtitleDiff", "Removed in the other version"));
+    if (flags & RowConflict) lines.append(QCoreApplication::translate("SubtitleDiff", "Conflicts with an edit of this document"));
+    return lines.join(u'\n');
+}
+
+QVector<quint64> SubtitleDiff::textHashes(const SubtitleStore &store) {
+    QVector<quint64> hashes(store.size());
+    QVarLengthArray<char16_t, 256> buf;
+    for (qsizetype i = 0; i < store.size(); ++i) {
+        buf.clear();
+        bool space = false;
+        for (QChar c : store.textView(i)) {
+            if (isBlank(c.unicode())) {
+                space = !buf.isEmpty();
+                continue;
+            }
+            if (space) buf.append(u' ');
+            space = false;
+            buf.append(c.unicode());
+        }
+        hashes[i] = hash64(buf.constData(), buf.size() * qsizetype(sizeof(char16_t)));
+    }
+    return hashes;
+}
+
+quint8 SubtitleDiff::differences(const SubtitleStore &a, qsizetype i, const SubtitleStore &b, qsizetype j) {
+    quint8 parts = 0;
+    if (a.textView(i) != b.textView(j)) parts |= CueChange::Text;
+    if (a.startMs(i) != b.startMs(j) || a.endMs(i) != b.endMs(j)) parts |= CueChange::Timing;
+    if (!SubtitleStore::sameLayout(a, i, b, j)) parts |= CueChange::Layout;
+    return parts;
+}
+
+QVector<CueChange> SubtitleDiff::compare(const SubtitleStore &document, const SubtitleStore &other) {
+    TRACE_SCOPE("SubtitleDiff::compare");
+    const QVector<int> match = Aligner(textHashes(document), textHashes(other)).run();
+    const int n = int(document.size());
+    const int m = int(other.size());
+    QVector<CueChange> changes;
+    for (int i = 0, j = 0; i < n || j < m;) {
+        if (i < n && match.at(i) == j) {
+            // same text; the timing or layout may still differ
+            if (const quint8 parts = differences(document, i, other, j))
+                changes.append({ CueChange::Modified, parts, false, i, j });
+            ++i;
+            ++j;
+            continue;
+        }
+        int i1 = i;
+        while (i1 < n && match.at(i1) < 0) ++i1;
+        const int j1 = i1 < n ? match.at(i1) : m;
+        pairGap(document, i, i1, other, j, j1, changes);
+        i = i1;
+        j = j1;
+    }
+    return changes;
+}
+
+QVector<CueChange> SubtitleDiff::merge(const SubtitleStore &base, const SubtitleStore &document,
+                                       const SubtitleStore &theirs)
+{
+    TRACE_SCOPE("SubtitleDiff::merge");
+    const int n = int(base.size());
+    const RowMap ours(compare(base, document), n);
+    const RowMap their(compare(base, theirs), n);
+    QVector<CueChange> changes;
+    int cursor = 0; // document row the next addition goes before
+    for (int g = 0; g <= n; ++g) {
+        cursor = ours.addedFirst.at(g) + ours.addedCount.at(g);
+        if (const int count = their.addedCount.at(g)) {
+            const int first = their.addedFirst.at(g);
+            const int ownCount = ours.addedCount.at(g);
+            bool same = ownCount == count;
+            for (int k = 0; same && k < count; ++k)
+                same = differences(document, ours.addedFirst.at(g) + k, theirs, first + k) == 0;
+            if (!same) {
+                for (int k = 0; k < count; ++k)
+                    changes.append({ CueChange::Added, 0, ownCount > 0, cursor, first + k });
+            }
+        }
+        if (g == n) break;
+
+        const int own = ours.row.at(g);
+        const int other = their.row.at(g);
+        if (other >= 0 && their.parts.at(g) != 0) {
+            if (own < 0) {
+                // modified there, deleted here
+                changes.append({ CueChange::Added, 0, true, cursor, other });
+            } else if (const quint8 parts = differences(document, own, theirs, other)) {
+                changes.append({ CueChange::Modified, parts, ours.parts.at(g) != 0, own, other });
+            }
+        } else if (other < 0 && own >= 0) {
+            changes.append({ CueChange::Removed, 0, ours.parts.at(g) != 0, own, -1 });
+        }
+    }
+    return changes;
+}
+
+QVector<CueSplice> SubtitleDiff::splices(const QVector<CueChange> &changes, const SubtitleStore &other) {
+    QVector<CueSplice> splices;
+    // consecutive cues of 'other' are copied as one run
+    int runFirst = -1;
+    int runCount = 0;
+    auto flush = [&] {
+        if (runCount > 0) splices.last().inserted.append(other.mid(runFirst, runCount));
+        runCount = 0;
+    };
+    for (const CueChange &c : changes) {
+        if (splices.isEmpty() || splices.last().row + splices.last().removed != c.row) {
+            flush();
+            splices.append({ c.row, 0, SubtitleStore() });
+        }
+        CueSplice &s = splices.last();
+        if (c.kind != CueChange::Added) ++s.removed;
+        if (c.other < 0) continue;
+        if (runCount > 0 && runFirst + runCount == c.other) {
+            ++runCount;
+        } else {
+            flush();
+            runFirst = c.other;
+            runCount = 1;
+        }
+    }
+    flush();
+    return splices;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+#include "subtitlestore.h"
+
+// One difference between the document and another version of it, by rows of
+// the document.
+struct CueChange {
+    enum Kind : quint8 { Modified, Added, Removed };
+    enum Part : quint8 { Text = 1, Timing = 2, Layout = 4 };
+
+    Kind kind = Modified;
+    quint8 parts = 0;      // Modified: Part bits of what differs
+    bool conflict = false; // merge: the document changed the same cue (or gap) another way
+    int row = 0;           // document row; Added: the row the cue goes before (up to size())
+    int other = -1;        // row in the other version; -1 for Removed
+};
+
+// Cue-level comparison of subtitle versions.
+//
+// Cues are aligned on a hash of their normalized text (whitespace runs folded,
+// ends trimmed), so renumbered cues still line up and a retimed cue pairs
+// with its old self; line numbers are ignored. The alignment is patience
+// style: after the common head and tail, cues whose hash occurs once on each
+// side are anchors, the longest run of them in the same order is kept
+// (O(n log n)), and the gaps between anchors are aligned the same way. Small
+// gaps get an exact LCS; cues still unaligned in a gap are paired by
+// overlapping times, anything left is an addition or a removal.
+class SubtitleDiff {
+public:
+    // Per-row marks of a change list (SubtitleModel::DiffRole).
+    enum RowFlag : quint8 {
+        RowModified = 1,
+        RowAddedBefore = 2, // cues of the other version go before this row
+        RowAddedAfter = 4,  // ... or after it (the last row)
+        RowRemoved = 8,
+        RowConflict = 16
+    };
+
+    // Changes turning 'document' into 'other', ascending by row; at one row
+    // the Added cues come before the change of the row itself.
+    static QVector<CueChange> compare(const SubtitleStore &document, const SubtitleStore &other);
+    // Three-way merge: the changes 'theirs' made to 'base', mapped onto
+    // 'document' (the document's own changes to 'base' are kept). A change
+    // to a cue, or an addition to a gap, that the document changed too is a
+    // conflict, unless both sides made the same change.
+    static QVector<CueChange> merge(const SubtitleStore &base, const SubtitleStore &document,
+                                    const SubtitleStore &theirs);
+
+    // Splices that apply 'changes' (ascending, e.g. a subset of a compare()
+    // result) to the document, taking the new cues from 'other'.
+    static QVector<CueSplice> splices(const QVector<CueChange> &changes, const SubtitleStore &other);
+
+    // RowFlag bits for each of 'rows' rows, and the bits one change sets on
+    // its row (additions at the end mark the last row).
+    static QVector<quint8> rowFlags(const QVector<CueChange> &changes, int rows);
+    static quint8 changeFlags(const CueChange &change, int rows);
+    // One line per RowFlag, for tooltips.
+    static QString describe(quint8 flags);
+
+    // Hash of the normalized text of each cue.
+    static QVector<quint64> textHashes(const SubtitleStore &store);
+    // CueChange::Part bits of what differs between cue i of 'a' and cue j of
+    // 'b' (exact text, start and end, CueLayout).
+    static quint8 differences(const SubtitleStore &a, qsizetype i, const SubtitleStore &b, qsizetype j);
+};
@@ -0,0 +1,97 @@
+#include "subtitlefile.h"
+#include "srtparser.h"
+#include "subtitleformat.h"
+#include "trace.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QStringDecoder>
+#include <QStringEncoder>
+
+bool SubtitleFile::read(const QString &path, SubtitleStore &out, const SrtReadOptions &options,
+                        TextFormat *format, SubtitleFormat::Id *documentFormat)
+{
+    TRACE_SCOPE("SubtitleFile::read");
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) return false;
+
+    // Map the file and scan the bytes in place; fall back to a plain read for
+    // files that cannot be mapped (pipes, some network shares).
+    QByteArray buffer;
+    const char *data = nullptr;
+    qint64 size = f.size();
+    if (size > 0) {
+        if (uchar *mapped = f.map(0, size))
+            data = reinterpret_cast<const char *>(mapped);
+    }
+    if (!data) {
+        buffer = f.readAll();
+        data = buffer.constData();
+        size = buffer.size();
+    }
+
+    TextFormat detected = TextEncoding::detect(data, size);
+    if (!options.encoding.isEmpty()) {
+        // the caller's encoding wins; line endings and BOM are still what
+        // the file has
+        detected.encoding = options.encoding;
+        detected.byteOrderMark = false;
+    }
+    TextEncoding::Kind encoding = TextEncoding::kindForName(detected.encoding);
+    if (!options.encoding.isEmpty() && encoding != TextEncoding::Other)
+        detected.crlf = TextEncoding::usesCrlf(encoding, data, size);
+    if (encoding == TextEncoding::Other) {
+        QStringDecoder decoder(detected.encoding.constData());
+        if (!decoder.isValid()) return false;
+        buffer = QString(decoder(QByteArrayView(data, size))).toUtf8();
+        data = buffer.constData();
+        size = buffer.size();
+        encoding = TextEncoding::Utf8;
+    } else if ((encoding == TextEncoding::Utf16LE || encoding == TextEncoding::Utf16BE)
+               && encoding != TextEncoding::HostUtf16) {
+        buffer = TextEncoding::swapUtf16(data, size);
+        data = buffer.constData();
+        size = buffer.size();
+        encoding = TextEncoding::HostUtf16;
+    }
+    if (const qsizetype bom = TextEncoding::bomLength(encoding, data, size)) {
+        detected.byteOrderMark = true;
+        data += bom;
+        size -= bom;
+    }
+
+    SubtitleStore tmp;
+    const SubtitleFormat::Id id = SubtitleFormat::detect(path, data, size, encoding);
+    int fallbackCounter = 0;
+    if (id != SubtitleFormat::Srt)
+        SubtitleFormat::get(id).read(data, data + size, encoding, tmp);
+    else if (options.parallel && !options.fallbackRows)
+        SrtParser::parseParallel(data, data + size, tmp, fallbackCounter, encoding);
+    else
+        SrtParser::parse(data, data + size, tmp, fallbackCounter, options.fallbackRows, encoding);
+    out = std::move(tmp);
+    if (format) *format = detected;
+    if (documentFormat) *documentFormat = id;
+    return true;
+}
+
+bool SubtitleFile::write(const QString &path, const SubtitleStore &store, const SrtWriteOptions &options) {
+    SrtWriter writer(options);
+    return write(path, store, writer);
+}
+
+bool SubtitleFile::write(const QString &path, const SubtitleStore &store, SrtWriter &writer) {
+    TRACE_SCOPE("SubtitleFile::write");
+    if (!writer.isValid()) return false;
+    QSaveFile f(path);
+    if (!f.open(QIODevice::WriteOnly)) return false;
+    if (!writer.write(&f, store)) {
+        f.cancelWriting();
+        return false;
+    }
+    return f.commit();
+}
+
+bool SubtitleFile::isSupportedEncoding(const QByteArray &name) {
+    return TextEncoding::kindForName(name) != TextEncoding::Other
+           || QStringEncoder(name.constData()).isValid();
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include "srtwriter.h"
+#include "subtitleformat.h"
+#include "subtitlestore.h"
+#include "textencoding.h"
+
+struct SrtReadOptions {
+    QByteArray encoding;                  // empty: detect (TextEncoding::detect)
+    bool parallel = true;                 // parse large files on the global pool
+    QVector<int> *fallbackRows = nullptr; // see SrtParser::parse; SRT only, parses sequentially
+};
+
+// Reads and writes subtitle files (SRT, ASS/SSA, WebVTT; see SubtitleFormat)
+// to and from a SubtitleStore. Needs only QtCore, so the editor and
+// substudio-cli share it.
+class SubtitleFile {
+public:
+    // Replaces the contents of 'out'. Files in UTF-8, UTF-16, Windows-1252 or
+    // Latin-1 are mapped and decoded while they are scanned (UTF-16 in the
+    // other byte order is swapped first); other encodings are converted to
+    // UTF-8 first. 'format', if given, receives the encoding and line
+    // endings, detected or as requested. The document format is sniffed
+    // from the first line, then guessed from the suffix; 'documentFormat',
+    // if given, receives it.
+    static bool read(const QString &path, SubtitleStore &out, const SrtReadOptions &options = {},
+                     TextFormat *format = nullptr, SubtitleFormat::Id *documentFormat = nullptr);
+    // Writes in options.format. Atomic: the data goes to a temporary file
+    // that replaces 'path' only once everything was written, so a failed
+    // save leaves the old file.
+    static bool write(const QString &path, const SubtitleStore &store, const SrtWriteOptions &options = {});
+    // Same, reusing the writer's buffer (and its options) across saves.
+    static bool write(const QString &path, const SubtitleStore &store, SrtWriter &writer);
+
+    // True if Qt, or the built-in single-byte codecs, can convert to/from the
+    // named encoding.
+    static bool isSupportedEncoding(const QByteArray &name);
+};
@@ -0,0 +1,70 @@
+#include "subtitleformat.h"
+#include "assformat.h"
+#include "srtformat.h"
+#include "texttokenizer.h"
+#include "vttformat.h"
+#include <QFileInfo>
+#include <QObject>
+
+namespace {
+
+// Bytes decoded for sniff(); the signatures sit on the first line.
+constexpr qsizetype SniffBytes = 512;
+
+} // namespace
+
+const QList<const SubtitleFormat *> &SubtitleFormat::all() {
+    static const SrtFormat srt;
+    static const AssFormat ass;
+    static const VttFormat vtt;
+    // in Id order
+    static const QList<const SubtitleFormat *> formats { &srt, &ass, &vtt };
+    return formats;
+}
+
+const SubtitleFormat &SubtitleFormat::get(Id id) {
+    return *all().at(id);
+}
+
+const SubtitleFormat *SubtitleFormat::forKey(const QString &key) {
+    for (const SubtitleFormat *f : all()) {
+        if (f->key().compare(key, Qt::CaseInsensitive) == 0) return f;
+    }
+    return nullptr;
+}
+
+SubtitleFormat::Id SubtitleFormat::forPath(const QString &path, Id fallback) {
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    for (const SubtitleFormat *f : all()) {
+        if (f->suffixes().contains(suffix)) return f->id();
+    }
+    return fallback;
+}
+
+SubtitleFormat::Id SubtitleFormat::detect(const QString &path, const char *data, qsizetype size,
+                                          TextEncoding::Kind encoding)
+{
+    QString head;
+    TextScan::withUnits(data, data + qMin(size, SniffBytes), encoding, [&](auto b, auto e, auto decoder) {
+        head = TextScan::decodeField(decoder, b, e);
+    });
+    for (const SubtitleFormat *f : all()) {
+        if (f->sniff(head)) return f->id();
+    }
+    return forPath(path, Srt);
+}
+
+QString SubtitleFormat::fileFilter(bool allSupported) {
+    QStringList filters;
+    QStringList everything;
+    for (const SubtitleFormat *f : all()) {
+        QStringList patterns;
+        for (const QString &suffix : f->suffixes()) patterns.append(QStringLiteral("*.") + suffix);
+        everything += patterns;
+        filters.append(QStringLiteral("%1 (%2)").arg(f->name(), patterns.join(u' ')));
+    }
+    if (allSupported)
+        filters.prepend(QObject::tr("Subtitle files (%1)").arg(everything.join(u' ')));
+    filters.append(QObject::tr("All files (*.*)"));
+    return filters.join(QStringLiteral(";;"));
+}
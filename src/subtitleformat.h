@@ -0,0 +1,52 @@
+#pragma once
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include "subtitlestore.h"
+#include "textencoding.h"
+
+class SrtWriter;
+
+// A subtitle file format: a reader that scans a buffer straight into a
+// SubtitleStore and a writer that streams a store out through SrtWriter.
+// Readers share the tokenizer of SrtParser (texttokenizer.h) and keep what
+// SubRip has no place for in the store's side tables (CueLayout, header and
+// footer), so converting a file is one scan and one write.
+class SubtitleFormat {
+public:
+    enum Id { Srt, Ass, WebVtt };
+
+    virtual ~SubtitleFormat() = default;
+
+    virtual Id id() const = 0;
+    // Short name for file dialogs and the command line ("SubRip", "srt").
+    virtual QString name() const = 0;
+    virtual QString key() const = 0;
+    // Lower-case file suffixes; the first one is used for new files.
+    virtual QStringList suffixes() const = 0;
+    // Whether a document starting with 'head' (decoded, BOM skipped) is in
+    // this format. SubRip has no signature and never claims a document.
+    virtual bool sniff(QStringView head) const = 0;
+    // Appends the cues of [begin, end) (BOM skipped) to 'out', together with
+    // the document header and footer. 'encoding' is one SrtParser scans
+    // itself; UTF-16 in host byte order.
+    virtual void read(const char *begin, const char *end, TextEncoding::Kind encoding,
+                      SubtitleStore &out) const = 0;
+    // Writes 'store' through 'writer', which owns encoding, BOM and line
+    // endings. Stores read from another format get a default header.
+    virtual void write(SrtWriter &writer, const SubtitleStore &store) const = 0;
+
+    static const SubtitleFormat &get(Id id);
+    static const QList<const SubtitleFormat *> &all();
+    // The format whose key() is 'key', or nullptr.
+    static const SubtitleFormat *forKey(const QString &key);
+    // By suffix alone, for files about to be written.
+    static Id forPath(const QString &path, Id fallback = Srt);
+    // Format of a document: its signature if it has one, else the suffix of
+    // 'path', else SubRip.
+    static Id detect(const QString &path, const char *data, qsizetype size, TextEncoding::Kind encoding);
+    // "SubRip (*.srt);;..." for QFileDialog, optionally led by an entry that
+    // matches every supported suffix.
+    static QString fileFilter(bool allSupported);
+};
@@ -0,0 +1,172 @@
+#include "subtitleloader.h"
+#include "srtparser.h"
+#include "subtitlecache.h"
+#include "trace.h"
+#include <QPromise>
+#include <QtConcurrent>
+
+namespace {
+
+// Runs on a pool thread. The encoding is detected first, so it is known even
+// for a cache hit. A valid cache entry is reported as one batch, and so is
+// an ASS or WebVTT document (those are not cached). Otherwise the first few
+// KB are parsed on their own so the view gets rows immediately; the rest is
+// parsed in parallel waves and reported chunk by chunk, in file order, and
+// the cache entry is rebuilt afterwards.
+void parseInBatches(QPromise<SubtitleStore> &promise, const QString &filePath,
+                    const char *data, qint64 size, bool useCache, bool *fromCache,
+                    TextFormat *format, SubtitleFormat::Id *documentFormat)
+{
+    TRACE_SCOPE("SubtitleLoader::parse");
+    constexpr qsizetype FirstBatchSize = 64 * 1024;
+
+    promise.setProgressRange(0, 100);
+    *format = TextEncoding::detect(data, size);
+    const TextEncoding::Kind encoding = TextEncoding::kindForName(format->encoding);
+    const char *raw = data; // the cache key covers the file as it is on disk
+    const qint64 rawSize = size;
+    QByteArray swapped; // UTF-16 in the other byte order, in host order
+    if ((encoding == TextEncoding::Utf16LE || encoding == TextEncoding::Utf16BE)
+        && encoding != TextEncoding::HostUtf16) {
+        swapped = TextEncoding::swapUtf16(data, size);
+        data = swapped.constData();
+        size = swapped.size();
+    }
+    const TextEncoding::Kind scanAs = swapped.isNull() ? encoding : TextEncoding::HostUtf16;
+    const char *end = data + size;
+    const char *begin = data + TextEncoding::bomLength(scanAs, data, size);
+
+    *documentFormat = SubtitleFormat::detect(filePath, begin, end - begin, scanAs);
+    if (*documentFormat != SubtitleFormat::Srt) {
+        SubtitleStore document;
+        SubtitleFormat::get(*documentFormat).read(begin, end, scanAs, document);
+        promise.addResult(std::move(document));
+        promise.setProgressValue(100);
+        return;
+    }
+
+    SubtitleCache::Key key;
+    if (useCache) {
+        key = SubtitleCache::keyFor(filePath, raw, rawSize);
+        SubtitleStore cached;
+        if (SubtitleCache::load(key, cached)) {
+            *fromCache = true;
+            promise.addResult(std::move(cached));
+            promise.setProgressValue(100);
+            return;
+        }
+    }
+
+    SubtitleStore all; // copy of every batch for the cache
+    auto report = [&](const char *upTo) {
+        promise.setProgressValue(size > 0 ? int(100 * (upTo - data) / size) : 100);
+    };
+
+    int fallbackCounter = 0;
+    const SrtParser::Chunk first = SrtParser::splitChunks(begin, end, FirstBatchSize, scanAs).constFirst();
+    SubtitleStore firstBatch;
+    SrtParser::parse(first.first, first.second, firstBatch, fallbackCounter, nullptr, scanAs);
+    if (useCache) all = firstBatch;
+    promise.addResult(std::move(firstBatch));
+    report(first.second);
+    if (promise.isCanceled()) return;
+    auto rebuildCache = [&] {
+        // the batches are already in the view; write the entry on another
+        // pool thread instead of holding back finished()
+        if (useCache)
+            QtConcurrent::run([key, all = std::move(all)] { SubtitleCache::save(key, all); });
+    };
+    if (first.second == end) {
+        rebuildCache();
+        return;
+    }
+
+    const QVector<SrtParser::Chunk> chunks =
+        SrtParser::splitChunks(first.second, end, SrtParser::parallelChunkSize(end - first.second), scanAs);
+    SrtParser::parseChunks(chunks, fallbackCounter, QThreadPool::globalInstance()->maxThreadCount(),
+                           [&](SubtitleStore &&cues, const char *chunkEnd) {
+                               if (promise.isCanceled()) return false;
+                               if (useCache) all.append(cues);
+                               promise.addResult(std::move(cues));
+                               report(chunkEnd);
+                               return true;
+                           },
+                           scanAs);
+    if (!promise.isCanceled()) rebuildCache();
+}
+
+} // namespace
+
+SubtitleLoader::SubtitleLoader(SubtitleModel *model, QObject *parent)
+    : QObject(parent), model_(model)
+{
+    connect(&watcher_, &QFutureWatcher<SubtitleStore>::resultsReadyAt,
+            this, &SubtitleLoader::onResultsReady);
+    connect(&watcher_, &QFutureWatcher<SubtitleStore>::progressValueChanged,
+            this, &SubtitleLoader::progressChanged);
+    connect(&watcher_, &QFutureWatcher<SubtitleStore>::finished,
+            this, &SubtitleLoader::onFinished);
+}
+
+SubtitleLoader::~SubtitleLoader() {
+    // the worker reads straight from the mapping, so it must stop before unmap
+    cancel();
+    watcher_.waitForFinished();
+}
+
+bool SubtitleLoader::isRunning() const {
+    return watcher_.isRunning();
+}
+
+bool SubtitleLoader::start(const QString &filePath) {
+    if (isRunning()) {
+        cancel();
+        watcher_.waitForFinished();
+    }
+    release();
+
+    file_.setFileName(filePath);
+    if (!file_.open(QIODevice::ReadOnly)) return false;
+
+    const char *data = nullptr;
+    qint64 size = file_.size();
+    if (size > 0) {
+        if (uchar *mapped = file_.map(0, size))
+            data = reinterpret_cast<const char *>(mapped);
+    }
+    if (!data) {
+        buffer_ = file_.readAll();
+        data = buffer_.constData();
+        size = buffer_.size();
+    }
+
+    model_->clear();
+    fromCache_ = false;
+    format_ = TextFormat();
+    documentFormat_ = SubtitleFormat::Srt;
+    watcher_.setFuture(QtConcurrent::run(parseInBatches, filePath, data, size, cacheEnabled_,
+                                         &fromCache_, &format_, &documentFormat_));
+    return true;
+}
+
+void SubtitleLoader::cancel() {
+    watcher_.cancel();
+}
+
+void SubtitleLoader::onResultsReady(int begin, int end) {
+    for (int i = begin; i < end; ++i)
+        model_->appendCues(watcher_.resultAt(i));
+}
+
+void SubtitleLoader::onFinished() {
+    const bool ok = !watcher_.isCanceled();
+    release();
+    emit finished(ok);
+}
+
+void SubtitleLoader::release() {
+    // drop the batches kept by the future; the model holds its own copies
+    watcher_.setFuture(QFuture<SubtitleStore>());
+    if (file_.isOpen()) file_.close(); // also unmaps
+    buffer_.clear();
+}
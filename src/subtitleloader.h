@@ -0,0 +1,53 @@
+#pragma once
+#include <QByteArray>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QObject>
+#include "subtitleformat.h"
+#include "subtitlemodel.h"
+#include "textencoding.h"
+
+// Loads a subtitle file off the GUI thread and feeds the cues into a SubtitleModel
+// in batches as they are parsed, so the first rows show up right away while
+// the rest of a large file streams in. Files parsed before are served from
+// SubtitleCache when the cache entry is still valid.
+class SubtitleLoader : public QObject {
+    Q_OBJECT
+public:
+    explicit SubtitleLoader(SubtitleModel *model, QObject *parent = nullptr);
+    ~SubtitleLoader() override;
+
+    // Clears the model and starts loading 'filePath'. A load in progress is
+    // cancelled first. Returns false if the file cannot be opened.
+    bool start(const QString &filePath);
+    bool isRunning() const;
+    // Whether the last load came from the binary cache.
+    bool loadedFromCache() const { return fromCache_; }
+    void setCacheEnabled(bool enabled) { cacheEnabled_ = enabled; }
+    // Encoding and line endings detected for the last load; valid once it
+    // finished.
+    const TextFormat &format() const { return format_; }
+    // SRT, ASS or WebVTT, likewise.
+    SubtitleFormat::Id documentFormat() const { return documentFormat_; }
+
+public slots:
+    void cancel();
+
+signals:
+    void progressChanged(int percent);
+    void finished(bool ok); // false when cancelled
+
+private:
+    void onResultsReady(int begin, int end);
+    void onFinished();
+    void release();
+
+    SubtitleModel *model_;
+    QFile file_;
+    QByteArray buffer_;     // used when the file cannot be memory-mapped
+    QFutureWatcher<SubtitleStore> watcher_;
+    bool cacheEnabled_ = true;
+    bool fromCache_ = false; // written by the worker, read once it finished
+    TextFormat format_;      // likewise
+    SubtitleFormat::Id documentFormat_ = SubtitleFormat::Srt; // likewise
+};
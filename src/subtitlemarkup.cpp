@@ -0,0 +1,228 @@
+#include "subtitlemarkup.h"
+#include <utility>
+
+namespace {
+
+// Styles both families have an on/off switch for, in closing order.
+constexpr char16_t Styles[] = { u's', u'u', u'b', u'i' };
+
+bool isStyle(QChar c) {
+    return c == u'i' || c == u'b' || c == u'u' || c == u's';
+}
+
+int hexDigit(QChar c) {
+    if (c >= u'0' && c <= u'9') return c.unicode() - u'0';
+    if (c >= u'a' && c <= u'f') return c.unicode() - u'a' + 10;
+    if (c >= u'A' && c <= u'F') return c.unicode() - u'A' + 10;
+    return -1;
+}
+
+// Six hex digits at the start of 'text'; false if there are fewer.
+bool readRgb(QStringView text, int rgb[3]) {
+    if (text.size() < 6) return false;
+    for (int k = 0; k < 3; ++k) {
+        const int hi = hexDigit(text.at(2 * k));
+        const int lo = hexDigit(text.at(2 * k + 1));
+        if (hi < 0 || lo < 0) return false;
+        rgb[k] = hi * 16 + lo;
+    }
+    return true;
+}
+
+void appendHex(QString &out, int value) {
+    constexpr char Digits[] = "0123456789ABCDEF";
+    out += QLatin1Char(Digits[value >> 4]);
+    out += QLatin1Char(Digits[value & 15]);
+}
+
+// The colour of a <font> tag's attributes: "#RRGGBB" as ASS "&HBBGGRR&".
+bool fontColour(QStringView attributes, QString &colour) {
+    const qsizetype at = attributes.indexOf(u"color", 0, Qt::CaseInsensitive);
+    if (at < 0) return false;
+    QStringView value = attributes.sliced(at + 5).trimmed();
+    if (!value.startsWith(u'=')) return false;
+    value = value.sliced(1).trimmed();
+    if (value.startsWith(u'"') || value.startsWith(u'\'')) value = value.sliced(1);
+    int rgb[3];
+    if (!value.startsWith(u'#') || !readRgb(value.sliced(1), rgb)) return false;
+    colour = QStringLiteral("&H");
+    for (int k = 2; k >= 0; --k) appendHex(colour, rgb[k]);
+    colour += u'&';
+    return true;
+}
+
+// Override tags toward tags: the styles and the colour that are open.
+struct TagState {
+    bool open[4] = {}; // by Styles index
+    bool font = false;
+
+    static int index(QChar style) {
+        for (int k = 0; k < 4; ++k) {
+            if (Styles[k] == style.unicode()) return k;
+        }
+        return -1;
+    }
+    void set(QChar style, bool on, QString &out) {
+        bool &o = open[index(style)];
+        if (o == on) return;
+        o = on;
+        out += on ? QStringView(u"<") : QStringView(u"</");
+        out += style;
+        out += u'>';
+    }
+    void setFont(const QString &colour, QString &out) {
+        closeFont(out);
+        out += QStringLiteral("<font color=\"#%1\">").arg(colour);
+        font = true;
+    }
+    void closeFont(QString &out) {
+        if (!std::exchange(font, false)) return;
+        out += QStringLiteral("</font>");
+    }
+    void closeAll(QString &out) {
+        closeFont(out);
+        for (char16_t style : Styles) set(QChar(style), false, out);
+    }
+};
+
+// One override tag ("i1", "c&H0000FF&", "r"), without its backslash.
+void overrideToTags(QStringView tag, bool colours, TagState &state, QString &out) {
+    tag = tag.trimmed();
+    if (tag.isEmpty()) return;
+    const QChar name = tag.at(0);
+    const QStringView arg = tag.sliced(1);
+    if (isStyle(name)) {
+        // "\bord", "\shad", "\iclip" are other tags that start alike
+        bool number = false;
+        const int value = arg.toInt(&number);
+        if (!number) return;
+        // "\b" also takes a font weight
+        const bool on = name == u'b' ? value == 1 || value >= 700 : value != 0;
+        state.set(name, on, out);
+        return;
+    }
+    if (name == u'r') {
+        state.closeAll(out);
+        return;
+    }
+    // "\c" and "\1c": the primary colour, "&HBBGGRR&"; none resets it
+    QStringView colour;
+    if (name == u'c' && (arg.isEmpty() || arg.startsWith(u'&'))) colour = arg;
+    else if (tag.startsWith(u"1c")) colour = tag.sliced(2);
+    else return;
+    if (!colours) return;
+    if (colour.startsWith(u"&H", Qt::CaseInsensitive)) colour = colour.sliced(2);
+    if (const qsizetype amp = colour.indexOf(u'&'); amp >= 0) colour.truncate(amp);
+    bool ok = false;
+    const uint bgr = colour.toUInt(&ok, 16);
+    if (!ok) {
+        state.closeFont(out);
+        return;
+    }
+    QString rgb;
+    appendHex(rgb, int(bgr & 0xFF));
+    appendHex(rgb, int(bgr >> 8 & 0xFF));
+    appendHex(rgb, int(bgr >> 16 & 0xFF));
+    state.setFont(rgb, out);
+}
+
+} // namespace
+
+bool SubtitleMarkup::usesOverrides(const SubtitleStore &store) {
+    return SubtitleFormat::get(SubtitleFormat::Ass).sniff(store.header());
+}
+
+void SubtitleMarkup::toAss(QStringView text, QString &out) {
+    out.resize(0);
+    const qsizetype n = text.size();
+    for (qsizetype i = 0; i < n;) {
+        const QChar c = text.at(i);
+        if (c == u'<') {
+            const qsizetype close = text.indexOf(u'>', i + 1);
+            if (close < 0) {
+                out += text.sliced(i);
+                break;
+            }
+            QStringView tag = text.sliced(i + 1, close - i - 1).trimmed();
+            i = close + 1;
+            const bool end = tag.startsWith(u'/');
+            if (end) tag = tag.sliced(1).trimmed();
+            if (tag.size() == 1 && isStyle(tag.at(0).toLower())) {
+                out += u"{\\";
+                out += tag.at(0).toLower();
+                out += end ? QStringView(u"0}") : QStringView(u"1}");
+            } else if (tag.startsWith(u"font", Qt::CaseInsensitive)) {
+                QString colour;
+                if (end) {
+                    out += u"{\\c}";
+                } else if (fontColour(tag.sliced(4), colour)) {
+                    out += u"{\\c";
+                    out += colour;
+                    out += u'}';
+                }
+            }
+            // anything else (<v Name>, <c.class>, timestamps) has no ASS tag
+            continue;
+        }
+        if (c == u'&') {
+            static constexpr struct { QStringView entity; QStringView text; } Entities[] = {
+                { u"&amp;", u"&" }, { u"&lt;", u"<" }, { u"&gt;", u">" }, { u"&nbsp;", u"\\h" },
+            };
+            bool found = false;
+            for (const auto &e : Entities) {
+                if (text.sliced(i).startsWith(e.entity)) {
+                    out += e.text;
+                    i += e.entity.size();
+                    found = true;
+                    break;
+                }
+            }
+            if (found) continue;
+        }
+        out += c;
+        ++i;
+    }
+}
+
+bool SubtitleMarkup::needsTags(QStringView text, SubtitleFormat::Id target) {
+    if (text.contains(u'{') || text.contains(u'\\')) return true;
+    return target == SubtitleFormat::WebVtt && (text.contains(u'<') || text.contains(u'&'));
+}
+
+void SubtitleMarkup::toTags(QStringView text, SubtitleFormat::Id target, QString &out) {
+    out.resize(0);
+    const bool vtt = target == SubtitleFormat::WebVtt;
+    TagState state;
+    const qsizetype n = text.size();
+    for (qsizetype i = 0; i < n;) {
+        const QChar c = text.at(i);
+        if (c == u'{') {
+            const qsizetype close = text.indexOf(u'}', i + 1);
+            if (close >= 0) {
+                // text before the first backslash is a comment
+                const QStringView block = text.sliced(i + 1, close - i - 1);
+                for (qsizetype from = block.indexOf(u'\\'); from >= 0;) {
+                    const qsizetype next = block.indexOf(u'\\', from + 1);
+                    overrideToTags(block.sliced(from + 1, (next < 0 ? block.size() : next) - from - 1), !vtt,
+                                   state, out);
+                    from = next;
+                }
+                i = close + 1;
+                continue;
+            }
+        }
+        if (c == u'\\' && i + 1 < n) {
+            const QChar next = text.at(i + 1);
+            if (next == u'h' || next == u'n' || next == u'N') {
+                out += next == u'h' ? QChar(0xA0) : next == u'n' ? QChar(u' ') : QChar(u'\n');
+                i += 2;
+                continue;
+            }
+        }
+        if (vtt && c == u'&') out += u"&amp;";
+        else if (vtt && c == u'<') out += u"&lt;";
+        else out += c;
+        ++i;
+    }
+    state.closeAll(out);
+}
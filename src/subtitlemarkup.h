@@ -0,0 +1,28 @@
+#pragma once
+#include <QString>
+#include <QStringView>
+#include "subtitleformat.h"
+#include "subtitlestore.h"
+
+// Inline markup of cue text across the two families the formats use: the
+// tags of SubRip and WebVTT (<i>, <b>, <font color>) and the override blocks
+// of ASS ({\i1}, {\c&H0000FF&}). Italic, bold, underline, strike-out and
+// colour map one to one; what the other side has no tag for is dropped
+// rather than shown as text. Writers convert only cues of a store read from
+// the other family, into a buffer they reuse from cue to cue.
+class SubtitleMarkup {
+public:
+    // Whether the cue text of 'store' uses ASS override blocks (it was read
+    // from an ASS file) rather than tags.
+    static bool usesOverrides(const SubtitleStore &store);
+
+    // Tagged text as ASS: tags become override blocks, "&amp;", "&lt;",
+    // "&gt;" and "&nbsp;" become the characters (a hard space: "\h").
+    static bool needsAss(QStringView text) { return text.contains(u'<') || text.contains(u'&'); }
+    static void toAss(QStringView text, QString &out);
+    // ASS text with tags for 'target' (SubRip or WebVTT): override blocks
+    // become tags, "\h" a no-break space and "\n" a space. WebVTT gets no
+    // colours (it has only classes) and its '&' and '<' escaped.
+    static bool needsTags(QStringView text, SubtitleFormat::Id target);
+    static void toTags(QStringView text, SubtitleFormat::Id target, QString &out);
+};
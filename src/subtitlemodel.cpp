@@ -1,14 +1,25 @@
 #include "subtitlemodel.h"
-#include <QFile>
-#include <QTextStream>
-#include <QRegularExpression>
+#include "subtitlefile.h"
+#include "trace.h"
 #include <QtGlobal>
-#include <cmath>
+#include <algorithm>
+#include <utility>
 
-SubtitleModel::SubtitleModel(QObject *parent) : QAbstractTableModel(parent) {}
+namespace {
+
+// Splices applied as row insertions and removals; more reset the model.
+constexpr int MaxIncrementalSplices = 16;
+
+} // namespace
+
+SubtitleModel::SubtitleModel(QObject *parent) : QAbstractTableModel(parent), spell_(store_) {
+    connect(&spell_, &SpellChecker::finished, this, [this] {
+        if (!store_.isEmpty()) emit dataChanged(index(0, Text), index(rowCount() - 1, Text), { SpellingRole });
+    });
+}
 
 int SubtitleModel::rowCount(const QModelIndex & /*parent*/) const {
-    return entries_.size();
+    return int(store_.size());
 }
 
 int SubtitleModel::columnCount(const QModelIndex & /*parent*/) const {
@@ -24,18 +35,80 @@ QVariant SubtitleModel::data(const QModelIndex &index, int role) const {
         return QVariant();
     }
 
+    const int row = index.row();
+    if (role == OverlapRole) return intervals_.isOverlapping(row);
+    if (role == QcFlagsRole) return int(qc_.flags(row));
+    if (role == MatchRole) return row < matchFlags_.size() && matchFlags_.at(row);
+    if (role == DiffRole) return row < diffFlags_.size() ? int(diffFlags_.at(row)) : 0;
+    if (role == SpellingRole) return index.column() == Text ? misspelledSpans(row) : QVariant();
+    if (role == Qt::ToolTipRole) {
+        if (index.column() != Text) {
+            QStringList lines;
+            if (const quint16 flags = qc_.flags(row)) lines.append(QcEngine::describe(flags));
+            if (row < diffFlags_.size() && diffFlags_.at(row)) lines.append(SubtitleDiff::describe(diffFlags_.at(row)));
+            return lines.isEmpty() ? QVariant() : QVariant(lines.join(u'\n'));
+        }
+        // the full text of cues the table shows summarized
+        const QStringView text = store_.textView(row);
+        return text.contains(u'\n') ? QVariant(text.toString()) : QVariant();
+    }
+
     if (role != Qt::DisplayRole) return {};
-    const SubtitleEntry &e = entries_.at(index.row());
     switch (index.column()) {
-        case LineNumber: return e.lineNumber;
-        case StartTime: return e.startTime;
-        case EndTime: return e.endTime;
-        case CPS: return e.cps;
-        case Text: return e.text;
+        case LineNumber: return store_.lineNumber(row);
+        case StartTime: return SubtitleStore::formatTime(store_.startMs(row));
+        case EndTime: return SubtitleStore::formatTime(store_.endMs(row));
+        case CPS: return store_.cps(row);
+        case Text: return summarizedText(row);
         default: return {};
     }
 }
 
+QString SubtitleModel::summarizedText(int row) const {
+    // rows have one fixed height: line breaks become a marker instead of
+    // making the view measure and wrap every cue
+    const QStringView text = store_.textView(row);
+    if (!text.contains(u'\n')) return text.toString();
+    QString out;
+    out.reserve(text.size() + 8);
+    bool first = true;
+    for (QStringView line : text.tokenize(u'\n')) {
+        if (!first) out += QStringLiteral(" \u21B5 ");
+        out += line;
+        first = false;
+    }
+    return out;
+}
+
+QVariant SubtitleModel::misspelledSpans(int row) const {
+    const SpellChecker::Words &words = spell_.words(row);
+    if (words.isEmpty()) return {};
+    // positions in the summarized text, where each line break is 3 characters
+    const QStringView text = store_.textView(row);
+    QList<int> spans;
+    spans.reserve(words.size() * 2);
+    int breaks = 0;
+    int scanned = 0;
+    for (const SpellChecker::Word &w : words) {
+        for (; scanned < w.start; ++scanned) breaks += text.at(scanned) == u'\n';
+        spans << w.start + 2 * breaks << w.length;
+    }
+    return QVariant::fromValue(spans);
+}
+
+void SubtitleModel::numberInsertedCues(QVector<CueSplice> &splices) const {
+    int next = maxLineNumber_;
+    for (CueSplice &s : splices) {
+        for (qsizetype i = 0; i < s.inserted.size(); ++i)
+            s.inserted.setLineNumber(i, i < s.removed ? store_.lineNumber(s.row + i) : ++next);
+    }
+}
+
+void SubtitleModel::trackLineNumbers(const SubtitleStore &cues) {
+    for (qsizetype i = 0; i < cues.size(); ++i)
+        maxLineNumber_ = qMax(maxLineNumber_, cues.lineNumber(i));
+}
+
 QVariant SubtitleModel::headerData(int section, Qt::Orientation orientation, int role) const {
     if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
         switch (section) {
@@ -51,134 +124,431 @@ QVariant SubtitleModel::headerData(int section, Qt::Orientation orientation, int
 
 void SubtitleModel::clear() {
     beginResetModel();
-    entries_.clear();
+    store_.clear();
+    intervals_.clear();
+    qc_.clear();
+    search_.clear();
+    matchFlags_.clear();
+    matchRowsValid_ = false;
+    diffFlags_.clear();
+    spell_.clear();
+    maxLineNumber_ = 0;
     endResetModel();
+    emit qcChanged();
+    if (!searchText_.isEmpty()) emit searchChanged();
+}
+
+void SubtitleModel::appendCues(const SubtitleStore &batch) {
+    TRACE_SCOPE("SubtitleModel::appendCues");
+    if (batch.isEmpty()) return;
+    const int first = int(store_.size());
+    beginInsertRows(QModelIndex(), first, first + int(batch.size()) - 1);
+    store_.append(batch);
+    intervals_.insertRows(store_, first, int(batch.size()));
+    qc_.insertRows(store_, intervals_, first, int(batch.size()));
+    searchRowsInserted(first, int(batch.size()));
+    if (!diffFlags_.isEmpty()) diffFlags_.insert(first, batch.size(), 0);
+    spell_.insertRows(first, int(batch.size()), false);
+    trackLineNumbers(batch);
+    endInsertRows();
+    emitFlagsChanged(first - 1, first - 1);
+    emit qcChanged();
+    if (!searchText_.isEmpty()) emit searchChanged();
 }
 
 bool SubtitleModel::loadSrt(const QString &filePath) {
-    QFile f(filePath);
-    if (!f.open(QIODevice::ReadOnly)) return false;
-
-    QTextStream in(&f);
-
-    QVector<SubtitleEntry> tmp;
-    QString line;
-    SubtitleEntry cur;
-    enum State { ExpectIndex, ExpectTime, ExpectText } state = ExpectIndex;
-    int indexCounter = 0;
-    bool bomChecked = false;
-
-    while (!in.atEnd()) {
-        line = in.readLine();
-
-        if (!bomChecked) {
-            bomChecked = true;
-            if (!line.isEmpty() && line.at(0) == QChar(0xFEFF)) {
-                line.remove(0, 1);
-            }
-        }
+    TRACE_SCOPE("SubtitleModel::loadSrt");
+    SubtitleStore tmp;
+    if (!SubtitleFile::read(filePath, tmp)) return false;
+    resetStore(std::move(tmp));
+    return true;
+}
 
-        if (line.trimmed().isEmpty()) {
-            if (state == ExpectText) {
-                cur.cps = computeCPS(cur);
-                tmp.append(cur);
-                cur = SubtitleEntry();
-                state = ExpectIndex;
-            } else {
-                state = ExpectIndex;
-            }
-            continue;
-        }
+void SubtitleModel::resetStore(SubtitleStore &&store) {
+    TRACE_SCOPE("SubtitleModel::resetStore");
+    beginResetModel();
+    store_ = std::move(store);
+    intervals_.rebuild(store_);
+    qc_.checkAll(store_, intervals_);
+    search_.clear();
+    matchFlags_.clear();
+    matchRowsValid_ = false;
+    diffFlags_.clear();
+    spell_.clear();
+    spell_.checkAll();
+    maxLineNumber_ = 0;
+    trackLineNumbers(store_);
+    endResetModel();
+    emit qcChanged();
+    if (!searchText_.isEmpty()) {
+        // run the current search again on the new document
+        const QString needle = std::exchange(searchText_, QString());
+        setSearch(needle, searchCase_);
+    }
+}
 
-        if (state == ExpectIndex) {
-            bool ok;
-            int num = line.trimmed().toInt(&ok);
-            if (ok) {
-                cur.lineNumber = num;
-            } else {
-                cur.lineNumber = ++indexCounter;
-            }
-            state = ExpectTime;
-        } else if (state == ExpectTime) {
-            QRegularExpression re(R"((\d{2}:\d{2}:\d{2}[,\.]\d{1,3})\s*-->\s*(\d{2}:\d{2}:\d{2}[,\.]\d{1,3}))");
-            auto m = re.match(line);
-            if (m.hasMatch()) {
-                cur.startTime = m.captured(1);
-                cur.endTime = m.captured(2);
-                double s1 = parseTimeToSeconds(cur.startTime);
-                double s2 = parseTimeToSeconds(cur.endTime);
-                cur.durationSeconds = qMax(0.0, s2 - s1);
-            }
-            state = ExpectText;
-        } else if (state == ExpectText) {
-            if (!cur.text.isEmpty()) cur.text += "\n";
-            cur.text += line;
-        }
+void SubtitleModel::insertCues(int row, const SubtitleStore &cues) {
+    TRACE_SCOPE("SubtitleModel::insertCues");
+    if (cues.isEmpty() || row < 0 || row > store_.size()) return;
+    beginInsertRows(QModelIndex(), row, row + int(cues.size()) - 1);
+    store_.insert(row, cues);
+    intervals_.insertRows(store_, row, int(cues.size()));
+    qc_.insertRows(store_, intervals_, row, int(cues.size()));
+    searchRowsInserted(row, int(cues.size()));
+    if (!diffFlags_.isEmpty()) diffFlags_.insert(row, cues.size(), 0);
+    spell_.insertRows(row, int(cues.size()));
+    trackLineNumbers(cues);
+    endInsertRows();
+    emitFlagsChanged(row - 1, row - 1);
+    emit qcChanged();
+    if (!searchText_.isEmpty()) emit searchChanged();
+}
+
+void SubtitleModel::removeCues(int first, int count) {
+    TRACE_SCOPE("SubtitleModel::removeCues");
+    if (first < 0 || count <= 0 || first + count > store_.size()) return;
+    beginRemoveRows(QModelIndex(), first, first + count - 1);
+    store_.remove(first, count);
+    intervals_.removeRows(first, count);
+    qc_.removeRows(store_, intervals_, first, count);
+    searchRowsRemoved(first, count);
+    if (!diffFlags_.isEmpty()) diffFlags_.remove(first, count);
+    spell_.removeRows(first, count);
+    endRemoveRows();
+    emitFlagsChanged(first - 1, first - 1);
+    emit qcChanged();
+    if (!searchText_.isEmpty()) emit searchChanged();
+}
+
+void SubtitleModel::setQcOptions(const QcOptions &options) {
+    qc_.setOptions(options);
+    qc_.checkAll(store_, intervals_);
+    if (!store_.isEmpty())
+        emit dataChanged(index(0, 0), index(rowCount() - 1, ColumnCount - 1), { QcFlagsRole, Qt::ToolTipRole });
+    emit qcChanged();
+}
+
+void SubtitleModel::setCpsOptions(const CpsOptions &options) {
+    if (options == SubtitleStore::cpsOptions()) return;
+    SubtitleStore::setCpsOptions(options);
+    store_.recountCharacters();
+    // reading speed depends on the counts
+    qc_.checkAll(store_, intervals_);
+    // the text itself is unchanged: leave its column (and its caches) alone
+    if (!store_.isEmpty())
+        emit dataChanged(index(0, 0), index(rowCount() - 1, CPS),
+                         { Qt::DisplayRole, QcFlagsRole, Qt::ToolTipRole });
+    emit qcChanged();
+}
+
+void SubtitleModel::spliceCues(const QVector<CueSplice> &splices) {
+    TRACE_SCOPE("SubtitleModel::spliceCues");
+    // past a few splices, per-splice row signals (and the index and QC
+    // updates behind each) cost more than rebuilding everything once
+    if (splices.size() > MaxIncrementalSplices) {
+        resetStore(store_.spliced(splices));
+        return;
+    }
+    // back to front, so earlier rows keep their numbers
+    for (qsizetype i = splices.size() - 1; i >= 0; --i) {
+        const CueSplice &s = splices.at(i);
+        removeCues(s.row, s.removed);
+        insertCues(s.row, s.inserted);
     }
+}
 
-    if (state == ExpectText && !cur.text.isEmpty()) {
-        cur.cps = computeCPS(cur);
-        tmp.append(cur);
+void SubtitleModel::replaceCues(int first, int count, const SubtitleStore &cues) {
+    TRACE_SCOPE("SubtitleModel::replaceCues");
+    if (first < 0 || count < 0 || first + count > store_.size()) return;
+    // rows on both sides are updated in place, so the view keeps its
+    // selection and scroll position; only the rest is inserted or removed
+    const int overlap = qMin(count, int(cues.size()));
+    int changedFirst = rowCount();
+    int changedLast = -1;
+    int retimedFirst = rowCount();
+    int retimedLast = -1;
+    bool matchChanged = false;
+    for (int i = 0; i < overlap; ++i) {
+        const int row = first + i;
+        bool changed = false;
+        if (store_.lineNumber(row) != cues.lineNumber(i)) {
+            store_.setLineNumber(row, cues.lineNumber(i));
+            maxLineNumber_ = qMax(maxLineNumber_, cues.lineNumber(i));
+            changed = true;
+        }
+        if (store_.startMs(row) != cues.startMs(i) || store_.endMs(row) != cues.endMs(i)) {
+            store_.setTiming(row, cues.startMs(i), cues.endMs(i));
+            retimedFirst = qMin(retimedFirst, row);
+            retimedLast = row;
+            changed = true;
+        }
+        if (store_.textView(row) != cues.textView(i)) {
+            store_.setText(row, cues.textView(i));
+            matchChanged |= searchRowChanged(row);
+            spell_.recheck(row);
+            changed = true;
+        }
+        changed |= store_.copyLayout(row, cues, i);
+        if (!changed) continue;
+        changedFirst = qMin(changedFirst, row);
+        changedLast = row;
+    }
+    if (changedFirst <= changedLast) {
+        if (retimedFirst <= retimedLast) intervals_.updateRows(store_, retimedFirst, retimedLast);
+        qc_.recheck(store_, intervals_, changedFirst, changedLast, retimedFirst <= retimedLast);
+        emit dataChanged(index(changedFirst, 0), index(changedLast, ColumnCount - 1),
+                         { Qt::DisplayRole, Qt::ToolTipRole, QcFlagsRole, MatchRole, SpellingRole });
+        if (retimedFirst <= retimedLast) emitFlagsChanged(retimedFirst - 1, retimedLast);
+        emit qcChanged();
+        if (matchChanged) emit searchChanged();
     }
 
-    beginResetModel();
-    entries_ = std::move(tmp);
-    endResetModel();
-    return true;
+    if (count > overlap) removeCues(first + overlap, count - overlap);
+    else if (cues.size() > overlap) insertCues(first + overlap, cues.mid(overlap, cues.size() - overlap));
 }
 
-double SubtitleModel::parseTimeToSeconds(const QString &timeStr) {
-    QString s = timeStr;
-    s.replace(',', '.');
-    QStringList parts = s.split(':');
-    if (parts.size() != 3) return 0.0;
-    double hh = parts[0].toDouble();
-    double mm = parts[1].toDouble();
-    double ss = parts[2].toDouble();
-    return hh * 3600.0 + mm * 60.0 + ss;
+void SubtitleModel::setHeaderAndFooter(const QString &header, const QString &footer) {
+    store_.setHeader(header);
+    store_.setFooter(footer);
 }
 
-int SubtitleModel::computeCPS(const SubtitleEntry &e) {
-    int chars = e.text.length();
-    double dur = e.durationSeconds;
-    if (dur <= 0.001) return 0;
-    double cps = chars / dur;
-    return static_cast<int>(std::round(cps));
+SubtitleStore SubtitleModel::cuesAt(int first, int count) const {
+    if (first < 0 || count <= 0 || first + count > store_.size()) return SubtitleStore();
+    return store_.mid(first, count);
 }
 
 void SubtitleModel::setTextAt(int row, const QString &text) {
-    if (row < 0 || row >= entries_.size()) return;
-    entries_[row].text = text;
-    entries_[row].cps = computeCPS(entries_[row]);
-    const QModelIndex top = index(row, Text);
-    const QModelIndex bottom = index(row, Text);
-    emit dataChanged(top, bottom, { Qt::DisplayRole });
-    // also update CPS column
-    emit dataChanged(index(row, CPS), index(row, CPS), { Qt::DisplayRole });
-}
-
-bool SubtitleModel::saveSrt(const QString &filePath) const {
-    QFile f(filePath);
-    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
-    QTextStream out(&f);
-    out.setGenerateByteOrderMark(false);
-    // write each entry in SRT format
-    for (int i = 0; i < entries_.size(); ++i) {
-        const SubtitleEntry &e = entries_.at(i);
-        // write index (use original lineNumber when present; otherwise i+1)
-        const int idx = (e.lineNumber > 0) ? e.lineNumber : (i + 1);
-        out << idx << '\n';
-        out << e.startTime << " --> " << e.endTime << '\n';
-
-        // write text (already may contain newlines)
-        const QStringList lines = e.text.split('\n');
-        for (const QString &ln : lines) {
-            out << ln << '\n';
-        }
+    if (row < 0 || row >= store_.size()) return;
+    store_.setText(row, text);
+    qc_.recheck(store_, intervals_, row, row, false);
+    const bool matchChanged = searchRowChanged(row);
+    spell_.recheck(row);
+    // the QC flags show in every column (the '#' highlight, the tooltips)
+    emit dataChanged(index(row, LineNumber), index(row, Text),
+                     { Qt::DisplayRole, Qt::ToolTipRole, QcFlagsRole, MatchRole, SpellingRole });
+    emit qcChanged();
+    if (matchChanged) emit searchChanged();
+}
 
-        // blank separator
-        out << '\n';
+void SubtitleModel::setTexts(const QVector<int> &rows, const QStringList &texts) {
+    TRACE_SCOPE("SubtitleModel::setTexts");
+    int first = rowCount();
+    int last = -1;
+    bool matchChanged = false;
+    for (qsizetype i = 0; i < rows.size() && i < texts.size(); ++i) {
+        const int row = rows.at(i);
+        if (row < 0 || row >= store_.size()) continue;
+        store_.setText(row, texts.at(i));
+        qc_.recheck(store_, intervals_, row, row, false);
+        matchChanged |= searchRowChanged(row);
+        spell_.recheck(row);
+        first = qMin(first, row);
+        last = qMax(last, row);
     }
-    f.close();
+    if (first > last) return;
+    emit dataChanged(index(first, LineNumber), index(last, Text),
+                     { Qt::DisplayRole, Qt::ToolTipRole, QcFlagsRole, MatchRole, SpellingRole });
+    emit qcChanged();
+    if (matchChanged) emit searchChanged();
+}
+
+void SubtitleModel::setSearch(const QString &needle, Qt::CaseSensitivity cs) {
+    TRACE_SCOPE("SubtitleModel::setSearch");
+    if (needle == searchText_ && cs == searchCase_) return;
+    const QVector<int> before = searchMatches();
+    searchText_ = needle;
+    searchCase_ = cs;
+    matchFlags_.clear();
+    matchRows_.clear();
+    if (!needle.isEmpty()) {
+        if (!search_.isBuilt()) search_.rebuild(store_);
+        matchRows_ = search_.find(store_, needle, cs);
+        matchFlags_.resize(store_.size());
+        for (int row : std::as_const(matchRows_)) matchFlags_[row] = true;
+    }
+    matchRowsValid_ = true;
+
+    // repaint the old and the new matches
+    int first = rowCount();
+    int last = -1;
+    for (const QVector<int> *rows : { &before, &matchRows_ }) {
+        if (rows->isEmpty()) continue;
+        first = qMin(first, rows->first());
+        last = qMax(last, rows->last());
+    }
+    if (first <= last) emit dataChanged(index(first, 0), index(last, ColumnCount - 1), { MatchRole });
+    emit searchChanged();
+}
+
+void SubtitleModel::setDiffFlags(QVector<quint8> flags) {
+    if (flags.isEmpty() && diffFlags_.isEmpty()) return;
+    flags.resize(flags.isEmpty() ? 0 : store_.size());
+    diffFlags_ = std::move(flags);
+    if (!store_.isEmpty())
+        emit dataChanged(index(0, 0), index(rowCount() - 1, ColumnCount - 1), { DiffRole, Qt::ToolTipRole });
+}
+
+void SubtitleModel::setSpellDictionary(std::shared_ptr<const SpellDictionary> dictionary) {
+    spell_.setDictionary(std::move(dictionary));
+    // the old words are gone; the new ones come with SpellChecker::finished
+    if (!store_.isEmpty()) emit dataChanged(index(0, Text), index(rowCount() - 1, Text), { SpellingRole });
+}
+
+void SubtitleModel::checkSpelling() {
+    spell_.checkAll();
+}
+
+const QVector<int> &SubtitleModel::searchMatches() const {
+    if (!matchRowsValid_) {
+        matchRows_.clear();
+        for (int row = 0; row < matchFlags_.size(); ++row) {
+            if (matchFlags_.at(row)) matchRows_.append(row);
+        }
+        matchRowsValid_ = true;
+    }
+    return matchRows_;
+}
+
+void SubtitleModel::searchRowsInserted(int first, int count) {
+    search_.insertRows(store_, first, count);
+    if (searchText_.isEmpty()) return;
+    matchFlags_.insert(first, count, false);
+    for (int row = first; row < first + count; ++row)
+        matchFlags_[row] = SearchIndex::matches(store_.textView(row), searchText_, searchCase_);
+    matchRowsValid_ = false;
+}
+
+void SubtitleModel::searchRowsRemoved(int first, int count) {
+    search_.removeRows(store_, first, count);
+    if (searchText_.isEmpty()) return;
+    matchFlags_.remove(first, count);
+    matchRowsValid_ = false;
+}
+
+bool SubtitleModel::searchRowChanged(int row) {
+    search_.updateRow(store_, row);
+    if (searchText_.isEmpty()) return false;
+    const bool match = SearchIndex::matches(store_.textView(row), searchText_, searchCase_);
+    if (match == matchFlags_.at(row)) return false;
+    matchFlags_[row] = match;
+    matchRowsValid_ = false;
     return true;
 }
+
+QString SubtitleModel::textAt(int row) const {
+    if (row < 0 || row >= store_.size()) return QString();
+    return store_.text(row);
+}
+
+int SubtitleModel::durationMsAt(int row) const {
+    if (row < 0 || row >= store_.size()) return 0;
+    return store_.durationMs(row);
+}
+
+void SubtitleModel::retime(int first, int last, const std::function<void(int *, qsizetype)> &op) {
+    TRACE_SCOPE("SubtitleModel::retime");
+    first = qMax(0, first);
+    last = qMin(last, rowCount() - 1);
+    if (first > last) return;
+    const qsizetype n = last - first + 1;
+    op(store_.startMsData() + first, n);
+    op(store_.endMsData() + first, n);
+    store_.updateCps(first, last);
+    intervals_.updateRows(store_, first, last);
+    qc_.recheck(store_, intervals_, first, last, true);
+    emit dataChanged(index(first, StartTime), index(last, CPS), { Qt::DisplayRole });
+    emitFlagsChanged(first - 1, last);
+    emit qcChanged();
+}
+
+void SubtitleModel::emitFlagsChanged(int first, int last) {
+    if (store_.isEmpty()) return;
+    const QList<int> roles { OverlapRole, QcFlagsRole, Qt::ToolTipRole };
+    if (intervals_.allOverlapsChanged()) {
+        emit dataChanged(index(0, 0), index(rowCount() - 1, ColumnCount - 1), roles);
+        return;
+    }
+    first = qMax(0, first);
+    last = qMin(last, rowCount() - 1);
+    if (first <= last) emit dataChanged(index(first, 0), index(last, ColumnCount - 1), roles);
+    QVector<int> rows;
+    for (int row : intervals_.overlapChanges()) {
+        if (row < first || row > last) rows.append(row);
+    }
+    std::sort(rows.begin(), rows.end());
+    // one signal per run of adjacent rows
+    for (qsizetype i = 0; i < rows.size();) {
+        qsizetype j = i + 1;
+        while (j < rows.size() && rows.at(j) <= rows.at(j - 1) + 1) ++j;
+        emit dataChanged(index(rows.at(i), 0), index(rows.at(j - 1), ColumnCount - 1), roles);
+        i = j;
+    }
+}
+
+void SubtitleModel::shiftTimes(int first, int last, int deltaMs) {
+    retime(first, last, [deltaMs](int *t, qsizetype n) {
+        TimingEngine::shift(t, n, deltaMs, SubtitleStore::NoTime);
+    });
+}
+
+void SubtitleModel::syncTimes(int first, int last, int fromA, int toA, int fromB, int toB) {
+    retime(first, last, [=](int *t, qsizetype n) {
+        TimingEngine::sync(t, n, fromA, toA, fromB, toB, SubtitleStore::NoTime);
+    });
+}
+
+void SubtitleModel::convertFramerate(int first, int last, Framerate from, Framerate to) {
+    retime(first, last, [=](int *t, qsizetype n) {
+        TimingEngine::convertFramerate(t, n, from, to, SubtitleStore::NoTime);
+    });
+}
+
+void SubtitleModel::snapToFrames(int first, int last, Framerate fps) {
+    retime(first, last, [fps](int *t, qsizetype n) {
+        TimingEngine::snapToFrame(t, n, fps, SubtitleStore::NoTime);
+    });
+}
+
+void SubtitleModel::timingsInRange(int first, int last, QVector<int> &starts, QVector<int> &ends) const {
+    const qsizetype n = qMax(0, last - first + 1);
+    starts = QVector<int>(store_.startMsData() + first, store_.startMsData() + first + n);
+    ends = QVector<int>(store_.endMsData() + first, store_.endMsData() + first + n);
+}
+
+void SubtitleModel::addTimingDeltas(int first, const QVector<int> &startDeltas,
+                                    const QVector<int> &endDeltas, int sign)
+{
+    const int last = first + int(startDeltas.size()) - 1;
+    if (first < 0 || last >= store_.size() || first > last) return;
+    int *starts = store_.startMsData() + first;
+    int *ends = store_.endMsData() + first;
+    const int *ds = startDeltas.constData();
+    const int *de = endDeltas.constData();
+    for (qsizetype i = 0; i < startDeltas.size(); ++i) {
+        starts[i] += sign * ds[i];
+        ends[i] += sign * de[i];
+    }
+    store_.updateCps(first, last);
+    intervals_.updateRows(store_, first, last);
+    qc_.recheck(store_, intervals_, first, last, true);
+    emit dataChanged(index(first, StartTime), index(last, CPS), { Qt::DisplayRole });
+    emitFlagsChanged(first - 1, last);
+    emit qcChanged();
+}
+
+bool SubtitleModel::saveSrt(const QString &filePath) {
+    TRACE_SCOPE("SubtitleModel::saveSrt");
+    store_.compact();
+    return SubtitleFile::write(filePath, store_);
+}
+
+SubtitleStore SubtitleModel::snapshot() {
+    TRACE_SCOPE("SubtitleModel::snapshot");
+    store_.compact();
+    return store_;
+}
+
+SubtitleStore SubtitleModel::cues() {
+    if (store_.staleChars() > store_.liveChars()) store_.compact();
+    return store_;
+}
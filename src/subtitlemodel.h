@@ -1,16 +1,16 @@
 #pragma once
 #include <QAbstractTableModel>
 #include <QString>
-#include <QVector>
-
-struct SubtitleEntry {
-    int lineNumber = 0;
-    QString startTime;
-    QString endTime;
-    double durationSeconds = 0.0;
-    int cps = 0;
-    QString text;
-};
+#include <QStringList>
+#include <functional>
+#include <memory>
+#include "intervalindex.h"
+#include "qcengine.h"
+#include "searchindex.h"
+#include "spellchecker.h"
+#include "subtitlediff.h"
+#include "subtitlestore.h"
+#include "timingengine.h"
 
 class SubtitleModel : public QAbstractTableModel {
     Q_OBJECT
@@ -24,9 +24,100 @@ public:
 
     bool loadSrt(const QString &filePath);
     void clear();
+    // Appends a batch of parsed cues as new rows (used while loading).
+    void appendCues(const SubtitleStore &batch);
+
+    // Inserts 'cues' before 'row' (row == rowCount() appends) / removes rows
+    // [first, first + count).
+    void insertCues(int row, const SubtitleStore &cues);
+    void removeCues(int first, int count);
+    // Applies ascending splices (see SubtitleStore::spliced) at once: a few
+    // as row insertions and removals, many as one model reset.
+    void spliceCues(const QVector<CueSplice> &splices);
+    // Replaces rows [first, first + count) with 'cues' (a file reloaded in
+    // part): rows present on both sides are updated in place (number,
+    // timing, text, layout) with one dataChanged, the rest inserted or
+    // removed.
+    void replaceCues(int first, int count, const SubtitleStore &cues);
+    // Document text around the cues (see SubtitleStore::header()).
+    void setHeaderAndFooter(const QString &header, const QString &footer);
+    SubtitleStore cuesAt(int first, int count) const;
 
     void setTextAt(int row, const QString &text);
-    bool saveSrt(const QString &filePath) const;
+    // Replaces the text of several rows at once: one dataChanged over their
+    // span and one qcChanged, however many rows there are.
+    void setTexts(const QVector<int> &rows, const QStringList &texts);
+    QString textAt(int row) const;
+    int durationMsAt(int row) const;
+    // Largest line number loaded or inserted since the last clear (removing
+    // rows does not lower it). Bounds the width of the '#' column; the
+    // numbers past it are free for new cues.
+    int maxLineNumber() const { return maxLineNumber_; }
+    // Gives the cues 'splices' insert line numbers no other cue has, for cues
+    // taken from another document (a compare or merge): a cue replacing one
+    // takes its number, any other the next free one.
+    void numberInsertedCues(QVector<CueSplice> &splices) const;
+    // Timing index, kept up to date by every edit: active cue at a time,
+    // overlaps (also exposed per row as OverlapRole).
+    const IntervalIndex &intervals() const { return intervals_; }
+    // Quality check results, kept up to date like the interval index (also
+    // exposed per row as QcFlagsRole and in the tooltips).
+    const QcEngine &qc() const { return qc_; }
+    // Runs a full check with the new limits.
+    void setQcOptions(const QcOptions &options);
+    // Makes 'options' the process-wide CPS rules and recounts every cue.
+    void setCpsOptions(const CpsOptions &options);
+    // Find: the rows whose text contains the search text, kept up to date by
+    // every edit (also exposed per row as MatchRole). The trigram index
+    // behind it is built by the first search.
+    void setSearch(const QString &needle, Qt::CaseSensitivity cs);
+    QString searchText() const { return searchText_; }
+    Qt::CaseSensitivity searchCaseSensitivity() const { return searchCase_; }
+    // Matching rows, ascending.
+    const QVector<int> &searchMatches() const;
+    // Marks of a comparison with another version of the document, one
+    // SubtitleDiff::RowFlag set per row (also exposed as DiffRole and in the
+    // tooltips). Rows inserted later get none; an empty vector clears them.
+    void setDiffFlags(QVector<quint8> flags);
+    // Spell checking against 'dictionary' (null turns it off), kept up to
+    // date like the QC results: edits re-check the rows they touch, a new
+    // document or dictionary is checked in the background (also exposed per
+    // row as SpellingRole).
+    void setSpellDictionary(std::shared_ptr<const SpellDictionary> dictionary);
+    const SpellChecker &spelling() const { return spell_; }
+    // Checks every row in the background: rows appended by a load are not
+    // checked until it finishes.
+    void checkSpelling();
+    // Also compacts the text arena, dropping text replaced by edits.
+    bool saveSrt(const QString &filePath);
+    // Compacted copy of the cues for saving off the GUI thread. Cheap: the
+    // data is shared until the next edit.
+    SubtitleStore snapshot();
+    // Shared copy for background readers that ask often, such as the diff:
+    // the arena is compacted only once stale text outweighs the live text,
+    // so a call between two edits does not cost O(file).
+    SubtitleStore cues();
+
+    // Bulk retiming of rows [first, last]; each emits a single dataChanged
+    // over the range, plus the mark changes of emitFlagsChanged().
+    void shiftTimes(int first, int last, int deltaMs);
+    void syncTimes(int first, int last, int fromA, int toA, int fromB, int toB);
+    void convertFramerate(int first, int last, Framerate from, Framerate to);
+    void snapToFrames(int first, int last, Framerate fps);
+
+    // Timing snapshot of rows [first, last], and per-row deltas applied from
+    // 'first' on (sign +1 or -1). Used by the edit history to undo bulk
+    // retimes without a model reset.
+    void timingsInRange(int first, int last, QVector<int> &starts, QVector<int> &ends) const;
+    void addTimingDeltas(int first, const QVector<int> &startDeltas, const QVector<int> &endDeltas, int sign);
+
+    enum Role {
+        OverlapRole = Qt::UserRole + 1, // bool: the cue overlaps another one
+        QcFlagsRole,                    // int: QcEngine::Issue bits of the cue
+        MatchRole,                      // bool: the cue matches the search text
+        DiffRole,                       // int: SubtitleDiff::RowFlag bits of the cue
+        SpellingRole                    // QList<int>: start and length of each misspelled word in the display text
+    };
 
     enum Column {
         LineNumber = 0,
@@ -37,10 +128,42 @@ public:
         ColumnCount
     };
 
+signals:
+    // The QC results changed (counts or flags of some rows).
+    void qcChanged();
+    // The search text or the set of matching rows changed.
+    void searchChanged();
+
 private:
-    QVector<SubtitleEntry> entries_;
-    static double parseTimeToSeconds(const QString &timeStr);
-    static int computeCPS(const SubtitleEntry &e);
+    // Runs 'op' over the start and end arrays of rows [first, last].
+    void retime(int first, int last, const std::function<void(int *, qsizetype)> &op);
+    // After a timing change: repaints the overlap and QC marks of rows
+    // [first, last] (the edited rows and the one before, whose gap moved)
+    // and of the rows whose overlap flag the index update changed.
+    void emitFlagsChanged(int first, int last);
+    // Display text: one line, line breaks shown as a marker.
+    QString summarizedText(int row) const;
+    void trackLineNumbers(const SubtitleStore &cues);
+    // Replaces the whole document (one model reset).
+    void resetStore(SubtitleStore &&store);
+    // Keep the search index and match flags in step with the store.
+    void searchRowsInserted(int first, int count);
+    void searchRowsRemoved(int first, int count);
+    bool searchRowChanged(int row); // true if the row's match changed
+    QVariant misspelledSpans(int row) const;
+
+    SubtitleStore store_;
+    IntervalIndex intervals_;
+    QcEngine qc_;
+    int maxLineNumber_ = 0;
+    SearchIndex search_;
+    QString searchText_;
+    Qt::CaseSensitivity searchCase_ = Qt::CaseInsensitive;
+    QVector<bool> matchFlags_;            // by row; empty when not searching
+    mutable QVector<int> matchRows_;
+    mutable bool matchRowsValid_ = true;
+    QVector<quint8> diffFlags_;           // by row; empty when not comparing
+    SpellChecker spell_;                  // reads store_
 
-    friend class MainWindow; // optional: main window can access entries_ if needed
+    friend class MainWindow; // optional: main window can access store_ if needed
 };
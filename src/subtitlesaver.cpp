@@ -0,0 +1,41 @@
+#include "subtitlesaver.h"
+#include "subtitlefile.h"
+#include <QtConcurrent>
+#include <utility>
+
+SubtitleSaver::SubtitleSaver(QObject *parent) : QObject(parent) {
+    connect(&watcher_, &QFutureWatcher<bool>::finished, this, &SubtitleSaver::onFinished);
+}
+
+SubtitleSaver::~SubtitleSaver() {
+    // never leave a save half done; QSaveFile would discard it
+    watcher_.waitForFinished();
+}
+
+bool SubtitleSaver::start(const QString &filePath, const SubtitleStore &snapshot, const SrtWriteOptions &options) {
+    if (isRunning()) return false;
+    filePath_ = filePath;
+    reported_ = false;
+    // the buffer is kept only while the file is written the same way
+    if (writer_.options() != options) writer_ = SrtWriter(options);
+    watcher_.setFuture(QtConcurrent::run([this, filePath, snapshot] {
+        return SubtitleFile::write(filePath, snapshot, writer_);
+    }));
+    return true;
+}
+
+bool SubtitleSaver::isRunning() const {
+    return watcher_.isRunning();
+}
+
+bool SubtitleSaver::waitForFinished() {
+    watcher_.waitForFinished();
+    // report it now: the watcher only notifies from the event loop
+    onFinished();
+    return watcher_.future().resultCount() > 0 && watcher_.result();
+}
+
+void SubtitleSaver::onFinished() {
+    if (std::exchange(reported_, true)) return;
+    emit finished(watcher_.future().resultCount() > 0 && watcher_.result(), filePath_);
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <QFutureWatcher>
+#include <QObject>
+#include <QString>
+#include "srtwriter.h"
+#include "subtitlestore.h"
+
+// Writes a snapshot of the cues on a worker thread, so editing goes on while a
+// large file is saved. The write is atomic (see SubtitleFile::write) and the
+// encode buffer is reused from one save to the next.
+class SubtitleSaver : public QObject {
+    Q_OBJECT
+public:
+    explicit SubtitleSaver(QObject *parent = nullptr);
+    ~SubtitleSaver() override;
+
+    // Returns false if a save is already running.
+    bool start(const QString &filePath, const SubtitleStore &snapshot, const SrtWriteOptions &options = {});
+    bool isRunning() const;
+    // Blocks until the current save is done and returns its result.
+    // finished() is emitted before it returns, once per save.
+    bool waitForFinished();
+    // Characters the last save's encoding could not represent (the save
+    // failed because of them); empty while a save runs.
+    QString unencodable() const { return isRunning() ? QString() : writer_.unencodable(); }
+
+signals:
+    void finished(bool ok, const QString &filePath);
+
+private:
+    void onFinished();
+
+    QString filePath_;
+    bool reported_ = true; // finished() was emitted for the last save
+    SrtWriter writer_; // used by the worker only while a save runs
+    QFutureWatcher<bool> watcher_;
+};
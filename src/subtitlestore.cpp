@@ -0,0 +1,440 @@
+#include "subtitlestore.h"
+#include <QChar>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace {
+
+// Packed CpsOptions (bit 0: spaces, bit 1: line breaks), read by the loader
+// threads while the GUI may change it.
+std::atomic<unsigned> cpsRules{1u};
+
+// Code points that attach to the previous grapheme instead of starting one:
+// combining marks, invisible format characters (ZWNJ, bidi marks, ...),
+// variation selectors, emoji skin tones and Hangul medial/final jamo.
+bool extendsGrapheme(char32_t cp) {
+    if ((cp >= 0xFE00 && cp <= 0xFE0F) || (cp >= 0xE0100 && cp <= 0xE01EF)
+        || (cp >= 0x1F3FB && cp <= 0x1F3FF)
+        || (cp >= 0x1160 && cp <= 0x11FF) || (cp >= 0xD7B0 && cp <= 0xD7FF))
+        return true;
+    switch (QChar::category(cp)) {
+    case QChar::Mark_NonSpacing:
+    case QChar::Mark_SpacingCombining:
+    case QChar::Mark_Enclosing:
+    case QChar::Other_Format:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool isRegionalIndicator(char32_t cp) {
+    return cp >= 0x1F1E6 && cp <= 0x1F1FF;
+}
+
+// '<' starting an HTML-style tag (<i>, </font>, <font color=...>): returns
+// the position after its '>', or nullptr if it is just a '<'.
+const char16_t *skipTag(const char16_t *p, const char16_t *end) {
+    if (p + 1 >= end) return nullptr;
+    const char16_t c = p[1];
+    if (c != u'/' && !((c | 0x20) >= u'a' && (c | 0x20) <= u'z')) return nullptr;
+    for (const char16_t *q = p + 2; q < end; ++q) {
+        if (*q == u'>') return q + 1;
+        if (*q == u'<' || *q == u'\n') return nullptr;
+    }
+    return nullptr;
+}
+
+// '{' starting an override block ({\an8}, {\i1}): returns the position after
+// its '}', or nullptr if it is plain text.
+const char16_t *skipOverride(const char16_t *p, const char16_t *end) {
+    if (p + 1 >= end || p[1] != u'\\') return nullptr;
+    for (const char16_t *q = p + 2; q < end; ++q) {
+        if (*q == u'}') return q + 1;
+        if (*q == u'\n') return nullptr;
+    }
+    return nullptr;
+}
+
+// Writes 'value' as at least 'width' decimal digits.
+template <typename Char>
+Char *writeDigits(Char *out, int value, int width) {
+    Char tmp[12];
+    int n = 0;
+    do {
+        tmp[n++] = Char('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (n < width) tmp[n++] = Char('0');
+    while (n > 0) *out++ = tmp[--n];
+    return out;
+}
+
+template <typename Char>
+Char *writeTime(Char *p, int ms) {
+    ms = qBound(0, ms, SubtitleStore::MaxTime);
+    p = writeDigits(p, ms / 3600000, 2);
+    *p++ = Char(':');
+    p = writeDigits(p, (ms / 60000) % 60, 2);
+    *p++ = Char(':');
+    p = writeDigits(p, (ms / 1000) % 60, 2);
+    *p++ = Char(',');
+    return writeDigits(p, ms % 1000, 3);
+}
+
+} // namespace
+
+void SubtitleStore::clear() {
+    *this = SubtitleStore();
+}
+
+void SubtitleStore::reserve(qsizetype cues, qsizetype textChars) {
+    lineNumbers_.reserve(cues);
+    startMs_.reserve(cues);
+    endMs_.reserve(cues);
+    cps_.reserve(cues);
+    chars_.reserve(cues);
+    textOffsets_.reserve(cues);
+    textLengths_.reserve(cues);
+    arena_.reserve(textChars);
+}
+
+int SubtitleStore::durationMs(qsizetype i) const {
+    const int s = startMs_.at(i);
+    const int e = endMs_.at(i);
+    if (s == NoTime || e == NoTime) return 0;
+    return qMax(0, e - s);
+}
+
+void SubtitleStore::pushRow(int lineNumber, int startMs, int endMs, qsizetype offset, qsizetype length) {
+    lineNumbers_.append(lineNumber);
+    startMs_.append(startMs);
+    endMs_.append(endMs);
+    textOffsets_.append(offset);
+    textLengths_.append(int(length));
+    liveChars_ += length;
+    if (hasLayout()) layouts_.append(CueLayout());
+    const qsizetype row = lineNumbers_.size() - 1;
+    chars_.append(visibleCharacters(textView(row)));
+    cps_.append(computeCPS(chars_.last(), durationMs(row)));
+}
+
+void SubtitleStore::append(int lineNumber, int startMs, int endMs, QStringView text) {
+    const qsizetype offset = arena_.size();
+    arena_.append(text);
+    pushRow(lineNumber, startMs, endMs, offset, text.size());
+}
+
+void SubtitleStore::append(const SubtitleStore &other) {
+    // an empty store takes everything, header and footer included
+    if (isEmpty() && arena_.isEmpty()) {
+        *this = other;
+        return;
+    }
+    if (other.isEmpty()) return;
+    const qsizetype base = arena_.size();
+    const qsizetype first = textOffsets_.size();
+    lineNumbers_.append(other.lineNumbers_);
+    startMs_.append(other.startMs_);
+    endMs_.append(other.endMs_);
+    cps_.append(other.cps_);
+    chars_.append(other.chars_);
+    textLengths_.append(other.textLengths_);
+    textOffsets_.append(other.textOffsets_);
+    qsizetype *offsets = textOffsets_.data();
+    for (qsizetype i = first; i < textOffsets_.size(); ++i) offsets[i] += base;
+    arena_.append(other.arena_);
+    liveChars_ += other.liveChars_;
+    adoptLayouts(first, other);
+}
+
+void SubtitleStore::insert(qsizetype row, const SubtitleStore &cues) {
+    if (cues.isEmpty()) return;
+    if (row >= size()) {
+        append(cues);
+        return;
+    }
+    const qsizetype n = cues.size();
+    lineNumbers_.insert(row, n, 0);
+    startMs_.insert(row, n, 0);
+    endMs_.insert(row, n, 0);
+    cps_.insert(row, n, 0);
+    chars_.insert(row, n, 0);
+    textOffsets_.insert(row, n, 0);
+    textLengths_.insert(row, n, 0);
+    for (qsizetype i = 0; i < n; ++i) {
+        const qsizetype r = row + i;
+        lineNumbers_[r] = cues.lineNumbers_.at(i);
+        startMs_[r] = cues.startMs_.at(i);
+        endMs_[r] = cues.endMs_.at(i);
+        cps_[r] = cues.cps_.at(i);
+        chars_[r] = cues.chars_.at(i);
+        textOffsets_[r] = arena_.size();
+        textLengths_[r] = cues.textLengths_.at(i);
+        arena_.append(cues.textView(i));
+        liveChars_ += cues.textLengths_.at(i);
+    }
+    adoptLayouts(row, cues);
+}
+
+void SubtitleStore::remove(qsizetype first, qsizetype count) {
+    if (count <= 0) return;
+    for (qsizetype i = first; i < first + count; ++i) liveChars_ -= textLengths_.at(i);
+    lineNumbers_.remove(first, count);
+    startMs_.remove(first, count);
+    endMs_.remove(first, count);
+    cps_.remove(first, count);
+    chars_.remove(first, count);
+    textOffsets_.remove(first, count);
+    textLengths_.remove(first, count);
+    if (hasLayout()) layouts_.remove(first, count);
+}
+
+SubtitleStore SubtitleStore::mid(qsizetype first, qsizetype count) const {
+    SubtitleStore out;
+    qsizetype chars = 0;
+    for (qsizetype i = first; i < first + count; ++i) chars += textLengths_.at(i);
+    out.reserve(count, chars);
+    for (qsizetype i = first; i < first + count; ++i)
+        out.append(lineNumbers_.at(i), startMs_.at(i), endMs_.at(i), textView(i));
+    if (hasLayout()) {
+        out.layouts_ = layouts_.mid(first, count);
+        out.layoutStrings_ = layoutStrings_;
+        out.layoutStringIds_ = layoutStringIds_;
+    }
+    return out;
+}
+
+SubtitleStore SubtitleStore::spliced(const QVector<CueSplice> &splices) const {
+    SubtitleStore out;
+    qsizetype at = 0;
+    for (const CueSplice &s : splices) {
+        out.append(mid(at, s.row - at));
+        out.append(s.inserted);
+        at = s.row + s.removed;
+    }
+    out.append(mid(at, size() - at));
+    out.header_ = header_;
+    out.footer_ = footer_;
+    return out;
+}
+
+void SubtitleStore::adoptLayouts(qsizetype row, const SubtitleStore &other) {
+    const qsizetype n = other.size();
+    if (!other.hasLayout()) {
+        if (hasLayout()) layouts_.insert(row, n, CueLayout());
+        return;
+    }
+    if (!hasLayout()) layouts_.fill(CueLayout(), size() - n);
+    // the string ids of 'other' mean nothing here
+    QVector<int> ids(other.layoutStrings_.size());
+    for (qsizetype i = 0; i < ids.size(); ++i) ids[i] = layoutStringId(other.layoutStrings_.at(i));
+    layouts_.insert(row, n, CueLayout());
+    for (qsizetype i = 0; i < n; ++i) {
+        CueLayout l = other.layouts_.at(i);
+        l.style = ids.at(l.style);
+        l.actor = ids.at(l.actor);
+        l.effect = ids.at(l.effect);
+        l.identifier = ids.at(l.identifier);
+        l.settings = ids.at(l.settings);
+        layouts_[row + i] = l;
+    }
+}
+
+void SubtitleStore::setLayout(qsizetype i, const CueLayout &layout) {
+    if (!hasLayout()) {
+        if (layout == CueLayout()) return;
+        layouts_.fill(CueLayout(), size());
+    }
+    layouts_[i] = layout;
+}
+
+int SubtitleStore::layoutStringId(const QString &text) {
+    if (text.isEmpty()) return 0;
+    const auto it = layoutStringIds_.constFind(text);
+    if (it != layoutStringIds_.cend()) return *it;
+    const int id = int(layoutStrings_.size());
+    layoutStrings_.append(text);
+    layoutStringIds_.insert(text, id);
+    return id;
+}
+
+bool SubtitleStore::sameLayout(const SubtitleStore &a, qsizetype i, const SubtitleStore &b, qsizetype j) {
+    if (!a.hasLayout() && !b.hasLayout()) return true;
+    const CueLayout x = a.layout(i);
+    const CueLayout y = b.layout(j);
+    return x.layer == y.layer && x.marginL == y.marginL && x.marginR == y.marginR && x.marginV == y.marginV
+           && x.comment == y.comment && a.layoutString(x.style) == b.layoutString(y.style)
+           && a.layoutString(x.actor) == b.layoutString(y.actor)
+           && a.layoutString(x.effect) == b.layoutString(y.effect)
+           && a.layoutString(x.identifier) == b.layoutString(y.identifier)
+           && a.layoutString(x.settings) == b.layoutString(y.settings);
+}
+
+bool SubtitleStore::copyLayout(qsizetype i, const SubtitleStore &other, qsizetype j) {
+    if (sameLayout(*this, i, other, j)) return false;
+    CueLayout l = other.layout(j);
+    for (int *id : { &l.style, &l.actor, &l.effect, &l.identifier, &l.settings })
+        *id = layoutStringId(other.layoutStrings_.at(*id));
+    setLayout(i, l);
+    return true;
+}
+
+void SubtitleStore::setText(qsizetype i, QStringView text) {
+    // 'text' may point into the arena, which can move while appending
+    const QChar *arenaBegin = arena_.constData();
+    if (text.data() >= arenaBegin && text.data() < arenaBegin + arena_.size()) {
+        setText(i, QStringView(text.toString()));
+        return;
+    }
+    liveChars_ -= textLengths_.at(i);
+    textOffsets_[i] = arena_.size();
+    textLengths_[i] = int(text.size());
+    arena_.append(text);
+    liveChars_ += text.size();
+    chars_[i] = visibleCharacters(text);
+    cps_[i] = computeCPS(chars_.at(i), durationMs(i));
+}
+
+void SubtitleStore::setTiming(qsizetype i, int startMs, int endMs) {
+    startMs_[i] = startMs;
+    endMs_[i] = endMs;
+    cps_[i] = computeCPS(chars_.at(i), durationMs(i));
+}
+
+void SubtitleStore::updateCps(qsizetype first, qsizetype last) {
+    // timings only: the character counts are cached
+    const int *chars = chars_.constData();
+    int *cps = cps_.data();
+    for (qsizetype i = first; i <= last; ++i)
+        cps[i] = computeCPS(chars[i], durationMs(i));
+}
+
+void SubtitleStore::recountCharacters() {
+    const CpsOptions options = cpsOptions();
+    for (qsizetype i = 0; i < size(); ++i) {
+        chars_[i] = visibleCharacters(textView(i), options);
+        cps_[i] = computeCPS(chars_.at(i), durationMs(i));
+    }
+}
+
+QChar *SubtitleStore::beginText(qsizetype maxChars) {
+    pendingText_ = arena_.size();
+    arena_.resize(pendingText_ + maxChars);
+    return arena_.data() + pendingText_;
+}
+
+void SubtitleStore::commitCue(int lineNumber, int startMs, int endMs, const QChar *textEnd) {
+    Q_ASSERT(pendingText_ >= 0);
+    const qsizetype length = textEnd - (arena_.constData() + pendingText_);
+    arena_.resize(pendingText_ + length);
+    pushRow(lineNumber, startMs, endMs, pendingText_, length);
+    pendingText_ = -1;
+}
+
+void SubtitleStore::compact() {
+    if (staleChars() == 0) return;
+    QString packed;
+    packed.reserve(liveChars_);
+    for (qsizetype i = 0; i < size(); ++i) {
+        const qsizetype offset = packed.size();
+        packed.append(textView(i));
+        textOffsets_[i] = offset;
+    }
+    arena_ = std::move(packed);
+}
+
+QString SubtitleStore::formatTime(int ms) {
+    if (ms == NoTime) return QString();
+    char16_t buf[24];
+    const char16_t *end = writeTime(buf, ms);
+    return QString(reinterpret_cast<const QChar *>(buf), end - buf);
+}
+
+char *SubtitleStore::formatTime(int ms, char *out) {
+    if (ms == NoTime) return out;
+    return writeTime(out, ms);
+}
+
+int SubtitleStore::computeCPS(QStringView text, int durationMs) {
+    return computeCPS(visibleCharacters(text), durationMs);
+}
+
+int SubtitleStore::computeCPS(qsizetype chars, int durationMs) {
+    // anything up to 1 ms counts as no duration
+    if (durationMs <= 1) return 0;
+    return static_cast<int>(std::min(std::round(chars * 1000.0 / durationMs), double(MaxCps)));
+}
+
+int SubtitleStore::visibleCharacters(QStringView text, const CpsOptions &options) {
+    const char16_t *p = text.utf16();
+    const char16_t *const end = p + text.size();
+    int count = 0;
+    bool joinNext = false;       // previous code point was a ZWJ
+    bool pairedIndicator = false; // previous code point opened a flag
+    while (p < end) {
+        const char16_t c = *p;
+        if (c < 0x80) {
+            // ASCII: markup, line breaks and spaces are the only special cases
+            joinNext = pairedIndicator = false;
+            if (c == u'<') {
+                if (const char16_t *q = skipTag(p, end)) { p = q; continue; }
+            } else if (c == u'{') {
+                if (const char16_t *q = skipOverride(p, end)) { p = q; continue; }
+            } else if (c == u'\\' && p + 1 < end && (p[1] == u'N' || p[1] == u'n')) {
+                // ASS hard line break
+                count += options.countLineBreaks;
+                p += 2;
+                continue;
+            }
+            ++p;
+            if (c == u'\n')
+                count += options.countLineBreaks;
+            else if (c == u' ' || c == u'\t')
+                count += options.countSpaces;
+            else if (c >= 0x20 && c != 0x7F)
+                ++count;
+            continue;
+        }
+
+        char32_t cp = c;
+        if (QChar::isHighSurrogate(c) && p + 1 < end && QChar::isLowSurrogate(p[1])) {
+            cp = QChar::surrogateToUcs4(c, p[1]);
+            ++p;
+        }
+        ++p;
+        if (joinNext) {
+            // the code point after a ZWJ belongs to the same emoji sequence
+            joinNext = false;
+            continue;
+        }
+        if (cp == 0x200D) {
+            joinNext = true;
+            continue;
+        }
+        if (extendsGrapheme(cp)) continue;
+        if (isRegionalIndicator(cp)) {
+            // flags are pairs of indicators
+            pairedIndicator = !pairedIndicator;
+            if (!pairedIndicator) continue;
+        } else {
+            pairedIndicator = false;
+        }
+        if (QChar::isSpace(cp))
+            count += options.countSpaces;
+        else
+            ++count;
+    }
+    return count;
+}
+
+CpsOptions SubtitleStore::cpsOptions() {
+    const unsigned rules = cpsRules.load(std::memory_order_relaxed);
+    return { (rules & 1u) != 0, (rules & 2u) != 0 };
+}
+
+void SubtitleStore::setCpsOptions(const CpsOptions &options) {
+    cpsRules.store((options.countSpaces ? 1u : 0u) | (options.countLineBreaks ? 2u : 0u),
+                   std::memory_order_relaxed);
+}
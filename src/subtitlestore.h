@@ -0,0 +1,178 @@
+#pragma once
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <QVector>
+
+// What counts as a character for CPS. Markup (<i>-style tags, {\an8}-style
+// override codes) never counts, and a grapheme (a base character with its
+// combining marks, a surrogate pair, an emoji sequence) counts once.
+struct CpsOptions {
+    bool countSpaces = true;
+    bool countLineBreaks = false;
+
+    bool operator==(const CpsOptions &) const = default;
+};
+
+// Per-cue data of formats richer than SubRip (see SubtitleFormat): the ASS
+// layer, style, actor, margins and effect, and the WebVTT identifier and cue
+// settings. Strings are ids into the store's string table, 0 being "".
+struct CueLayout {
+    int style = 0;
+    int actor = 0;
+    int effect = 0;
+    int identifier = 0;
+    int settings = 0;
+    int layer = 0;
+    qint16 marginL = 0;
+    qint16 marginR = 0;
+    qint16 marginV = 0;
+    bool comment = false; // ASS "Comment:" event, kept but never shown
+
+    bool operator==(const CueLayout &) const = default;
+};
+
+struct CueSplice;
+
+// Struct-of-arrays storage for cues. Timings are integer milliseconds and the
+// text of every cue lives in one contiguous UTF-16 arena addressed by
+// offset/length, so a row costs a few ints instead of three heap-allocated
+// QStrings.
+//
+// Edited text is appended at the end of the arena and the old copy is left in
+// place; compact() drops those stale copies (the model does it on save).
+//
+// Copies are cheap: all members are implicitly shared Qt containers.
+class SubtitleStore {
+public:
+    static constexpr int NoTime = -1; // cue without a parsable timing line
+    // 99:59:59,999: the last time "HH:MM:SS,mmm" can hold, and the upper
+    // bound of every time the readers accept and retiming produces.
+    static constexpr int MaxTime = 359999999;
+
+    qsizetype size() const { return lineNumbers_.size(); }
+    bool isEmpty() const { return lineNumbers_.isEmpty(); }
+    void clear();
+    void reserve(qsizetype cues, qsizetype textChars);
+
+    int lineNumber(qsizetype i) const { return lineNumbers_.at(i); }
+    int startMs(qsizetype i) const { return startMs_.at(i); }
+    int endMs(qsizetype i) const { return endMs_.at(i); }
+    int cps(qsizetype i) const { return cps_.at(i); }
+    // Visible characters of the text, as counted for CPS.
+    int characters(qsizetype i) const { return chars_.at(i); }
+    int durationMs(qsizetype i) const;
+    QStringView textView(qsizetype i) const {
+        return QStringView(arena_.constData() + textOffsets_.at(i), textLengths_.at(i));
+    }
+    QString text(qsizetype i) const { return textView(i).toString(); }
+
+    void append(int lineNumber, int startMs, int endMs, QStringView text);
+    void append(const SubtitleStore &other);
+    // Inserts all cues of 'cues' before row 'row' / removes rows
+    // [first, first + count). Removed text becomes stale arena space.
+    void insert(qsizetype row, const SubtitleStore &cues);
+    void remove(qsizetype first, qsizetype count);
+    // Copy of rows [first, first + count) with only their text in the arena.
+    SubtitleStore mid(qsizetype first, qsizetype count) const;
+    // Copy with every splice applied, built in one pass. 'splices' are
+    // ascending and do not overlap; their rows are rows of this store.
+    SubtitleStore spliced(const QVector<CueSplice> &splices) const;
+    void setLineNumber(qsizetype i, int lineNumber) { lineNumbers_[i] = lineNumber; }
+    void setText(qsizetype i, QStringView text);
+    void setTiming(qsizetype i, int startMs, int endMs);
+
+    // Raw timing arrays for bulk operations; call updateCps() on the touched
+    // range afterwards.
+    int *startMsData() { return startMs_.data(); }
+    int *endMsData() { return endMs_.data(); }
+    const int *startMsData() const { return startMs_.constData(); }
+    const int *endMsData() const { return endMs_.constData(); }
+    void updateCps(qsizetype first, qsizetype last);
+    // Counts the characters of every cue again (after setCpsOptions()).
+    void recountCharacters();
+
+    // Writer interface for parsers that decode straight into the arena:
+    // beginText() returns room for at least 'maxChars' characters, the parser
+    // fills it and commitCue() records the cue whose text ends at 'textEnd'.
+    QChar *beginText(qsizetype maxChars);
+    void commitCue(int lineNumber, int startMs, int endMs, const QChar *textEnd);
+
+    // Side tables of ASS/SSA and WebVTT documents. They stay empty for SRT,
+    // so reading and writing SubRip never touches them; once one cue has a
+    // layout every row has one (rows added later get the default).
+    bool hasLayout() const { return !layouts_.isEmpty(); }
+    CueLayout layout(qsizetype i) const { return hasLayout() ? layouts_.at(i) : CueLayout(); }
+    void setLayout(qsizetype i, const CueLayout &layout);
+    QStringView layoutString(int id) const { return QStringView(layoutStrings_.at(id)); }
+    // Id of 'text' in the string table, adding it if needed.
+    int layoutStringId(const QString &text);
+    // Whether cue i of 'a' and cue j of 'b' have the same layout, strings
+    // compared by value.
+    static bool sameLayout(const SubtitleStore &a, qsizetype i, const SubtitleStore &b, qsizetype j);
+    // Gives row i the layout of cue j of 'other'; false if it had it already.
+    bool copyLayout(qsizetype i, const SubtitleStore &other, qsizetype j);
+    // Document text before and after the cues (ASS sections, WebVTT header
+    // blocks), verbatim with '\n' line breaks.
+    const QString &header() const { return header_; }
+    const QString &footer() const { return footer_; }
+    void setHeader(const QString &header) { header_ = header; }
+    void setFooter(const QString &footer) { footer_ = footer; }
+
+    // Characters in the arena that no cue refers to any more, and those
+    // that one does.
+    qsizetype staleChars() const { return arena_.size() - liveChars_; }
+    qsizetype liveChars() const { return liveChars_; }
+    void compact();
+
+    // "HH:MM:SS,mmm"; empty for NoTime.
+    static QString formatTime(int ms);
+    // Same, as ASCII written to 'out' (room for 24 chars); returns the end.
+    static char *formatTime(int ms, char *out);
+    // Rounded, at most MaxCps: every threshold is far below, and the CPS
+    // column is sized for its four digits.
+    static constexpr int MaxCps = 9999;
+    static int computeCPS(QStringView text, int durationMs);
+    static int computeCPS(qsizetype chars, int durationMs);
+    // Graphemes of 'text' left after stripping markup, in one pass; ASCII
+    // text never reaches the Unicode tables.
+    static int visibleCharacters(QStringView text, const CpsOptions &options);
+    static int visibleCharacters(QStringView text) { return visibleCharacters(text, cpsOptions()); }
+
+    // Process-wide counting rules. Stores keep their counts: call
+    // recountCharacters() on the live ones after a change.
+    static CpsOptions cpsOptions();
+    static void setCpsOptions(const CpsOptions &options);
+
+private:
+    friend class SubtitleCache; // reads and writes the columns in bulk
+
+    void pushRow(int lineNumber, int startMs, int endMs, qsizetype offset, qsizetype length);
+    // Layouts for rows [row, row + other.size()), just taken from 'other'.
+    void adoptLayouts(qsizetype row, const SubtitleStore &other);
+
+    QVector<int> lineNumbers_;
+    QVector<int> startMs_;
+    QVector<int> endMs_;
+    QVector<int> cps_;
+    QVector<int> chars_;        // visible characters, recounted only when the text changes
+    QVector<qsizetype> textOffsets_;
+    QVector<int> textLengths_;
+    QString arena_;
+    qsizetype liveChars_ = 0;
+    qsizetype pendingText_ = -1; // arena size at beginText()
+    // side tables, empty for SRT
+    QVector<CueLayout> layouts_;
+    QStringList layoutStrings_ { QString() };
+    QHash<QString, int> layoutStringIds_;
+    QString header_;
+    QString footer_;
+};
+
+// Rows [row, row + removed) of a store replaced by 'inserted'.
+struct CueSplice {
+    int row = 0;
+    int removed = 0;
+    SubtitleStore inserted;
+};
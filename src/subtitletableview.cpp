@@ -0,0 +1,11 @@
+#include "subtitletableview.h"
+#include "trace.h"
+#include <QElapsedTimer>
+
+void SubtitleTableView::paintEvent(QPaintEvent *event) {
+    TRACE_SCOPE("SubtitleTableView::paintEvent");
+    QElapsedTimer clock;
+    clock.start();
+    QTableView::paintEvent(event);
+    emit framePainted(clock.nsecsElapsed());
+}
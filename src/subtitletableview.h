@@ -0,0 +1,16 @@
+#pragma once
+#include <QTableView>
+
+// The cue table. Times every repaint of its viewport, for the performance
+// HUD and the trace.
+class SubtitleTableView : public QTableView {
+    Q_OBJECT
+public:
+    using QTableView::QTableView;
+
+signals:
+    void framePainted(qint64 ns);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+};
@@ -0,0 +1,216 @@
+#include "textdelegate.h"
+#include "appsettings.h"
+#include "highlightdelegate.h"
+#include "trace.h"
+#include <QAbstractItemModel>
+#include <QApplication>
+#include <QFontMetrics>
+#include <QPainter>
+#include <QPainterPath>
+
+namespace {
+
+constexpr qsizetype DefaultCacheLimit = 8 * 1024 * 1024;
+// rough size of a prepared QStaticText: fixed part plus glyph data per char
+constexpr int EntryOverhead = 256;
+constexpr int BytesPerChar = 32;
+// height and length of a half period of the underline wave, in pixels
+constexpr qreal WaveHeight = 2;
+constexpr qreal WaveStep = 2;
+
+// Length of the SRT formatting tag starting at text[i] ('<'), or 0.
+qsizetype formattingTagLength(QStringView text, qsizetype i) {
+    const qsizetype close = text.indexOf(u'>', i);
+    if (close < 0) return 0;
+    QStringView tag = text.mid(i + 1, close - i - 1).trimmed();
+    if (tag.startsWith(u'/')) tag = tag.mid(1).trimmed();
+    static const char16_t *const simple[] = { u"i", u"b", u"u", u"s", u"font" };
+    for (const char16_t *name : simple) {
+        const QStringView n(name);
+        if (tag.compare(n, Qt::CaseInsensitive) == 0) return close - i + 1;
+    }
+    if (tag.startsWith(u"font ", Qt::CaseInsensitive) && !tag.contains(u'<'))
+        return close - i + 1;
+    return 0;
+}
+
+} // namespace
+
+TextDelegate::TextDelegate(QAbstractItemModel *model, int column, QObject *parent)
+    : QStyledItemDelegate(parent), column_(column), cache_(DefaultCacheLimit)
+{
+    connect(model, &QAbstractItemModel::dataChanged, this, &TextDelegate::invalidateRows);
+    // row numbers move: every entry may now belong to another cue
+    auto clear = [this] { clearCache(); };
+    connect(model, &QAbstractItemModel::rowsInserted, this, clear);
+    connect(model, &QAbstractItemModel::rowsRemoved, this, clear);
+    connect(model, &QAbstractItemModel::rowsMoved, this, clear);
+    connect(model, &QAbstractItemModel::modelReset, this, clear);
+    connect(model, &QAbstractItemModel::layoutChanged, this, clear);
+}
+
+void TextDelegate::setCacheLimit(qsizetype bytes) {
+    cache_.setMaxCost(bytes);
+}
+
+void TextDelegate::clearCache() const {
+    cache_.clear();
+}
+
+void TextDelegate::setHighlight(int role, std::function<QColor()> colour) {
+    highlightRole_ = role;
+    highlightColour_ = std::move(colour);
+}
+
+void TextDelegate::setUnderline(int role, std::function<QColor()> colour) {
+    underlineRole_ = role;
+    underlineColour_ = std::move(colour);
+}
+
+void TextDelegate::invalidateRows(const QModelIndex &topLeft, const QModelIndex &bottomRight,
+                                  const QList<int> &roles)
+{
+    if (column_ < topLeft.column() || column_ > bottomRight.column()) return;
+    if (!roles.isEmpty() && !roles.contains(Qt::DisplayRole)) return;
+    const int first = topLeft.row();
+    const int last = bottomRight.row();
+    if (last - first + 1 > cache_.count()) {
+        // bulk change: walk the (smaller) cache instead of the range
+        const QList<int> rows = cache_.keys();
+        for (int row : rows) {
+            if (row >= first && row <= last) cache_.remove(row);
+        }
+    } else {
+        for (int row = first; row <= last; ++row) cache_.remove(row);
+    }
+}
+
+QString TextDelegate::tagsToHtml(QStringView text) {
+    QString html;
+    html.reserve(text.size() + 16);
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        const QChar c = text.at(i);
+        if (c == u'<') {
+            if (const qsizetype n = formattingTagLength(text, i)) {
+                html += text.mid(i, n);
+                i += n - 1;
+            } else {
+                html += QLatin1String("&lt;");
+            }
+        } else if (c == u'>') {
+            html += QLatin1String("&gt;");
+        } else if (c == u'&') {
+            html += QLatin1String("&amp;");
+        } else {
+            html += c;
+        }
+    }
+    return html;
+}
+
+QStaticText *TextDelegate::layout(const QModelIndex &index, const QFont &font, int width, bool richText) const {
+    if (font != font_ || width != width_ || richText != richText_) {
+        cache_.clear();
+        font_ = font;
+        width_ = width;
+        richText_ = richText;
+    }
+    if (QStaticText *cached = cache_.object(index.row())) return cached;
+
+    const QString text = index.data(Qt::DisplayRole).toString();
+    auto *st = new QStaticText;
+    st->setPerformanceHint(QStaticText::AggressiveCaching);
+    if (richText) {
+        // rich text cannot be elided; the painter clips it to the cell
+        st->setTextFormat(Qt::RichText);
+        st->setText(tagsToHtml(text));
+    } else {
+        st->setTextFormat(Qt::PlainText);
+        st->setText(QFontMetrics(font).elidedText(text, Qt::ElideRight, width));
+    }
+    st->prepare(QTransform(), font);
+    const qsizetype cost = EntryOverhead + text.size() * BytesPerChar;
+    if (!cache_.insert(index.row(), st, cost)) return nullptr; // larger than the whole cache
+    return st;
+}
+
+void TextDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option,
+                         const QModelIndex &index) const
+{
+    TRACE_SCOPE("TextDelegate::paint");
+    const QWidget *widget = option.widget;
+    QStyle *style = widget ? widget->style() : QApplication::style();
+
+    // background, selection and focus frame as the default delegate draws
+    // them, minus the text
+    QStyleOptionViewItem opt(option);
+    opt.index = index;
+    const QVariant background = index.data(Qt::BackgroundRole);
+    if (background.canConvert<QBrush>()) opt.backgroundBrush = qvariant_cast<QBrush>(background);
+    const QBrush diff = HighlightDelegate::diffBackground(index);
+    if (diff.style() != Qt::NoBrush) opt.backgroundBrush = diff;
+    if (highlightRole_ >= 0 && index.data(highlightRole_).toBool()) opt.backgroundBrush = highlightColour_();
+    style->drawControl(QStyle::CE_ItemViewItem, &opt, painter, widget);
+
+    const int margin = style->pixelMetric(QStyle::PM_FocusFrameHMargin, nullptr, widget) + 1;
+    const QRect textRect = option.rect.adjusted(margin, 0, -margin, 0);
+    if (textRect.width() <= 0) return;
+
+    const QStaticText *st = layout(index, option.font, textRect.width(), AppSettings::instance()->renderTextTags());
+    if (!st) {
+        QStyledItemDelegate::paint(painter, option, index);
+        return;
+    }
+
+    const QPalette::ColorGroup group = !(option.state & QStyle::State_Enabled) ? QPalette::Disabled
+                                     : (option.state & QStyle::State_Active) ? QPalette::Active
+                                                                             : QPalette::Inactive;
+    QColor color = option.palette.color(group, QPalette::Text);
+    if (option.state & QStyle::State_Selected) {
+        color = option.palette.color(group, QPalette::HighlightedText);
+    } else {
+        const QVariant foreground = index.data(Qt::ForegroundRole);
+        if (foreground.canConvert<QBrush>()) color = qvariant_cast<QBrush>(foreground).color();
+    }
+
+    painter->save();
+    painter->setClipRect(textRect);
+    painter->setFont(option.font);
+    painter->setPen(color);
+    const qreal y = textRect.top() + (textRect.height() - st->size().height()) / 2;
+    painter->drawStaticText(QPointF(textRect.left(), y), *st);
+    if (underlineRole_ >= 0 && st->textFormat() == Qt::PlainText) {
+        const QVariant spans = index.data(underlineRole_);
+        if (spans.isValid()) drawUnderlines(painter, *st, spans.value<QList<int>>(), option.font, QPointF(textRect.left(), y));
+    }
+    painter->restore();
+}
+
+void TextDelegate::drawUnderlines(QPainter *painter, const QStaticText &text, const QList<int> &spans,
+                                  const QFont &font, const QPointF &origin) const
+{
+    // the laid out text may be elided: ranges past the ellipsis are not shown
+    const QString shown = text.text();
+    const qsizetype visible = shown.size() - (shown.endsWith(u'\u2026') ? 1 : 0);
+    const QFontMetricsF fm(font);
+    const qreal y = origin.y() + fm.ascent() + fm.underlinePos();
+    QPainterPath wave;
+    for (qsizetype i = 0; i + 1 < spans.size(); i += 2) {
+        const int start = spans.at(i);
+        const int length = spans.at(i + 1);
+        if (start < 0 || length <= 0 || start + length > visible) continue;
+        const qreal x1 = origin.x() + fm.horizontalAdvance(shown.left(start));
+        const qreal x2 = x1 + fm.horizontalAdvance(shown.mid(start, length));
+        wave.moveTo(x1, y);
+        bool up = true;
+        for (qreal x = x1; x < x2; x += WaveStep) {
+            wave.lineTo(qMin(x + WaveStep, x2), up ? y - WaveHeight / 2 : y + WaveHeight / 2);
+            up = !up;
+        }
+    }
+    if (wave.isEmpty()) return;
+    painter->setRenderHint(QPainter::Antialiasing);
+    painter->setPen(QPen(underlineColour_(), 1));
+    painter->setBrush(Qt::NoBrush);
+    painter->drawPath(wave);
+}
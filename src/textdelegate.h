@@ -0,0 +1,56 @@
+#pragma once
+#include <QCache>
+#include <QColor>
+#include <QFont>
+#include <QStaticText>
+#include <QStyledItemDelegate>
+#include <functional>
+
+class QAbstractItemModel;
+
+// Paints the Text column from a cache of prepared QStaticText, one entry per
+// row, so scrolling does not shape the same cue text again on every paint.
+//
+// Entries are dropped for exactly the rows a dataChanged of the display text
+// covers (changes of other roles keep them); row insertions, removals and
+// resets, and any change of font, column width or tag rendering, clear the
+// whole cache. The cache is an LRU bounded by an approximate byte cost.
+class TextDelegate : public QStyledItemDelegate {
+public:
+    TextDelegate(QAbstractItemModel *model, int column, QObject *parent = nullptr);
+
+    void setCacheLimit(qsizetype bytes);
+    // Background for cells whose 'role' data is true (e.g. search matches),
+    // looked up at paint time like HighlightDelegate does.
+    void setHighlight(int role, std::function<QColor()> colour);
+    // Wavy underline under the character ranges the 'role' data lists
+    // (QList<int> of start and length pairs in the display text), e.g.
+    // misspelled words. Drawn in plain text only: with the tags rendered the
+    // positions no longer match the display text.
+    void setUnderline(int role, std::function<QColor()> colour);
+    void clearCache() const;
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option,
+               const QModelIndex &index) const override;
+
+    // Cue text as rich text: <i>, <b>, <u>, <s> and <font> tags are kept,
+    // everything else is escaped.
+    static QString tagsToHtml(QStringView text);
+
+private:
+    void invalidateRows(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles);
+    QStaticText *layout(const QModelIndex &index, const QFont &font, int width, bool richText) const;
+    void drawUnderlines(QPainter *painter, const QStaticText &text, const QList<int> &spans,
+                        const QFont &font, const QPointF &origin) const;
+
+    int column_;
+    int highlightRole_ = -1;
+    std::function<QColor()> highlightColour_;
+    int underlineRole_ = -1;
+    std::function<QColor()> underlineColour_;
+    mutable QCache<int, QStaticText> cache_;
+    // what the cached entries were laid out for
+    mutable QFont font_;
+    mutable int width_ = -1;
+    mutable bool richText_ = false;
+};
@@ -0,0 +1,204 @@
+#include "textencoding.h"
+#include "trace.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SUBSTUDIO_HAVE_SSE2
+#endif
+
+namespace {
+
+// Bytes of the first few KB looked at for the NUL pattern of UTF-16.
+constexpr qsizetype Utf16Sample = 4096;
+
+// Windows-1252 differs from Latin-1 only in 0x80..0x9F; the five bytes it
+// leaves undefined map to the C1 controls, as in Latin-1.
+constexpr char16_t Windows1252High[128] = {
+    0x20AC, 0x0081, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+    0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008D, 0x017D, 0x008F,
+    0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+    0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x009D, 0x017E, 0x0178,
+    0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF,
+    0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xBB, 0xBC, 0xBD, 0xBE, 0xBF,
+    0xC0, 0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xCB, 0xCC, 0xCD, 0xCE, 0xCF,
+    0xD0, 0xD1, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xDB, 0xDC, 0xDD, 0xDE, 0xDF,
+    0xE0, 0xE1, 0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xEB, 0xEC, 0xED, 0xEE, 0xEF,
+    0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF,
+};
+
+constexpr auto makeLatin1High() {
+    struct { char16_t c[128]; } t {};
+    for (int i = 0; i < 128; ++i) t.c[i] = char16_t(0x80 + i);
+    return t;
+}
+constexpr auto Latin1High = makeLatin1High();
+
+// Bytes Windows-1252 does not define: their presence means Latin-1.
+bool hasUndefined1252(const uchar *p, qsizetype size) {
+    for (qsizetype i = 0; i < size; ++i) {
+        switch (p[i]) {
+        case 0x81: case 0x8D: case 0x8F: case 0x90: case 0x9D:
+            return true;
+        default:
+            break;
+        }
+    }
+    return false;
+}
+
+// UTF-16 without a BOM: most text is ASCII, so one byte of nearly every unit
+// is NUL, always on the same side.
+TextEncoding::Kind utf16FromNuls(const uchar *p, qsizetype size) {
+    const qsizetype n = qMin(size, Utf16Sample) & ~qsizetype(1);
+    if (n < 4) return TextEncoding::Other;
+    qsizetype evenNuls = 0;
+    qsizetype oddNuls = 0;
+    for (qsizetype i = 0; i < n; i += 2) {
+        evenNuls += p[i] == 0;
+        oddNuls += p[i + 1] == 0;
+    }
+    const qsizetype units = n / 2;
+    if (oddNuls * 2 > units && evenNuls * 8 < oddNuls) return TextEncoding::Utf16LE;
+    if (evenNuls * 2 > units && oddNuls * 8 < evenNuls) return TextEncoding::Utf16BE;
+    return TextEncoding::Other;
+}
+
+} // namespace
+
+TextEncoding::Kind TextEncoding::kindForName(const QByteArray &name) {
+    const QByteArray n = name.toLower();
+    if (n == "utf-8" || n == "utf8") return Utf8;
+    if (n == "utf-16le") return Utf16LE;
+    if (n == "utf-16be") return Utf16BE;
+    if (n == "windows-1252" || n == "cp1252") return Windows1252;
+    if (n == "iso-8859-1" || n == "latin1" || n == "latin-1") return Latin1;
+    return Other;
+}
+
+QByteArray TextEncoding::name(Kind kind) {
+    switch (kind) {
+    case Utf8: return "UTF-8";
+    case Utf16LE: return "UTF-16LE";
+    case Utf16BE: return "UTF-16BE";
+    case Windows1252: return "windows-1252";
+    case Latin1: return "ISO-8859-1";
+    case Other: break;
+    }
+    return QByteArray();
+}
+
+qsizetype TextEncoding::bomLength(Kind kind, const char *data, qsizetype size) {
+    const uchar *u = reinterpret_cast<const uchar *>(data);
+    switch (kind) {
+    case Utf8:
+        return size >= 3 && u[0] == 0xEF && u[1] == 0xBB && u[2] == 0xBF ? 3 : 0;
+    case Utf16LE:
+        return size >= 2 && u[0] == 0xFF && u[1] == 0xFE ? 2 : 0;
+    case Utf16BE:
+        return size >= 2 && u[0] == 0xFE && u[1] == 0xFF ? 2 : 0;
+    default:
+        return 0;
+    }
+}
+
+bool TextEncoding::usesCrlf(Kind kind, const char *data, qsizetype size) {
+    if (kind == Utf16LE || kind == Utf16BE) {
+        // '\n' and '\r' with the NUL byte on the side 'kind' puts it
+        const int low = kind == Utf16LE ? 0 : 1;
+        for (qsizetype i = 2; i + 1 < size; i += 2) {
+            if (data[i + low] == '\n' && data[i + 1 - low] == 0)
+                return data[i - 2 + low] == '\r' && data[i - 1 - low] == 0;
+        }
+        return false;
+    }
+    const char *nl = static_cast<const char *>(std::memchr(data, '\n', size_t(size)));
+    return nl && nl > data && nl[-1] == '\r';
+}
+
+qsizetype TextEncoding::validUtf8Prefix(const char *data, qsizetype size) {
+    const uchar *const begin = reinterpret_cast<const uchar *>(data);
+    const uchar *const end = begin + size;
+    const uchar *p = begin;
+    while (p < end) {
+        // skip ASCII a block at a time; subtitles are mostly ASCII
+#ifdef SUBSTUDIO_HAVE_SSE2
+        while (end - p >= 16
+               && _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))) == 0) {
+            p += 16;
+        }
+#endif
+        while (end - p >= 8) {
+            quint64 word;
+            std::memcpy(&word, p, 8);
+            if (word & 0x8080808080808080ull) break;
+            p += 8;
+        }
+        if (p == end) break;
+        const uchar c = *p;
+        if (c < 0x80) {
+            ++p;
+            continue;
+        }
+
+        // shortest form only, no surrogates, nothing above U+10FFFF
+        int length;
+        uchar low = 0x80;
+        uchar high = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF) {
+            length = 2;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            length = 3;
+            if (c == 0xE0) low = 0xA0;
+            else if (c == 0xED) high = 0x9F;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            length = 4;
+            if (c == 0xF0) low = 0x90;
+            else if (c == 0xF4) high = 0x8F;
+        } else {
+            break;
+        }
+        if (end - p < length || p[1] < low || p[1] > high) break;
+        int i = 2;
+        while (i < length && (p[i] & 0xC0) == 0x80) ++i;
+        if (i < length) break;
+        p += length;
+    }
+    return p - begin;
+}
+
+const char16_t *TextEncoding::upperHalf(Kind kind) {
+    return kind == Windows1252 ? Windows1252High : Latin1High.c;
+}
+
+QByteArray TextEncoding::swapUtf16(const char *data, qsizetype size) {
+    QByteArray out(size & ~qsizetype(1), Qt::Uninitialized);
+    char *o = out.data();
+    for (qsizetype i = 0; i + 1 < size; i += 2) {
+        o[i] = data[i + 1];
+        o[i + 1] = data[i];
+    }
+    return out;
+}
+
+TextFormat TextEncoding::detect(const char *data, qsizetype size) {
+    TRACE_SCOPE("TextEncoding::detect");
+    const uchar *u = reinterpret_cast<const uchar *>(data);
+    Kind kind = Other;
+    for (Kind k : { Utf8, Utf16LE, Utf16BE }) {
+        if (bomLength(k, data, size) > 0) {
+            kind = k;
+            break;
+        }
+    }
+    TextFormat format;
+    format.byteOrderMark = kind != Other;
+    if (kind == Other) kind = utf16FromNuls(u, size);
+    if (kind == Other) {
+        if (validUtf8Prefix(data, size) == size) kind = Utf8;
+        else kind = hasUndefined1252(u, size) ? Latin1 : Windows1252;
+    }
+    format.encoding = name(kind);
+    format.crlf = usesCrlf(kind, data, size);
+    return format;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <QByteArray>
+#include <QtGlobal>
+
+// Encoding and line endings of a subtitle file: detected when it is read,
+// so that saving writes it back the same way.
+struct TextFormat {
+    QByteArray encoding = "UTF-8"; // any name SubtitleFile::isSupportedEncoding() accepts
+    bool byteOrderMark = false;
+    bool crlf = false;
+
+    bool operator==(const TextFormat &) const = default;
+};
+
+// Encoding detection and the encodings the SRT scanner decodes itself, in
+// the same pass that splits the lines (no up-front conversion to UTF-8).
+class TextEncoding {
+public:
+    enum Kind { Utf8, Utf16LE, Utf16BE, Windows1252, Latin1, Other };
+    // UTF-16 in the byte order of this machine; the other order is swapped
+    // before scanning.
+    static constexpr Kind HostUtf16 = Q_BYTE_ORDER == Q_LITTLE_ENDIAN ? Utf16LE : Utf16BE;
+
+    static Kind kindForName(const QByteArray &name);
+    static QByteArray name(Kind kind);
+
+    // One look at the bytes: a byte order mark, else the NUL pattern of
+    // UTF-16 in the first few KB, else a UTF-8 validity scan. Text that is
+    // not UTF-8 is taken as Windows-1252, or Latin-1 when it uses bytes
+    // Windows-1252 leaves undefined. Line endings follow the first line.
+    static TextFormat detect(const char *data, qsizetype size);
+
+    // Length of the byte order mark of 'kind' at 'data', 0 if there is none.
+    static qsizetype bomLength(Kind kind, const char *data, qsizetype size);
+    // Whether the first line break of the text is "\r\n".
+    static bool usesCrlf(Kind kind, const char *data, qsizetype size);
+
+    // Length of the longest valid UTF-8 prefix. ASCII runs are checked 16
+    // bytes at a time (SSE2, else 8-byte words).
+    static qsizetype validUtf8Prefix(const char *data, qsizetype size);
+
+    // Characters of bytes 0x80..0xFF of a single-byte encoding.
+    static const char16_t *upperHalf(Kind kind);
+
+    // 'size' bytes of UTF-16 with every code unit byte-swapped.
+    static QByteArray swapUtf16(const char *data, qsizetype size);
+};
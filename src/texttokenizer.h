@@ -0,0 +1,317 @@
+#pragma once
+#include <QByteArrayView>
+#include <QChar>
+#include <QString>
+#include <QStringDecoder>
+#include <QtGlobal>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include "textencoding.h"
+
+// Building blocks shared by the subtitle scanners (SrtParser and the ASS and
+// WebVTT readers). Helpers are templates on the code unit: char for UTF-8 and
+// the single-byte encodings, char16_t for UTF-16. Everything a scanner looks
+// at (digits, separators, line breaks, keywords) is ASCII, so both compare
+// the same; only cue text goes through a decoder, straight into the store's
+// arena. Whitespace may not be ASCII, so the helpers that skip it take the
+// decoder too, which tells how the bytes spell it.
+namespace TextScan {
+
+// Decoders of a cue's text span into the arena, one per supported encoding.
+struct Utf8Text {
+    QStringDecoder decoder { QStringDecoder::Utf8,
+                             QStringDecoder::Flag::Stateless | QStringDecoder::Flag::ConvertInitialBom };
+
+    qsizetype requiredSpace(qsizetype units) const { return decoder.requiredSpace(units); }
+    QChar *append(QChar *out, const char *text, qsizetype units) {
+        return decoder.appendToBuffer(out, QByteArrayView(text, units));
+    }
+};
+
+struct SingleByteText {
+    const char16_t *upperHalf; // characters of bytes 0x80..0xFF
+
+    qsizetype requiredSpace(qsizetype units) const { return units; }
+    QChar *append(QChar *out, const char *text, qsizetype units) const {
+        for (qsizetype i = 0; i < units; ++i) {
+            const uchar c = uchar(text[i]);
+            out[i] = QChar(c < 0x80 ? char16_t(c) : upperHalf[c - 0x80]);
+        }
+        return out + units;
+    }
+};
+
+struct Utf16Text {
+    qsizetype requiredSpace(qsizetype units) const { return units; }
+    QChar *append(QChar *out, const char16_t *text, qsizetype units) const {
+        std::memcpy(out, text, size_t(units) * sizeof(char16_t));
+        return out + units;
+    }
+};
+
+// ASCII whitespace; spaceAt() adds the rest of QChar::isSpace.
+template<typename Unit>
+inline bool isSpace(Unit c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+// Length of the UTF-8 sequence of 2 to 4 bytes at p, with its code point in
+// 'cp'; 0 if the bytes are not one.
+inline int utf8At(const char *p, const char *e, char32_t &cp) {
+    const uchar c = uchar(*p);
+    int len;
+    char32_t min;
+    if ((c & 0xE0) == 0xC0) {
+        len = 2, min = 0x80, cp = c & 0x1F;
+    } else if ((c & 0xF0) == 0xE0) {
+        len = 3, min = 0x800, cp = c & 0x0F;
+    } else if ((c & 0xF8) == 0xF0) {
+        len = 4, min = 0x10000, cp = c & 0x07;
+    } else {
+        return 0;
+    }
+    if (e - p < len) return 0;
+    for (int i = 1; i < len; ++i) {
+        if ((uchar(p[i]) & 0xC0) != 0x80) return 0;
+        cp = (cp << 6) | (uchar(p[i]) & 0x3F);
+    }
+    return cp >= min && cp <= 0x10FFFF ? len : 0;
+}
+
+// Code units of the whitespace character (QChar::isSpace) at p, 0 if p does
+// not start one. The decoder of the text says how non-ASCII spaces (NBSP,
+// U+2000..U+200A, U+3000, ...) are spelled: as UTF-8 sequences, or in a
+// single-byte encoding as the byte 0xA0 (NBSP) alone.
+template<typename Decoder>
+inline int spaceAt(const char16_t *p, const char16_t *, const Decoder &) {
+    return *p < 0x80 ? isSpace(*p) : QChar::isSpace(*p); // every space is in the BMP
+}
+
+inline int spaceAt(const char *p, const char *e, const Utf8Text &) {
+    const uchar c = uchar(*p);
+    if (c < 0x80) return isSpace(c);
+    char32_t cp;
+    if (const int len = utf8At(p, e, cp)) return QChar::isSpace(cp) ? len : 0;
+    return 0;
+}
+
+inline int spaceAt(const char *p, const char *, const SingleByteText &) {
+    const uchar c = uchar(*p);
+    return c < 0x80 ? isSpace(c) : c == 0xA0;
+}
+
+// Same for the character that ends at e, not before b.
+template<typename Decoder>
+inline int spaceBefore(const char16_t *, const char16_t *e, const Decoder &decoder) {
+    return spaceAt(e - 1, e, decoder);
+}
+
+inline int spaceBefore(const char *b, const char *e, const Utf8Text &) {
+    const uchar c = uchar(e[-1]);
+    if (c < 0x80) return isSpace(c);
+    // back to the lead byte of the sequence e[-1] may end
+    const char *s = e - 1;
+    while (s > b && e - s < 4 && (uchar(*s) & 0xC0) == 0x80) --s;
+    char32_t cp;
+    if (s < e - 1 && utf8At(s, e, cp) == e - s) return QChar::isSpace(cp) ? int(e - s) : 0;
+    return 0;
+}
+
+inline int spaceBefore(const char *, const char *e, const SingleByteText &decoder) {
+    return spaceAt(e - 1, e, decoder);
+}
+
+// First unit of [p, e) after its leading whitespace.
+template<typename Unit, typename Decoder>
+inline const Unit *skipSpace(const Unit *p, const Unit *e, const Decoder &decoder) {
+    while (p < e) {
+        const int n = spaceAt(p, e, decoder);
+        if (!n) break;
+        p += n;
+    }
+    return p;
+}
+
+// End of [b, e) without its trailing whitespace.
+template<typename Unit, typename Decoder>
+inline const Unit *skipSpaceBack(const Unit *b, const Unit *e, const Decoder &decoder) {
+    while (e > b) {
+        const int n = spaceBefore(b, e, decoder);
+        if (!n) break;
+        e -= n;
+    }
+    return e;
+}
+
+template<typename Unit>
+inline bool isDigit(Unit c) {
+    return c >= '0' && c <= '9';
+}
+
+inline const char *findUnit(const char *p, const char *end, char c) {
+    return static_cast<const char *>(std::memchr(p, c, size_t(end - p)));
+}
+
+inline const char16_t *findUnit(const char16_t *p, const char16_t *end, char16_t c) {
+    const char16_t *found = std::find(p, end, c);
+    return found == end ? nullptr : found;
+}
+
+// Returns the end of the line starting at 'p' without its terminator ("\n" or
+// "\r\n", like QTextStream::readLine) and sets 'next' to the following line.
+template<typename Unit>
+inline const Unit *lineEnd(const Unit *p, const Unit *end, const Unit *&next) {
+    const Unit *nl = findUnit(p, end, Unit('\n'));
+    if (!nl) {
+        next = end;
+        return end;
+    }
+    next = nl + 1;
+    if (nl > p && nl[-1] == '\r') return nl - 1;
+    return nl;
+}
+
+template<typename Unit, typename Decoder>
+inline bool isBlank(const Unit *b, const Unit *e, const Decoder &decoder) {
+    return skipSpace(b, e, decoder) == e;
+}
+
+// Equivalent of line.trimmed().toInt(&ok).
+template<typename Unit, typename Decoder>
+inline bool parseInt(const Unit *b, const Unit *e, int &value, const Decoder &decoder) {
+    b = skipSpace(b, e, decoder);
+    e = skipSpaceBack(b, e, decoder);
+    if (b == e) return false;
+    bool negative = false;
+    if (*b == '+' || *b == '-') {
+        negative = (*b == '-');
+        ++b;
+    }
+    if (b == e) return false;
+    qint64 v = 0;
+    for (; b < e; ++b) {
+        if (!isDigit(*b)) return false;
+        v = v * 10 + (*b - '0');
+        if (v > qint64(INT_MAX) + 1) return false;
+    }
+    if (negative) v = -v;
+    if (v > INT_MAX || v < INT_MIN) return false;
+    value = int(v);
+    return true;
+}
+
+// "HH:MM:SS" at p; caller guarantees 8 readable units.
+template<typename Unit>
+inline bool isClock(const Unit *p) {
+    return isDigit(p[0]) && isDigit(p[1]) && p[2] == ':'
+        && isDigit(p[3]) && isDigit(p[4]) && p[5] == ':'
+        && isDigit(p[6]) && isDigit(p[7]);
+}
+
+template<typename Unit>
+inline int twoDigits(const Unit *p) {
+    return (p[0] - '0') * 10 + (p[1] - '0');
+}
+
+template<typename Unit>
+inline int clockMs(const Unit *p) {
+    return twoDigits(p) * 3600000 + twoDigits(p + 3) * 60000 + twoDigits(p + 6) * 1000;
+}
+
+// Fraction of 1..3 digits as milliseconds (",5" is 500 ms, ",05" is 50 ms).
+template<typename Unit>
+inline int fractionMs(const Unit *p, int digits) {
+    static const int scale[] = { 0, 100, 10, 1 };
+    int v = 0;
+    for (int i = 0; i < digits; ++i) v = v * 10 + (p[i] - '0');
+    return v * scale[digits];
+}
+
+template<typename Unit>
+inline bool isFractionSeparator(Unit c) {
+    return c == ',' || c == '.';
+}
+
+// Whether [b, e) starts with the ASCII string 'prefix'.
+template<typename Unit>
+inline bool startsWith(const Unit *b, const Unit *e, const char *prefix) {
+    for (; *prefix; ++prefix, ++b) {
+        if (b == e || *b != Unit(uchar(*prefix))) return false;
+    }
+    return true;
+}
+
+// Same, ignoring ASCII case.
+template<typename Unit>
+inline bool startsWithNoCase(const Unit *b, const Unit *e, const char *prefix) {
+    for (; *prefix; ++prefix, ++b) {
+        if (b == e) return false;
+        const Unit c = (*b >= 'A' && *b <= 'Z') ? Unit(*b | 0x20) : *b;
+        const char p = (*prefix >= 'A' && *prefix <= 'Z') ? char(*prefix | 0x20) : *prefix;
+        if (c != Unit(uchar(p))) return false;
+    }
+    return true;
+}
+
+// Strips whitespace from both ends of [b, e), like QString::trimmed().
+template<typename Unit, typename Decoder>
+inline void trim(const Unit *&b, const Unit *&e, const Decoder &decoder) {
+    b = skipSpace(b, e, decoder);
+    e = skipSpaceBack(b, e, decoder);
+}
+
+// Turns every "\r\n" in [b, e) into "\n" in place; returns the new end.
+inline QChar *foldCrLf(QChar *b, QChar *e) {
+    QChar *w = b;
+    for (QChar *r = b; r < e; ++r) {
+        if (*r == u'\r' && r + 1 < e && r[1] == u'\n') continue;
+        *w++ = *r;
+    }
+    return w;
+}
+
+// Decodes [b, e) into a QString, for the short fields that are not cue
+// text (ASS style names, WebVTT identifiers).
+template<typename Unit, typename Decoder>
+QString decodeField(Decoder &decoder, const Unit *b, const Unit *e) {
+    QString out(decoder.requiredSpace(e - b), Qt::Uninitialized);
+    const QChar *end = decoder.append(out.data(), b, e - b);
+    out.truncate(end - out.constData());
+    return out;
+}
+
+inline bool isUtf16(TextEncoding::Kind encoding) {
+    return encoding == TextEncoding::Utf16LE || encoding == TextEncoding::Utf16BE;
+}
+
+// [begin, end) as whole UTF-16 code units.
+inline const char16_t *units(const char *p) {
+    return reinterpret_cast<const char16_t *>(p);
+}
+inline const char16_t *unitsEnd(const char *begin, const char *end) {
+    return units(begin) + (end - begin) / 2;
+}
+
+// Calls f(begin, end, decoder) with [begin, end) as code units of 'encoding'
+// and the decoder that goes with them. 'encoding' must not be
+// TextEncoding::Other; UTF-16 must be in host byte order.
+template<typename F>
+void withUnits(const char *begin, const char *end, TextEncoding::Kind encoding, F &&f) {
+    switch (encoding) {
+    case TextEncoding::Utf16LE:
+    case TextEncoding::Utf16BE:
+        Q_ASSERT(encoding == TextEncoding::HostUtf16);
+        f(units(begin), unitsEnd(begin, end), Utf16Text());
+        break;
+    case TextEncoding::Windows1252:
+    case TextEncoding::Latin1:
+        f(begin, end, SingleByteText { TextEncoding::upperHalf(encoding) });
+        break;
+    default:
+        f(begin, end, Utf8Text());
+        break;
+    }
+}
+
+} // namespace TextScan
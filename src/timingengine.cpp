@@ -0,0 +1,118 @@
+#include "timingengine.h"
+#include <QList>
+#include <limits>
+#include "subtitlestore.h"
+
+namespace {
+
+// Round-half-away-from-zero division; 'den' > 0.
+inline qint64 roundDiv(qint64 num, qint64 den) {
+    return num >= 0 ? (num + den / 2) / den : -((-num + den / 2) / den);
+}
+
+// past MaxTime the hours no longer fit the two digits SubRip has
+inline int clampTime(qint64 v) {
+    return int(qBound<qint64>(0, v, SubtitleStore::MaxTime));
+}
+
+// t' = outOffset + (t - inOffset) * mul / div for every timed entry.
+void applyRational(int *t, qsizetype n, qint64 inOffset, qint64 outOffset,
+                   qint64 mul, qint64 div, int noTime)
+{
+    if (div < 0) {
+        mul = -mul;
+        div = -div;
+    }
+    for (qsizetype i = 0; i < n; ++i) {
+        const int v = t[i];
+        const int mapped = clampTime(outOffset + roundDiv((v - inOffset) * mul, div));
+        t[i] = (v == noTime) ? v : mapped;
+    }
+}
+
+} // namespace
+
+QString Framerate::name() const {
+    if (den == 1) return QString::number(num);
+    return QString::number(double(num) / den, 'f', 3);
+}
+
+QVector<Framerate> Framerate::common() {
+    return { { 24000, 1001 }, { 24, 1 }, { 25, 1 }, { 30000, 1001 }, { 30, 1 } };
+}
+
+void TimingEngine::shift(int *t, qsizetype n, int deltaMs, int noTime) {
+    for (qsizetype i = 0; i < n; ++i) {
+        const int v = t[i];
+        const int shifted = clampTime(qint64(v) + deltaMs);
+        t[i] = (v == noTime) ? v : shifted;
+    }
+}
+
+void TimingEngine::sync(int *t, qsizetype n, int fromA, int toA, int fromB, int toB, int noTime) {
+    if (fromA == fromB) return;
+    applyRational(t, n, fromA, toA, qint64(toB) - toA, qint64(fromB) - fromA, noTime);
+}
+
+void TimingEngine::convertFramerate(int *t, qsizetype n, Framerate from, Framerate to, int noTime) {
+    // frame k sits at k / from seconds and moves to k / to seconds:
+    // t' = t * from / to = t * from.num * to.den / (from.den * to.num)
+    applyRational(t, n, 0, 0, qint64(from.num) * to.den, qint64(from.den) * to.num, noTime);
+}
+
+void TimingEngine::snapToFrame(int *t, qsizetype n, Framerate fps, int noTime) {
+    // frame = round(t * num / (den * 1000)); t' = round(frame * den * 1000 / num)
+    const qint64 frameDen = qint64(fps.den) * 1000;
+    for (qsizetype i = 0; i < n; ++i) {
+        const int v = t[i];
+        const qint64 frame = roundDiv(qint64(v) * fps.num, frameDen);
+        const int snapped = clampTime(roundDiv(frame * frameDen, fps.num));
+        t[i] = (v == noTime) ? v : snapped;
+    }
+}
+
+int TimingEngine::parseTime(QStringView text, bool *ok) {
+    if (ok) *ok = false;
+    text = text.trimmed();
+    bool negative = false;
+    if (text.startsWith(u'-') || text.startsWith(u'+')) {
+        negative = text.startsWith(u'-');
+        text = text.mid(1);
+    }
+    if (text.isEmpty()) return 0;
+
+    // split off the fraction, then read up to three ':'-separated fields
+    qsizetype sep = text.indexOf(u',');
+    if (sep < 0) sep = text.indexOf(u'.');
+    QStringView clock = sep < 0 ? text : text.left(sep);
+    QStringView frac = sep < 0 ? QStringView() : text.mid(sep + 1);
+
+    qint64 ms = 0;
+    const QList<QStringView> fields = clock.split(u':');
+    if (fields.size() > 3) return 0;
+    if (fields.size() == 1 && sep < 0) {
+        // plain number: milliseconds
+        bool numOk = false;
+        ms = fields.first().toLongLong(&numOk);
+        if (!numOk) return 0;
+    } else {
+        for (QStringView f : fields) {
+            bool numOk = false;
+            const qint64 v = f.toLongLong(&numOk);
+            if (!numOk || v < 0) return 0;
+            ms = ms * 60 + v;
+        }
+        ms *= 1000;
+        if (!frac.isEmpty()) {
+            if (frac.size() > 3) return 0;
+            bool numOk = false;
+            const int v = frac.toInt(&numOk);
+            if (!numOk || v < 0) return 0;
+            static const int scale[] = { 0, 100, 10, 1 };
+            ms += v * scale[frac.size()];
+        }
+    }
+    if (ms > std::numeric_limits<int>::max()) return 0;
+    if (ok) *ok = true;
+    return int(negative ? -ms : ms);
+}
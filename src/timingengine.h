@@ -0,0 +1,39 @@
+#pragma once
+#include <QString>
+#include <QStringView>
+#include <QVector>
+
+// Exact frame rate as a fraction (23.976 is 24000/1001).
+struct Framerate {
+    int num = 25;
+    int den = 1;
+
+    QString name() const;
+    static QVector<Framerate> common(); // 23.976, 24, 25, 29.97, 30
+};
+
+// Bulk retiming kernels over contiguous millisecond arrays. Every operation is
+// integer arithmetic with round-half-away-from-zero, so results never drift
+// from what saveSrt writes. Entries equal to 'noTime' are left untouched and
+// results are clamped to [0, SubtitleStore::MaxTime]. The loops are branch-free apart from the noTime
+// select so the compiler can vectorize them.
+class TimingEngine {
+public:
+    // t + deltaMs
+    static void shift(int *t, qsizetype n, int deltaMs, int noTime);
+
+    // Linear map that sends fromA -> toA and fromB -> toB (two-point sync).
+    // Requires fromA != fromB.
+    static void sync(int *t, qsizetype n, int fromA, int toA, int fromB, int toB, int noTime);
+
+    // Keeps every cue on the same frame number when the video is re-timed from
+    // one rate to the other: t * from / to.
+    static void convertFramerate(int *t, qsizetype n, Framerate from, Framerate to, int noTime);
+
+    // Rounds every time to the nearest frame boundary of 'fps'.
+    static void snapToFrame(int *t, qsizetype n, Framerate fps, int noTime);
+
+    // Parses "[-]HH:MM:SS,mmm" (also '.', and shorter forms like "MM:SS,mmm",
+    // "SS.mmm" or plain milliseconds).
+    static int parseTime(QStringView text, bool *ok = nullptr);
+};
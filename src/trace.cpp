@@ -0,0 +1,130 @@
+#include "trace.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace {
+
+struct Event {
+    const char *name;
+    qint64 startNs;
+    qint64 durationNs;
+};
+
+// Written by its thread only; 'written' is published after each event.
+struct Buffer {
+    int thread = 0;
+    QByteArray threadName;
+    std::atomic<quint64> written { 0 };
+    std::unique_ptr<Event[]> events { new Event[Trace::EventsPerThread] };
+};
+
+// Buffers live until exit, so spans of finished threads can still be
+// exported.
+struct Registry {
+    QMutex mutex;
+    std::vector<std::unique_ptr<Buffer>> buffers;
+};
+
+Registry &registry() {
+    static Registry r;
+    return r;
+}
+
+thread_local Buffer *threadBuffer = nullptr;
+
+Buffer *currentBuffer() {
+    if (threadBuffer) return threadBuffer;
+    auto buffer = std::make_unique<Buffer>();
+    QThread *thread = QThread::currentThread();
+    const QCoreApplication *app = QCoreApplication::instance();
+    Registry &r = registry();
+    QMutexLocker lock(&r.mutex);
+    buffer->thread = int(r.buffers.size()) + 1;
+    if (app && thread == app->thread()) buffer->threadName = "GUI";
+    else if (!thread->objectName().isEmpty()) buffer->threadName = thread->objectName().toUtf8();
+    else buffer->threadName = "Thread " + QByteArray::number(buffer->thread);
+    threadBuffer = buffer.get();
+    r.buffers.push_back(std::move(buffer));
+    return threadBuffer;
+}
+
+void appendJsonString(QByteArray &out, const char *s) {
+    out += '"';
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') out += '\\';
+        out += *s;
+    }
+    out += '"';
+}
+
+} // namespace
+
+void Trace::setEnabled(bool enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+qint64 Trace::nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::record(const char *name, qint64 startNs, qint64 durationNs) {
+    Buffer *b = currentBuffer();
+    const quint64 n = b->written.load(std::memory_order_relaxed);
+    b->events[n % EventsPerThread] = { name, startNs, durationNs };
+    b->written.store(n + 1, std::memory_order_release);
+}
+
+bool Trace::writeJson(const QString &path) {
+    struct Span {
+        int thread;
+        Event event;
+    };
+    std::vector<Span> spans;
+    QByteArray out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    bool first = true;
+    {
+        Registry &r = registry();
+        QMutexLocker lock(&r.mutex);
+        for (const auto &b : r.buffers) {
+            const quint64 written = b->written.load(std::memory_order_acquire);
+            const quint64 kept = qMin<quint64>(written, EventsPerThread);
+            for (quint64 i = written - kept; i < written; ++i)
+                spans.push_back({ b->thread, b->events[i % EventsPerThread] });
+            // names the thread's track
+            out += first ? "" : ",";
+            out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":"
+                   + QByteArray::number(b->thread) + ",\"args\":{\"name\":";
+            appendJsonString(out, b->threadName.constData());
+            out += "}}";
+            first = false;
+        }
+    }
+
+    // times in microseconds from the first span
+    qint64 origin = std::numeric_limits<qint64>::max();
+    for (const Span &s : spans) origin = qMin(origin, s.event.startNs);
+    out.reserve(out.size() + qsizetype(spans.size()) * 96);
+    for (const Span &s : spans) {
+        out += first ? "{" : ",{";
+        first = false;
+        out += "\"name\":";
+        appendJsonString(out, s.event.name);
+        out += ",\"cat\":\"substudio\",\"ph\":\"X\",\"ts\":"
+               + QByteArray::number((s.event.startNs - origin) / 1000.0, 'f', 3)
+               + ",\"dur\":" + QByteArray::number(s.event.durationNs / 1000.0, 'f', 3)
+               + ",\"pid\":" + pid + ",\"tid\":" + QByteArray::number(s.thread) + "}";
+    }
+    out += "]}\n";
+
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    return f.write(out) == out.size();
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <QString>
+#include <atomic>
+
+// Always-compiled tracing: scoped spans (TRACE_SCOPE) are recorded into a
+// ring buffer per thread and exported as Chrome trace JSON, which
+// chrome://tracing and ui.perfetto.dev open. While disabled a span costs one
+// relaxed atomic load; while enabled, two clock reads and a store into the
+// thread's own buffer (no lock).
+class Trace {
+public:
+    // Newest spans kept per thread.
+    static constexpr int EventsPerThread = 1 << 15;
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled() { return enabled_.load(std::memory_order_relaxed); }
+    // Monotonic clock the spans are measured with.
+    static qint64 nowNs();
+    // Records a finished span on the calling thread. 'name' must outlive the
+    // process's tracing (a string literal): only the pointer is kept.
+    static void record(const char *name, qint64 startNs, qint64 durationNs);
+    // Writes every span still buffered. Meant for when recording has
+    // stopped (spans recorded meanwhile may be torn).
+    static bool writeJson(const QString &path);
+
+private:
+    static inline std::atomic<bool> enabled_ { false };
+};
+
+// Records its own lifetime as a span, if tracing was enabled when it began.
+class TraceScope {
+public:
+    explicit TraceScope(const char *name) : name_(name), startNs_(Trace::isEnabled() ? Trace::nowNs() : -1) {}
+    ~TraceScope() {
+        if (startNs_ >= 0) Trace::record(name_, startNs_, Trace::nowNs() - startNs_);
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *name_;
+    qint64 startNs_;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+// Traces the rest of the enclosing block as 'name' (a string literal).
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
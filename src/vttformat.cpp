@@ -0,0 +1,225 @@
+#include "vttformat.h"
+#include "srtwriter.h"
+#include "subtitlemarkup.h"
+#include "texttokenizer.h"
+#include <cstring>
+
+namespace {
+
+using namespace TextScan;
+
+// "[HH:]MM:SS.mmm" at 'p'; returns the position after it, or nullptr.
+template<typename Unit>
+const Unit *scanTime(const Unit *p, const Unit *e, int &ms) {
+    int groups[3];
+    int count = 0;
+    for (;;) {
+        const Unit *digits = p;
+        int value = 0;
+        while (p < e && isDigit(*p) && p - digits < 4) value = value * 10 + (*p++ - '0');
+        // hours may have more than two digits, minutes and seconds have two
+        if (p == digits || (count > 0 && p - digits != 2)) return nullptr;
+        groups[count++] = value;
+        if (p < e && *p == ':' && count < 3) {
+            ++p;
+            continue;
+        }
+        break;
+    }
+    if (count < 2 || e - p < 4 || *p != '.' || !isDigit(p[1]) || !isDigit(p[2]) || !isDigit(p[3]))
+        return nullptr;
+    const int hours = count == 3 ? groups[0] : 0;
+    const int minutes = groups[count - 2];
+    const int seconds = groups[count - 1];
+    if (count == 2 && minutes > 99) return nullptr;
+    // the other formats stop at 99 hours
+    const qint64 value = hours * qint64(3600000) + minutes * 60000 + seconds * 1000 + fractionMs(p + 1, 3);
+    if (value > SubtitleStore::MaxTime) return nullptr;
+    ms = int(value);
+    return p + 4;
+}
+
+template<typename Unit>
+bool hasArrow(const Unit *b, const Unit *e) {
+    for (const Unit *p = b; (p = findUnit(p, e, Unit('-'))) && e - p >= 3; ++p) {
+        if (p[1] == '-' && p[2] == '>') return true;
+    }
+    return false;
+}
+
+// "start --> end [settings]"; 'settings' is left empty when there are none.
+template<typename Unit, typename Decoder>
+bool scanTimingLine(const Unit *b, const Unit *e, int &startMs, int &endMs,
+                    const Unit *&settingsBegin, const Unit *&settingsEnd, const Decoder &decoder)
+{
+    trim(b, e, decoder);
+    const Unit *p = scanTime(b, e, startMs);
+    if (!p) return false;
+    p = skipSpace(p, e, decoder);
+    if (!startsWith(p, e, "-->")) return false;
+    p += 3;
+    p = skipSpace(p, e, decoder);
+    p = scanTime(p, e, endMs);
+    if (!p || (p < e && !spaceAt(p, e, decoder))) return false;
+    settingsBegin = p;
+    settingsEnd = e;
+    trim(settingsBegin, settingsEnd, decoder);
+    return true;
+}
+
+// Header blocks (and the NOTE comments that may follow cues) are never cues,
+// whatever their second line holds.
+template<typename Unit>
+bool isHeaderBlock(const Unit *b, const Unit *e) {
+    return startsWith(b, e, "WEBVTT") || startsWith(b, e, "NOTE") || startsWith(b, e, "STYLE")
+           || startsWith(b, e, "REGION");
+}
+
+template<typename Unit, typename Decoder>
+void readUnits(const Unit *begin, const Unit *end, SubtitleStore &out, Decoder decoder) {
+    const Unit *headerEnd = end; // first cue block
+    int cues = 0;
+
+    const Unit *p = begin;
+    while (p < end) {
+        const Unit *next;
+        const Unit *le = lineEnd(p, end, next);
+        if (isBlank(p, le, decoder)) {
+            p = next;
+            continue;
+        }
+
+        // a cue block: optional identifier line, then the timing line
+        const Unit *block = p;
+        const Unit *idBegin = nullptr;
+        const Unit *idEnd = nullptr;
+        const Unit *timing = p;
+        const Unit *timingEnd = le;
+        if (!hasArrow(p, le) && !isHeaderBlock(p, le)) {
+            const Unit *afterTiming;
+            const Unit *secondEnd = lineEnd(next, end, afterTiming);
+            if (next < end && !isBlank(next, secondEnd, decoder)) {
+                idBegin = p;
+                idEnd = le;
+                timing = next;
+                timingEnd = secondEnd;
+                next = afterTiming;
+            }
+        }
+        int startMs = 0;
+        int endMs = 0;
+        const Unit *settingsBegin = nullptr;
+        const Unit *settingsEnd = nullptr;
+        const bool isCue = !isHeaderBlock(block, le)
+                           && scanTimingLine(timing, timingEnd, startMs, endMs, settingsBegin, settingsEnd, decoder);
+        p = next;
+
+        // the text (or, for other blocks, the rest of the block) runs up to
+        // the next blank line
+        const Unit *textBegin = nullptr;
+        const Unit *textEnd = nullptr;
+        while (p < end) {
+            const Unit *lineNext;
+            const Unit *lineStop = lineEnd(p, end, lineNext);
+            if (isBlank(p, lineStop, decoder)) break;
+            if (!textBegin) textBegin = p;
+            textEnd = lineStop;
+            p = lineNext;
+        }
+        if (!isCue) continue;
+        if (headerEnd == end) headerEnd = block;
+
+        CueLayout layout;
+        int lineNumber;
+        ++cues;
+        if (idBegin) {
+            trim(idBegin, idEnd, decoder);
+            layout.identifier = out.layoutStringId(decodeField(decoder, idBegin, idEnd));
+        }
+        // cues without a numeric identifier are numbered by position
+        if (!idBegin || !parseInt(idBegin, idEnd, lineNumber, decoder)) lineNumber = cues;
+        if (settingsBegin < settingsEnd)
+            layout.settings = out.layoutStringId(decodeField(decoder, settingsBegin, settingsEnd));
+
+        const qsizetype len = textBegin ? textEnd - textBegin : 0;
+        QChar *text = out.beginText(decoder.requiredSpace(len));
+        QChar *written = text;
+        if (len > 0) {
+            written = decoder.append(text, textBegin, len);
+            if (findUnit(textBegin, textEnd, Unit('\r'))) written = foldCrLf(text, written);
+        }
+        out.commitCue(lineNumber, startMs, endMs, written);
+        out.setLayout(out.size() - 1, layout);
+    }
+
+    QString header = decodeField(decoder, begin, headerEnd);
+    header.remove(u'\r');
+    out.setHeader(header);
+}
+
+// "HH:MM:SS.mmm"
+void appendTime(SrtWriter &writer, int ms) {
+    char buf[24];
+    char *p = SubtitleStore::formatTime(qMax(0, ms), buf);
+    *std::strchr(buf, ',') = '.';
+    writer.appendAscii(buf, p - buf);
+}
+
+} // namespace
+
+bool VttFormat::sniff(QStringView head) const {
+    if (!head.startsWith(QLatin1StringView("WEBVTT"))) return false;
+    return head.size() == 6 || head.at(6) == u' ' || head.at(6) == u'\t' || head.at(6) == u'\n'
+           || head.at(6) == u'\r';
+}
+
+void VttFormat::read(const char *begin, const char *end, TextEncoding::Kind encoding,
+                     SubtitleStore &out) const
+{
+    withUnits(begin, end, encoding, [&](auto b, auto e, auto decoder) {
+        readUnits(b, e, out, decoder);
+    });
+}
+
+void VttFormat::write(SrtWriter &writer, const SubtitleStore &store) const {
+    // the header is kept only when it came from a WebVTT file
+    if (sniff(store.header())) {
+        QStringView header = store.header();
+        while (header.endsWith(u'\n')) header.chop(1);
+        writer.appendText(header);
+    } else {
+        writer.appendAscii("WEBVTT", 6);
+    }
+    writer.appendLineBreak();
+    writer.appendLineBreak();
+
+    const bool overrides = SubtitleMarkup::usesOverrides(store);
+    QString converted;
+    for (qsizetype i = 0; i < store.size() && !writer.failed(); ++i) {
+        const CueLayout layout = store.layout(i);
+        // ASS comment events have no place in WebVTT
+        if (layout.comment) continue;
+        if (layout.identifier) {
+            writer.appendEncoded(store.layoutString(layout.identifier));
+            writer.appendLineBreak();
+        }
+        appendTime(writer, store.startMs(i));
+        writer.appendAscii(" --> ", 5);
+        appendTime(writer, store.endMs(i));
+        if (layout.settings) {
+            writer.appendAscii(" ", 1);
+            writer.appendEncoded(store.layoutString(layout.settings));
+        }
+        writer.appendLineBreak();
+        QStringView text = store.textView(i);
+        if (overrides && SubtitleMarkup::needsTags(text, WebVtt)) {
+            SubtitleMarkup::toTags(text, WebVtt, converted);
+            text = converted;
+        }
+        if (!text.isEmpty()) {
+            writer.appendText(text);
+            writer.appendLineBreak();
+        }
+        writer.appendLineBreak();
+    }
+}
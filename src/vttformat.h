@@ -0,0 +1,18 @@
+#pragma once
+#include "subtitleformat.h"
+
+// WebVTT. The "WEBVTT" line and the STYLE, REGION and NOTE blocks in front
+// of the first cue are kept verbatim as the store's header; blocks between
+// cues that are not cues are dropped. Cue identifiers and settings go to the
+// CueLayout side table; a numeric identifier also becomes the line number.
+class VttFormat : public SubtitleFormat {
+public:
+    Id id() const override { return WebVtt; }
+    QString name() const override { return QStringLiteral("WebVTT"); }
+    QString key() const override { return QStringLiteral("vtt"); }
+    QStringList suffixes() const override { return { QStringLiteral("vtt") }; }
+    bool sniff(QStringView head) const override;
+    void read(const char *begin, const char *end, TextEncoding::Kind encoding,
+              SubtitleStore &out) const override;
+    void write(SrtWriter &writer, const SubtitleStore &store) const override;
+};